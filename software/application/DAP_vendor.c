@@ -0,0 +1,98 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "swj_tune.h"
+#include "core_reg.h"
+#include "halt_mon.h"
+#include "profile.h"
+#include "serial.h"
+#include "isp.h"
+#include "bench.h"
+#include "trace.h"
+
+/* Process vendor specific command and prepare response, overrides the weak default in DAP.c.
+ * request:  pointer to request data.
+ * response: pointer to response data.
+ * return:   number of bytes in response (lower 16 bits), number of bytes in request (upper 16 bits).
+ */
+uint32_t DAP_ProcessVendorCommand(const uint8_t *request, uint8_t *response)
+{
+    uint32_t num = (1u << 16) | 1u;
+
+    *response++ = *request; /* copy Command ID. */
+
+    switch (*request++)
+    {
+        case ID_DAP_VENDOR_SWJ_TUNE:
+            num += swj_tune_command(request, response);
+            break;
+        case ID_DAP_VENDOR_CORE_REG_READ:
+            num += core_reg_read_command(request, response);
+            break;
+        case ID_DAP_VENDOR_CORE_REG_WRITE:
+            num += core_reg_write_command(request, response);
+            break;
+        case ID_DAP_VENDOR_HALT_MON:
+            num += halt_mon_command(request, response);
+            break;
+        case ID_DAP_VENDOR_PROFILE:
+            num += profile_command(request, response);
+            break;
+        case ID_DAP_VENDOR_SERIAL_STATUS:
+            num += serial_status_command(request, response);
+            break;
+        case ID_DAP_VENDOR_SERIAL_CONFIG:
+            num += serial_config_command(request, response);
+            break;
+        case ID_DAP_VENDOR_SERIAL_CAPTURE:
+            num += serial_capture_command(request, response);
+            break;
+        case ID_DAP_VENDOR_SERIAL_AUTOBAUD:
+            num += serial_autobaud_command(request, response);
+            break;
+        case ID_DAP_VENDOR_ISP_START:
+            num += isp_start_command(request, response);
+            break;
+        case ID_DAP_VENDOR_ISP_STATUS:
+            num += isp_status_command(request, response);
+            break;
+        case ID_DAP_VENDOR_BENCH:
+            num += bench_command(request, response);
+            break;
+        case ID_DAP_VENDOR_TRACE:
+            num += trace_command(request, response);
+            break;
+        default:
+            *(response - 1) = ID_DAP_Invalid;
+            break;
+    }
+
+    return num;
+}
+
+/* DAP_vendor.c - end */
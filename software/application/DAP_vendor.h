@@ -0,0 +1,60 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef DAP_VENDOR_H
+#define DAP_VENDOR_H
+
+#include <stdint.h>
+
+/* vendor command ids, see the matching *_command() handler for the payload layout. */
+#define ID_DAP_VENDOR_SWJ_TUNE         0x80u /* SWD clock auto-tune. */
+#define ID_DAP_VENDOR_CORE_REG_READ    0x81u /* batched core register read. */
+#define ID_DAP_VENDOR_CORE_REG_WRITE   0x82u /* batched core register write. */
+#define ID_DAP_VENDOR_HALT_MON         0x83u /* probe-side halt detection. */
+#define ID_DAP_VENDOR_PROFILE          0x84u /* pc-sampling profiler. */
+#define ID_DAP_VENDOR_SERIAL_STATUS    0x85u /* per-channel uart baud rate and error counters. */
+#define ID_DAP_VENDOR_SERIAL_CONFIG    0x86u /* per-channel uart flow control. */
+#define ID_DAP_VENDOR_SERIAL_CAPTURE   0x87u /* timestamped uart rx capture to the stream. */
+#define ID_DAP_VENDOR_SERIAL_AUTOBAUD  0x88u /* uart rx bit rate detection. */
+#define ID_DAP_VENDOR_ISP_START        0x89u /* uart bootloader programming. */
+#define ID_DAP_VENDOR_ISP_STATUS       0x8Au /* uart bootloader programming progress. */
+#define ID_DAP_VENDOR_BENCH            0x8Bu /* probe self-benchmarks. */
+#define ID_DAP_VENDOR_TRACE            0x8Cu /* usb and dap event trace download. */
+
+/* little endian helpers for command payloads. */
+static inline uint32_t dap_get_le32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static inline void dap_put_le32(uint8_t *buf, uint32_t val)
+{
+    buf[0] = (uint8_t)(val);
+    buf[1] = (uint8_t)(val >> 8);
+    buf[2] = (uint8_t)(val >> 16);
+    buf[3] = (uint8_t)(val >> 24);
+}
+
+#endif /* DAP_VENDOR_H */
@@ -0,0 +1,370 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "platform.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "target.h"
+#include "serial.h"
+#include "bench.h"
+
+#define BENCH_USB_ECHO_MAX      (DAP_PACKET_SIZE - 10u) /* command id, status, packets, ticks. */
+#define BENCH_SWD_CHUNK         64u  /* words per timed block read / write. */
+#define BENCH_UART_SLACK        PLATFORM_MS_TO_TICKS(50u)
+
+/* usb loopback. */
+static uint32_t bench_usb_packets = 0u;
+static uint32_t bench_usb_start;
+
+/* swd block test buffer, the words read are written back unchanged. */
+static uint32_t bench_swd_buf[BENCH_SWD_CHUNK];
+
+/* uart loopback. */
+static uint8_t  bench_uart_state = BENCH_UART_IDLE;
+static uint8_t  bench_uart_error = BENCH_ERROR_NONE;
+static uint8_t  bench_uart_channel;
+static uint8_t  bench_uart_rx_errors; /* UART_ERROR_xxx bits seen. */
+static uint32_t bench_uart_baud;      /* rate the uart actually runs at. */
+static uint32_t bench_uart_bytes;
+static uint32_t bench_uart_sent;
+static uint32_t bench_uart_received;
+static uint32_t bench_uart_mismatches;
+static uint32_t bench_uart_start;     /* first tx byte queued. */
+static uint32_t bench_uart_last;      /* last rx byte seen. */
+static uint32_t bench_uart_timeout;   /* rx silence that ends the test. */
+
+static uint8_t bench_uart_pattern(uint32_t i)
+{
+    return (uint8_t)(i ^ (i >> 8));
+}
+
+static void bench_set_clock(uint32_t clock)
+{
+    uint8_t request[5];
+    uint8_t response[2];
+    request[0] = ID_DAP_SWJ_Clock;
+    dap_put_le32(&request[1], clock);
+    DAP_ProcessCommand(request, response);
+}
+
+/* swclk cycles SWD_Transfer clocks out for a DP read that ended with ack. an open line reads
+ * no ack, the transfer then backs off over the data phase, so it is as long as a good read.
+ */
+static uint32_t bench_transfer_bits(uint8_t ack)
+{
+    uint32_t trn = DAP_Data.swd_conf.turnaround;
+
+    if ( (DAP_TRANSFER_WAIT == ack) || (DAP_TRANSFER_FAULT == ack) )
+    {
+        return 8u + trn + 3u + trn + ((0u != DAP_Data.swd_conf.data_phase) ? 33u : 0u);
+    }
+    if (DAP_TRANSFER_OK == ack)
+    {
+        return 8u + trn + 3u + 33u + trn + DAP_Data.transfer.idle_cycles;
+    }
+    return 8u + trn + 3u + trn + 33u;
+}
+
+/* request: flags (1) BENCH_USB_xxx, length (1), payload (length).
+ * response: status (1), packets since the reset (4), ticks since the reset (4), payload echoed.
+ * the host fills every report, so the full packet goes both ways.
+ */
+static uint32_t bench_usb(const uint8_t *request, uint8_t *response)
+{
+    uint32_t len = request[1];
+    uint32_t n   = (len > BENCH_USB_ECHO_MAX) ? BENCH_USB_ECHO_MAX : len;
+    uint32_t now = platform_timer_get();
+
+    if ( (0u != (request[0] & BENCH_USB_RESET)) || (0u == bench_usb_packets) )
+    {
+        bench_usb_packets = 0u;
+        bench_usb_start   = now;
+    }
+    bench_usb_packets++;
+    response[0] = DAP_OK;
+    dap_put_le32(&response[1], bench_usb_packets);
+    dap_put_le32(&response[5], now - bench_usb_start);
+    for (uint32_t i = 0u; i < n; i++)
+    {
+        response[9u + i] = request[2u + i];
+    }
+    return ((2u + len) << 16) | (9u + n);
+}
+
+/* request: transfers per clock (2), count (1), clocks (4 each, up to BENCH_SWCLK_MAX).
+ * response: status (1), count (1), per clock: clock (4), swclk cycles (4), ticks (4).
+ * times IDCODE reads at each clock, with or without a target on the wire, and puts the
+ * host's clock setting back afterwards.
+ */
+static uint32_t bench_swclk(const uint8_t *request, uint8_t *response)
+{
+    uint32_t transfers = (uint32_t)request[0] | ((uint32_t)request[1] << 8);
+    uint32_t count     = request[2];
+    uint32_t num       = ((3u + 4u * count) << 16) | 2u;
+
+    response[0] = DAP_ERROR;
+    response[1] = 0u;
+    if ( (DAP_PORT_SWD != DAP_Data.debug_port) || (count > BENCH_SWCLK_MAX) )
+    {
+        return num;
+    }
+
+    uint8_t  fast  = DAP_Data.fast_clock;
+    uint32_t delay = DAP_Data.clock_delay;
+    for (uint32_t i = 0u; i < count; i++)
+    {
+        uint32_t clock = dap_get_le32(&request[3u + 4u * i]);
+        uint32_t bits  = 0u;
+        bench_set_clock(clock);
+
+        uint32_t start = platform_timer_get();
+        for (uint32_t j = 0u; j < transfers; j++)
+        {
+            uint32_t val;
+            bits += bench_transfer_bits(SWD_Transfer(DAP_TRANSFER_RnW | DP_IDCODE, &val));
+        }
+        uint32_t ticks = platform_timer_get() - start;
+
+        dap_put_le32(&response[2u + 12u * i], clock);
+        dap_put_le32(&response[6u + 12u * i], bits);
+        dap_put_le32(&response[10u + 12u * i], ticks);
+    }
+    DAP_Data.fast_clock  = fast;
+    DAP_Data.clock_delay = delay;
+
+    response[0] = DAP_OK;
+    response[1] = (uint8_t)count;
+    return num + (12u * count);
+}
+
+/* request: target ram address (4), words (4).
+ * response: status (1), ack (1), words done (4), read ticks (4), write ticks (4).
+ * reads the range in BENCH_SWD_CHUNK word blocks and writes each block back unchanged, so
+ * the target must not be writing that memory meanwhile.
+ */
+static uint32_t bench_swd(const uint8_t *request, uint8_t *response)
+{
+    uint32_t addr        = dap_get_le32(&request[0]);
+    uint32_t words       = dap_get_le32(&request[4]);
+    uint32_t done        = 0u;
+    uint32_t read_ticks  = 0u;
+    uint32_t write_ticks = 0u;
+    uint8_t  ack         = DAP_TRANSFER_ERROR;
+
+    if (target_begin())
+    {
+        ack = DAP_TRANSFER_OK;
+        while ( (DAP_TRANSFER_OK == ack) && (done < words) )
+        {
+            uint32_t n = words - done;
+            if (n > BENCH_SWD_CHUNK)
+            {
+                n = BENCH_SWD_CHUNK;
+            }
+            uint32_t start = platform_timer_get();
+            ack = target_mem_read_block(addr, bench_swd_buf, n);
+            uint32_t mid = platform_timer_get();
+            if (DAP_TRANSFER_OK == ack)
+            {
+                ack = target_mem_write_block(addr, bench_swd_buf, n);
+            }
+            uint32_t end = platform_timer_get();
+            read_ticks  += mid - start;
+            write_ticks += end - mid;
+            if (DAP_TRANSFER_OK == ack)
+            {
+                done += n;
+                addr += 4u * n;
+            }
+        }
+        target_end();
+    }
+
+    response[0] = (DAP_TRANSFER_OK == ack) ? DAP_OK : DAP_ERROR;
+    response[1] = ack;
+    dap_put_le32(&response[2], done);
+    dap_put_le32(&response[6], read_ticks);
+    dap_put_le32(&response[10], write_ticks);
+    return (8u << 16) | 14u;
+}
+
+static void bench_uart_finish(uint8_t error)
+{
+    bench_uart_error = error;
+    bench_uart_state = (BENCH_ERROR_NONE == error) ? BENCH_UART_DONE : BENCH_UART_ERROR;
+    serial_claim(bench_uart_channel, false); /* puts the host's line coding back. */
+}
+
+/* request: channel (1), baud (4), bytes (4).
+ * response: status (1).
+ * needs TX wired to RX. the channel is taken from the serial bridge at 8N1 and the given
+ * rate for the test, bench_task() streams a pattern through the dma rings and checks it.
+ */
+static uint32_t bench_uart(const uint8_t *request, uint8_t *response)
+{
+    uint8_t  channel = request[0];
+    uint32_t baud    = dap_get_le32(&request[1]);
+    uint32_t bytes   = dap_get_le32(&request[5]);
+    cdc_line_coding_t coding = { .bit_rate = baud, .stop_bits = 0u, .parity = 0u, .data_bits = 8u };
+    uint8_t *buf;
+    uint32_t n;
+
+    response[0] = DAP_ERROR;
+    if (   (BENCH_UART_BUSY == bench_uart_state) || (channel >= SERIAL_CHANNEL_COUNT)
+        || serial_claimed(channel) || (0u == baud) || (0u == bytes) )
+    {
+        return (9u << 16) | 1u;
+    }
+    serial_claim(channel, true);
+    bench_uart_channel    = channel;
+    bench_uart_bytes      = bytes;
+    bench_uart_sent       = 0u;
+    bench_uart_received   = 0u;
+    bench_uart_mismatches = 0u;
+    bench_uart_rx_errors  = 0u;
+    bench_uart_baud       = 0u;
+    bench_uart_state      = BENCH_UART_BUSY;
+    if (!uart_init(channel, &coding))
+    {
+        bench_uart_finish(BENCH_ERROR_BAUD);
+        return (9u << 16) | 1u;
+    }
+    while (0u != (n = uart_rx_peek(channel, &buf)))
+    {
+        uart_rx_consume(channel, n);
+    }
+    uart_rx_errors(channel);
+    uint32_t requested;
+    int32_t  error_ppm;
+    uart_get_baud(channel, &requested, &bench_uart_baud, &error_ppm);
+    bench_uart_timeout = BENCH_UART_SLACK + (PLATFORM_TIMER_FREQ / baud) * 200u; /* 20 characters. */
+    bench_uart_error   = BENCH_ERROR_NONE;
+    response[0] = DAP_OK;
+    return (9u << 16) | 1u;
+}
+
+/* request: none.
+ * response: state (1) BENCH_UART_xxx, error (1) BENCH_ERROR_xxx, actual baud (4),
+ *           bytes received (4), mismatches (4), ticks first tx to last rx (4), rx errors (1).
+ */
+static uint32_t bench_uart_status(uint8_t *response)
+{
+    response[0] = bench_uart_state;
+    response[1] = bench_uart_error;
+    dap_put_le32(&response[2], bench_uart_baud);
+    dap_put_le32(&response[6], bench_uart_received);
+    dap_put_le32(&response[10], bench_uart_mismatches);
+    dap_put_le32(&response[14], bench_uart_last - bench_uart_start);
+    response[18] = bench_uart_rx_errors;
+    return (0u << 16) | 19u;
+}
+
+void bench_task(void)
+{
+    uint8_t *buf;
+    uint32_t n;
+
+    if (BENCH_UART_BUSY != bench_uart_state)
+    {
+        return;
+    }
+    uint32_t now = platform_timer_get();
+    if (0u == bench_uart_sent)
+    {
+        bench_uart_start = now;
+        bench_uart_last  = now;
+    }
+    while ( (bench_uart_sent < bench_uart_bytes) && (0u != (n = uart_tx_reserve(bench_uart_channel, &buf))) )
+    {
+        if (n > (bench_uart_bytes - bench_uart_sent))
+        {
+            n = bench_uart_bytes - bench_uart_sent;
+        }
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            buf[i] = bench_uart_pattern(bench_uart_sent + i);
+        }
+        uart_tx_commit(bench_uart_channel, n);
+        bench_uart_sent += n;
+    }
+    while (0u != (n = uart_rx_peek(bench_uart_channel, &buf)))
+    {
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            if (buf[i] != bench_uart_pattern(bench_uart_received + i))
+            {
+                bench_uart_mismatches++;
+            }
+        }
+        uart_rx_consume(bench_uart_channel, n);
+        bench_uart_received += n;
+        bench_uart_last = now;
+    }
+    bench_uart_rx_errors |= (uint8_t)uart_rx_errors(bench_uart_channel);
+
+    if (bench_uart_received >= bench_uart_bytes)
+    {
+        bench_uart_finish(BENCH_ERROR_NONE);
+    }
+    else if ((now - bench_uart_last) >= bench_uart_timeout)
+    {
+        bench_uart_finish(BENCH_ERROR_TIMEOUT);
+    }
+}
+
+/* request: test (1) BENCH_TEST_xxx, then the test's own request.
+ * response: the test's response, see above.
+ */
+uint32_t bench_command(const uint8_t *request, uint8_t *response)
+{
+    uint32_t num;
+
+    switch (request[0])
+    {
+        case BENCH_TEST_USB:
+            num = bench_usb(&request[1], response);
+            break;
+        case BENCH_TEST_SWCLK:
+            num = bench_swclk(&request[1], response);
+            break;
+        case BENCH_TEST_SWD:
+            num = bench_swd(&request[1], response);
+            break;
+        case BENCH_TEST_UART:
+            num = bench_uart(&request[1], response);
+            break;
+        case BENCH_TEST_UART_STATUS:
+            num = bench_uart_status(response);
+            break;
+        default:
+            response[0] = DAP_ERROR;
+            num = 1u;
+            break;
+    }
+    return num + (1u << 16);
+}
+
+/* bench.c - end */
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* tests, first request byte of ID_DAP_VENDOR_BENCH. */
+#define BENCH_TEST_USB          0x00u /* dap endpoint loopback. */
+#define BENCH_TEST_SWCLK        0x01u /* achieved swclk per clock setting. */
+#define BENCH_TEST_SWD          0x02u /* block read / write rate against the target. */
+#define BENCH_TEST_UART         0x03u /* start a uart dma loopback. */
+#define BENCH_TEST_UART_STATUS  0x04u /* uart loopback progress and result. */
+
+#define BENCH_USB_RESET         (1u << 0) /* usb flag, restart the packet count and time. */
+#define BENCH_SWCLK_MAX         5u        /* clock settings per swclk request. */
+
+/* uart loopback states and errors. */
+#define BENCH_UART_IDLE         0u
+#define BENCH_UART_BUSY         1u
+#define BENCH_UART_DONE         2u
+#define BENCH_UART_ERROR        3u
+
+#define BENCH_ERROR_NONE        0u
+#define BENCH_ERROR_BAUD        1u /* the uart refused the rate. */
+#define BENCH_ERROR_TIMEOUT     2u /* rx stopped short, no loopback wire? */
+
+/* probe self-benchmark api. times are PLATFORM_TIMER_FREQ ticks, the host turns them into rates. */
+void     bench_task(void);
+uint32_t bench_command(const uint8_t *request, uint8_t *response);
+
+#endif /* BENCH_H */
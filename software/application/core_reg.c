@@ -0,0 +1,175 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "target.h"
+#include "core_reg.h"
+
+#define CORE_REG_READY_RETRY    100u
+#define CORE_REG_READ_MAX       ((DAP_PACKET_SIZE - 3u) / 4u) /* id, status, count, values. */
+#define CORE_REG_WRITE_MAX      ((DAP_PACKET_SIZE - 5u) / 4u) /* id, mask, values. */
+
+static uint8_t core_reg_wait_ready(void)
+{
+    uint32_t dhcsr;
+    for (uint32_t i = 0u; i < CORE_REG_READY_RETRY; i++)
+    {
+        uint8_t ack = target_mem_read(TARGET_DHCSR, &dhcsr);
+        if (DAP_TRANSFER_OK != ack)
+        {
+            return ack;
+        }
+        if (0u != (dhcsr & TARGET_DHCSR_S_REGRDY))
+        {
+            return DAP_TRANSFER_OK;
+        }
+    }
+    return DAP_TRANSFER_ERROR;
+}
+
+static uint8_t core_reg_check_halted(void)
+{
+    uint32_t dhcsr;
+    uint8_t ack = target_mem_read(TARGET_DHCSR, &dhcsr);
+    if ( (DAP_TRANSFER_OK == ack) && (0u == (dhcsr & TARGET_DHCSR_S_HALT)) )
+    {
+        ack = DAP_TRANSFER_ERROR; /* DCRSR only works in debug state. */
+    }
+    return ack;
+}
+
+/* read up to max of the selected registers in REGSEL order, returns the number read. */
+uint32_t core_reg_read(uint32_t mask, uint32_t *val, uint32_t max, uint8_t *ack)
+{
+    uint32_t n = 0u;
+
+    *ack = core_reg_check_halted();
+    for (uint32_t sel = 0u; (sel < 32u) && (n < max) && (DAP_TRANSFER_OK == *ack); sel++)
+    {
+        if (0u == (mask & (1u << sel)))
+        {
+            continue;
+        }
+        *ack = target_mem_write(TARGET_DCRSR, sel);
+        if (DAP_TRANSFER_OK == *ack)
+        {
+            *ack = core_reg_wait_ready();
+        }
+        if (DAP_TRANSFER_OK == *ack)
+        {
+            *ack = target_mem_read(TARGET_DCRDR, &val[n]);
+        }
+        if (DAP_TRANSFER_OK == *ack)
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+/* write up to max of the selected registers from little endian words, returns the number written. */
+uint32_t core_reg_write(uint32_t mask, const uint8_t *val, uint32_t max, uint8_t *ack)
+{
+    uint32_t n = 0u;
+
+    *ack = core_reg_check_halted();
+    for (uint32_t sel = 0u; (sel < 32u) && (n < max) && (DAP_TRANSFER_OK == *ack); sel++)
+    {
+        if (0u == (mask & (1u << sel)))
+        {
+            continue;
+        }
+        *ack = target_mem_write(TARGET_DCRDR, dap_get_le32(&val[4u * n]));
+        if (DAP_TRANSFER_OK == *ack)
+        {
+            *ack = target_mem_write(TARGET_DCRSR, sel | TARGET_DCRSR_REGWnR);
+        }
+        if (DAP_TRANSFER_OK == *ack)
+        {
+            *ack = core_reg_wait_ready();
+        }
+        if (DAP_TRANSFER_OK == *ack)
+        {
+            n++;
+        }
+    }
+    return n;
+}
+
+/* request: register mask (4).
+ * response: status (1), count (1), count register values (4 each) in REGSEL order.
+ * at most CORE_REG_READ_MAX registers fit, the host asks again for the rest.
+ */
+uint32_t core_reg_read_command(const uint8_t *request, uint8_t *response)
+{
+    uint32_t val[CORE_REG_READ_MAX];
+    uint8_t  ack = DAP_TRANSFER_ERROR;
+    uint32_t n = 0u;
+
+    if (target_begin())
+    {
+        n = core_reg_read(dap_get_le32(request), val, CORE_REG_READ_MAX, &ack);
+        target_end();
+    }
+    response[0] = (DAP_TRANSFER_OK == ack) ? DAP_OK : DAP_ERROR;
+    response[1] = (uint8_t)n;
+    for (uint32_t i = 0u; i < n; i++)
+    {
+        dap_put_le32(&response[2u + 4u * i], val[i]);
+    }
+    return (4u << 16) | (2u + 4u * n);
+}
+
+/* request: register mask (4), one value (4) per selected register in REGSEL order.
+ * response: status (1), count written (1).
+ */
+uint32_t core_reg_write_command(const uint8_t *request, uint8_t *response)
+{
+    uint32_t mask = dap_get_le32(request);
+    uint32_t num = 0u;
+    uint8_t  ack = DAP_TRANSFER_ERROR;
+    uint32_t n = 0u;
+
+    for (uint32_t sel = 0u; sel < 32u; sel++)
+    {
+        num += (mask >> sel) & 1u;
+    }
+    if (num > CORE_REG_WRITE_MAX)
+    {
+        num = CORE_REG_WRITE_MAX;
+    }
+    if (target_begin())
+    {
+        n = core_reg_write(mask, &request[4], num, &ack);
+        target_end();
+    }
+    response[0] = (DAP_TRANSFER_OK == ack) ? DAP_OK : DAP_ERROR;
+    response[1] = (uint8_t)n;
+    return ((4u + 4u * num) << 16) | 2u;
+}
+
+/* core_reg.c - end */
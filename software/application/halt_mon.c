@@ -0,0 +1,174 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "platform.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "target.h"
+#include "core_reg.h"
+#include "stream.h"
+#include "halt_mon.h"
+
+#define HALT_MON_REGSEL_MASK    0x0007C000u /* LR, PC, xPSR, MSP, PSP. */
+#define HALT_MON_IPSR_MASK      0x1FFu
+#define HALT_MON_EXC_RETURN     0xFFFFFFF0u
+#define HALT_MON_EXC_RETURN_PSP (1u << 2)
+
+enum
+{
+    HALT_MON_REG_LR = 0,
+    HALT_MON_REG_PC,
+    HALT_MON_REG_XPSR,
+    HALT_MON_REG_MSP,
+    HALT_MON_REG_PSP,
+    HALT_MON_REG_COUNT,
+};
+
+static uint32_t halt_mon_interval = 0u; /* timer ticks between polls, 0 = disabled. */
+static uint8_t  halt_mon_flags    = 0u;
+static uint32_t halt_mon_last     = 0u;
+static bool     halt_mon_primed   = false; /* previous state is known. */
+static bool     halt_mon_halted   = false;
+
+void halt_mon_config(uint32_t interval_ms, uint8_t flags)
+{
+    halt_mon_flags    = flags;
+    halt_mon_interval = PLATFORM_MS_TO_TICKS(interval_ms);
+    halt_mon_last     = platform_timer_get();
+    halt_mon_primed   = false;
+}
+
+/* HardFault..UsageFault active, or halted by a vector catch. */
+static bool halt_mon_is_fault(uint32_t xpsr, uint32_t dfsr)
+{
+    uint32_t ipsr = xpsr & HALT_MON_IPSR_MASK;
+    return ( (ipsr >= 3u) && (ipsr <= 6u) ) || (0u != (dfsr & TARGET_DFSR_VCATCH));
+}
+
+/* fault snapshot: timestamp, CFSR, HFSR, DFSR, MMFAR, BFAR, LR, PC, xPSR, MSP,
+ * PSP, then the 8 stacked words R0-R3, R12, LR, PC, xPSR. fault registers that
+ * do not exist on the target (armv6-m) read as zero.
+ */
+static void halt_mon_snapshot(uint32_t timestamp, const uint32_t *regs)
+{
+    uint32_t words[1u + 5u + HALT_MON_REG_COUNT + 8u] = {0u};
+    uint32_t lr = regs[HALT_MON_REG_LR];
+    uint32_t sp = regs[HALT_MON_REG_MSP];
+    if ( (HALT_MON_EXC_RETURN == (lr & HALT_MON_EXC_RETURN)) && (0u != (lr & HALT_MON_EXC_RETURN_PSP)) )
+    {
+        sp = regs[HALT_MON_REG_PSP]; /* frame was stacked on the process stack. */
+    }
+    uint8_t  payload[sizeof(words)];
+
+    words[0] = timestamp;
+    if (DAP_TRANSFER_OK != target_mem_read_block(TARGET_CFSR, &words[1], 5u))
+    {
+        for (uint32_t i = 1u; i < 6u; i++)
+        {
+            words[i] = 0u;
+        }
+        target_mem_read(TARGET_DFSR, &words[3]);
+    }
+    for (uint32_t i = 0u; i < HALT_MON_REG_COUNT; i++)
+    {
+        words[6u + i] = regs[i];
+    }
+    target_mem_read_block(sp & ~3u, &words[6u + HALT_MON_REG_COUNT], 8u);
+
+    for (uint32_t i = 0u; i < (sizeof(words) / 4u); i++)
+    {
+        dap_put_le32(&payload[4u * i], words[i]);
+    }
+    stream_push(STREAM_TYPE_FAULT, payload, sizeof(payload));
+}
+
+static void halt_mon_report(uint32_t dhcsr)
+{
+    uint8_t  payload[16];
+    uint32_t timestamp = platform_timer_get();
+    uint32_t regs[HALT_MON_REG_COUNT] = {0u};
+    uint32_t dfsr = 0u;
+    uint8_t  ack;
+
+    target_mem_read(TARGET_DFSR, &dfsr);
+    core_reg_read(HALT_MON_REGSEL_MASK, regs, HALT_MON_REG_COUNT, &ack);
+
+    dap_put_le32(&payload[0],  timestamp);
+    dap_put_le32(&payload[4],  dhcsr);
+    dap_put_le32(&payload[8],  dfsr);
+    dap_put_le32(&payload[12], regs[HALT_MON_REG_PC]);
+    stream_push(STREAM_TYPE_HALT, payload, sizeof(payload));
+
+    if ( (0u != (halt_mon_flags & HALT_MON_FLAG_FAULT_SNAP)) && (DAP_TRANSFER_OK == ack) &&
+         halt_mon_is_fault(regs[HALT_MON_REG_XPSR], dfsr) )
+    {
+        halt_mon_snapshot(timestamp, regs);
+    }
+}
+
+void halt_mon_task(void)
+{
+    if (0u == halt_mon_interval)
+    {
+        return;
+    }
+    uint32_t now = platform_timer_get();
+    if ( (now - halt_mon_last) < halt_mon_interval )
+    {
+        return;
+    }
+    halt_mon_last = now;
+
+    if (!target_begin())
+    {
+        halt_mon_primed = false;
+        return;
+    }
+    uint32_t dhcsr;
+    if (DAP_TRANSFER_OK == target_mem_read(TARGET_DHCSR, &dhcsr))
+    {
+        bool halted = (0u != (dhcsr & TARGET_DHCSR_S_HALT));
+        if (halted && halt_mon_primed && !halt_mon_halted)
+        {
+            halt_mon_report(dhcsr);
+        }
+        halt_mon_halted = halted;
+        halt_mon_primed = true;
+    }
+    target_end();
+}
+
+/* request: poll interval in ms (2, 0 = disabled, clamped to PLATFORM_TIMER_MAX_MS), flags (1).
+ * response: status (1).
+ */
+uint32_t halt_mon_command(const uint8_t *request, uint8_t *response)
+{
+    halt_mon_config((uint32_t)request[0] | ((uint32_t)request[1] << 8), request[2]);
+    response[0] = DAP_OK;
+    return (3u << 16) | 1u;
+}
+
+/* halt_mon.c - end */
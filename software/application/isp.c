@@ -0,0 +1,560 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "platform.h"
+#include "tusb.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "stream.h"
+#include "serial.h"
+#include "isp.h"
+
+/* stm32 usart bootloader protocol, see AN3155. */
+#define ISP_SYNC                0x7Fu
+#define ISP_ACK                 0x79u
+#define ISP_NACK                0x1Fu
+#define ISP_CMD_GET             0x00u
+#define ISP_CMD_GO              0x21u
+#define ISP_CMD_WRITE           0x31u
+#define ISP_CMD_ERASE           0x43u
+#define ISP_CMD_EXT_ERASE       0x44u
+#define ISP_BLOCK_SIZE          256u /* largest write memory block. */
+
+#define ISP_SYNC_TIMEOUT        PLATFORM_MS_TO_TICKS(100u)
+#define ISP_ACK_TIMEOUT         PLATFORM_MS_TO_TICKS(1000u)
+#define ISP_ERASE_TIMEOUT       PLATFORM_MS_TO_TICKS(PLATFORM_TIMER_MAX_MS) /* mass erase of a large part. */
+#define ISP_HOST_TIMEOUT        PLATFORM_MS_TO_TICKS(2000u)
+#define ISP_RESET_PULSE         PLATFORM_MS_TO_TICKS(10u)
+#define ISP_RESET_BOOT          PLATFORM_MS_TO_TICKS(50u) /* bootloader start-up after reset. */
+
+enum
+{
+    ISP_STEP_SYNC = 0,
+    ISP_STEP_RESET,
+    ISP_STEP_GET,
+    ISP_STEP_GET_LIST,
+    ISP_STEP_ERASE,
+    ISP_STEP_ERASE_ARGS,
+    ISP_STEP_WRITE,
+    ISP_STEP_WRITE_ADDR,
+    ISP_STEP_WRITE_DATA,
+    ISP_STEP_GO,
+    ISP_STEP_GO_ADDR,
+    ISP_STEP_DONE,
+};
+
+enum
+{
+    ISP_REPLY_NONE = 0,
+    ISP_REPLY_ACK,
+    ISP_REPLY_NACK,
+    ISP_REPLY_TIMEOUT,
+};
+
+/* tried from the fastest rate not above the host's limit down, the bootloader measures the 0x7F. */
+static const uint32_t isp_rates[] = {1000000u, 921600u, 460800u, 230400u, 115200u, 57600u, 38400u, 19200u, 9600u};
+
+static uint8_t  isp_state = ISP_STATE_IDLE;
+static uint8_t  isp_error = ISP_ERROR_NONE;
+static uint8_t  isp_step;
+static uint8_t  isp_channel;
+static uint8_t  isp_flags;
+static uint8_t  isp_rate;          /* index into isp_rates. */
+static bool     isp_ext_erase;     /* the bootloader has extended erase. */
+static uint32_t isp_start_addr;
+static uint32_t isp_addr;          /* address of the next block. */
+static uint32_t isp_remaining;     /* image bytes not yet sent to the target. */
+static uint32_t isp_written;       /* image bytes acknowledged by the target. */
+static uint32_t isp_inflight;      /* bytes of the block waiting for its ack. */
+static bool     isp_waiting = false; /* a request is out, waiting for the reply. */
+static uint32_t isp_wait_start;
+static uint32_t isp_wait_ticks;
+static bool     isp_reset_held;    /* ISP_STEP_RESET: nRESET is still low. */
+static uint32_t isp_rx_count;      /* reply bytes seen in ISP_STEP_GET_LIST. */
+static uint32_t isp_get_len;
+static uint32_t isp_host_time;     /* last time image data arrived. */
+static uint8_t  isp_block[ISP_BLOCK_SIZE + 2u]; /* N - 1, data, checksum. */
+static uint32_t isp_block_len = 0u; /* data bytes loaded. */
+
+static void isp_send(const uint8_t *data, uint32_t len)
+{
+    while (len > 0u)
+    {
+        uint8_t *buf;
+        uint32_t n = uart_tx_reserve(isp_channel, &buf);
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(buf, data, n);
+        uart_tx_commit(isp_channel, n);
+        data += n;
+        len  -= n;
+    }
+}
+
+static void isp_request(const uint8_t *data, uint32_t len, uint32_t timeout)
+{
+    isp_send(data, len);
+    isp_waiting    = true;
+    isp_wait_start = platform_timer_get();
+    isp_wait_ticks = timeout;
+}
+
+/* send an address, big endian with its xor checksum. */
+static void isp_request_addr(uint32_t addr)
+{
+    uint8_t buf[5];
+
+    buf[0] = (uint8_t)(addr >> 24);
+    buf[1] = (uint8_t)(addr >> 16);
+    buf[2] = (uint8_t)(addr >> 8);
+    buf[3] = (uint8_t)(addr);
+    buf[4] = buf[0] ^ buf[1] ^ buf[2] ^ buf[3];
+    isp_request(buf, sizeof(buf), ISP_ACK_TIMEOUT);
+}
+
+static bool isp_timed_out(void)
+{
+    return ((platform_timer_get() - isp_wait_start) >= isp_wait_ticks);
+}
+
+/* ISP_REPLY_xxx for the request that is out, anything but ack / nack is line noise. */
+static uint8_t isp_reply(void)
+{
+    uint8_t *buf;
+
+    while (0u != uart_rx_peek(isp_channel, &buf))
+    {
+        uint8_t c = buf[0];
+        uart_rx_consume(isp_channel, 1u);
+        if ( (ISP_ACK == c) || (ISP_NACK == c) )
+        {
+            isp_waiting = false;
+            return (ISP_ACK == c) ? ISP_REPLY_ACK : ISP_REPLY_NACK;
+        }
+    }
+    if (isp_timed_out())
+    {
+        isp_waiting = false;
+        return ISP_REPLY_TIMEOUT;
+    }
+    return ISP_REPLY_NONE;
+}
+
+static void isp_finish(uint8_t error)
+{
+    isp_error = error;
+    isp_state = (ISP_ERROR_NONE == error) ? ISP_STATE_DONE : ISP_STATE_ERROR;
+    isp_waiting = false;
+    stream_attach(STREAM_CH_ISP, false); /* image data still coming is discarded. */
+    serial_claim(isp_channel, false); /* puts the host's line coding back. */
+}
+
+/* move on to next on ack. */
+static void isp_expect_ack(uint8_t next)
+{
+    uint8_t reply = isp_reply();
+
+    if (ISP_REPLY_ACK == reply)
+    {
+        isp_step = next;
+    }
+    else if (ISP_REPLY_NONE != reply)
+    {
+        isp_finish((ISP_REPLY_NACK == reply) ? ISP_ERROR_NACK : ISP_ERROR_TIMEOUT);
+    }
+}
+
+/* pulse nRESET before the next rate is tried. the bootloader locks to the rate of the first
+ * 0x7F it sees, only a reset with BOOT0 still set lets it measure again.
+ */
+static void isp_reset_target(void)
+{
+    GPIO_Init_Type gpio_init;
+    gpio_init.Pins    = BRD_DAP_RESET_GPIO_PIN;
+    gpio_init.PinMode = GPIO_PinMode_Out_OpenDrain;
+    gpio_init.Speed   = GPIO_Speed_50MHz;
+    PIN_nRESET_OUT(0u);
+    GPIO_Init(BRD_DAP_RESET_GPIO_PORT, &gpio_init);
+
+    isp_reset_held = true;
+    isp_step       = ISP_STEP_RESET;
+    isp_waiting    = true;
+    isp_wait_start = platform_timer_get();
+    isp_wait_ticks = ISP_RESET_PULSE;
+}
+
+/* release nRESET once the pulse is over, then give the bootloader time to start. */
+static void isp_reset_wait(void)
+{
+    if (!isp_timed_out())
+    {
+        return;
+    }
+    if (isp_reset_held)
+    {
+        PIN_nRESET_OUT(1u); /* open drain, released. */
+        isp_reset_held = false;
+        isp_wait_start = platform_timer_get();
+        isp_wait_ticks = ISP_RESET_BOOT;
+        return;
+    }
+    isp_waiting = false;
+    isp_step    = ISP_STEP_SYNC;
+}
+
+/* switch to the current rate at 8E1 and say hello. rates the uart cannot do are skipped. */
+static void isp_sync(void)
+{
+    cdc_line_coding_t coding = { .bit_rate = 0u, .stop_bits = 0u, .parity = 2u, .data_bits = 8u };
+    uint8_t *buf;
+
+    while (isp_rate < (sizeof(isp_rates) / sizeof(isp_rates[0])))
+    {
+        coding.bit_rate = isp_rates[isp_rate];
+        if (uart_init(isp_channel, &coding))
+        {
+            uint32_t n;
+            while (0u != (n = uart_rx_peek(isp_channel, &buf)))
+            {
+                uart_rx_consume(isp_channel, n);
+            }
+            uint8_t sync = ISP_SYNC;
+            isp_request(&sync, 1u, ISP_SYNC_TIMEOUT);
+            return;
+        }
+        isp_rate++;
+    }
+    isp_finish(ISP_ERROR_SYNC);
+}
+
+/* GET reply after the ack: N, version, N command codes, ack. */
+static void isp_get_list(void)
+{
+    uint8_t *buf;
+    uint32_t n = uart_rx_peek(isp_channel, &buf);
+
+    for (uint32_t i = 0u; i < n; i++)
+    {
+        if (0u == isp_rx_count)
+        {
+            isp_get_len = buf[i];
+        }
+        else if ((isp_get_len + 2u) == isp_rx_count)
+        {
+            uart_rx_consume(isp_channel, i + 1u);
+            isp_waiting = false;
+            if (ISP_ACK != buf[i])
+            {
+                isp_finish(ISP_ERROR_NACK);
+            }
+            else
+            {
+                isp_step = (0u != (isp_flags & ISP_FLAG_ERASE)) ? ISP_STEP_ERASE : ISP_STEP_WRITE;
+            }
+            return;
+        }
+        else if ( (isp_rx_count >= 2u) && (ISP_CMD_EXT_ERASE == buf[i]) )
+        {
+            isp_ext_erase = true;
+        }
+        isp_rx_count++;
+    }
+    uart_rx_consume(isp_channel, n);
+    if (isp_timed_out())
+    {
+        isp_finish(ISP_ERROR_TIMEOUT);
+    }
+}
+
+/* pull the next block from the host, also while the target is busy with the previous one. */
+static void isp_fetch(void)
+{
+    uint32_t want = (isp_remaining > ISP_BLOCK_SIZE) ? ISP_BLOCK_SIZE : isp_remaining;
+
+    if (isp_block_len < want)
+    {
+        uint32_t n = stream_read(STREAM_CH_ISP, &isp_block[1u + isp_block_len], want - isp_block_len);
+        if (0u != n)
+        {
+            isp_block_len += n;
+            isp_host_time = platform_timer_get();
+        }
+    }
+}
+
+/* send the loaded block, the last one is padded to whole words. */
+static void isp_send_block(void)
+{
+    uint32_t len = (isp_block_len + 3u) & ~3u;
+    uint8_t  sum = (uint8_t)(len - 1u);
+
+    memset(&isp_block[1u + isp_block_len], 0xFF, len - isp_block_len);
+    isp_block[0] = (uint8_t)(len - 1u);
+    for (uint32_t i = 1u; i <= len; i++)
+    {
+        sum ^= isp_block[i];
+    }
+    isp_block[1u + len] = sum;
+    isp_request(isp_block, len + 2u, ISP_ACK_TIMEOUT);
+
+    /* the data now sits in the uart tx ring, the buffer takes the next block. */
+    isp_inflight   = isp_block_len;
+    isp_addr      += isp_block_len;
+    isp_remaining -= isp_block_len;
+    isp_block_len  = 0u;
+}
+
+void isp_task(void)
+{
+    static const uint8_t cmd_get[]       = {ISP_CMD_GET, 0xFFu};
+    static const uint8_t cmd_erase[]     = {ISP_CMD_ERASE, 0xBCu};
+    static const uint8_t cmd_ext_erase[] = {ISP_CMD_EXT_ERASE, 0xBBu};
+    static const uint8_t arg_erase[]     = {0xFFu, 0x00u};        /* global erase. */
+    static const uint8_t arg_ext_erase[] = {0xFFu, 0xFFu, 0x00u}; /* mass erase. */
+    static const uint8_t cmd_write[]     = {ISP_CMD_WRITE, 0xCEu};
+    static const uint8_t cmd_go[]        = {ISP_CMD_GO, 0xDEu};
+
+    if (ISP_STATE_BUSY != isp_state)
+    {
+        return;
+    }
+    if (isp_step >= ISP_STEP_ERASE)
+    {
+        isp_fetch();
+    }
+
+    switch (isp_step)
+    {
+        case ISP_STEP_SYNC:
+            if (!isp_waiting)
+            {
+                isp_sync();
+            }
+            else
+            {
+                uint8_t reply = isp_reply();
+                if ( (ISP_REPLY_ACK == reply) || (ISP_REPLY_NACK == reply) )
+                {
+                    isp_step = ISP_STEP_GET; /* a nack means the bootloader was already synced at this rate. */
+                }
+                else if (ISP_REPLY_TIMEOUT == reply)
+                {
+                    isp_rate++;
+                    if (isp_rate < (sizeof(isp_rates) / sizeof(isp_rates[0])))
+                    {
+                        isp_reset_target();
+                    }
+                }
+            }
+            break;
+        case ISP_STEP_RESET:
+            isp_reset_wait();
+            break;
+        case ISP_STEP_GET:
+            if (!isp_waiting)
+            {
+                isp_request(cmd_get, sizeof(cmd_get), ISP_ACK_TIMEOUT);
+            }
+            else
+            {
+                isp_expect_ack(ISP_STEP_GET_LIST);
+                if (ISP_STEP_GET_LIST == isp_step)
+                {
+                    isp_rx_count   = 0u;
+                    isp_waiting    = true; /* the list and a second ack follow. */
+                    isp_wait_start = platform_timer_get();
+                }
+            }
+            break;
+        case ISP_STEP_GET_LIST:
+            isp_get_list();
+            break;
+        case ISP_STEP_ERASE:
+            if (!isp_waiting)
+            {
+                isp_request(isp_ext_erase ? cmd_ext_erase : cmd_erase, sizeof(cmd_erase), ISP_ACK_TIMEOUT);
+            }
+            else
+            {
+                isp_expect_ack(ISP_STEP_ERASE_ARGS);
+            }
+            break;
+        case ISP_STEP_ERASE_ARGS:
+            if (!isp_waiting)
+            {
+                if (isp_ext_erase)
+                {
+                    isp_request(arg_ext_erase, sizeof(arg_ext_erase), ISP_ERASE_TIMEOUT);
+                }
+                else
+                {
+                    isp_request(arg_erase, sizeof(arg_erase), ISP_ERASE_TIMEOUT);
+                }
+            }
+            else
+            {
+                isp_expect_ack(ISP_STEP_WRITE);
+            }
+            break;
+        case ISP_STEP_WRITE:
+            if (isp_waiting)
+            {
+                isp_expect_ack(ISP_STEP_WRITE_ADDR);
+            }
+            else if (0u == isp_remaining)
+            {
+                isp_step = (0u != (isp_flags & ISP_FLAG_GO)) ? ISP_STEP_GO : ISP_STEP_DONE;
+            }
+            else if ( (isp_block_len == isp_remaining) || (ISP_BLOCK_SIZE == isp_block_len) )
+            {
+                isp_request(cmd_write, sizeof(cmd_write), ISP_ACK_TIMEOUT);
+            }
+            else if ((platform_timer_get() - isp_host_time) >= ISP_HOST_TIMEOUT)
+            {
+                isp_finish(ISP_ERROR_HOST);
+            }
+            break;
+        case ISP_STEP_WRITE_ADDR:
+            if (!isp_waiting)
+            {
+                isp_request_addr(isp_addr);
+            }
+            else
+            {
+                isp_expect_ack(ISP_STEP_WRITE_DATA);
+            }
+            break;
+        case ISP_STEP_WRITE_DATA:
+            if (!isp_waiting)
+            {
+                isp_send_block();
+            }
+            else
+            {
+                isp_expect_ack(ISP_STEP_WRITE);
+                if (ISP_STEP_WRITE == isp_step)
+                {
+                    isp_written += isp_inflight;
+                    isp_host_time = platform_timer_get(); /* the host was not waited on while the target was busy. */
+                }
+            }
+            break;
+        case ISP_STEP_GO:
+            if (!isp_waiting)
+            {
+                isp_request(cmd_go, sizeof(cmd_go), ISP_ACK_TIMEOUT);
+            }
+            else
+            {
+                isp_expect_ack(ISP_STEP_GO_ADDR);
+            }
+            break;
+        case ISP_STEP_GO_ADDR:
+            if (!isp_waiting)
+            {
+                isp_request_addr(isp_start_addr);
+            }
+            else
+            {
+                isp_expect_ack(ISP_STEP_DONE);
+            }
+            break;
+        case ISP_STEP_DONE:
+            isp_finish(ISP_ERROR_NONE);
+            break;
+        default:
+            isp_finish(ISP_ERROR_TIMEOUT);
+            break;
+    }
+}
+
+/* request: channel (1), flags (1) ISP_FLAG_xxx, max baud (4), address (4), length (4).
+ * response: status (1), DAP_ERROR while the channel is lent to the uart bench.
+ * the target must be sitting in its bootloader with BOOT0 held: when a rate gets no reply,
+ * nRESET is pulsed before the next rate so the bootloader measures afresh. the channel is
+ * taken from the serial bridge until the engine is done, then its line coding is restored.
+ * the image is then sent on the STREAM_CH_ISP stream channel, usb flow control paces the host
+ * while the engine is busy. once it is done or failed, image data still coming is discarded.
+ */
+uint32_t isp_start_command(const uint8_t *request, uint8_t *response)
+{
+    uint8_t  channel = request[0];
+    uint32_t baud    = dap_get_le32(&request[2]);
+    uint32_t length  = dap_get_le32(&request[10]);
+    uint8_t  scratch[32];
+
+    response[0] = DAP_ERROR;
+    if (   (ISP_STATE_BUSY == isp_state) || (channel >= SERIAL_CHANNEL_COUNT)
+        || serial_claimed(channel) || (0u == length) )
+    {
+        return (14u << 16) | 1u;
+    }
+    while (0u != stream_read(STREAM_CH_ISP, scratch, sizeof(scratch)))
+    {
+        /* drop anything left over from an earlier run. */
+    }
+    serial_claim(channel, true);
+    stream_attach(STREAM_CH_ISP, true);
+    isp_channel    = channel;
+    isp_flags      = request[1];
+    isp_start_addr = dap_get_le32(&request[6]);
+    isp_addr       = isp_start_addr;
+    isp_remaining  = length;
+    isp_written    = 0u;
+    isp_block_len  = 0u;
+    isp_ext_erase  = false;
+    isp_waiting    = false;
+    isp_host_time  = platform_timer_get();
+    isp_rate = 0u;
+    while ( (isp_rate < ((sizeof(isp_rates) / sizeof(isp_rates[0])) - 1u)) && (isp_rates[isp_rate] > baud) )
+    {
+        isp_rate++;
+    }
+    isp_step  = ISP_STEP_SYNC;
+    isp_error = ISP_ERROR_NONE;
+    isp_state = ISP_STATE_BUSY;
+    response[0] = DAP_OK;
+    return (14u << 16) | 1u;
+}
+
+/* request: none.
+ * response: state (1) ISP_STATE_xxx, error (1) ISP_ERROR_xxx, baud (4), bytes written (4).
+ */
+uint32_t isp_status_command(const uint8_t *request, uint8_t *response)
+{
+    (void) request;
+
+    response[0] = isp_state;
+    response[1] = isp_error;
+    dap_put_le32(&response[2], (isp_rate < (sizeof(isp_rates) / sizeof(isp_rates[0]))) ? isp_rates[isp_rate] : 0u);
+    dap_put_le32(&response[6], isp_written);
+    return (0u << 16) | 10u;
+}
+
+/* isp.c - end */
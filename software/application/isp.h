@@ -0,0 +1,55 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef ISP_H
+#define ISP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* engine states. */
+#define ISP_STATE_IDLE          0u
+#define ISP_STATE_BUSY          1u
+#define ISP_STATE_DONE          2u
+#define ISP_STATE_ERROR         3u
+
+/* errors. */
+#define ISP_ERROR_NONE          0u
+#define ISP_ERROR_SYNC          1u /* no reply to 0x7F at any rate. */
+#define ISP_ERROR_NACK          2u /* the bootloader refused a command. */
+#define ISP_ERROR_TIMEOUT       3u /* the bootloader stopped answering. */
+#define ISP_ERROR_HOST          4u /* the host stopped sending image data. */
+
+#define ISP_FLAG_ERASE          (1u << 0) /* mass erase before writing. */
+#define ISP_FLAG_GO             (1u << 1) /* jump to the image start when done. */
+
+/* uart isp api, programs a target through its stm32 usart bootloader (AN3155) with the
+ * image taken from the STREAM_CH_ISP stream channel.
+ */
+void     isp_task(void);
+uint32_t isp_start_command(const uint8_t *request, uint8_t *response);
+uint32_t isp_status_command(const uint8_t *request, uint8_t *response);
+
+#endif /* ISP_H */
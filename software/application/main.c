@@ -26,9 +26,15 @@
 #include "platform.h"
 #include "tusb.h"
 #include "DAP.h"
-
-/* cdc task. */
-void cdc_task(void);
+#include "target.h"
+#include "swj_tune.h"
+#include "halt_mon.h"
+#include "profile.h"
+#include "stream.h"
+#include "serial.h"
+#include "isp.h"
+#include "bench.h"
+#include "trace.h"
 
 int main(void)
 {
@@ -39,8 +45,40 @@ int main(void)
     while (1)
     {
         tud_task();
-        cdc_task();
+        serial_task();
+        isp_task();
+        bench_task();
+        halt_mon_task();
+        profile_task();
+        stream_task();
+    }
+}
+
+/* same as DAP_ExecuteCommand, but lets the probe-side modules see every single command. */
+static uint32_t dap_execute_command(const uint8_t *request, uint8_t *response)
+{
+    uint32_t cnt = 1u;
+    uint32_t num = 0u;
+
+    if (ID_DAP_ExecuteCommands == *request)
+    {
+        *response++ = *request++;
+        cnt = *request++;
+        *response++ = (uint8_t)cnt;
+        num = (2u << 16) | 2u;
     }
+    while (cnt--)
+    {
+        trace_event(TRACE_DAP_START, request[0], (uint16_t)(request[1] | ((uint32_t)request[2] << 8)));
+        uint32_t n = DAP_ProcessCommand(request, response);
+        trace_event(TRACE_DAP_END, request[0], (uint16_t)n);
+        target_observe_command(request, response);
+        swj_tune_observe(request, response);
+        num      += n;
+        request  += (uint16_t)(n >> 16);
+        response += (uint16_t)n;
+    }
+    return num;
 }
 
 /* hid callback. */
@@ -69,37 +107,8 @@ void tud_hid_set_report_cb(uint8_t itf, uint8_t report_id, hid_report_type_t rep
     (void) report_type;
 
     uint32_t response_size = TU_MIN(CFG_TUD_HID_EP_BUFSIZE, bufsize);
-    DAP_ExecuteCommand(buffer, hid_tx_data_buf);
+    dap_execute_command(buffer, hid_tx_data_buf);
     tud_hid_n_report(itf, report_id, hid_tx_data_buf, response_size);
 }
 
-/* cdc task & callback. */
-
-void cdc_task(void)
-{
-    if ( tud_cdc_n_connected(0))
-    {
-        if (uart_rx_available() && tud_cdc_n_write_available(0) > 0)
-        {
-            uint8_t rx_buf[64];
-            uint32_t rx_cnt = uart_rx(rx_buf, tud_cdc_n_write_available(0));
-            tud_cdc_n_write(0, rx_buf, rx_cnt);
-            tud_cdc_n_write_flush(0);
-        }
-        if (uart_tx_idle() && tud_cdc_n_available(0) > 0)
-        {
-            char tx_buf[128] = "012345678\r\n";
-            uint32_t tx_cnt = tud_cdc_n_read(0, tx_buf, sizeof(tx_buf));
-            uart_tx((uint8_t*)tx_buf, tx_cnt);
-        }
-    }
-}
-
-/* Invoked when line coding is change via SET_LINE_CODING
- */
-void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const* p_line_coding)
-{
-    uart_init(p_line_coding);
-}
-
 /* main.c - end */
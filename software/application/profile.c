@@ -0,0 +1,250 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "platform.h"
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "target.h"
+#include "core_reg.h"
+#include "stream.h"
+#include "profile.h"
+
+#define PROFILE_BINS            256u  /* bin index fits in one byte. */
+#define PROFILE_BURST_PCSR      32u   /* samples per profile_task() call. */
+#define PROFILE_BURST_HALT      4u
+#define PROFILE_RECORD_BINS     16u   /* bin entries per stream record. */
+#define PROFILE_HALT_RETRY      8u
+#define PROFILE_PCSR_HALTED     0xFFFFFFFFu /* PCSR value while the core is in debug state. */
+#define PROFILE_REGSEL_PC       15u
+
+static uint16_t profile_hist[PROFILE_BINS];
+static uint32_t profile_base = 0u;
+static uint8_t  profile_shift = 0u;
+static uint8_t  profile_mode = PROFILE_MODE_OFF;
+static uint32_t profile_interval = 0u; /* timer ticks between reports. */
+static uint32_t profile_last = 0u;
+static uint32_t profile_samples = 0u;  /* samples since the last report. */
+static uint32_t profile_other = 0u;    /* samples outside the histogram range. */
+
+static void profile_clear(void)
+{
+    for (uint32_t i = 0u; i < PROFILE_BINS; i++)
+    {
+        profile_hist[i] = 0u;
+    }
+    profile_samples = 0u;
+    profile_other   = 0u;
+}
+
+static void profile_bin(uint32_t pc)
+{
+    uint32_t idx = (pc - profile_base) >> profile_shift;
+
+    profile_samples++;
+    if ( (pc < profile_base) || (idx >= PROFILE_BINS) )
+    {
+        profile_other++;
+    }
+    else if (0xFFFFu != profile_hist[idx])
+    {
+        profile_hist[idx]++;
+    }
+}
+
+/* PCSR reads as zero when not implemented and as all ones while halted. */
+static uint8_t profile_detect(void)
+{
+    uint32_t pcsr[2] = {0u, 0u};
+
+    if (DAP_TRANSFER_OK != target_mem_read_repeat(TARGET_DWT_PCSR, pcsr, 2u))
+    {
+        return PROFILE_MODE_HALT;
+    }
+    return ( (0u != pcsr[0]) || (0u != pcsr[1]) ) ? PROFILE_MODE_PCSR : PROFILE_MODE_HALT;
+}
+
+/* halt, read PC and resume. a core the host has halted, or without debug enabled, is left alone.
+ * DFSR is cleared before the halt. if it then shows more than our own halt request (a breakpoint,
+ * watchpoint or vector catch hit at the same time) the core stays halted for halt_mon to report.
+ */
+static bool profile_halt_sample(uint32_t *pc)
+{
+    uint32_t dhcsr;
+    uint32_t dfsr = 0u;
+    uint8_t  ack;
+
+    if (   (DAP_TRANSFER_OK != target_mem_read(TARGET_DHCSR, &dhcsr))
+        || (0u != (dhcsr & TARGET_DHCSR_S_HALT))
+        || (0u == (dhcsr & TARGET_DHCSR_C_DEBUGEN)) )
+    {
+        return false;
+    }
+    dhcsr = TARGET_DHCSR_DBGKEY | (dhcsr & 0x00000009u); /* keep C_DEBUGEN and C_MASKINTS. */
+    if (   (DAP_TRANSFER_OK != target_mem_write(TARGET_DFSR, TARGET_DFSR_ALL))
+        || (DAP_TRANSFER_OK != target_mem_write(TARGET_DHCSR, dhcsr | TARGET_DHCSR_C_HALT)) )
+    {
+        return false;
+    }
+    uint32_t n = 0u;
+    for (uint32_t i = 0u; (i < PROFILE_HALT_RETRY) && (0u == n); i++)
+    {
+        n = core_reg_read(1u << PROFILE_REGSEL_PC, pc, 1u, &ack);
+    }
+    if ( (DAP_TRANSFER_OK != target_mem_read(TARGET_DFSR, &dfsr)) || (TARGET_DFSR_HALTED != (dfsr & TARGET_DFSR_ALL)) )
+    {
+        return false; /* halted for another reason too, or unknown: leave it halted. */
+    }
+    target_mem_write(TARGET_DHCSR, dhcsr);
+    return (0u != n);
+}
+
+static void profile_sample(void)
+{
+    if (PROFILE_MODE_PCSR == profile_mode)
+    {
+        uint32_t pcsr[PROFILE_BURST_PCSR];
+        if (DAP_TRANSFER_OK == target_mem_read_repeat(TARGET_DWT_PCSR, pcsr, PROFILE_BURST_PCSR))
+        {
+            for (uint32_t i = 0u; i < PROFILE_BURST_PCSR; i++)
+            {
+                if (PROFILE_PCSR_HALTED != pcsr[i])
+                {
+                    profile_bin(pcsr[i]);
+                }
+            }
+        }
+    }
+    else
+    {
+        uint32_t pc;
+        for (uint32_t i = 0u; (i < PROFILE_BURST_HALT) && profile_halt_sample(&pc); i++)
+        {
+            profile_bin(pc);
+        }
+    }
+}
+
+/* record: timestamp (4), samples (2), out of range samples (2), then bin (1), count (2) for each
+ * non-empty bin. samples and out of range counts are only carried by the first record of a report.
+ * bins that do not fit in the stream queue stay in the histogram for the next report.
+ */
+static void profile_report(void)
+{
+    uint8_t  payload[8u + 3u * PROFILE_RECORD_BINS];
+    uint32_t timestamp = platform_timer_get();
+    uint32_t bin = 0u;
+
+    while ( (0u != profile_samples) || (bin < PROFILE_BINS) )
+    {
+        uint32_t start = bin;
+        uint32_t len = 8u;
+        for (; (bin < PROFILE_BINS) && (len < sizeof(payload)); bin++)
+        {
+            if (0u != profile_hist[bin])
+            {
+                payload[len++] = (uint8_t)bin;
+                payload[len++] = (uint8_t)(profile_hist[bin]);
+                payload[len++] = (uint8_t)(profile_hist[bin] >> 8);
+            }
+        }
+        if ( (8u == len) && (0u == profile_samples) )
+        {
+            break;
+        }
+        uint32_t samples = (profile_samples > 0xFFFFu) ? 0xFFFFu : profile_samples;
+        uint32_t other   = (profile_other > 0xFFFFu) ? 0xFFFFu : profile_other;
+        dap_put_le32(&payload[0], timestamp);
+        payload[4] = (uint8_t)(samples);
+        payload[5] = (uint8_t)(samples >> 8);
+        payload[6] = (uint8_t)(other);
+        payload[7] = (uint8_t)(other >> 8);
+        if (!stream_push(STREAM_TYPE_PROFILE, payload, (uint8_t)len))
+        {
+            break;
+        }
+        for (uint32_t i = start; i < bin; i++)
+        {
+            profile_hist[i] = 0u;
+        }
+        profile_samples = 0u;
+        profile_other   = 0u;
+    }
+}
+
+uint8_t profile_config(uint32_t base, uint8_t shift, uint32_t interval_ms, uint8_t mode)
+{
+    profile_base     = base;
+    profile_shift    = (shift > 31u) ? 31u : shift;
+    profile_interval = PLATFORM_MS_TO_TICKS(interval_ms);
+    profile_last     = platform_timer_get();
+    profile_mode     = PROFILE_MODE_OFF;
+    profile_clear();
+
+    if ( (PROFILE_MODE_AUTO == mode) && target_begin() )
+    {
+        mode = profile_detect();
+        target_end();
+    }
+    if ( (PROFILE_MODE_PCSR == mode) || (PROFILE_MODE_HALT == mode) )
+    {
+        profile_mode = mode;
+    }
+    return profile_mode;
+}
+
+void profile_task(void)
+{
+    if (PROFILE_MODE_OFF == profile_mode)
+    {
+        return;
+    }
+    if (target_begin())
+    {
+        profile_sample();
+        target_end();
+    }
+    uint32_t now = platform_timer_get();
+    if ( (0u != profile_interval) && ((now - profile_last) >= profile_interval) )
+    {
+        profile_last = now;
+        profile_report();
+    }
+}
+
+/* request: histogram base address (4), bin size as log2 bytes (1), report interval in ms (2, clamped to PLATFORM_TIMER_MAX_MS), mode (1).
+ * response: status (1), selected mode (1).
+ */
+uint32_t profile_command(const uint8_t *request, uint8_t *response)
+{
+    uint8_t mode = profile_config(dap_get_le32(&request[0]), request[4],
+                                  (uint32_t)request[5] | ((uint32_t)request[6] << 8), request[7]);
+
+    response[0] = ( (PROFILE_MODE_OFF != request[7]) && (PROFILE_MODE_OFF == mode) ) ? DAP_ERROR : DAP_OK;
+    response[1] = mode;
+    return (8u << 16) | 2u;
+}
+
+/* profile.c - end */
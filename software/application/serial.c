@@ -0,0 +1,452 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "platform.h"
+#include "tusb.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "stream.h"
+#include "serial.h"
+
+#define SERIAL_STATE_CARRIERS   0x03u /* bRxCarrier (DCD) | bTxCarrier (DSR). */
+#define SERIAL_BREAK_FOREVER    0xFFFFu
+#define SERIAL_CAPTURE_HDR      10u
+#define SERIAL_CAPTURE_DATA     48u    /* rx bytes per capture record, keeps records small in the stream queue. */
+
+/* one channel per cdc interface, channel n is cdc instance n and uart port n. */
+typedef struct
+{
+    uint8_t         itf;               /* cdc communication interface, see tusb_descriptors.c. */
+    uint8_t         notif_ep;          /* its notification endpoint. */
+    serial_policy_t policy;
+    bool            unflushed;         /* data written to the cdc fifo since the last flush. */
+    uint32_t        unflushed_since;   /* time of the first unflushed write. */
+    uint32_t        state_pending;     /* SERIAL_STATE bits still to be sent. */
+    bool            state_due;
+    bool            brk;
+    uint32_t        break_start;
+    uint32_t        break_ticks;       /* 0 = until cleared by the host. */
+    uint8_t         notify[10];        /* SERIAL_STATE buffer, must outlive the transfer. */
+    bool            capture;           /* copy rx chunks to the stream as timestamped records. */
+    uint32_t        rx_offset;         /* rx bytes passed on since capture was enabled. */
+    bool            claimed;           /* the uart is lent to another module, see serial_claim(). */
+    cdc_line_coding_t host_coding;     /* what the host wants, applied when the claim ends. */
+} serial_channel_t;
+
+#define SERIAL_CHANNEL_INIT(itf_num, ep) \
+    { \
+        .itf      = (itf_num), \
+        .notif_ep = (ep), \
+        .policy   = { .latency_ms = SERIAL_LATENCY_DEFAULT_MS, .event_char = '\n', .flags = SERIAL_POLICY_FLUSH_ON_IDLE }, \
+    }
+
+static serial_channel_t serial_channels[SERIAL_CHANNEL_COUNT] =
+{
+    SERIAL_CHANNEL_INIT(1u, 0x82u), /* ITF_NUM_CDC, EPNUM_CDC_NOTIF. */
+#if (SERIAL_CHANNEL_COUNT > 1u)
+    SERIAL_CHANNEL_INIT(4u, 0x85u), /* ITF_NUM_CDC2, EPNUM_CDC2_NOTIF. */
+#endif
+};
+
+TU_VERIFY_STATIC(SERIAL_CHANNEL_COUNT == CFG_TUD_CDC, "one cdc interface per serial channel");
+TU_VERIFY_STATIC(SERIAL_CHANNEL_COUNT == PLATFORM_UART_COUNT, "one uart port per serial channel");
+
+/* SERIAL_STATE notification on the cdc interrupt endpoint. */
+static bool serial_notify(serial_channel_t *ch, uint16_t state)
+{
+    uint8_t notify[sizeof(ch->notify)];
+
+    notify[0] = 0xA1; /* class, interface, device to host. */
+    notify[1] = CDC_NOTIF_SERIAL_STATE;
+    notify[2] = 0u;
+    notify[3] = 0u;
+    notify[4] = ch->itf;
+    notify[5] = 0u;
+    notify[6] = 2u;
+    notify[7] = 0u;
+    notify[8] = (uint8_t)(state);
+    notify[9] = (uint8_t)(state >> 8);
+    return tusb_port_notify(ch->notif_ep, ch->notify, notify, sizeof(notify));
+}
+
+static void serial_state_task(uint8_t idx)
+{
+    serial_channel_t *ch = &serial_channels[idx];
+    uint32_t errors = uart_rx_errors(idx);
+    if (0u != errors)
+    {
+        ch->state_pending |= errors;
+        ch->state_due = true;
+    }
+    if (ch->state_due && serial_notify(ch, (uint16_t)(SERIAL_STATE_CARRIERS | ch->state_pending)))
+    {
+        ch->state_pending = 0u; /* the error bits are one-shot. */
+        ch->state_due = false;
+    }
+}
+
+static void serial_break_task(uint8_t idx)
+{
+    serial_channel_t *ch = &serial_channels[idx];
+    if ( ch->brk && (0u != ch->break_ticks) && ((platform_timer_get() - ch->break_start) >= ch->break_ticks) )
+    {
+        ch->brk = false;
+        uart_set_break(idx, false);
+    }
+}
+
+/* record: timestamp (4), channel (1), flags (1), rx offset (4), data.
+ * the offset counts rx bytes since capture was enabled, a gap means records were dropped
+ * because the stream queue was full. the plain cdc data is not affected.
+ * the timestamp is when the rx idle or dma isr saw the chunk land. bytes no isr has seen
+ * yet carry the poll time and SERIAL_CAPTURE_POLLED, still a bound but a looser one.
+ */
+static void serial_capture_run(uint8_t idx, uint32_t timestamp, const uint8_t *data, uint32_t len, uint8_t flags)
+{
+    serial_channel_t *ch = &serial_channels[idx];
+    uint8_t payload[SERIAL_CAPTURE_HDR + SERIAL_CAPTURE_DATA];
+
+    do
+    {
+        uint32_t n = (len > SERIAL_CAPTURE_DATA) ? SERIAL_CAPTURE_DATA : len;
+        dap_put_le32(&payload[0], timestamp);
+        payload[4] = idx;
+        payload[5] = (n == len) ? flags : (flags & SERIAL_CAPTURE_POLLED);
+        dap_put_le32(&payload[6], ch->rx_offset);
+        memcpy(&payload[SERIAL_CAPTURE_HDR], data, n);
+        stream_push(STREAM_TYPE_SERIAL, payload, (uint8_t)(SERIAL_CAPTURE_HDR + n));
+        ch->rx_offset += n;
+        data += n;
+        len  -= n;
+    } while (0u != len);
+}
+
+static void serial_capture(uint8_t idx, uint32_t now, const uint8_t *data, uint32_t len, uint8_t flags)
+{
+    uint32_t stamp;
+    uint32_t n = uart_rx_stamped(idx, &stamp);
+
+    if (n > len)
+    {
+        n = len;
+    }
+    if (0u != n)
+    {
+        serial_capture_run(idx, stamp, data, n, (n == len) ? flags : 0u);
+    }
+    if (n != len)
+    {
+        serial_capture_run(idx, now, &data[n], len - n, flags | SERIAL_CAPTURE_POLLED);
+    }
+}
+
+/* uart to cdc. full packets go out on their own, a partial packet is flushed by the policy:
+ * latency timer expiry, the event character, or the line going idle.
+ */
+static void serial_rx_task(uint8_t idx)
+{
+    serial_channel_t *ch = &serial_channels[idx];
+    uint8_t *rx_buf;
+    uint32_t rx_cnt = uart_rx_peek(idx, &rx_buf);
+    uint32_t now = platform_timer_get();
+    bool     idle = uart_rx_idle(idx);
+    bool     flush = false;
+
+    if (!tud_cdc_n_connected(idx))
+    {
+        /* capture only, the bridge is closed. */
+        if (ch->capture && (rx_cnt > 0))
+        {
+            serial_capture(idx, now, rx_buf, rx_cnt, idle ? SERIAL_CAPTURE_IDLE : 0u);
+        }
+        uart_rx_consume(idx, rx_cnt);
+        return;
+    }
+    if (rx_cnt > 0)
+    {
+        /* straight from the dma ring into the cdc fifo. */
+        rx_cnt = tud_cdc_n_write(idx, rx_buf, rx_cnt);
+        if (ch->capture && (rx_cnt > 0))
+        {
+            serial_capture(idx, now, rx_buf, rx_cnt, idle ? SERIAL_CAPTURE_IDLE : 0u);
+        }
+        if ( (0u != (ch->policy.flags & SERIAL_POLICY_EVENT_CHAR)) && (NULL != memchr(rx_buf, ch->policy.event_char, rx_cnt)) )
+        {
+            flush = true;
+        }
+        uart_rx_consume(idx, rx_cnt);
+        if ( (rx_cnt > 0) && !ch->unflushed )
+        {
+            ch->unflushed = true;
+            ch->unflushed_since = now;
+        }
+    }
+    if (idle && (0u != (ch->policy.flags & SERIAL_POLICY_FLUSH_ON_IDLE)))
+    {
+        flush = true;
+    }
+    if ( ch->unflushed && ((platform_timer_get() - ch->unflushed_since) >= PLATFORM_MS_TO_TICKS(ch->policy.latency_ms)) )
+    {
+        flush = true;
+    }
+    if (flush && ch->unflushed)
+    {
+        tud_cdc_n_write_flush(idx);
+        ch->unflushed = false;
+    }
+}
+
+void serial_task(void)
+{
+    for (uint8_t idx = 0u; idx < SERIAL_CHANNEL_COUNT; idx++)
+    {
+        uint32_t baud;
+
+        uart_task(idx); /* a new line coding, once tx has drained. */
+        if (serial_channels[idx].claimed)
+        {
+            continue;
+        }
+        (void) uart_autobaud_poll(idx, &baud); /* applies a detected rate as soon as it locks. */
+        serial_break_task(idx);
+        if ( tud_cdc_n_connected(idx))
+        {
+            serial_state_task(idx);
+
+            serial_rx_task(idx);
+            uint8_t *tx_buf;
+            uint32_t tx_cnt = uart_tx_reserve(idx, &tx_buf);
+            if (tx_cnt > 0 && tud_cdc_n_available(idx) > 0 && !serial_channels[idx].brk)
+            {
+                /* straight from the cdc fifo into the tx ring, the dma chains runs back to back. */
+                tx_cnt = tud_cdc_n_read(idx, tx_buf, tx_cnt);
+            }
+            else
+            {
+                tx_cnt = 0u;
+            }
+            uart_tx_commit(idx, tx_cnt); /* also restarts a run held back by cts. */
+        }
+        else if (serial_channels[idx].capture)
+        {
+            serial_rx_task(idx); /* keep capturing with the port closed. */
+        }
+    }
+}
+
+/* Invoked when line coding is change via SET_LINE_CODING
+ */
+void tud_cdc_line_coding_cb(uint8_t itf, cdc_line_coding_t const* p_line_coding)
+{
+    serial_channel_t *ch = &serial_channels[itf];
+
+    if (ch->claimed)
+    {
+        ch->host_coding = *p_line_coding; /* the borrower keeps the uart, see serial_claim(). */
+        return;
+    }
+    uart_init(itf, p_line_coding); /* a refused rate keeps the previous setting, see serial_status_command(). */
+}
+
+/* Invoked when DTR / RTS change via SET_CONTROL_LINE_STATE, report the carriers once the port opens.
+ */
+void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts)
+{
+    (void) rts;
+
+    if (dtr)
+    {
+        serial_channels[itf].state_due = true;
+    }
+}
+
+/* Invoked on SEND_BREAK, 0 ends a break and 0xFFFF holds it until the next request.
+ * ignored while the uart is lent out.
+ */
+void tud_cdc_send_break_cb(uint8_t itf, uint16_t duration_ms)
+{
+    serial_channel_t *ch = &serial_channels[itf];
+
+    if (ch->claimed)
+    {
+        return;
+    }
+    ch->brk = (0u != duration_ms);
+    if (ch->brk)
+    {
+        ch->break_ticks = (SERIAL_BREAK_FOREVER == duration_ms) ? 0u : PLATFORM_MS_TO_TICKS(duration_ms);
+        ch->break_start = platform_timer_get();
+    }
+    uart_set_break(itf, ch->brk);
+}
+
+/* request: channel (1).
+ * response: status (1), requested baud (4), actual baud (4), error in ppm (4, signed), rx overruns (4).
+ * status is DAP_ERROR when the last requested rate was refused or the channel does not exist.
+ */
+uint32_t serial_status_command(const uint8_t *request, uint8_t *response)
+{
+    uint8_t  idx = request[0];
+    uint32_t requested = 0u;
+    uint32_t actual = 0u;
+    int32_t  error = 0;
+    uint32_t overruns = 0u;
+
+    response[0] = DAP_ERROR;
+    if (idx < SERIAL_CHANNEL_COUNT)
+    {
+        response[0] = uart_get_baud(idx, &requested, &actual, &error) ? DAP_OK : DAP_ERROR;
+        overruns = uart_rx_overrun_count(idx);
+    }
+    dap_put_le32(&response[1],  requested);
+    dap_put_le32(&response[5],  actual);
+    dap_put_le32(&response[9],  (uint32_t)error);
+    dap_put_le32(&response[13], overruns);
+    return (1u << 16) | 17u;
+}
+
+/* vendor control requests for the flush policy, modelled on the ftdi latency timer / event char requests.
+ * the low byte of wIndex selects the channel.
+ * SET_LATENCY:    wValue = latency in ms, clamped to 1..255.
+ * GET_LATENCY:    2 bytes in.
+ * SET_EVENT_CHAR: wValue = character | SERIAL_POLICY_xxx flags << 8.
+ */
+bool serial_control_request(uint8_t rhport, tusb_control_request_t const * request)
+{
+    static uint16_t latency;
+    uint8_t idx = (uint8_t)request->wIndex;
+
+    if (idx >= SERIAL_CHANNEL_COUNT)
+    {
+        return false;
+    }
+    serial_policy_t *policy = &serial_channels[idx].policy;
+    switch (request->bRequest)
+    {
+        case SERIAL_REQUEST_SET_LATENCY:
+            policy->latency_ms = (request->wValue < SERIAL_LATENCY_MIN_MS) ? SERIAL_LATENCY_MIN_MS
+                               : ((request->wValue > SERIAL_LATENCY_MAX_MS) ? SERIAL_LATENCY_MAX_MS : request->wValue);
+            return tud_control_status(rhport, request);
+        case SERIAL_REQUEST_GET_LATENCY:
+            latency = policy->latency_ms;
+            return tud_control_xfer(rhport, request, &latency, sizeof(latency));
+        case SERIAL_REQUEST_SET_EVENT_CHAR:
+            policy->event_char = (uint8_t)request->wValue;
+            policy->flags      = (uint8_t)(request->wValue >> 8);
+            return tud_control_status(rhport, request);
+        default:
+            return false;
+    }
+}
+
+/* request: channel (1), flags (1), bit 0 enables rts / cts flow control.
+ * response: status (1), DAP_ERROR when the channel has no flow control pins.
+ */
+uint32_t serial_config_command(const uint8_t *request, uint8_t *response)
+{
+    response[0] = DAP_ERROR;
+    if (request[0] < SERIAL_CHANNEL_COUNT)
+    {
+        response[0] = uart_set_flow_control(request[0], 0u != (request[1] & SERIAL_CONFIG_FLOW_CONTROL)) ? DAP_OK : DAP_ERROR;
+    }
+    return (2u << 16) | 1u;
+}
+
+/* request: channel (1), enable (1).
+ * response: status (1).
+ * while enabled, rx data of the channel is also sent on the stream as STREAM_TYPE_SERIAL
+ * records, stamped with the probe timer when the chunk was taken from the dma ring.
+ * with the cdc port closed the data is captured and then discarded.
+ */
+uint32_t serial_capture_command(const uint8_t *request, uint8_t *response)
+{
+    response[0] = DAP_ERROR;
+    if (request[0] < SERIAL_CHANNEL_COUNT)
+    {
+        serial_channels[request[0]].capture   = (0u != request[1]);
+        serial_channels[request[0]].rx_offset = 0u;
+        response[0] = DAP_OK;
+    }
+    return (2u << 16) | 1u;
+}
+
+/* request: channel (1), start (1), non-zero starts a new measurement.
+ * response: status (1), state (1) UART_AUTOBAUD_xxx, detected baud (4).
+ * the detected rate is applied with the current data bits, parity and stop bits
+ * and then also shows up in serial_status_command(). a channel that is lent out
+ * cannot start a measurement. the characters received while measuring are rebuilt from
+ * the edges and delivered ahead of later data. a character cut off by the end of the capture
+ * is lost and counted as an overrun, one arriving before the rate is applied may be garbled.
+ */
+uint32_t serial_autobaud_command(const uint8_t *request, uint8_t *response)
+{
+    uint32_t baud = 0u;
+    uint8_t  state = UART_AUTOBAUD_IDLE;
+
+    response[0] = DAP_ERROR;
+    if (request[0] < SERIAL_CHANNEL_COUNT)
+    {
+        if ( (0u == request[1]) || (!serial_channels[request[0]].claimed && uart_autobaud_start(request[0])) )
+        {
+            response[0] = DAP_OK;
+        }
+        state = uart_autobaud_poll(request[0], &baud);
+    }
+    response[1] = state;
+    dap_put_le32(&response[2], baud);
+    return (2u << 16) | 6u;
+}
+
+/* lend the uart of a channel to another module (e.g. isp.c), the bridge leaves it alone until released.
+ * a break or auto-baud measurement in progress is ended first. the borrower may change the line
+ * coding, the release puts back the host's, including a change the host made in the meantime.
+ */
+void serial_claim(uint8_t idx, bool claim)
+{
+    serial_channel_t *ch = &serial_channels[idx];
+
+    if (claim)
+    {
+        uart_autobaud_stop(idx);
+        if (ch->brk)
+        {
+            ch->brk = false;
+            uart_set_break(idx, false);
+        }
+        uart_get_line_coding(idx, &ch->host_coding);
+    }
+    else if (ch->claimed)
+    {
+        uart_init(idx, &ch->host_coding);
+    }
+    ch->claimed = claim;
+}
+
+bool serial_claimed(uint8_t idx)
+{
+    return serial_channels[idx].claimed;
+}
+
+/* serial.c - end */
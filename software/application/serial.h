@@ -0,0 +1,65 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef SERIAL_H
+#define SERIAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "tusb.h"
+
+#define SERIAL_CHANNEL_COUNT        CFG_TUD_CDC /* cdc 0 on UART2, cdc 1 on LPUART where the board routes it. */
+#define SERIAL_CONFIG_FLOW_CONTROL  (1u << 0)
+#define SERIAL_CAPTURE_IDLE         (1u << 0) /* capture record flag, the line went idle after this chunk. */
+#define SERIAL_CAPTURE_POLLED       (1u << 1) /* capture record flag, stamped when polled, not in the rx isr. */
+
+/* per-channel flush policy, set with vendor control requests on the vendor interface. */
+#define SERIAL_REQUEST_SET_EVENT_CHAR   0x06u
+#define SERIAL_REQUEST_SET_LATENCY      0x09u
+#define SERIAL_REQUEST_GET_LATENCY      0x0Au
+#define SERIAL_LATENCY_DEFAULT_MS       1u
+#define SERIAL_LATENCY_MIN_MS           1u   /* same range as the ftdi latency timer. */
+#define SERIAL_LATENCY_MAX_MS           255u
+#define SERIAL_POLICY_EVENT_CHAR        (1u << 0) /* flush when the event character is received. */
+#define SERIAL_POLICY_FLUSH_ON_IDLE     (1u << 1) /* flush when the rx line goes idle. */
+
+typedef struct
+{
+    uint16_t latency_ms; /* flush a partial packet this long after its first byte. */
+    uint8_t  event_char;
+    uint8_t  flags;      /* SERIAL_POLICY_xxx. */
+} serial_policy_t;
+
+/* serial bridge api, moves data between each cdc interface and its uart. */
+void     serial_task(void);
+uint32_t serial_status_command(const uint8_t *request, uint8_t *response);
+uint32_t serial_config_command(const uint8_t *request, uint8_t *response);
+uint32_t serial_capture_command(const uint8_t *request, uint8_t *response);
+uint32_t serial_autobaud_command(const uint8_t *request, uint8_t *response);
+void     serial_claim(uint8_t idx, bool claim);
+bool     serial_claimed(uint8_t idx);
+bool     serial_control_request(uint8_t rhport, tusb_control_request_t const * request);
+
+#endif /* SERIAL_H */
@@ -0,0 +1,383 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include <string.h>
+#include "platform.h"
+#include "tusb.h"
+#include "stream.h"
+
+/* every packet is written as a full endpoint-sized block so the usb packets line up
+ * with the frames, a partial packet is padded once it has waited STREAM_LATENCY.
+ */
+#define STREAM_PACKET_SIZE      CFG_TUD_VENDOR_EPSIZE
+#define STREAM_LATENCY          PLATFORM_MS_TO_TICKS(1u)
+
+/* longest a full OUT channel may hold the pipe without its consumer reading. a consumer
+ * waits at most PLATFORM_TIMER_MAX_MS (isp mass erase), the 2 s on top still fit the timer.
+ */
+#define STREAM_OUT_HOLD         (PLATFORM_MS_TO_TICKS(PLATFORM_TIMER_MAX_MS) + PLATFORM_MS_TO_TICKS(2000u))
+
+typedef struct
+{
+    uint8_t  *buf;
+    uint32_t size;      /* 2^n, 0 for a channel without a queue. */
+    uint32_t head;      /* free-running write count. */
+    uint32_t tail;      /* free-running read count. */
+    bool     out;       /* host to probe. */
+    bool     flow;      /* credit flow control on. */
+    uint32_t credit;    /* bytes the host still accepts. */
+    bool     attached;  /* OUT: a consumer is reading the channel. */
+    uint8_t  priority;
+    uint32_t dropped;   /* IN: records that did not fit, OUT: chunks discarded. */
+} stream_channel_t;
+
+static uint8_t stream_event_buf[128];
+static uint8_t stream_sampling_buf[256];
+static uint8_t stream_uart_buf[256];
+static uint8_t stream_isp_buf[256];
+
+#define STREAM_CHANNEL_IN(b, prio)  { .buf = (b), .size = sizeof(b), .out = false, .priority = (prio) }
+#define STREAM_CHANNEL_OUT(b)       { .buf = (b), .size = sizeof(b), .out = true }
+
+static stream_channel_t stream_channels[STREAM_CH_COUNT] =
+{
+    [STREAM_CH_EVENT]    = STREAM_CHANNEL_IN(stream_event_buf, 3u),
+    [STREAM_CH_SAMPLING] = STREAM_CHANNEL_IN(stream_sampling_buf, 1u),
+    [STREAM_CH_UART]     = STREAM_CHANNEL_IN(stream_uart_buf, 2u),
+    [STREAM_CH_ISP]      = STREAM_CHANNEL_OUT(stream_isp_buf),
+};
+
+static uint8_t  stream_next = 0u;        /* round robin start among equal priorities. */
+static bool     stream_pending = false;  /* IN data is waiting for a packet. */
+static uint32_t stream_pending_since;
+
+/* OUT frames may span packets, parser state. */
+static uint8_t  stream_rx_hdr[STREAM_FRAME_HDR];
+static uint32_t stream_rx_hdr_len = 0u;
+static uint8_t  stream_rx_channel;
+static uint32_t stream_rx_left = 0u;     /* data bytes left in the current frame. */
+static uint8_t  stream_ctrl[STREAM_CTRL_SIZE];
+static uint32_t stream_ctrl_len = 0u;
+static bool     stream_rx_holding = false; /* a full OUT channel is holding the pipe. */
+static uint32_t stream_rx_hold_since;
+
+static uint32_t stream_free(stream_channel_t *ch)
+{
+    return ch->size - (ch->head - ch->tail);
+}
+
+static void stream_put(stream_channel_t *ch, const uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0u; i < len; i++)
+    {
+        ch->buf[ch->head++ & (ch->size - 1u)] = data[i];
+    }
+}
+
+static uint8_t stream_type_channel(uint8_t type)
+{
+    switch (type)
+    {
+        case STREAM_TYPE_PROFILE:
+            return STREAM_CH_SAMPLING;
+        case STREAM_TYPE_SERIAL:
+            return STREAM_CH_UART;
+        default:
+            return STREAM_CH_EVENT;
+    }
+}
+
+/* queue a whole record on the channel of its type, or drop it. */
+bool stream_push(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    stream_channel_t *ch = &stream_channels[stream_type_channel(type)];
+    uint8_t hdr[2];
+
+    if (stream_free(ch) < (2u + len))
+    {
+        ch->dropped++;
+        return false;
+    }
+    hdr[0] = type;
+    hdr[1] = len;
+    stream_put(ch, hdr, sizeof(hdr));
+    stream_put(ch, payload, len);
+    return true;
+}
+
+/* bytes received on an OUT channel. */
+uint32_t stream_read(uint8_t channel, uint8_t *data, uint32_t len)
+{
+    if ( (channel >= STREAM_CH_COUNT) || !stream_channels[channel].out )
+    {
+        return 0u;
+    }
+    stream_channel_t *ch = &stream_channels[channel];
+    uint32_t n = ch->head - ch->tail;
+    if (n > len)
+    {
+        n = len;
+    }
+    for (uint32_t i = 0u; i < n; i++)
+    {
+        data[i] = ch->buf[ch->tail++ & (ch->size - 1u)];
+    }
+    return n;
+}
+
+/* an OUT channel only holds the pipe while a consumer is attached. */
+void stream_attach(uint8_t channel, bool attach)
+{
+    if ( (channel < STREAM_CH_COUNT) && stream_channels[channel].out )
+    {
+        stream_channels[channel].attached = attach;
+    }
+}
+
+static void stream_control(const uint8_t *msg)
+{
+    uint16_t value = (uint16_t)(msg[2] | (msg[3] << 8));
+
+    if (msg[1] >= STREAM_CH_COUNT)
+    {
+        return;
+    }
+    stream_channel_t *ch = &stream_channels[msg[1]];
+    switch (msg[0])
+    {
+        case STREAM_CTRL_CREDIT:
+            ch->flow    = true;
+            ch->credit += value;
+            break;
+        case STREAM_CTRL_PRIORITY:
+            ch->priority = (uint8_t)value;
+            break;
+        case STREAM_CTRL_RESET:
+            ch->tail   = ch->head;
+            ch->flow   = false;
+            ch->credit = 0u;
+            break;
+        default:
+            break;
+    }
+}
+
+/* a full OUT channel keeps the rest of its frame in the usb fifo, which naks the host,
+ * but only while its consumer is attached and reads within STREAM_OUT_HOLD. otherwise
+ * the data is discarded, so the frames behind it, control among them, always get through.
+ */
+static bool stream_hold(stream_channel_t *ch)
+{
+    uint32_t now = platform_timer_get();
+
+    if (!ch->attached)
+    {
+        return false;
+    }
+    if (!stream_rx_holding)
+    {
+        stream_rx_holding    = true;
+        stream_rx_hold_since = now;
+    }
+    if ((now - stream_rx_hold_since) < STREAM_OUT_HOLD)
+    {
+        return true;
+    }
+    ch->attached = false; /* the consumer went quiet without detaching. */
+    return false;
+}
+
+/* OUT: split frames into their channels. usb flow control is per pipe, a held channel
+ * holds every channel behind it, see stream_hold().
+ */
+static void stream_rx_task(void)
+{
+    uint8_t chunk[STREAM_PACKET_SIZE];
+
+    while (0u != tud_vendor_n_available(STREAM_ITF))
+    {
+        if (0u == stream_rx_left)
+        {
+            stream_rx_hdr_len += tud_vendor_n_read(STREAM_ITF, &stream_rx_hdr[stream_rx_hdr_len], STREAM_FRAME_HDR - stream_rx_hdr_len);
+            if (STREAM_FRAME_HDR == stream_rx_hdr_len)
+            {
+                stream_rx_hdr_len = 0u;
+                stream_rx_channel = stream_rx_hdr[0];
+                stream_rx_left    = stream_rx_hdr[1];
+            }
+            continue;
+        }
+
+        uint32_t n = (stream_rx_left > sizeof(chunk)) ? sizeof(chunk) : stream_rx_left;
+        stream_channel_t *ch = (stream_rx_channel < STREAM_CH_COUNT) ? &stream_channels[stream_rx_channel] : NULL;
+        bool keep = (NULL != ch) && ch->out;
+        if (keep)
+        {
+            if (0u == stream_free(ch))
+            {
+                if (stream_hold(ch))
+                {
+                    return;
+                }
+                keep = false;
+                ch->dropped++;
+            }
+            else if (n > stream_free(ch))
+            {
+                n = stream_free(ch);
+            }
+        }
+        stream_rx_holding = false;
+        n = tud_vendor_n_read(STREAM_ITF, chunk, n);
+        stream_rx_left -= n;
+        if (STREAM_CH_CONTROL == stream_rx_channel)
+        {
+            for (uint32_t i = 0u; i < n; i++)
+            {
+                stream_ctrl[stream_ctrl_len++] = chunk[i];
+                if (STREAM_CTRL_SIZE == stream_ctrl_len)
+                {
+                    stream_control(stream_ctrl);
+                    stream_ctrl_len = 0u;
+                }
+            }
+        }
+        else if (keep)
+        {
+            stream_put(ch, chunk, n);
+        }
+        /* anything else is padding, an unknown channel or discarded. */
+    }
+}
+
+/* bytes an IN channel may send now. */
+static uint32_t stream_sendable(stream_channel_t *ch)
+{
+    uint32_t n = ch->head - ch->tail;
+
+    if (ch->out)
+    {
+        return 0u;
+    }
+    if (ch->flow && (n > ch->credit))
+    {
+        n = ch->credit;
+    }
+    return n;
+}
+
+/* highest priority channel with data, round robin among equals. */
+static uint8_t stream_pick(void)
+{
+    uint8_t best = STREAM_CH_PAD;
+
+    for (uint32_t i = 0u; i < STREAM_CH_COUNT; i++)
+    {
+        uint8_t idx = (uint8_t)((stream_next + i) % STREAM_CH_COUNT);
+        if ( (0u != stream_sendable(&stream_channels[idx]))
+          && ((STREAM_CH_PAD == best) || (stream_channels[idx].priority > stream_channels[best].priority)) )
+        {
+            best = idx;
+        }
+    }
+    if (STREAM_CH_PAD != best)
+    {
+        stream_next = (uint8_t)((best + 1u) % STREAM_CH_COUNT);
+    }
+    return best;
+}
+
+/* IN: fill one packet with frames, only once it would be full or data has waited long enough. */
+static void stream_tx_task(void)
+{
+    uint32_t total = 0u;
+    uint32_t now = platform_timer_get();
+
+    for (uint32_t i = 0u; i < STREAM_CH_COUNT; i++)
+    {
+        uint32_t n = stream_sendable(&stream_channels[i]);
+        total += (0u != n) ? (STREAM_FRAME_HDR + n) : 0u;
+    }
+    if (0u == total)
+    {
+        stream_pending = false;
+        return;
+    }
+    if (!stream_pending)
+    {
+        stream_pending       = true;
+        stream_pending_since = now;
+    }
+    if ( ((total < STREAM_PACKET_SIZE) && ((now - stream_pending_since) < STREAM_LATENCY))
+      || !tud_vendor_n_mounted(STREAM_ITF) || (tud_vendor_n_write_available(STREAM_ITF) < STREAM_PACKET_SIZE) )
+    {
+        return;
+    }
+
+    uint8_t  packet[STREAM_PACKET_SIZE];
+    uint32_t len = 0u;
+    while ((len + STREAM_FRAME_HDR) < STREAM_PACKET_SIZE)
+    {
+        uint8_t idx = stream_pick();
+        if (STREAM_CH_PAD == idx)
+        {
+            break;
+        }
+        stream_channel_t *ch = &stream_channels[idx];
+        uint32_t n = stream_sendable(ch);
+        if (n > (STREAM_PACKET_SIZE - STREAM_FRAME_HDR - len))
+        {
+            n = STREAM_PACKET_SIZE - STREAM_FRAME_HDR - len;
+        }
+        packet[len++] = idx;
+        packet[len++] = (uint8_t)n;
+        for (uint32_t i = 0u; i < n; i++)
+        {
+            packet[len++] = ch->buf[ch->tail++ & (ch->size - 1u)];
+        }
+        if (ch->flow)
+        {
+            ch->credit -= n;
+        }
+    }
+    if (len < STREAM_PACKET_SIZE)
+    {
+        packet[len] = STREAM_CH_PAD;
+        memset(&packet[len + 1u], 0, STREAM_PACKET_SIZE - len - 1u);
+    }
+    tud_vendor_n_write(STREAM_ITF, packet, STREAM_PACKET_SIZE);
+#if (TUSB_VERSION_MAJOR > 0) || (TUSB_VERSION_MINOR >= 16)
+    tud_vendor_n_write_flush(STREAM_ITF);
+#endif
+    stream_pending_since = now;
+}
+
+void stream_task(void)
+{
+    stream_rx_task();
+    stream_tx_task();
+}
+
+/* stream.c - end */
@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define STREAM_ITF              0u    /* vendor interface instance. */
+
+/* channels multiplexed on the vendor bulk pair.
+ * every usb packet carries whole frames: channel (1), length (1), data. a channel
+ * is a byte stream, a record may span frames. STREAM_CH_PAD fills the rest of a packet.
+ * IN channels only carry the records of stream_push(), the cdc uart data has its own
+ * interfaces. 4 and 5 are unassigned.
+ */
+#define STREAM_CH_CONTROL       0u    /* OUT: STREAM_CTRL_xxx messages. */
+#define STREAM_CH_EVENT         1u    /* IN: halt and fault records. */
+#define STREAM_CH_SAMPLING      2u    /* IN: pc sampling records. */
+#define STREAM_CH_UART          3u    /* IN: uart capture records. */
+#define STREAM_CH_ISP           6u    /* OUT: isp image data. */
+#define STREAM_CH_COUNT         7u
+#define STREAM_CH_PAD           0xFFu
+#define STREAM_FRAME_HDR        2u
+
+/* control messages, 4 bytes each: op (1), channel (1), value (2). */
+#define STREAM_CTRL_CREDIT      0x01u /* allow value more bytes on the channel, switches it to credit flow control. */
+#define STREAM_CTRL_PRIORITY    0x02u /* set the channel priority, higher goes first. */
+#define STREAM_CTRL_RESET       0x03u /* drop queued data, back to no flow control. */
+#define STREAM_CTRL_SIZE        4u
+
+/* record types, sent as type (1), length (1), payload on the channel of the producer. */
+#define STREAM_TYPE_HALT        0x01u /* timestamp, DHCSR, DFSR, PC. */
+#define STREAM_TYPE_FAULT       0x02u /* fault snapshot, see halt_mon.c. */
+#define STREAM_TYPE_PROFILE     0x03u /* pc histogram delta, see profile.c. */
+#define STREAM_TYPE_SERIAL      0x04u /* timestamped uart rx chunk, see serial.c. */
+
+/* stream api. */
+bool     stream_push(uint8_t type, const uint8_t *payload, uint8_t len);
+uint32_t stream_read(uint8_t channel, uint8_t *data, uint32_t len);
+void     stream_attach(uint8_t channel, bool attach);
+void     stream_task(void);
+
+#endif /* STREAM_H */
@@ -0,0 +1,209 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "target.h"
+#include "swj_tune.h"
+
+#define SWJ_TUNE_BURST              64u  /* IDCODE and RAM checks per clock step. */
+#define SWJ_TUNE_FALLBACK_ERRORS    4u   /* host transfer errors before stepping down. */
+#define SWJ_TUNE_FALLBACK_WINDOW    256u /* good host transfers that clear the error count. */
+
+/* requested clocks in ascending order, DAP_SWJ_Clock rounds each to the nearest achievable setting. */
+static const uint32_t swj_tune_clock_tbl[] =
+{
+    1000000u, 2000000u, 3000000u, 4000000u, 6000000u, 8000000u, 10000000u, CPU_CLOCK / 8u,
+};
+#define SWJ_TUNE_CLOCK_NUM  (sizeof(swj_tune_clock_tbl) / sizeof(swj_tune_clock_tbl[0]))
+
+static bool     swj_tune_active = false; /* clock is owned by the tuner, fall back on errors. */
+static uint32_t swj_tune_index  = 0u;
+static uint32_t swj_tune_errors = 0u;
+static uint32_t swj_tune_good   = 0u;
+
+static void swj_tune_set_clock(uint32_t clock)
+{
+    uint8_t request[5];
+    uint8_t response[2];
+    request[0] = ID_DAP_SWJ_Clock;
+    dap_put_le32(&request[1], clock);
+    DAP_ProcessCommand(request, response);
+}
+
+/* line reset and IDCODE read, required after a desync before any other transfer. */
+static bool swj_tune_resync(uint32_t *idcode)
+{
+    target_line_reset();
+    return DAP_TRANSFER_OK == target_dp_read(DP_IDCODE, idcode);
+}
+
+static bool swj_tune_check(uint32_t idcode, uint32_t ram_addr)
+{
+    for (uint32_t i = 0u; i < SWJ_TUNE_BURST; i++)
+    {
+        uint32_t val;
+        if ( (DAP_TRANSFER_OK != target_dp_read(DP_IDCODE, &val)) || (val != idcode) )
+        {
+            return false;
+        }
+        if (0u != ram_addr)
+        {
+            uint32_t pattern = (i & 1u) ? (0xAAAAAAAAu ^ i) : (0x55555555u ^ (i << 16));
+            if (   (DAP_TRANSFER_OK != target_mem_write(ram_addr, pattern))
+                || (DAP_TRANSFER_OK != target_mem_read(ram_addr, &val))
+                || (val != pattern) )
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* step through the clock table and keep the fastest setting that passes the whole burst.
+ * ram_addr is a word of target RAM the host allows us to scribble on (0 = IDCODE only),
+ * its content is restored before returning. returns the selected clock, 0 on failure.
+ */
+uint32_t swj_tune_run(uint32_t ram_addr, uint32_t max_clock, uint32_t *idcode)
+{
+    uint32_t ram_saved = 0u;
+    uint32_t good = 0u;
+
+    swj_tune_active = false;
+    swj_tune_set_clock(swj_tune_clock_tbl[0]);
+    if ( !swj_tune_resync(idcode) || !target_begin() )
+    {
+        return 0u;
+    }
+    if ( (0u != ram_addr) && (DAP_TRANSFER_OK != target_mem_read(ram_addr, &ram_saved)) )
+    {
+        target_end();
+        return 0u;
+    }
+
+    uint8_t  last_fast  = DAP_Data.fast_clock;
+    uint32_t last_delay = DAP_Data.clock_delay;
+    for (uint32_t i = 1u; (i < SWJ_TUNE_CLOCK_NUM) && (0u == max_clock || swj_tune_clock_tbl[i] <= max_clock); i++)
+    {
+        swj_tune_set_clock(swj_tune_clock_tbl[i]);
+        if ( (DAP_Data.fast_clock == last_fast) && (DAP_Data.clock_delay == last_delay) )
+        {
+            good = i; /* same setting as the previous step. */
+            continue;
+        }
+        last_fast  = DAP_Data.fast_clock;
+        last_delay = DAP_Data.clock_delay;
+        if ( !swj_tune_check(*idcode, ram_addr) )
+        {
+            break;
+        }
+        good = i;
+    }
+
+    swj_tune_set_clock(swj_tune_clock_tbl[good]);
+    if (swj_tune_resync(idcode) && (0u != ram_addr))
+    {
+        target_mem_write(ram_addr, ram_saved);
+    }
+    target_end();
+
+    swj_tune_index  = good;
+    swj_tune_errors = 0u;
+    swj_tune_good   = 0u;
+    swj_tune_active = true;
+    return swj_tune_clock_tbl[good];
+}
+
+/* watch host transfers and step the clock down when parity or protocol errors pile up. */
+void swj_tune_observe(const uint8_t *request, const uint8_t *response)
+{
+    uint32_t status;
+
+    if (!swj_tune_active)
+    {
+        return;
+    }
+    switch (request[0])
+    {
+        case ID_DAP_SWJ_Clock: /* host took the clock back. */
+            swj_tune_active = false;
+            return;
+        case ID_DAP_Transfer:
+            status = response[2];
+            break;
+        case ID_DAP_TransferBlock:
+            status = response[3];
+            break;
+        default:
+            return;
+    }
+
+    uint32_t ack = status & 0x07u;
+    if ( (0u == (status & DAP_TRANSFER_ERROR)) && ( (DAP_TRANSFER_OK == ack) || (DAP_TRANSFER_WAIT == ack) || (DAP_TRANSFER_FAULT == ack) ) )
+    {
+        if (++swj_tune_good >= SWJ_TUNE_FALLBACK_WINDOW)
+        {
+            swj_tune_good   = 0u;
+            swj_tune_errors = 0u;
+        }
+        return;
+    }
+    if (++swj_tune_errors < SWJ_TUNE_FALLBACK_ERRORS)
+    {
+        return;
+    }
+
+    swj_tune_errors = 0u;
+    swj_tune_good   = 0u;
+    if (0u == swj_tune_index)
+    {
+        swj_tune_active = false; /* nothing slower to fall back to. */
+        return;
+    }
+    uint8_t  fast  = DAP_Data.fast_clock;
+    uint32_t delay = DAP_Data.clock_delay;
+    do
+    {
+        swj_tune_set_clock(swj_tune_clock_tbl[--swj_tune_index]);
+    } while ( (0u != swj_tune_index) && (DAP_Data.fast_clock == fast) && (DAP_Data.clock_delay == delay) );
+}
+
+/* request: ram_addr (4), max_clock (4, 0 = no limit).
+ * response: status (1), selected clock (4), idcode (4).
+ */
+uint32_t swj_tune_command(const uint8_t *request, uint8_t *response)
+{
+    uint32_t idcode = 0u;
+    uint32_t clock  = swj_tune_run(dap_get_le32(&request[0]), dap_get_le32(&request[4]), &idcode);
+
+    response[0] = (0u != clock) ? DAP_OK : DAP_ERROR;
+    dap_put_le32(&response[1], clock);
+    dap_put_le32(&response[5], idcode);
+    return (8u << 16) | 9u;
+}
+
+/* swj_tune.c - end */
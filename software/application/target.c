@@ -0,0 +1,343 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "target.h"
+
+#define TARGET_ABORT_CLEAR  0x1Eu /* STKCMPCLR | STKERRCLR | WDERRCLR | ORUNERRCLR. */
+#define TARGET_STICKY       0xB2u /* CTRL/STAT WDATAERR | STICKYERR | STICKYCMP | STICKYORUN. */
+
+static uint32_t target_host_select = 0u;        /* last SELECT value written by the host. */
+static bool     target_host_select_valid = false;
+static uint32_t target_select = 0u;             /* SELECT value currently on the wire. */
+static bool     target_select_valid = false;
+static uint32_t target_saved_csw;
+static uint32_t target_saved_tar;
+static bool     target_saved = false;
+static bool     target_owned = false;           /* sticky flags were clear at target_begin(). */
+
+/* single swd transfer, retry on WAIT. a FAULT inside target_begin() / target_end() is one
+ * of ours, its sticky flags are cleared. outside, they are the host's and stay for it to see.
+ */
+static uint8_t target_transfer(uint32_t request, uint32_t *data)
+{
+    uint32_t retry = DAP_Data.transfer.retry_count;
+    uint8_t  ack;
+
+    do
+    {
+        ack = SWD_Transfer(request, data);
+    } while ( (DAP_TRANSFER_WAIT == ack) && (retry-- != 0u) && (0u == DAP_TransferAbort) );
+
+    if ( (DAP_TRANSFER_FAULT == ack) && target_owned )
+    {
+        uint32_t abort = TARGET_ABORT_CLEAR;
+        SWD_Transfer(DP_ABORT, &abort);
+    }
+    return ack;
+}
+
+static uint8_t target_select_bank(uint32_t reg)
+{
+    uint32_t select = reg & 0xF0u; /* APSEL 0, APBANKSEL from reg. */
+    if (target_select_valid && target_select == select)
+    {
+        return DAP_TRANSFER_OK;
+    }
+    uint8_t ack = target_dp_write(DP_SELECT, select);
+    if (DAP_TRANSFER_OK == ack)
+    {
+        target_select = select;
+        target_select_valid = true;
+    }
+    return ack;
+}
+
+void target_line_reset(void)
+{
+    static const uint8_t seq[8] = {0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0x00u};
+    SWJ_Sequence(64u, seq); /* >50 clocks high then idle. */
+    target_select_valid = false;
+}
+
+uint8_t target_dp_read(uint32_t reg, uint32_t *data)
+{
+    return target_transfer(DAP_TRANSFER_RnW | (reg & 0x0Cu), data);
+}
+
+uint8_t target_dp_write(uint32_t reg, uint32_t data)
+{
+    if (DP_SELECT == (reg & 0x0Cu))
+    {
+        target_select_valid = false;
+    }
+    return target_transfer(reg & 0x0Cu, &data);
+}
+
+uint8_t target_ap_read(uint32_t reg, uint32_t *data)
+{
+    uint8_t ack = target_select_bank(reg);
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | (reg & 0x0Cu), NULL); /* posted read. */
+    }
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_transfer(DAP_TRANSFER_RnW | DP_RDBUFF, data);
+    }
+    return ack;
+}
+
+uint8_t target_ap_write(uint32_t reg, uint32_t data)
+{
+    uint8_t ack = target_select_bank(reg);
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_transfer(DAP_TRANSFER_APnDP | (reg & 0x0Cu), &data);
+    }
+    return ack;
+}
+
+uint8_t target_mem_read(uint32_t addr, uint32_t *data)
+{
+    uint8_t ack = target_ap_write(TARGET_AP_TAR, addr);
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_ap_read(TARGET_AP_DRW, data);
+    }
+    return ack;
+}
+
+uint8_t target_mem_write(uint32_t addr, uint32_t data)
+{
+    uint8_t ack = target_ap_write(TARGET_AP_TAR, addr);
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_ap_write(TARGET_AP_DRW, data);
+    }
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_dp_read(DP_RDBUFF, NULL); /* wait for the write to complete. */
+    }
+    return ack;
+}
+
+/* n pipelined DRW reads, each AP read returns the previous one and RDBUFF the last. */
+static uint8_t target_read_drw(uint32_t *data, uint32_t n)
+{
+    uint8_t ack = target_transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | TARGET_AP_DRW, NULL);
+    for (uint32_t i = 1u; (i < n) && (DAP_TRANSFER_OK == ack); i++)
+    {
+        ack = target_transfer(DAP_TRANSFER_APnDP | DAP_TRANSFER_RnW | TARGET_AP_DRW, data++);
+    }
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_transfer(DAP_TRANSFER_RnW | DP_RDBUFF, data);
+    }
+    return ack;
+}
+
+/* word reads with TAR auto-increment, TAR is rewritten at each 1KB boundary. */
+uint8_t target_mem_read_block(uint32_t addr, uint32_t *data, uint32_t count)
+{
+    uint8_t ack = target_ap_write(TARGET_AP_CSW, TARGET_CSW_WORD_INC);
+
+    while ( (DAP_TRANSFER_OK == ack) && (0u != count) )
+    {
+        uint32_t n = (0x400u - (addr & 0x3FFu)) / 4u;
+        if (n > count)
+        {
+            n = count;
+        }
+        ack = target_ap_write(TARGET_AP_TAR, addr);
+        if (DAP_TRANSFER_OK == ack)
+        {
+            ack = target_read_drw(data, n);
+        }
+        data  += n;
+        addr  += 4u * n;
+        count -= n;
+    }
+    target_ap_write(TARGET_AP_CSW, TARGET_CSW_WORD);
+    return ack;
+}
+
+/* word writes with TAR auto-increment, TAR is rewritten at each 1KB boundary. */
+uint8_t target_mem_write_block(uint32_t addr, const uint32_t *data, uint32_t count)
+{
+    uint8_t ack = target_ap_write(TARGET_AP_CSW, TARGET_CSW_WORD_INC);
+
+    while ( (DAP_TRANSFER_OK == ack) && (0u != count) )
+    {
+        uint32_t n = (0x400u - (addr & 0x3FFu)) / 4u;
+        if (n > count)
+        {
+            n = count;
+        }
+        ack = target_ap_write(TARGET_AP_TAR, addr);
+        for (uint32_t i = 0u; (i < n) && (DAP_TRANSFER_OK == ack); i++)
+        {
+            uint32_t val = data[i];
+            ack = target_transfer(DAP_TRANSFER_APnDP | TARGET_AP_DRW, &val);
+        }
+        data  += n;
+        addr  += 4u * n;
+        count -= n;
+    }
+    if (DAP_TRANSFER_OK == ack)
+    {
+        ack = target_dp_read(DP_RDBUFF, NULL); /* wait for the last write to complete. */
+    }
+    target_ap_write(TARGET_AP_CSW, TARGET_CSW_WORD);
+    return ack;
+}
+
+/* read the same word count times, used for sampling registers such as DWT_PCSR. */
+uint8_t target_mem_read_repeat(uint32_t addr, uint32_t *data, uint32_t count)
+{
+    uint8_t ack = target_ap_write(TARGET_AP_TAR, addr);
+    if ( (DAP_TRANSFER_OK == ack) && (0u != count) )
+    {
+        ack = target_read_drw(data, count);
+    }
+    return ack;
+}
+
+bool target_begin(void)
+{
+    if (DAP_PORT_SWD != DAP_Data.debug_port)
+    {
+        return false;
+    }
+    target_select       = target_host_select;
+    target_select_valid = target_host_select_valid;
+    target_saved        = false;
+
+    /* a sticky flag left by the host's own accesses is for the host to read and clear, the
+     * abort after a fault of ours would wipe it, so stay off the wire until it is gone.
+     * CTRL/STAT sits in DP bank 0.
+     */
+    uint32_t ctrl_stat;
+    if ( target_select_valid && (0u != (target_select & 0x0Fu)) )
+    {
+        if (DAP_TRANSFER_OK != target_dp_write(DP_SELECT, target_select & 0xF0u))
+        {
+            target_end();
+            return false;
+        }
+    }
+    if ( (DAP_TRANSFER_OK != target_dp_read(DP_CTRL_STAT, &ctrl_stat)) || (0u != (ctrl_stat & TARGET_STICKY)) )
+    {
+        target_end();
+        return false;
+    }
+    target_owned = true;
+
+    if (   (DAP_TRANSFER_OK != target_ap_read(TARGET_AP_CSW, &target_saved_csw))
+        || (DAP_TRANSFER_OK != target_ap_read(TARGET_AP_TAR, &target_saved_tar)) )
+    {
+        target_end();
+        return false;
+    }
+    target_saved = true;
+    if (DAP_TRANSFER_OK != target_ap_write(TARGET_AP_CSW, TARGET_CSW_WORD))
+    {
+        target_end();
+        return false;
+    }
+    return true;
+}
+
+void target_end(void)
+{
+    if (target_saved)
+    {
+        target_ap_write(TARGET_AP_CSW, target_saved_csw);
+        target_ap_write(TARGET_AP_TAR, target_saved_tar);
+        target_saved = false;
+    }
+    if ( target_host_select_valid && ( !target_select_valid || (target_select != target_host_select) ) )
+    {
+        target_dp_write(DP_SELECT, target_host_select);
+    }
+    target_owned = false;
+}
+
+/* DAP_Transfer: index, count, then per transfer the request byte and optional data word. */
+static void target_observe_transfer(const uint8_t *request, uint32_t done)
+{
+    uint32_t count = request[1];
+    request += 2;
+    for (uint32_t i = 0u; (i < count) && (i < done); i++)
+    {
+        uint32_t req = *request++;
+        if (0u == (req & DAP_TRANSFER_RnW))
+        {
+            if ( (DP_SELECT == (req & 0x0Fu)) && (0u == (req & DAP_TRANSFER_MATCH_MASK)) )
+            {
+                target_host_select = dap_get_le32(request);
+                target_host_select_valid = true;
+            }
+            request += 4;
+        }
+        else if (0u != (req & DAP_TRANSFER_MATCH_VALUE))
+        {
+            request += 4;
+        }
+    }
+}
+
+/* DAP_TransferBlock: index, count (16-bit), request byte, then data words for writes. */
+static void target_observe_transfer_block(const uint8_t *request, uint32_t done)
+{
+    uint32_t req = request[3];
+    if ( (0u != done) && (DP_SELECT == (req & 0x0Fu)) )
+    {
+        target_host_select = dap_get_le32(&request[4u + 4u * (done - 1u)]);
+        target_host_select_valid = true;
+    }
+}
+
+void target_observe_command(const uint8_t *request, const uint8_t *response)
+{
+    switch (request[0])
+    {
+        case ID_DAP_Connect:
+            target_host_select_valid = false;
+            break;
+        case ID_DAP_Transfer:
+            target_observe_transfer(&request[1], response[1]);
+            break;
+        case ID_DAP_TransferBlock:
+            target_observe_transfer_block(&request[1], (uint32_t)response[1] | ((uint32_t)response[2] << 8));
+            break;
+        default:
+            break;
+    }
+}
+
+/* target.c - end */
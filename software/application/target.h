@@ -0,0 +1,85 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef TARGET_H
+#define TARGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* MEM-AP registers (AP0, bank 0). */
+#define TARGET_AP_CSW       0x00u
+#define TARGET_AP_TAR       0x04u
+#define TARGET_AP_DRW       0x0Cu
+
+/* CSW for 32-bit accesses without / with single auto-increment. */
+#define TARGET_CSW_WORD     0x23000002u
+#define TARGET_CSW_WORD_INC 0x23000012u
+
+/* Cortex-M core debug registers. */
+#define TARGET_DHCSR        0xE000EDF0u
+#define TARGET_DCRSR        0xE000EDF4u
+#define TARGET_DCRDR        0xE000EDF8u
+#define TARGET_CFSR         0xE000ED28u /* CFSR, HFSR, DFSR, MMFAR, BFAR are contiguous. */
+#define TARGET_HFSR         0xE000ED2Cu
+#define TARGET_DFSR         0xE000ED30u
+#define TARGET_MMFAR        0xE000ED34u
+#define TARGET_BFAR         0xE000ED38u
+#define TARGET_DWT_CTRL     0xE0001000u
+#define TARGET_DWT_PCSR     0xE000101Cu
+#define TARGET_DFSR_HALTED      (1u << 0)
+#define TARGET_DFSR_VCATCH      (1u << 3)
+#define TARGET_DFSR_ALL         0x1Fu     /* EXTERNAL, VCATCH, DWTTRAP, BKPT, HALTED, write 1 to clear. */
+#define TARGET_DHCSR_DBGKEY     0xA05F0000u
+#define TARGET_DHCSR_C_DEBUGEN  (1u << 0)
+#define TARGET_DHCSR_C_HALT     (1u << 1)
+#define TARGET_DHCSR_S_REGRDY   (1u << 16)
+#define TARGET_DHCSR_S_HALT     (1u << 17)
+#define TARGET_DCRSR_REGWnR     (1u << 16)
+
+/* target api.
+ * probe-side accesses share the wire with the host debugger, so every
+ * sequence must be wrapped in target_begin() / target_end(), which save and
+ * restore the DP SELECT, MEM-AP CSW and TAR values the host has cached.
+ * target_begin() fails while a CTRL/STAT sticky flag is set, those belong to the host.
+ * all access functions return the SWD ack (DAP_TRANSFER_OK on success).
+ */
+bool    target_begin(void);
+void    target_end(void);
+void    target_line_reset(void);
+uint8_t target_dp_read(uint32_t reg, uint32_t *data);
+uint8_t target_dp_write(uint32_t reg, uint32_t data);
+uint8_t target_ap_read(uint32_t reg, uint32_t *data);
+uint8_t target_ap_write(uint32_t reg, uint32_t data);
+uint8_t target_mem_read(uint32_t addr, uint32_t *data);
+uint8_t target_mem_write(uint32_t addr, uint32_t data);
+uint8_t target_mem_read_block(uint32_t addr, uint32_t *data, uint32_t count);
+uint8_t target_mem_write_block(uint32_t addr, const uint32_t *data, uint32_t count);
+uint8_t target_mem_read_repeat(uint32_t addr, uint32_t *data, uint32_t count);
+
+/* track the wire state the host debugger leaves behind, called for each executed dap command. */
+void    target_observe_command(const uint8_t *request, const uint8_t *response);
+
+#endif /* TARGET_H */
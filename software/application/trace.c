@@ -0,0 +1,114 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#include "DAP_config.h"
+#include "DAP.h"
+#include "DAP_vendor.h"
+#include "trace.h"
+
+#define TRACE_EVENT_SIZE        8u
+#define TRACE_RESPONSE_HDR      14u /* status, head, now, first, count. */
+#define TRACE_EVENTS_MAX        ((DAP_PACKET_SIZE - 1u - TRACE_RESPONSE_HDR) / TRACE_EVENT_SIZE)
+
+static trace_event_t trace_usb_buf[TRACE_USB_SIZE];
+static trace_event_t trace_thread_buf[TRACE_THREAD_SIZE];
+
+trace_ring_t trace_rings[TRACE_RING_COUNT] =
+{
+    { .buf = trace_usb_buf,    .mask = TRACE_USB_SIZE - 1u,    .head = 0u },
+    { .buf = trace_thread_buf, .mask = TRACE_THREAD_SIZE - 1u, .head = 0u },
+};
+
+volatile bool trace_paused = false;
+
+/* request: ring (1), flags (1) TRACE_FLAG_xxx, first (4) sequence number of the first event wanted.
+ * response: status (1), head (4), now (4) TIM2, first (4) sequence number of the first event
+ *           returned, count (1), events: time (4), type (1), arg (1), value (2).
+ * events older than head - ring size are gone, first is moved up to the oldest one still
+ * there. the copy races the writer, events it overwrote meanwhile are dropped from the front.
+ */
+uint32_t trace_command(const uint8_t *request, uint8_t *response)
+{
+    uint8_t  idx   = request[0];
+    uint32_t first = dap_get_le32(&request[2]);
+    uint32_t count = 0u;
+
+    trace_paused = (0u != (request[1] & TRACE_FLAG_PAUSE));
+    response[0] = DAP_ERROR;
+    if ( (0u == TRACE_ENABLE) || (idx >= TRACE_RING_COUNT) )
+    {
+        return (6u << 16) | 1u;
+    }
+
+    trace_ring_t *ring = &trace_rings[idx];
+    uint32_t size = ring->mask + 1u;
+    uint32_t head = ring->head;
+    if ((head - first) > size) /* also catches first beyond head. */
+    {
+        first = (head > size) ? (head - size) : 0u;
+    }
+    count = head - first;
+    if (count > TRACE_EVENTS_MAX)
+    {
+        count = TRACE_EVENTS_MAX;
+    }
+
+    uint8_t *out = &response[TRACE_RESPONSE_HDR];
+    for (uint32_t i = 0u; i < count; i++)
+    {
+        volatile trace_event_t *ev = &ring->buf[(first + i) & ring->mask];
+        dap_put_le32(&out[0], ev->time);
+        out[4] = ev->type;
+        out[5] = ev->arg;
+        out[6] = (uint8_t)(ev->value);
+        out[7] = (uint8_t)(ev->value >> 8);
+        out += TRACE_EVENT_SIZE;
+    }
+
+    head = ring->head;
+    if ( (0u != count) && ((head - first) > size) )
+    {
+        uint32_t lost = head - size - first; /* overwritten while copying. */
+        if (lost > count)
+        {
+            lost = count;
+        }
+        for (uint32_t i = lost * TRACE_EVENT_SIZE; i < count * TRACE_EVENT_SIZE; i++)
+        {
+            response[TRACE_RESPONSE_HDR + i - lost * TRACE_EVENT_SIZE] = response[TRACE_RESPONSE_HDR + i];
+        }
+        first += lost;
+        count -= lost;
+    }
+
+    response[0] = DAP_OK;
+    dap_put_le32(&response[1], head);
+    dap_put_le32(&response[5], TIM2->CNT);
+    dap_put_le32(&response[9], first);
+    response[13] = (uint8_t)count;
+    return (6u << 16) | (TRACE_RESPONSE_HDR + count * TRACE_EVENT_SIZE);
+}
+
+/* trace.c - end */
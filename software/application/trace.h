@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hal_device_registers.h"
+
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE            1u /* 0 compiles the recorders out. */
+#endif
+
+/* one ring per context that records, the usb interrupt and thread mode. each ring has a
+ * single writer, so recording takes no lock and never masks interrupts. no other interrupt
+ * may record. sizes are powers of two, old events are overwritten.
+ */
+#define TRACE_RING_USB          0u
+#define TRACE_RING_THREAD       1u
+#define TRACE_RING_COUNT        2u
+#define TRACE_USB_SIZE          32u
+#define TRACE_THREAD_SIZE       16u
+
+/* event types, with what arg and value carry. */
+#define TRACE_USB_TOKEN         0x01u /* ep address, size (10 bits), bd odd (1), next data1 (1), pid (4). */
+#define TRACE_USB_RESET         0x02u
+#define TRACE_USB_SUSPEND       0x03u
+#define TRACE_USB_RESUME        0x04u
+#define TRACE_USB_STALL         0x05u /* stall handshake sent on ep0. */
+#define TRACE_USB_XFER          0x06u /* ep address, bytes queued. */
+#define TRACE_USB_XFER_BUSY     0x07u /* ep address, bytes refused, the bd is still with the sie. */
+#define TRACE_USB_EP_STALL      0x08u /* ep address, 1 stalled, 0 cleared. */
+#define TRACE_USB_ADDRESS       0x09u /* device address. */
+#define TRACE_DAP_START         0x10u /* command id, first two request bytes. */
+#define TRACE_DAP_END           0x11u /* command id, response bytes. */
+
+#define TRACE_FLAG_PAUSE        (1u << 0) /* download flag, stop recording until a request without it. */
+
+typedef struct
+{
+    uint32_t time;      /* TIM2 ticks. */
+    uint8_t  type;
+    uint8_t  arg;
+    uint16_t value;
+} trace_event_t;
+
+typedef struct
+{
+    volatile trace_event_t *buf;
+    uint32_t                mask;
+    volatile uint32_t       head; /* events ever recorded, the newest is head - 1. */
+} trace_ring_t;
+
+extern trace_ring_t  trace_rings[TRACE_RING_COUNT];
+extern volatile bool trace_paused;
+
+/* record an event in the ring of the current context. inline, so the sram handlers do not
+ * call out to flash for it.
+ */
+static inline void trace_event(uint8_t type, uint8_t arg, uint16_t value)
+{
+#if TRACE_ENABLE
+    if (trace_paused)
+    {
+        return;
+    }
+    trace_ring_t *ring = &trace_rings[(0u != __get_IPSR()) ? TRACE_RING_USB : TRACE_RING_THREAD];
+    uint32_t head = ring->head;
+    volatile trace_event_t *ev = &ring->buf[head & ring->mask];
+    ev->time   = TIM2->CNT;
+    ev->type   = type;
+    ev->arg    = arg;
+    ev->value  = value;
+    ring->head = head + 1u; /* publish after the event is complete. */
+#else
+    (void) type;
+    (void) arg;
+    (void) value;
+#endif
+}
+
+/* event trace api, download with ID_DAP_VENDOR_TRACE, tools/trace_pcap.py makes a pcapng of it. */
+uint32_t trace_command(const uint8_t *request, uint8_t *response);
+
+#endif /* TRACE_H */
@@ -42,13 +42,23 @@ extern "C" {
 #define CFG_TUSB_MEM_ALIGN          __attribute__ ((aligned(4)))
 #define CFG_TUD_ENDPOINT0_SIZE      64
 
+#define CFG_TUD_ENDPOINT_MAX        8 /* USB_FSEPCTL_COUNT, the bare CFG_TUSB_MCU default allows 5. */
+
+#ifdef BRD_LPUART_TX_GPIO_PORT
+#define CFG_TUD_CDC                 2 /* one per serial channel, see PLATFORM_UART_COUNT. */
+#else
 #define CFG_TUD_CDC                 1
+#endif
 #define CFG_TUD_HID                 1
+#define CFG_TUD_VENDOR              1
 
 #define CFG_TUD_HID_EP_BUFSIZE      64
-#define CFG_TUD_CDC_RX_BUFSIZE      64
-#define CFG_TUD_CDC_TX_BUFSIZE      64
+#define CFG_TUD_CDC_RX_BUFSIZE      128
+#define CFG_TUD_CDC_TX_BUFSIZE      128
 #define CFG_TUD_CDC_EP_BUFSIZE      64
+#define CFG_TUD_VENDOR_RX_BUFSIZE   64
+#define CFG_TUD_VENDOR_TX_BUFSIZE   128
+#define CFG_TUD_VENDOR_EPSIZE       64
 
 #ifdef __cplusplus
 }
@@ -24,6 +24,7 @@
  */
 
 #include "tusb.h"
+#include "serial.h"
 
 /*
  * Device Descriptors
@@ -32,7 +33,7 @@ const tusb_desc_device_t desc_device =
 {
     .bLength            = sizeof(tusb_desc_device_t),
     .bDescriptorType    = TUSB_DESC_DEVICE,
-    .bcdUSB             = 0x0110,
+    .bcdUSB             = 0x0210, /* 2.1 for the BOS descriptor. */
     .bDeviceClass       = 0x00,
     .bDeviceSubClass    = 0x00,
     .bDeviceProtocol    = 0x00,
@@ -85,15 +86,25 @@ enum
     ITF_NUM_HID,
     ITF_NUM_CDC,
     ITF_NUM_CDC_DATA,
+    ITF_NUM_VENDOR,
+#if (CFG_TUD_CDC > 1)
+    ITF_NUM_CDC2,
+    ITF_NUM_CDC2_DATA,
+#endif
     ITF_NUM_TOTAL
 };
 
-#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN + TUD_CDC_DESC_LEN)
+#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN + TUD_VENDOR_DESC_LEN + (CFG_TUD_CDC * TUD_CDC_DESC_LEN))
 
 #define EPNUM_HID           0x01
 #define EPNUM_CDC_NOTIF     0x82
 #define EPNUM_CDC_OUT       0x03
 #define EPNUM_CDC_IN        0x83
+#define EPNUM_VENDOR_OUT    0x04
+#define EPNUM_VENDOR_IN     0x84
+#define EPNUM_CDC2_NOTIF    0x85
+#define EPNUM_CDC2_OUT      0x06
+#define EPNUM_CDC2_IN       0x86
 
 uint8_t const desc_configuration[] =
 {
@@ -105,6 +116,14 @@ uint8_t const desc_configuration[] =
 
     /* Interface number, string index, EP notification address and size, EP data address (out, in) and size. */
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, EPNUM_CDC_IN, 64),
+
+    /* Interface number, string index, EP Out & IN address, EP size. */
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, 5, EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN, CFG_TUD_VENDOR_EPSIZE),
+
+#if (CFG_TUD_CDC > 1)
+    /* second serial bridge (LPUART), after the vendor interface so existing interface numbers stay put. */
+    TUD_CDC_DESCRIPTOR(ITF_NUM_CDC2, 6, EPNUM_CDC2_NOTIF, 8, EPNUM_CDC2_OUT, EPNUM_CDC2_IN, 64),
+#endif
 };
 
 /* Invoked when received GET CONFIGURATION DESCRIPTOR
@@ -117,6 +136,83 @@ uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
     return desc_configuration;
 }
 
+/*
+ * BOS Descriptor, points Windows at the MS OS 2.0 descriptor so the vendor interface binds to WinUSB.
+ */
+
+#define VENDOR_REQUEST_MICROSOFT    0x01
+#define MS_OS_20_DESC_LEN           0xB2
+#define BOS_TOTAL_LEN               (TUD_BOS_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN)
+
+uint8_t const desc_bos[] =
+{
+    /* total length, number of device caps. */
+    TUD_BOS_DESCRIPTOR(BOS_TOTAL_LEN, 1),
+
+    /* MS OS 2.0 descriptor set length, vendor code. */
+    TUD_BOS_MS_OS_20_DESCRIPTOR(MS_OS_20_DESC_LEN, VENDOR_REQUEST_MICROSOFT)
+};
+
+/* Invoked when received GET BOS DESCRIPTOR request
+ * Application return pointer to descriptor
+ */
+uint8_t const * tud_descriptor_bos_cb(void)
+{
+    return desc_bos;
+}
+
+uint8_t const desc_ms_os_20[] =
+{
+    /* Set header: length, type, windows version, total length. */
+    U16_TO_U8S_LE(0x000A), U16_TO_U8S_LE(MS_OS_20_SET_HEADER_DESCRIPTOR), U32_TO_U8S_LE(0x06030000), U16_TO_U8S_LE(MS_OS_20_DESC_LEN),
+
+    /* Configuration subset header: length, type, configuration index, reserved, configuration total length. */
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_CONFIGURATION), 0, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A),
+
+    /* Function subset header: length, type, first interface, reserved, subset length. */
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_FUNCTION), ITF_NUM_VENDOR, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08),
+
+    /* Compatible ID descriptor: length, type, compatible ID, sub compatible ID. */
+    U16_TO_U8S_LE(0x0014), U16_TO_U8S_LE(MS_OS_20_FEATURE_COMPATBLE_ID), 'W', 'I', 'N', 'U', 'S', 'B', 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+
+    /* Registry property descriptor: length, type, data type, name length, "DeviceInterfaceGUIDs\0" in UTF-16. */
+    U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08 - 0x08 - 0x14), U16_TO_U8S_LE(MS_OS_20_FEATURE_REG_PROPERTY),
+    U16_TO_U8S_LE(0x0007), U16_TO_U8S_LE(0x002A),
+    'D', 0x00, 'e', 0x00, 'v', 0x00, 'i', 0x00, 'c', 0x00, 'e', 0x00, 'I', 0x00, 'n', 0x00, 't', 0x00, 'e', 0x00,
+    'r', 0x00, 'f', 0x00, 'a', 0x00, 'c', 0x00, 'e', 0x00, 'G', 0x00, 'U', 0x00, 'I', 0x00, 'D', 0x00, 's', 0x00, 0x00, 0x00,
+
+    /* data length, "{CDB3B5AD-293B-4663-AA36-1AAE46463776}\0\0" in UTF-16. */
+    U16_TO_U8S_LE(0x0050),
+    '{', 0x00, 'C', 0x00, 'D', 0x00, 'B', 0x00, '3', 0x00, 'B', 0x00, '5', 0x00, 'A', 0x00, 'D', 0x00, '-', 0x00,
+    '2', 0x00, '9', 0x00, '3', 0x00, 'B', 0x00, '-', 0x00, '4', 0x00, '6', 0x00, '6', 0x00, '3', 0x00, '-', 0x00,
+    'A', 0x00, 'A', 0x00, '3', 0x00, '6', 0x00, '-', 0x00, '1', 0x00, 'A', 0x00, 'A', 0x00, 'E', 0x00, '4', 0x00,
+    '6', 0x00, '4', 0x00, '6', 0x00, '3', 0x00, '7', 0x00, '7', 0x00, '6', 0x00, '}', 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+TU_VERIFY_STATIC(sizeof(desc_ms_os_20) == MS_OS_20_DESC_LEN, "Incorrect size");
+
+/* Invoked when a control transfer occurred on an interface of this class
+ * Driver response accordingly to the request and the transfer stage (setup/data/ack)
+ * return false to stall control endpoint (e.g unsupported request)
+ */
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const * request)
+{
+    if (CONTROL_STAGE_SETUP != stage)
+    {
+        return true; /* nothing to do with DATA & ACK stage. */
+    }
+    if ( (TUSB_REQ_TYPE_VENDOR == request->bmRequestType_bit.type) && (VENDOR_REQUEST_MICROSOFT == request->bRequest) && (7 == request->wIndex) )
+    {
+        return tud_control_xfer(rhport, request, (void*)(uintptr_t)desc_ms_os_20, MS_OS_20_DESC_LEN);
+    }
+    if (TUSB_REQ_TYPE_VENDOR == request->bmRequestType_bit.type)
+    {
+        return serial_control_request(rhport, request);
+    }
+    return false;
+}
+
 /*
  * String Descriptors
  */
@@ -130,7 +226,9 @@ char const *string_desc_arr [] =
     "MindMotion",                   /* 1: Manufacturer                              */
     "CMSIS-DAP",                    /* 2: Product                                   */
     uid_str,                        /* 3: Serials, should use chip ID               */
-    "CDC"                           /* 4: CDC                                       */
+    "CDC",                          /* 4: CDC                                       */
+    "tiny-dap Stream",              /* 5: Vendor stream                             */
+    "CDC 2"                         /* 6: CDC on LPUART                             */
 };
 
 static uint16_t _desc_str[32];
@@ -0,0 +1,308 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* host stand-in for the cmsis core header, picked up ahead of the cmsis include path.
+ * the register layouts and base addresses are the cortex-m0 ones, the nvic / scb accesses
+ * trap into the simulator like any other peripheral. the intrinsics act on the simulated
+ * cpu state instead of emitting thumb instructions.
+ */
+
+#ifndef CORE_CM0_H
+#define CORE_CM0_H
+
+#include <stdint.h>
+
+/* compiler. */
+#define __ASM                   __asm__
+#define __INLINE                inline
+#define __STATIC_INLINE         static inline
+#define __STATIC_FORCEINLINE    __attribute__((always_inline)) static inline
+#define __NO_RETURN             __attribute__((__noreturn__))
+#define __USED                  __attribute__((used))
+#define __WEAK                  __attribute__((weak))
+#define __PACKED                __attribute__((packed, aligned(1)))
+#define __PACKED_STRUCT         struct __attribute__((packed, aligned(1)))
+#define __PACKED_UNION          union __attribute__((packed, aligned(1)))
+#define __ALIGNED(x)            __attribute__((aligned(x)))
+#define __RESTRICT              __restrict
+#define __COMPILER_BARRIER()    __ASM volatile("" ::: "memory")
+
+__PACKED_STRUCT T_UINT16_READ  { uint16_t v; };
+__PACKED_STRUCT T_UINT16_WRITE { uint16_t v; };
+__PACKED_STRUCT T_UINT32_READ  { uint32_t v; };
+__PACKED_STRUCT T_UINT32_WRITE { uint32_t v; };
+#define __UNALIGNED_UINT16_READ(addr)           (((const struct T_UINT16_READ *)(const void *)(addr))->v)
+#define __UNALIGNED_UINT16_WRITE(addr, val)     (void)((((struct T_UINT16_WRITE *)(void *)(addr))->v) = (val))
+#define __UNALIGNED_UINT32_READ(addr)           (((const struct T_UINT32_READ *)(const void *)(addr))->v)
+#define __UNALIGNED_UINT32_WRITE(addr, val)     (void)((((struct T_UINT32_WRITE *)(void *)(addr))->v) = (val))
+
+/* register access qualifiers. */
+#define __I                     volatile const
+#define __O                     volatile
+#define __IO                    volatile
+#define __IM                    volatile const
+#define __OM                    volatile
+#define __IOM                   volatile
+
+/* simulated cpu, see sim.h. */
+void     sim_set_primask(uint32_t primask);
+uint32_t sim_get_primask(void);
+uint32_t sim_get_ipsr(void);
+void     sim_advance(uint64_t cycles);
+void     sim_idle(void);
+__NO_RETURN void sim_fatal(const char *what);
+
+/* core peripherals. */
+typedef struct
+{
+    __IOM uint32_t ISER[1U];
+          uint32_t RESERVED0[31U];
+    __IOM uint32_t ICER[1U];
+          uint32_t RESERVED1[31U];
+    __IOM uint32_t ISPR[1U];
+          uint32_t RESERVED2[31U];
+    __IOM uint32_t ICPR[1U];
+          uint32_t RESERVED3[31U];
+          uint32_t RESERVED4[64U];
+    __IOM uint32_t IP[8U];
+} NVIC_Type;
+
+typedef struct
+{
+    __IM  uint32_t CPUID;
+    __IOM uint32_t ICSR;
+          uint32_t RESERVED0;
+    __IOM uint32_t AIRCR;
+    __IOM uint32_t SCR;
+    __IOM uint32_t CCR;
+          uint32_t RESERVED1;
+    __IOM uint32_t SHP[2U];
+    __IOM uint32_t SHCSR;
+} SCB_Type;
+
+typedef struct
+{
+    __IOM uint32_t CTRL;
+    __IOM uint32_t LOAD;
+    __IOM uint32_t VAL;
+    __IM  uint32_t CALIB;
+} SysTick_Type;
+
+#define SCS_BASE                (0xE000E000UL)
+#define SysTick_BASE            (SCS_BASE +  0x0010UL)
+#define NVIC_BASE               (SCS_BASE +  0x0100UL)
+#define SCB_BASE                (SCS_BASE +  0x0D00UL)
+
+#define SCB                     ((SCB_Type     *) SCB_BASE)
+#define SysTick                 ((SysTick_Type *) SysTick_BASE)
+#define NVIC                    ((NVIC_Type    *) NVIC_BASE)
+
+#define SCB_AIRCR_VECTKEY_Pos           16U
+#define SCB_AIRCR_VECTKEY_Msk           (0xFFFFUL << SCB_AIRCR_VECTKEY_Pos)
+#define SCB_AIRCR_SYSRESETREQ_Pos       2U
+#define SCB_AIRCR_SYSRESETREQ_Msk       (1UL << SCB_AIRCR_SYSRESETREQ_Pos)
+#define SCB_SCR_SLEEPDEEP_Pos           2U
+#define SCB_SCR_SLEEPDEEP_Msk           (1UL << SCB_SCR_SLEEPDEEP_Pos)
+#define SCB_SCR_SLEEPONEXIT_Pos         1U
+#define SCB_SCR_SLEEPONEXIT_Msk         (1UL << SCB_SCR_SLEEPONEXIT_Pos)
+#define SysTick_CTRL_COUNTFLAG_Msk      (1UL << 16U)
+#define SysTick_CTRL_CLKSOURCE_Msk      (1UL << 2U)
+#define SysTick_CTRL_TICKINT_Msk        (1UL << 1U)
+#define SysTick_CTRL_ENABLE_Msk         (1UL << 0U)
+#define SysTick_LOAD_RELOAD_Msk         (0xFFFFFFUL)
+
+/* nvic, device interrupts only. */
+#define _BIT_SHIFT(IRQn)        (  ((((uint32_t)(int32_t)(IRQn))         )      &  0x03UL) * 8UL)
+#define _IP_IDX(IRQn)           (   (((uint32_t)(int32_t)(IRQn))                >>    2UL)      )
+
+__STATIC_INLINE void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        NVIC->ISER[0U] = (uint32_t)(1UL << (((uint32_t)IRQn) & 0x1FUL));
+    }
+}
+
+__STATIC_INLINE uint32_t NVIC_GetEnableIRQ(IRQn_Type IRQn)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        return ((uint32_t)(((NVIC->ISER[0U] & (1UL << (((uint32_t)IRQn) & 0x1FUL))) != 0UL) ? 1UL : 0UL));
+    }
+    return 0U;
+}
+
+__STATIC_INLINE void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        NVIC->ICER[0U] = (uint32_t)(1UL << (((uint32_t)IRQn) & 0x1FUL));
+    }
+}
+
+__STATIC_INLINE uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        return ((uint32_t)(((NVIC->ISPR[0U] & (1UL << (((uint32_t)IRQn) & 0x1FUL))) != 0UL) ? 1UL : 0UL));
+    }
+    return 0U;
+}
+
+__STATIC_INLINE void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        NVIC->ISPR[0U] = (uint32_t)(1UL << (((uint32_t)IRQn) & 0x1FUL));
+    }
+}
+
+__STATIC_INLINE void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        NVIC->ICPR[0U] = (uint32_t)(1UL << (((uint32_t)IRQn) & 0x1FUL));
+    }
+}
+
+__STATIC_INLINE void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        NVIC->IP[_IP_IDX(IRQn)] = ((uint32_t)(NVIC->IP[_IP_IDX(IRQn)] & ~(0xFFUL << _BIT_SHIFT(IRQn))) |
+           (((priority << (8U - __NVIC_PRIO_BITS)) & (uint32_t)0xFFUL) << _BIT_SHIFT(IRQn)));
+    }
+}
+
+__STATIC_INLINE uint32_t NVIC_GetPriority(IRQn_Type IRQn)
+{
+    if ((int32_t)(IRQn) >= 0)
+    {
+        return ((uint32_t)(((NVIC->IP[_IP_IDX(IRQn)] >> _BIT_SHIFT(IRQn)) & (uint32_t)0xFFUL) >> (8U - __NVIC_PRIO_BITS)));
+    }
+    return 0U;
+}
+
+__NO_RETURN __STATIC_INLINE void NVIC_SystemReset(void)
+{
+    SCB->AIRCR = (uint32_t)((0x5FAUL << SCB_AIRCR_VECTKEY_Pos) | SCB_AIRCR_SYSRESETREQ_Msk);
+    sim_fatal("system reset did not take effect");
+}
+
+/* intrinsics. */
+__STATIC_FORCEINLINE void __enable_irq(void)
+{
+    sim_set_primask(0u);
+}
+
+__STATIC_FORCEINLINE void __disable_irq(void)
+{
+    sim_set_primask(1u);
+}
+
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK(void)
+{
+    return sim_get_primask();
+}
+
+__STATIC_FORCEINLINE void __set_PRIMASK(uint32_t priMask)
+{
+    sim_set_primask(priMask);
+}
+
+__STATIC_FORCEINLINE uint32_t __get_IPSR(void)
+{
+    return sim_get_ipsr();
+}
+
+__STATIC_FORCEINLINE void __NOP(void)
+{
+    sim_advance(1u);
+}
+
+__STATIC_FORCEINLINE void __WFI(void)
+{
+    sim_idle();
+}
+
+__STATIC_FORCEINLINE void __WFE(void)
+{
+    sim_idle();
+}
+
+__STATIC_FORCEINLINE void __SEV(void)
+{
+}
+
+__STATIC_FORCEINLINE void __ISB(void)
+{
+    __COMPILER_BARRIER();
+}
+
+__STATIC_FORCEINLINE void __DSB(void)
+{
+    __COMPILER_BARRIER();
+}
+
+__STATIC_FORCEINLINE void __DMB(void)
+{
+    __COMPILER_BARRIER();
+}
+
+__STATIC_FORCEINLINE uint32_t __REV(uint32_t value)
+{
+    return __builtin_bswap32(value);
+}
+
+__STATIC_FORCEINLINE uint32_t __REV16(uint32_t value)
+{
+    return ((value & 0xFF00FF00u) >> 8) | ((value & 0x00FF00FFu) << 8);
+}
+
+__STATIC_FORCEINLINE int16_t __REVSH(int16_t value)
+{
+    return (int16_t)__builtin_bswap16((uint16_t)value);
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT(uint32_t value)
+{
+    uint32_t result = 0u;
+
+    for (uint32_t i = 0u; i < 32u; i++)
+    {
+        result = (result << 1) | (value & 1u);
+        value >>= 1;
+    }
+    return result;
+}
+
+__STATIC_FORCEINLINE uint8_t __CLZ(uint32_t value)
+{
+    return (0u == value) ? 32u : (uint8_t)__builtin_clz(value);
+}
+
+#define __BKPT(value)           sim_fatal("bkpt " #value)
+
+#endif /* CORE_CM0_H */
@@ -0,0 +1,409 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+
+#include "hal_device_registers.h"
+#include "sim.h"
+#include "sim_model.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "the simulator single-steps through EFLAGS.TF, only x86-64 linux is supported."
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE     0x100000
+#endif
+
+#define SIM_PAGE_SIZE           4096u
+#define SIM_EFLAGS_TF           0x100     /* trap flag, one instruction then SIGTRAP. */
+#define SIM_PF_WRITE            0x2       /* page fault error code: the access was a store. */
+#define SIM_IDLE_CYCLES         (SIM_CPU_FREQ / 1000u) /* wfi with nothing scheduled. */
+#define SIM_IRQ_COUNT           32u
+
+/* every region is backed twice: at its real address for the firmware, protected while
+ * trapped, and at an always accessible alias for the models.
+ */
+typedef struct
+{
+    uint32_t base;
+    uint32_t size;
+    bool     trapped;
+    uint8_t *view;
+} sim_region_t;
+
+static sim_region_t sim_regions[] =
+{
+    { 0x1FFFF000u, 0x1000u,  false }, /* system memory, device id. */
+    { APB1_0_BASE, 0x30000u, true  }, /* apb1, apb2 and ahb1 peripherals. */
+    { AHB1_3_BASE, 0x1000u,  true  }, /* gpio ports. */
+    { AHB2_0_BASE, 0x1000u,  true  }, /* usb. */
+    { SCS_BASE,    0x1000u,  true  }, /* nvic, scb, systick. */
+};
+
+/* the access being single-stepped. */
+static struct
+{
+    uintptr_t          page;            /* 0 when idle. */
+    uint32_t           addr;
+    uint32_t           old;
+    bool               write;
+    const sim_block_t *block;
+} sim_trap;
+
+extern void (* const sim_vectors[SIM_IRQ_COUNT])(void); /* startup_host.c */
+
+uint64_t sim_now = 0u;
+static bool     sim_busy = false;       /* events or an isr are running. */
+static uint32_t sim_primask = 0u;
+static int32_t  sim_active_irq = -1;
+static uint32_t sim_nvic_enabled = 0u;
+static uint32_t sim_nvic_pending = 0u;  /* software pended, level requests come from the models. */
+static void   (*sim_reset_fn)(void) = NULL;
+
+static void sim_scs_read(uint32_t addr);
+static void sim_scs_write(uint32_t addr, uint32_t old);
+
+static const sim_block_t sim_scs_block = { SCS_BASE, 0x1000u, sim_scs_read, sim_scs_write };
+
+void sim_fatal(const char *what)
+{
+    fprintf(stderr, "sim: %s\n", what);
+    abort();
+}
+
+static sim_region_t *sim_region_find(uintptr_t addr)
+{
+    for (uint32_t i = 0u; i < (sizeof(sim_regions) / sizeof(sim_regions[0])); i++)
+    {
+        if ((addr >= sim_regions[i].base) && ((addr - sim_regions[i].base) < sim_regions[i].size))
+        {
+            return &sim_regions[i];
+        }
+    }
+    return NULL;
+}
+
+static const sim_block_t *sim_block_find(uint32_t addr)
+{
+    if ((addr - sim_scs_block.base) < sim_scs_block.size)
+    {
+        return &sim_scs_block;
+    }
+    for (uint32_t i = 0u; i < sim_block_count; i++)
+    {
+        if ((addr - sim_blocks[i].base) < sim_blocks[i].size)
+        {
+            return &sim_blocks[i];
+        }
+    }
+    return NULL;
+}
+
+void *sim_view_find(uint32_t addr)
+{
+    sim_region_t *region = sim_region_find(addr);
+
+    return (NULL != region) ? (region->view + (addr - region->base)) : NULL;
+}
+
+void *sim_view(uint32_t addr)
+{
+    void *view = sim_view_find(addr);
+
+    if (NULL == view)
+    {
+        sim_fatal("no simulated memory at the requested address");
+    }
+    return view;
+}
+
+/* interrupts. */
+
+static uint32_t sim_irq_priority(uint32_t irq)
+{
+    return (SIM_REG(NVIC_BASE + 0x300u + (irq & ~3u)) >> ((irq & 3u) * 8u)) & 0xFFu;
+}
+
+static uint32_t sim_irq_ready(void)
+{
+    return (sim_nvic_pending | sim_model_irq_lines()) & sim_nvic_enabled;
+}
+
+/* take pending interrupts by priority until none is left, each runs to completion. */
+static void sim_irq_dispatch(void)
+{
+    uint32_t ready;
+
+    while ( (0u == sim_primask) && (0u != (ready = sim_irq_ready())) )
+    {
+        uint32_t irq = 0u;
+        uint32_t best = 0x100u;
+
+        for (uint32_t i = 0u; i < SIM_IRQ_COUNT; i++)
+        {
+            if ( (0u != (ready & (1u << i))) && (sim_irq_priority(i) < best) )
+            {
+                best = sim_irq_priority(i);
+                irq = i;
+            }
+        }
+        sim_nvic_pending &= ~(1u << irq);
+        sim_active_irq = (int32_t)irq;
+        sim_vectors[irq]();
+        sim_active_irq = -1;
+    }
+}
+
+/* handle due events and interrupts. isrs run from here, their own accesses only move time on. */
+static void sim_run(void)
+{
+    if (sim_busy)
+    {
+        return;
+    }
+    sim_busy = true;
+    while (1)
+    {
+        sim_irq_dispatch();
+        uint64_t t = sim_model_next_event();
+        if (t > sim_now)
+        {
+            break;
+        }
+        sim_model_run(t);
+    }
+    sim_busy = false;
+}
+
+uint64_t sim_cycles(void)
+{
+    return sim_now;
+}
+
+void sim_advance(uint64_t cycles)
+{
+    sim_now += cycles;
+    sim_run();
+}
+
+void sim_idle(void)
+{
+    if (0u == sim_irq_ready())
+    {
+        uint64_t t = sim_model_next_event();
+        sim_now = ((SIM_NEVER == t) || (t <= sim_now)) ? (sim_now + SIM_IDLE_CYCLES) : t;
+    }
+    sim_run();
+}
+
+void sim_set_primask(uint32_t primask)
+{
+    sim_primask = primask & 1u;
+    if (0u == sim_primask)
+    {
+        sim_run();
+    }
+}
+
+uint32_t sim_get_primask(void)
+{
+    return sim_primask;
+}
+
+uint32_t sim_get_ipsr(void)
+{
+    return (sim_active_irq < 0) ? 0u : (uint32_t)(sim_active_irq + 16);
+}
+
+void sim_reset_hook(void (*hook)(void))
+{
+    sim_reset_fn = hook;
+}
+
+/* nvic and scb. */
+
+static void sim_scs_read(uint32_t addr)
+{
+    switch (addr - SCS_BASE)
+    {
+        case 0x100u: /* ISER */
+        case 0x180u: /* ICER */
+            SIM_REG(addr) = sim_nvic_enabled;
+            break;
+        case 0x200u: /* ISPR */
+        case 0x280u: /* ICPR */
+            SIM_REG(addr) = sim_nvic_pending | sim_model_irq_lines();
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_scs_write(uint32_t addr, uint32_t old)
+{
+    uint32_t val = SIM_REG(addr);
+
+    switch (addr - SCS_BASE)
+    {
+        case 0x100u:
+            sim_nvic_enabled |= val;
+            break;
+        case 0x180u:
+            sim_nvic_enabled &= ~val;
+            break;
+        case 0x200u:
+            sim_nvic_pending |= val;
+            break;
+        case 0x280u:
+            sim_nvic_pending &= ~val;
+            break;
+        case 0xD0Cu: /* AIRCR */
+            if ( (0x05FAu == (val >> SCB_AIRCR_VECTKEY_Pos)) && (0u != (val & SCB_AIRCR_SYSRESETREQ_Msk)) )
+            {
+                if (NULL == sim_reset_fn)
+                {
+                    exit(0);
+                }
+                sim_reset_fn();
+            }
+            val = old;
+            break;
+        default:
+            return;
+    }
+    SIM_REG(addr) = val;
+}
+
+/* traps. a load or store to a protected page lands here, the page is opened for exactly
+ * one instruction and closed again from the trace trap that follows it.
+ */
+static void sim_on_fault(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+    uintptr_t addr = (uintptr_t)info->si_addr;
+    sim_region_t *region = sim_region_find(addr);
+
+    (void) sig;
+    if ( (NULL == region) || !region->trapped || (0u != sim_trap.page) )
+    {
+        signal(SIGSEGV, SIG_DFL); /* a genuine crash, let it fault again unhandled. */
+        return;
+    }
+    sim_trap.page  = addr & ~(uintptr_t)(SIM_PAGE_SIZE - 1u);
+    sim_trap.addr  = (uint32_t)addr & ~3u;
+    sim_trap.write = (0 != (uc->uc_mcontext.gregs[REG_ERR] & SIM_PF_WRITE));
+    sim_trap.block = sim_block_find(sim_trap.addr);
+    sim_trap.old   = SIM_REG(sim_trap.addr);
+    if ( !sim_trap.write && (NULL != sim_trap.block) && (NULL != sim_trap.block->read) )
+    {
+        sim_trap.block->read(sim_trap.addr);
+    }
+    mprotect((void *)sim_trap.page, SIM_PAGE_SIZE, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= SIM_EFLAGS_TF;
+}
+
+static void sim_on_step(int sig, siginfo_t *info, void *context)
+{
+    ucontext_t *uc = (ucontext_t *)context;
+
+    (void) sig;
+    (void) info;
+    if (0u == sim_trap.page)
+    {
+        sim_fatal("unexpected trace trap");
+    }
+    uc->uc_mcontext.gregs[REG_EFL] &= ~SIM_EFLAGS_TF;
+    mprotect((void *)sim_trap.page, SIM_PAGE_SIZE, PROT_NONE);
+    sim_trap.page = 0u;
+    if ( sim_trap.write && (NULL != sim_trap.block) && (NULL != sim_trap.block->write) )
+    {
+        sim_trap.block->write(sim_trap.addr, sim_trap.old);
+    }
+    sim_advance(SIM_ACCESS_CYCLES); /* isrs nest in here, hence SA_NODEFER. */
+}
+
+static void sim_map(sim_region_t *region)
+{
+    int fd = memfd_create("sim", 0);
+
+    if ( (fd < 0) || (0 != ftruncate(fd, region->size)) )
+    {
+        sim_fatal("cannot create register memory");
+    }
+    void *fw = mmap((void *)(uintptr_t)region->base, region->size, region->trapped ? PROT_NONE : (PROT_READ | PROT_WRITE),
+                    MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+    region->view = mmap(NULL, region->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if ( ((uintptr_t)fw != region->base) || (MAP_FAILED == region->view) )
+    {
+        sim_fatal("cannot map register memory at its device address");
+    }
+}
+
+void sim_init(void)
+{
+    static bool done = false;
+    struct sigaction sa;
+
+    if (done)
+    {
+        return;
+    }
+    done = true;
+    if ((uintptr_t)&sim_regions > 0xFFFFFFFFu)
+    {
+        sim_fatal("static data above 4GB, dma addresses do not fit, link without pie");
+    }
+    for (uint32_t i = 0u; i < (sizeof(sim_regions) / sizeof(sim_regions[0])); i++)
+    {
+        sim_map(&sim_regions[i]);
+    }
+
+    /* fixed unique id, the usb serial number is derived from it. */
+    SIM_REG(0x1FFFF7E8u) = 0x4D4D3332u;
+    SIM_REG(0x1FFFF7ECu) = 0x46303136u;
+    SIM_REG(0x1FFFF7F0u) = 0x33440001u;
+    SIM_REG(SCB_BASE) = 0x410CC200u; /* CPUID, cortex-m0 r0p0. */
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_sigaction = sim_on_fault;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = sim_on_step;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    sim_model_reset();
+}
+
+/* sim.c - end */
@@ -0,0 +1,182 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* simulated MM32F0163D for the host build.
+ * the peripheral blocks sit at their real addresses but are mapped without access rights,
+ * every register access from firmware code traps, is single-stepped against the register
+ * model and moves virtual time on by SIM_ACCESS_CYCLES. time also moves with __NOP(),
+ * __WFI() and sim_advance(), never with the wall clock, so a run is fully deterministic.
+ * interrupts are taken between accesses, one at a time (no preemption).
+ * x86-64 linux only, single-stepping uses EFLAGS.TF.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_CPU_FREQ            96000000u
+#define SIM_ACCESS_CYCLES       4u      /* virtual cycles per trapped register access. */
+#define SIM_GPIO_PORT_COUNT     4u      /* GPIOA..GPIOD. */
+#define SIM_UART_COUNT          2u      /* same numbering as uart_port.c: 0 UART2, 1 LPUART. */
+
+/* runs before main() through startup_host.c, SystemInit() is done by then. */
+void     sim_init(void);
+
+/* time and cpu. */
+uint64_t sim_cycles(void);
+void     sim_advance(uint64_t cycles);  /* let time pass, due events and interrupts run. */
+void     sim_idle(void);                /* sleep until the next event or interrupt. */
+void     sim_set_primask(uint32_t primask);
+uint32_t sim_get_primask(void);
+uint32_t sim_get_ipsr(void);
+void     sim_fatal(const char *what) __attribute__((__noreturn__));
+void     sim_reset_hook(void (*hook)(void)); /* called for a system reset request, default exits. */
+
+/* gpio pins, port 0 is GPIOA. the hook runs after every change of a port's outputs or pin modes. */
+typedef void (*sim_gpio_hook_t)(uint8_t port);
+void     sim_gpio_set_input(uint8_t port, uint16_t pins, bool high);
+void     sim_gpio_release_input(uint8_t port, uint16_t pins);
+uint16_t sim_gpio_get_output(uint8_t port);
+uint16_t sim_gpio_get_output_enable(uint8_t port);
+void     sim_gpio_hook(sim_gpio_hook_t hook);
+
+/* uart wires. injected bytes are sent back to back in the line coding the port is set to,
+ * at the sender rate when one is set (0 follows the port). frames more than 3% off the
+ * port rate arrive with a framing error. sent bytes are kept for sim_uart_collect().
+ */
+uint32_t sim_uart_inject(uint8_t idx, const uint8_t *data, uint32_t len);
+uint32_t sim_uart_collect(uint8_t idx, uint8_t *data, uint32_t len);
+void     sim_uart_sender_baud(uint8_t idx, uint32_t baud);
+uint32_t sim_uart_baud(uint8_t idx);    /* rate the port is set to, 0 when disabled. */
+
+/* swd target on the probe pins (PA1 SWCLK, PA0 SWDIO), bit level: an SW-DP and one MEM-AP
+ * (APSEL 0) in front of a flash, a ram and a plain memory scs window. data is sampled on the
+ * rising SWCLK edge and driven right after it, the target pulls SWDIO up when released.
+ * WAIT, FAULT and read parity errors are injected on every nth access, counted separately.
+ */
+typedef struct
+{
+    uint32_t idcode;                    /* DPIDR. */
+    uint32_t ap_idr;                    /* MEM-AP IDR. */
+    uint32_t flash_base;
+    uint32_t flash_size;                /* read only through the ap, writes are bus errors. */
+    uint32_t ram_base;
+    uint32_t ram_size;
+    uint32_t wait_every;                /* stall every nth AP / RDBUFF access, 0 never. */
+    uint32_t wait_count;                /* WAIT acks before a stalled access goes through. */
+    uint32_t fault_every;               /* bus error on every nth AP access, answered FAULT. */
+    uint32_t parity_every;              /* bad parity on every nth read data phase. */
+} sim_swd_config_t;
+
+typedef struct
+{
+    uint64_t clocks;                    /* SWCLK rising edges. */
+    uint64_t packet_clocks;             /* of those, inside a packet. */
+    uint64_t first_cycle;               /* cpu cycles at the first and the last edge. */
+    uint64_t last_cycle;
+    uint32_t line_resets;
+    uint32_t ok;                        /* packets by acknowledge. */
+    uint32_t wait;
+    uint32_t fault;
+    uint32_t no_ack;                    /* protocol errors, the target did not answer. */
+    uint32_t dp_reads;                  /* OK packets by kind. */
+    uint32_t dp_writes;
+    uint32_t ap_reads;
+    uint32_t ap_writes;
+    uint32_t bus_errors;
+    uint32_t wdata_errors;              /* write data with bad parity from the probe. */
+    uint32_t parity_injected;
+} sim_swd_stats_t;
+
+/* every rising SWCLK edge with the part of the protocol its bit belongs to, for timing tools. */
+#define SIM_SWD_BIT_RESET       0u      /* line reset or waiting for one. */
+#define SIM_SWD_BIT_IDLE        1u
+#define SIM_SWD_BIT_REQUEST     2u      /* start bit included. */
+#define SIM_SWD_BIT_TURNAROUND  3u
+#define SIM_SWD_BIT_ACK         4u
+#define SIM_SWD_BIT_DATA        5u      /* data and parity. */
+
+typedef void (*sim_swd_edge_hook_t)(uint64_t cycle, uint8_t bit);
+
+void     sim_swd_attach(const sim_swd_config_t *config); /* NULL for the default target. */
+void     sim_swd_detach(void);
+uint8_t *sim_swd_memory(uint32_t addr, uint32_t len); /* target memory, NULL when unmapped. */
+void     sim_swd_stats(sim_swd_stats_t *stats, bool clear);
+void     sim_swd_edge_hook(sim_swd_edge_hook_t hook);
+
+/* usb host on the device controller, full speed. each 1ms frame is filled with transactions
+ * at their bus cost: interrupt pipes when their interval is due, then control and bulk round
+ * robin. pipe 0 is set up on connect, the others with sim_usb_pipe() (type as in
+ * bmAttributes). one transfer per pipe at a time, completions are reported from the event
+ * loop. toggle errors count DATA0/1 mismatches against the bd, IN packets that hit one are
+ * dropped by the host as retransmissions.
+ */
+#define SIM_USB_OK              0
+#define SIM_USB_STALL           (-1)
+#define SIM_USB_ERROR           (-2)    /* no answer, babble or disconnect. */
+
+typedef void (*sim_usb_done_t)(void *ctx, int32_t result, uint32_t len);
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t busy_frames;               /* frames that moved at least one data packet. */
+    uint32_t packets;                   /* acked data packets, both directions. */
+    uint32_t max_frame_packets;
+    uint32_t naks;
+    uint32_t stalls;
+    uint32_t toggle_errors;
+    uint32_t timeouts;
+    uint32_t overflows;                 /* packets larger than the buffer on the other side. */
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+} sim_usb_stats_t;
+
+void     sim_usb_connect(bool connect); /* plug in: bus reset once the device enables, then frames. */
+void     sim_usb_pipe(uint8_t ep_addr, uint8_t type, uint16_t max_packet, uint8_t interval);
+bool     sim_usb_control(const uint8_t setup[8], uint8_t *data, sim_usb_done_t done, void *ctx);
+bool     sim_usb_transfer(uint8_t ep_addr, uint8_t *data, uint32_t len, sim_usb_done_t done, void *ctx);
+void     sim_usb_stats(sim_usb_stats_t *stats, bool clear);
+
+/* cmsis-dap over tcp, see sim_dap.c. listens on 127.0.0.1, plugs the usb host in and
+ * enumerates the probe, then serves one debugger connection at a time. a session summary
+ * goes to stderr when the debugger disconnects. times are virtual cpu cycles from the
+ * request reaching the usb host to its response coming back.
+ */
+typedef struct
+{
+    uint32_t sessions;
+    uint32_t commands;
+    uint32_t truncated;                 /* requests longer than the hid report. */
+    uint64_t busy_cycles;
+    uint64_t max_cycles;
+} sim_dap_stats_t;
+
+bool     sim_dap_listen(uint16_t port);
+void     sim_dap_stats(sim_dap_stats_t *stats, bool clear); /* finished sessions. */
+
+#endif /* SIM_H */
@@ -0,0 +1,621 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* cmsis-dap over tcp for the host build: a debugger on the other end of a socket drives the
+ * simulated probe through the simulated usb host, so every command takes the same way as on
+ * hardware: hid OUT report, DAP_ExecuteCommand dispatch in the firmware, hid IN report, all
+ * within the usb frame schedule. the framing is the one of the openocd cmsis-dap tcp backend
+ * (cmsis-dap backend tcp, default port 4441): an 8 byte header of signature "DAP", payload
+ * length, packet type and a reserved byte, all little endian, then the dap packet.
+ * the link enumerates the probe itself and sizes its queue from DAP_Info packet size and
+ * count, so the debugger sees the firmware configuration. virtual time stands still while
+ * the link waits for the debugger, a session's time is the probe's share only.
+ * on top of openocd's packet types the link answers a status request (type 3), for
+ * benchmark tools that want virtual time instead of wall time, see sim_dap_status().
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "sim.h"
+#include "sim_model.h"
+
+#define SIM_DAP_SIGNATURE       0x00504144u /* "DAP". */
+#define SIM_DAP_TYPE_REQUEST    0x01u
+#define SIM_DAP_TYPE_RESPONSE   0x02u
+#define SIM_DAP_TYPE_STATUS     0x03u   /* simulator only, see sim_dap_status(). */
+#define SIM_DAP_HDR_SIZE        8u
+#define SIM_DAP_REPORT_MAX      1024u
+#define SIM_DAP_QUEUE_MAX       8u
+#define SIM_DAP_DEV_ADDR        1u
+#define SIM_DAP_CONFIG_MAX      512u
+
+#define SIM_DAP_ID_INFO         0x00u
+#define SIM_DAP_INFO_PACKET_COUNT   0xFFu
+#define SIM_DAP_INFO_PACKET_SIZE    0xFEu
+
+/* probe bring-up, one control transfer or dap command per step. */
+typedef enum
+{
+    SIM_DAP_OFF,
+    SIM_DAP_GET_DEVICE,
+    SIM_DAP_SET_ADDRESS,
+    SIM_DAP_GET_CONFIG_HEAD,
+    SIM_DAP_GET_CONFIG,
+    SIM_DAP_SET_CONFIG,
+    SIM_DAP_INFO_SIZE,
+    SIM_DAP_INFO_COUNT,
+    SIM_DAP_READY,
+    SIM_DAP_FAILED,
+} sim_dap_state_t;
+
+static struct
+{
+    sim_dap_state_t state;
+    int            listen_fd;
+    int            fd;                  /* debugger connection, -1 when none. */
+
+    uint8_t        ep_out;              /* hid interface of the probe. */
+    uint8_t        ep_in;
+    uint16_t       report;
+    uint16_t       packet_size;         /* from DAP_Info. */
+    uint8_t        window;              /* commands in flight, DAP_Info packet count. */
+    uint8_t        config[SIM_DAP_CONFIG_MAX];
+
+    /* commands in order: [head, sent) are out, waiting for their response, [sent, tail) queued. */
+    uint8_t        queue[SIM_DAP_QUEUE_MAX][SIM_DAP_REPORT_MAX];
+    uint64_t       start[SIM_DAP_QUEUE_MAX];
+    uint32_t       head;
+    uint32_t       sent;
+    uint32_t       tail;
+    bool           out_busy;
+    bool           in_busy;
+    uint8_t        response[SIM_DAP_REPORT_MAX];
+
+    uint8_t        rx[SIM_DAP_HDR_SIZE + SIM_DAP_REPORT_MAX];
+    uint32_t       rx_len;
+
+    uint64_t       session_start;
+    uint64_t       last_cycles;         /* of the last command answered. */
+    sim_dap_stats_t stats;
+    sim_dap_stats_t session;
+} sim_dap = { .state = SIM_DAP_OFF, .listen_fd = -1, .fd = -1 };
+
+static void sim_dap_fail(const char *what)
+{
+    fprintf(stderr, "sim: dap link: %s\n", what);
+    sim_dap.state = SIM_DAP_FAILED;
+}
+
+static uint16_t sim_dap_get16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8u));
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* command queue on the hid endpoints. */
+
+static void sim_dap_pump(void);
+static void sim_dap_answer(const uint8_t *data, uint32_t len);
+static void sim_dap_receive(bool block);
+
+static void sim_dap_out_done(void *ctx, int32_t result, uint32_t len)
+{
+    (void) ctx;
+    (void) len;
+    sim_dap.out_busy = false;
+    if (SIM_USB_OK != result)
+    {
+        sim_dap_fail("hid OUT report failed");
+        return;
+    }
+    sim_dap.sent++;
+    sim_dap_receive(false);
+    sim_dap_pump();
+}
+
+
+static void sim_dap_in_done(void *ctx, int32_t result, uint32_t len)
+{
+    uint32_t slot = sim_dap.head % SIM_DAP_QUEUE_MAX;
+    uint64_t cycles = sim_now - sim_dap.start[slot];
+
+    (void) ctx;
+    sim_dap.in_busy = false;
+    if (SIM_USB_OK != result)
+    {
+        sim_dap_fail("hid IN report failed");
+        return;
+    }
+    sim_dap.head++;
+    sim_dap.last_cycles = cycles;
+    if (SIM_DAP_READY == sim_dap.state)
+    {
+        sim_dap.session.commands++;
+        sim_dap.session.busy_cycles += cycles;
+        if (cycles > sim_dap.session.max_cycles)
+        {
+            sim_dap.session.max_cycles = cycles;
+        }
+    }
+    sim_dap_answer(sim_dap.response, len);
+    sim_dap_receive(false);
+    sim_dap_pump();
+}
+
+/* hand queued reports to the usb host as its pipes free up. */
+static void sim_dap_pump(void)
+{
+    if (SIM_DAP_FAILED == sim_dap.state)
+    {
+        return;
+    }
+    if ( !sim_dap.out_busy && (sim_dap.sent != sim_dap.tail) )
+    {
+        uint32_t slot = sim_dap.sent % SIM_DAP_QUEUE_MAX;
+        sim_dap.out_busy = sim_usb_transfer(sim_dap.ep_out, sim_dap.queue[slot], sim_dap.report, sim_dap_out_done, NULL);
+    }
+    if ( !sim_dap.in_busy && (sim_dap.head != sim_dap.sent) )
+    {
+        sim_dap.in_busy = sim_usb_transfer(sim_dap.ep_in, sim_dap.response, sim_dap.report, sim_dap_in_done, NULL);
+    }
+}
+
+static void sim_dap_queue(const uint8_t *data, uint32_t len)
+{
+    uint32_t slot = sim_dap.tail % SIM_DAP_QUEUE_MAX;
+
+    if (len > sim_dap.report)
+    {
+        len = sim_dap.report;
+        sim_dap.session.truncated++;
+    }
+    memset(sim_dap.queue[slot], 0, sim_dap.report);
+    memcpy(sim_dap.queue[slot], data, len);
+    sim_dap.start[slot] = sim_now;
+    sim_dap.tail++;
+    sim_dap_pump();
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* bring-up. */
+
+static void sim_dap_step(void);
+
+static void sim_dap_setup_done(void *ctx, int32_t result, uint32_t len)
+{
+    (void) ctx;
+    (void) len;
+    if (SIM_USB_OK != result)
+    {
+        sim_dap_fail("enumeration failed");
+        return;
+    }
+    sim_dap.state++;
+    sim_dap_step();
+}
+
+static void sim_dap_control(uint8_t type, uint8_t request, uint16_t value, uint16_t length)
+{
+    const uint8_t setup[8] =
+    {
+        type, request, (uint8_t)value, (uint8_t)(value >> 8u), 0u, 0u, (uint8_t)length, (uint8_t)(length >> 8u)
+    };
+
+    if (!sim_usb_control(setup, sim_dap.config, sim_dap_setup_done, NULL))
+    {
+        sim_dap_fail("control pipe busy");
+    }
+}
+
+/* the hid interface (class 3) and its interrupt endpoints from the configuration descriptor. */
+static bool sim_dap_find_hid(uint32_t total)
+{
+    bool hid = false;
+
+    for (uint32_t i = 0u; (i + 2u) <= total; i += sim_dap.config[i])
+    {
+        const uint8_t *d = &sim_dap.config[i];
+        if ( (d[0] < 2u) || ((i + d[0]) > total) )
+        {
+            break;
+        }
+        if ( (4u == d[1]) && (d[0] >= 9u) ) /* interface. */
+        {
+            if (hid)
+            {
+                break;
+            }
+            hid = (3u == d[5]);
+        }
+        else if ( hid && (5u == d[1]) && (d[0] >= 7u) && (3u == (d[3] & 3u)) ) /* interrupt endpoint. */
+        {
+            uint16_t size = sim_dap_get16(&d[4]) & 0x7FFu;
+            sim_usb_pipe(d[2], 3u, size, d[6]);
+            if (0u != (d[2] & 0x80u))
+            {
+                sim_dap.ep_in = d[2];
+            }
+            else
+            {
+                sim_dap.ep_out = d[2];
+                sim_dap.report = size;
+            }
+        }
+    }
+    return (0u != sim_dap.ep_in) && (0u != sim_dap.ep_out) && (0u != sim_dap.report) && (sim_dap.report <= SIM_DAP_REPORT_MAX);
+}
+
+static void sim_dap_step(void)
+{
+    switch (sim_dap.state)
+    {
+        case SIM_DAP_GET_DEVICE:
+            sim_dap_control(0x80u, 6u, 0x0100u, 18u);
+            break;
+        case SIM_DAP_SET_ADDRESS:
+            sim_usb_pipe(0x00u, 0u, sim_dap.config[7], 0u); /* bMaxPacketSize0. */
+            sim_dap_control(0x00u, 5u, SIM_DAP_DEV_ADDR, 0u);
+            break;
+        case SIM_DAP_GET_CONFIG_HEAD:
+            sim_dap_control(0x80u, 6u, 0x0200u, 9u);
+            break;
+        case SIM_DAP_GET_CONFIG:
+        {
+            uint16_t total = sim_dap_get16(&sim_dap.config[2]);
+            if (total > SIM_DAP_CONFIG_MAX)
+            {
+                sim_dap_fail("configuration descriptor too large");
+                break;
+            }
+            sim_dap_control(0x80u, 6u, 0x0200u, total);
+            break;
+        }
+        case SIM_DAP_SET_CONFIG:
+            if (!sim_dap_find_hid(sim_dap_get16(&sim_dap.config[2])))
+            {
+                sim_dap_fail("no hid interface with interrupt IN and OUT endpoints");
+                break;
+            }
+            sim_dap_control(0x00u, 9u, sim_dap.config[5], 0u); /* bConfigurationValue. */
+            break;
+        case SIM_DAP_INFO_SIZE:
+        case SIM_DAP_INFO_COUNT:
+        {
+            const uint8_t info[2] =
+            {
+                SIM_DAP_ID_INFO, (SIM_DAP_INFO_SIZE == sim_dap.state) ? SIM_DAP_INFO_PACKET_SIZE : SIM_DAP_INFO_PACKET_COUNT
+            };
+            sim_dap.window = 1u;
+            sim_dap_queue(info, sizeof(info));
+            break;
+        }
+        case SIM_DAP_READY:
+            sim_dap.window = (sim_dap.window > SIM_DAP_QUEUE_MAX) ? SIM_DAP_QUEUE_MAX : sim_dap.window;
+            fprintf(stderr, "sim: dap link: hid OUT 0x%02X IN 0x%02X, report %u, packet size %u, count %u\n",
+                    sim_dap.ep_out, sim_dap.ep_in, sim_dap.report, sim_dap.packet_size, sim_dap.window);
+            break;
+        default:
+            break;
+    }
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* debugger side. */
+
+static void sim_dap_session_end(void)
+{
+    double ms = (double)(sim_now - sim_dap.session_start) * 1000.0 / SIM_CPU_FREQ;
+
+    fprintf(stderr, "sim: dap session: %u commands in %.3f ms, %.3f ms in commands, longest %.3f ms, %u truncated\n",
+            sim_dap.session.commands, ms,
+            (double)sim_dap.session.busy_cycles * 1000.0 / SIM_CPU_FREQ,
+            (double)sim_dap.session.max_cycles * 1000.0 / SIM_CPU_FREQ,
+            sim_dap.session.truncated);
+    sim_dap.stats.sessions++;
+    sim_dap.stats.commands += sim_dap.session.commands;
+    sim_dap.stats.busy_cycles += sim_dap.session.busy_cycles;
+    sim_dap.stats.truncated += sim_dap.session.truncated;
+    if (sim_dap.session.max_cycles > sim_dap.stats.max_cycles)
+    {
+        sim_dap.stats.max_cycles = sim_dap.session.max_cycles;
+    }
+    close(sim_dap.fd);
+    sim_dap.fd = -1;
+    sim_dap.rx_len = 0u;
+}
+
+static void sim_dap_send(uint8_t type, const uint8_t *data, uint32_t len)
+{
+    uint8_t packet[SIM_DAP_HDR_SIZE + SIM_DAP_REPORT_MAX];
+    uint32_t done = 0u;
+
+    if (sim_dap.fd < 0)
+    {
+        return;
+    }
+    packet[0] = (uint8_t)SIM_DAP_SIGNATURE;
+    packet[1] = (uint8_t)(SIM_DAP_SIGNATURE >> 8u);
+    packet[2] = (uint8_t)(SIM_DAP_SIGNATURE >> 16u);
+    packet[3] = (uint8_t)(SIM_DAP_SIGNATURE >> 24u);
+    packet[4] = (uint8_t)len;
+    packet[5] = (uint8_t)(len >> 8u);
+    packet[6] = type;
+    packet[7] = 0u;
+    memcpy(&packet[SIM_DAP_HDR_SIZE], data, len);
+    len += SIM_DAP_HDR_SIZE;
+    while (done < len)
+    {
+        ssize_t n = send(sim_dap.fd, &packet[done], len - done, MSG_NOSIGNAL);
+        if (n <= 0)
+        {
+            if ( (n < 0) && (EINTR == errno) )
+            {
+                continue;
+            }
+            sim_dap_session_end();
+            return;
+        }
+        done += (uint32_t)n;
+    }
+}
+
+static uint8_t *sim_dap_put(uint8_t *p, uint64_t val, uint32_t size)
+{
+    for (uint32_t i = 0u; i < size; i++)
+    {
+        *p++ = (uint8_t)(val >> (i * 8u));
+    }
+    return p;
+}
+
+/* answer to a status request, little endian: virtual cycles now (8), cpu frequency (4),
+ * cycles of the last command (8), swd clocks (8) and clocks inside packets (8), swd OK,
+ * WAIT, FAULT and no-ack packets (4 each), usb frames and naks (4 each). 60 bytes.
+ */
+static void sim_dap_status(void)
+{
+    uint8_t payload[60];
+    uint8_t *p = payload;
+    sim_swd_stats_t swd;
+    sim_usb_stats_t usb;
+
+    sim_swd_stats(&swd, false);
+    sim_usb_stats(&usb, false);
+    p = sim_dap_put(p, sim_now, 8u);
+    p = sim_dap_put(p, SIM_CPU_FREQ, 4u);
+    p = sim_dap_put(p, sim_dap.last_cycles, 8u);
+    p = sim_dap_put(p, swd.clocks, 8u);
+    p = sim_dap_put(p, swd.packet_clocks, 8u);
+    p = sim_dap_put(p, swd.ok, 4u);
+    p = sim_dap_put(p, swd.wait, 4u);
+    p = sim_dap_put(p, swd.fault, 4u);
+    p = sim_dap_put(p, swd.no_ack, 4u);
+    p = sim_dap_put(p, usb.frames, 4u);
+    p = sim_dap_put(p, usb.naks, 4u);
+    sim_dap_send(SIM_DAP_TYPE_STATUS, payload, (uint32_t)(p - payload));
+}
+
+static void sim_dap_answer(const uint8_t *data, uint32_t len)
+{
+    if (SIM_DAP_READY != sim_dap.state)
+    {
+        /* our own DAP_Info during bring-up. */
+        if ( (len >= 3u) && (SIM_DAP_ID_INFO == data[0]) )
+        {
+            if ( (SIM_DAP_INFO_SIZE == sim_dap.state) && (2u == data[1]) && (len >= 4u) )
+            {
+                sim_dap.packet_size = sim_dap_get16(&data[2]);
+            }
+            else if ( (SIM_DAP_INFO_COUNT == sim_dap.state) && (1u == data[1]) )
+            {
+                sim_dap.window = data[2];
+            }
+        }
+        sim_dap.state++;
+        sim_dap_step();
+        return;
+    }
+    sim_dap_send(SIM_DAP_TYPE_RESPONSE, data, len);
+}
+
+/* queue complete requests from the socket while the window has room. a status request
+ * waits until everything before it is answered.
+ */
+static void sim_dap_parse(void)
+{
+    while ( (sim_dap.rx_len >= SIM_DAP_HDR_SIZE) && ((sim_dap.tail - sim_dap.head) < sim_dap.window) )
+    {
+        uint32_t signature = sim_dap.rx[0] | (sim_dap.rx[1] << 8u) | (sim_dap.rx[2] << 16u) | ((uint32_t)sim_dap.rx[3] << 24u);
+        uint32_t len = sim_dap_get16(&sim_dap.rx[4]);
+        uint8_t type = sim_dap.rx[6];
+        if ( (SIM_DAP_SIGNATURE != signature) || (len > SIM_DAP_REPORT_MAX)
+          || ((SIM_DAP_TYPE_REQUEST != type) && (SIM_DAP_TYPE_STATUS != type)) )
+        {
+            fprintf(stderr, "sim: dap link: bad packet header, dropping the connection\n");
+            sim_dap_session_end();
+            return;
+        }
+        if (sim_dap.rx_len < (SIM_DAP_HDR_SIZE + len))
+        {
+            return;
+        }
+        if (SIM_DAP_TYPE_REQUEST == type)
+        {
+            sim_dap_queue(&sim_dap.rx[SIM_DAP_HDR_SIZE], len);
+        }
+        else if (sim_dap.head == sim_dap.tail)
+        {
+            sim_dap_status();
+        }
+        else
+        {
+            return;
+        }
+        if (sim_dap.fd < 0)
+        {
+            return; /* dropped while answering. */
+        }
+        sim_dap.rx_len -= SIM_DAP_HDR_SIZE + len;
+        memmove(sim_dap.rx, &sim_dap.rx[SIM_DAP_HDR_SIZE + len], sim_dap.rx_len);
+    }
+}
+
+/* read from the debugger, waiting for it only when asked to. a new connection is only
+ * accepted with nothing in flight.
+ */
+static void sim_dap_receive(bool block)
+{
+    sim_dap_parse();
+    while ( (SIM_DAP_READY == sim_dap.state) && ((sim_dap.tail - sim_dap.head) < sim_dap.window) )
+    {
+        ssize_t n;
+
+        if (sim_dap.fd < 0)
+        {
+            int one = 1;
+            if (!block)
+            {
+                return;
+            }
+            sim_dap.fd = accept(sim_dap.listen_fd, NULL, NULL);
+            if (sim_dap.fd < 0)
+            {
+                if (EINTR != errno)
+                {
+                    sim_dap_fail("accept failed");
+                }
+                continue;
+            }
+            setsockopt(sim_dap.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            memset(&sim_dap.session, 0, sizeof(sim_dap.session));
+            sim_dap.session_start = sim_now;
+            continue;
+        }
+        if (sim_dap.rx_len >= sizeof(sim_dap.rx))
+        {
+            return; /* a status request waiting for the queue to drain. */
+        }
+        n = recv(sim_dap.fd, &sim_dap.rx[sim_dap.rx_len], sizeof(sim_dap.rx) - sim_dap.rx_len, block ? 0 : MSG_DONTWAIT);
+        if (n < 0)
+        {
+            if ( (EAGAIN == errno) || (EWOULDBLOCK == errno) )
+            {
+                return;
+            }
+            if (EINTR == errno)
+            {
+                continue;
+            }
+        }
+        if (n <= 0)
+        {
+            if (sim_dap.head != sim_dap.tail)
+            {
+                return; /* let the commands in flight finish first. */
+            }
+            sim_dap_session_end();
+            continue;
+        }
+        sim_dap.rx_len += (uint32_t)n;
+        sim_dap_parse();
+        if (sim_dap.head != sim_dap.tail)
+        {
+            block = false; /* got work, only take what is there already. */
+        }
+    }
+}
+
+uint64_t sim_dap_next_event(void)
+{
+    /* only with nothing in flight: the link waits for the debugger then. */
+    if ( (SIM_DAP_READY == sim_dap.state) && (sim_dap.head == sim_dap.tail) )
+    {
+        return sim_now;
+    }
+    return SIM_NEVER;
+}
+
+void sim_dap_run(uint64_t t)
+{
+    (void) t;
+    sim_dap_receive(true);
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* api. */
+
+bool sim_dap_listen(uint16_t port)
+{
+    struct sockaddr_in addr;
+    int one = 1;
+
+    if (SIM_DAP_OFF != sim_dap.state)
+    {
+        return false;
+    }
+    sim_dap.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (sim_dap.listen_fd < 0)
+    {
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(sim_dap.listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if ( (0 != bind(sim_dap.listen_fd, (struct sockaddr *)&addr, sizeof(addr))) || (0 != listen(sim_dap.listen_fd, 1)) )
+    {
+        close(sim_dap.listen_fd);
+        sim_dap.listen_fd = -1;
+        return false;
+    }
+    fprintf(stderr, "sim: dap link: listening on 127.0.0.1:%u\n", port);
+
+    /* bring-up runs from the usb events once the firmware has enabled the controller. */
+    sim_usb_connect(true);
+    sim_dap.state = SIM_DAP_GET_DEVICE;
+    sim_dap_step();
+    return true;
+}
+
+void sim_dap_stats(sim_dap_stats_t *stats, bool clear)
+{
+    if (NULL != stats)
+    {
+        *stats = sim_dap.stats;
+    }
+    if (clear)
+    {
+        memset(&sim_dap.stats, 0, sizeof(sim_dap.stats));
+    }
+}
+
+/* sim_dap.c - end */
@@ -0,0 +1,79 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* interface between the trap engine (sim.c) and the register models (sim_periph.c). */
+
+#ifndef SIM_MODEL_H
+#define SIM_MODEL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_NEVER               UINT64_MAX
+
+/* a modelled register block. read runs before a firmware load from the block, write after
+ * a store with the word's previous content. addresses are word aligned.
+ */
+typedef struct
+{
+    uint32_t base;
+    uint32_t size;
+    void   (*read)(uint32_t addr);
+    void   (*write)(uint32_t addr, uint32_t old);
+} sim_block_t;
+
+extern const sim_block_t sim_blocks[];
+extern const uint32_t sim_block_count;
+
+/* always accessible alias of a simulated address, for the models. */
+void *sim_view(uint32_t addr);
+void *sim_view_find(uint32_t addr);     /* NULL instead of fatal when nothing is mapped there. */
+#define SIM_VIEW(p)             ((__typeof__(p))sim_view((uint32_t)(uintptr_t)(p)))
+#define SIM_REG(addr)           (*(volatile uint32_t *)sim_view(addr))
+
+/* engine side. */
+extern uint64_t sim_now;
+
+/* model side. */
+void     sim_model_reset(void);
+uint64_t sim_model_next_event(void);    /* earliest pending model event, SIM_NEVER when none. */
+void     sim_model_run(uint64_t t);     /* handle the events due at t. */
+uint32_t sim_model_irq_lines(void);     /* level interrupt requests, bit per IRQn. */
+
+/* usb controller and host, sim_usb.c. */
+void     sim_usb_reset(void);
+void     sim_usb_write(uint32_t addr, uint32_t old);
+uint64_t sim_usb_next_event(void);
+void     sim_usb_run(uint64_t t);
+bool     sim_usb_irq(void);
+
+/* debugger link, sim_dap.c. */
+uint64_t sim_dap_next_event(void);
+void     sim_dap_run(uint64_t t);
+
+/* external devices on the pins. */
+void     sim_swd_pins(uint8_t port);    /* sim_swd.c, after every gpio output or mode change. */
+
+#endif /* SIM_MODEL_H */
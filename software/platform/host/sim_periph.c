@@ -0,0 +1,1065 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* register models for the blocks the firmware drives: rcc, gpio, TIM2, dma, UART2, LPUART
+ * and crc. everything else behaves as plain memory. the models work on the sim_view()
+ * alias, the firmware side of an access is done by the trapped instruction itself.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "hal_device_registers.h"
+#include "hal_dma.h"
+#include "sim.h"
+#include "sim_model.h"
+
+#define SIM_UART_QUEUE          4096u   /* bytes in flight on each wire, per direction. */
+#define SIM_UART_FERR_PPM       30000u  /* sender rate mismatch that breaks framing. */
+#define SIM_DMA_NONE            0xFFu
+
+/* ------------------------------------------------------------------------------------------ */
+/* rcc, clocks are ready as soon as they are switched on. */
+
+static void sim_tim2_reset(void);
+static void sim_uart_reset(uint8_t idx);
+
+static uint32_t sim_apb1_div(void)
+{
+    uint32_t ppre1 = (SIM_VIEW(RCC)->CFGR & RCC_CFGR_PPRE1_MASK) >> RCC_CFGR_PPRE1_SHIFT;
+
+    return (ppre1 >= 4u) ? (1u << (ppre1 - 3u)) : 1u; /* SYSCLK is always taken as SIM_CPU_FREQ. */
+}
+
+static void sim_rcc_write(uint32_t addr, uint32_t old)
+{
+    RCC_Type *rcc = SIM_VIEW(RCC);
+    uint32_t val = SIM_REG(addr);
+
+    switch (addr - RCC_BASE)
+    {
+        case offsetof(RCC_Type, CR):
+            val &= ~(RCC_CR_HSIRDY_MASK | RCC_CR_HSERDY_MASK | RCC_CR_PLL1RDY_MASK | RCC_CR_PLL2RDY_MASK);
+            val |= (0u != (val & RCC_CR_HSION_MASK))  ? RCC_CR_HSIRDY_MASK  : 0u;
+            val |= (0u != (val & RCC_CR_HSEON_MASK))  ? RCC_CR_HSERDY_MASK  : 0u;
+            val |= (0u != (val & RCC_CR_PLL1ON_MASK)) ? RCC_CR_PLL1RDY_MASK : 0u;
+            val |= (0u != (val & RCC_CR_PLL2ON_MASK)) ? RCC_CR_PLL2RDY_MASK : 0u;
+            rcc->CR = val;
+            break;
+        case offsetof(RCC_Type, CFGR):
+            rcc->CFGR = (val & ~RCC_CFGR_SWS_MASK) | RCC_CFGR_SWS((val & RCC_CFGR_SW_MASK) >> RCC_CFGR_SW_SHIFT);
+            break;
+        case offsetof(RCC_Type, BDCR):
+            rcc->BDCR = (0u != (val & RCC_BDCR_LSEON_MASK)) ? (val | RCC_BDCR_LSERDY_MASK) : (val & ~RCC_BDCR_LSERDY_MASK);
+            break;
+        case offsetof(RCC_Type, AHBRSTR):
+            if (0u != (val & ~old & RCC_AHBRSTR_USB_MASK))
+            {
+                sim_usb_reset();
+            }
+            break;
+        case offsetof(RCC_Type, APB1RSTR):
+            if (0u != (val & ~old & RCC_APB1RSTR_TIM2_MASK))
+            {
+                sim_tim2_reset();
+            }
+            if (0u != (val & ~old & RCC_APB1RSTR_UART2_MASK))
+            {
+                sim_uart_reset(0u);
+            }
+            break;
+        case offsetof(RCC_Type, APB2RSTR):
+            if (0u != (val & ~old & RCC_APB2RSTR_LPUART_MASK))
+            {
+                sim_uart_reset(1u);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* gpio. a pin reads its output latch when it is an output, otherwise the level driven from
+ * outside, otherwise its pull (the ODR bit selects up or down), otherwise low.
+ */
+
+static uint16_t sim_gpio_ext[SIM_GPIO_PORT_COUNT];
+static uint16_t sim_gpio_driven[SIM_GPIO_PORT_COUNT];
+static sim_gpio_hook_t sim_gpio_fn = NULL;
+
+static GPIO_Type *sim_gpio_port(uint8_t port)
+{
+    return (GPIO_Type *)sim_view(GPIOA_BASE + (0x400u * port));
+}
+
+/* pins whose 4-bit CRL / CRH field has a non-zero MODE, and those set up as pulled inputs. */
+static uint16_t sim_gpio_mode_mask(GPIO_Type *gpio, bool pull)
+{
+    uint16_t mask = 0u;
+
+    for (uint32_t pin = 0u; pin < 16u; pin++)
+    {
+        uint32_t cfg = (((pin < 8u) ? gpio->CRL : gpio->CRH) >> ((pin & 7u) * 4u)) & 0xFu;
+        if (pull ? (0x8u == cfg) : (0u != (cfg & 0x3u)))
+        {
+            mask |= (uint16_t)(1u << pin);
+        }
+    }
+    return mask;
+}
+
+static uint16_t sim_gpio_level(uint8_t port)
+{
+    GPIO_Type *gpio = sim_gpio_port(port);
+    uint16_t odr = (uint16_t)gpio->ODR;
+    uint16_t oe = sim_gpio_mode_mask(gpio, false);
+    uint16_t pull = sim_gpio_mode_mask(gpio, true) & (uint16_t)~sim_gpio_driven[port];
+
+    return (odr & oe) | (sim_gpio_ext[port] & sim_gpio_driven[port] & (uint16_t)~oe) | (odr & pull);
+}
+
+static uint32_t sim_gpio_af(uint8_t port, uint32_t pin)
+{
+    GPIO_Type *gpio = sim_gpio_port(port);
+
+    return (((pin < 8u) ? gpio->AFRL : gpio->AFRH) >> ((pin & 7u) * 4u)) & 0xFu;
+}
+
+static void sim_gpio_read(uint32_t addr)
+{
+    uint8_t port = (uint8_t)((addr - GPIOA_BASE) / 0x400u);
+
+    if (((addr - GPIOA_BASE) % 0x400u) == offsetof(GPIO_Type, IDR))
+    {
+        sim_gpio_port(port)->IDR = sim_gpio_level(port);
+    }
+}
+
+static void sim_gpio_write(uint32_t addr, uint32_t old)
+{
+    uint8_t port = (uint8_t)((addr - GPIOA_BASE) / 0x400u);
+    GPIO_Type *gpio = sim_gpio_port(port);
+    uint32_t val = SIM_REG(addr);
+
+    switch ((addr - GPIOA_BASE) % 0x400u)
+    {
+        case offsetof(GPIO_Type, BSRR):
+            gpio->ODR = (gpio->ODR & ~(val >> 16)) | (val & 0xFFFFu);
+            gpio->BSRR = 0u;
+            break;
+        case offsetof(GPIO_Type, BRR):
+            gpio->ODR &= ~(val & 0xFFFFu);
+            gpio->BRR = 0u;
+            break;
+        case offsetof(GPIO_Type, ODR):
+            gpio->ODR = val & 0xFFFFu;
+            break;
+        case offsetof(GPIO_Type, CRL):
+        case offsetof(GPIO_Type, CRH):
+            if (val != old)
+            {
+                break;
+            }
+            return;
+        case offsetof(GPIO_Type, IDR):
+            gpio->IDR = old; /* read only. */
+            return;
+        default:
+            return;
+    }
+    sim_swd_pins(port);
+    if (NULL != sim_gpio_fn)
+    {
+        sim_gpio_fn(port);
+    }
+}
+
+void sim_gpio_set_input(uint8_t port, uint16_t pins, bool high)
+{
+    sim_gpio_driven[port] |= pins;
+    sim_gpio_ext[port] = high ? (sim_gpio_ext[port] | pins) : (sim_gpio_ext[port] & (uint16_t)~pins);
+}
+
+void sim_gpio_release_input(uint8_t port, uint16_t pins)
+{
+    sim_gpio_driven[port] &= (uint16_t)~pins;
+}
+
+uint16_t sim_gpio_get_output(uint8_t port)
+{
+    return (uint16_t)sim_gpio_port(port)->ODR;
+}
+
+uint16_t sim_gpio_get_output_enable(uint8_t port)
+{
+    return sim_gpio_mode_mask(sim_gpio_port(port), false);
+}
+
+void sim_gpio_hook(sim_gpio_hook_t hook)
+{
+    sim_gpio_fn = hook;
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* TIM2, up-counting from the cpu clock through PSC. the counter is derived from virtual time
+ * when it is read, only the channel 4 input capture is modelled.
+ */
+
+static uint32_t sim_tim2_base_cnt;
+static uint64_t sim_tim2_base_time;
+static uint32_t sim_tim2_psc;
+
+static uint32_t sim_tim2_count_at(uint64_t t)
+{
+    if (0u == (SIM_VIEW(TIM2)->CR1 & TIM2_CR1_CEN_MASK))
+    {
+        return sim_tim2_base_cnt;
+    }
+    return sim_tim2_base_cnt + (uint32_t)((t - sim_tim2_base_time) / (sim_tim2_psc + 1u));
+}
+
+static void sim_tim2_rebase(uint32_t cnt)
+{
+    sim_tim2_base_cnt  = cnt;
+    sim_tim2_base_time = sim_now;
+}
+
+static void sim_tim2_reset(void)
+{
+    memset(SIM_VIEW(TIM2), 0, sizeof(TIM2_Type));
+    SIM_VIEW(TIM2)->ARR = 0xFFFFFFFFu;
+    sim_tim2_psc = 0u;
+    sim_tim2_rebase(0u);
+}
+
+static void sim_tim2_read(uint32_t addr)
+{
+    if ((addr - TIM2_BASE) == offsetof(TIM2_Type, CNT))
+    {
+        SIM_VIEW(TIM2)->CNT = sim_tim2_count_at(sim_now);
+    }
+}
+
+static void sim_tim2_write(uint32_t addr, uint32_t old)
+{
+    TIM2_Type *tim = SIM_VIEW(TIM2);
+    uint32_t val = SIM_REG(addr);
+
+    switch (addr - TIM2_BASE)
+    {
+        case offsetof(TIM2_Type, CNT):
+            sim_tim2_rebase(val);
+            break;
+        case offsetof(TIM2_Type, CR1):
+            if ((old ^ val) & TIM2_CR1_CEN_MASK)
+            {
+                tim->CR1 = old; /* count with the old state up to now. */
+                uint32_t cnt = sim_tim2_count_at(sim_now);
+                tim->CR1 = val;
+                sim_tim2_rebase(cnt);
+            }
+            break;
+        case offsetof(TIM2_Type, PSC):
+            sim_tim2_rebase(sim_tim2_count_at(sim_now));
+            sim_tim2_psc = val & 0xFFFFu; /* taken at once, not at the next update. */
+            break;
+        case offsetof(TIM2_Type, EGR):
+            if (0u != (val & TIM2_EGR_UG_MASK))
+            {
+                sim_tim2_rebase(0u);
+            }
+            tim->EGR = 0u;
+            break;
+        case offsetof(TIM2_Type, SR):
+            tim->SR = old & val; /* write 0 to clear. */
+            break;
+        default:
+            break;
+    }
+}
+
+/* an edge on TI4 (PA3 routed to AF2) at time t. */
+static void sim_tim2_edge(uint64_t t, bool rising)
+{
+    TIM2_Type *tim = SIM_VIEW(TIM2);
+    bool p  = (0u != (tim->CCER & TIM2_CCER_CC4P_MASK));
+    bool np = (0u != (tim->CCER & TIM2_CCER_CC4NP_MASK));
+
+    if ( (0u == (tim->CCER & TIM2_CCER_CC4E_MASK))
+      || (TIM2_CCMR2INPUT_CC4S(1u) != (tim->CCMR2 & TIM2_CCMR2INPUT_CC4S_MASK))
+      || (!(p && np) && (rising == p)) )
+    {
+        return;
+    }
+    if (0u != (tim->SR & TIM2_SR_CC4IF_MASK))
+    {
+        tim->SR |= TIM2_SR_CC4OF_MASK;
+    }
+    tim->CCR4 = sim_tim2_count_at(t);
+    tim->SR |= TIM2_SR_CC4IF_MASK;
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* dma. a peripheral finds its channel by the data register address in CPAR, the channel's
+ * transfer count is latched when it is enabled and reloaded in circular mode.
+ */
+
+static uint32_t sim_dma_reload[DMA_CHANNEL_COUNT];
+static uint32_t sim_dma_index[DMA_CHANNEL_COUNT];
+
+static void sim_dma_write(uint32_t addr, uint32_t old)
+{
+    DMA_Type *dma = SIM_VIEW(DMA1);
+    uint32_t off = addr - DMA_BASE;
+    uint32_t val = SIM_REG(addr);
+
+    if (offsetof(DMA_Type, ISR) == off)
+    {
+        dma->ISR = old; /* read only. */
+    }
+    else if (offsetof(DMA_Type, IFCR) == off)
+    {
+        dma->ISR &= ~val;
+        dma->IFCR = 0u;
+    }
+    else if ( (off >= offsetof(DMA_Type, CH)) && (0u == ((off - offsetof(DMA_Type, CH)) % sizeof(dma->CH[0]))) )
+    {
+        uint32_t ch = (off - offsetof(DMA_Type, CH)) / sizeof(dma->CH[0]);
+        if ( (ch < DMA_CHANNEL_COUNT) && (0u != (val & ~old & DMA_CCR_EN_MASK)) )
+        {
+            sim_dma_reload[ch] = dma->CH[ch].CNDTR;
+            sim_dma_index[ch]  = 0u;
+        }
+    }
+}
+
+/* enabled channel with work left serving the register at periph in the given direction. */
+static uint8_t sim_dma_find(uint32_t periph, bool to_periph)
+{
+    DMA_Type *dma = SIM_VIEW(DMA1);
+
+    for (uint8_t ch = 0u; ch < DMA_CHANNEL_COUNT; ch++)
+    {
+        uint32_t ccr = dma->CH[ch].CCR;
+        if ( (0u != (ccr & DMA_CCR_EN_MASK)) && (periph == dma->CH[ch].CPAR) && (0u != dma->CH[ch].CNDTR)
+          && (to_periph == (0u != (ccr & DMA_CCR_DIR_MASK))) )
+        {
+            return ch;
+        }
+    }
+    return SIM_DMA_NONE;
+}
+
+/* move one item between the peripheral and memory, the low byte is what the uarts use. */
+static void sim_dma_transfer(uint8_t ch, uint8_t *data)
+{
+    DMA_Type *dma = SIM_VIEW(DMA1);
+    uint32_t ccr = dma->CH[ch].CCR;
+    uint32_t size = 1u << ((ccr & DMA_CCR_MSIZE_MASK) >> DMA_CCR_MSIZE_SHIFT);
+    uint32_t offset = (0u != (ccr & DMA_CCR_MINC_MASK)) ? (sim_dma_index[ch] * size) : 0u;
+    uint8_t *mem = (uint8_t *)(uintptr_t)(dma->CH[ch].CMAR + offset); /* host build is non-pie, see sim_init(). */
+
+    if (0u != (ccr & DMA_CCR_DIR_MASK))
+    {
+        *data = mem[0];
+    }
+    else
+    {
+        memset(mem, 0, size);
+        mem[0] = *data;
+    }
+    sim_dma_index[ch]++;
+    dma->CH[ch].CNDTR--;
+
+    uint32_t flags = 0u;
+    if ( (sim_dma_reload[ch] >= 2u) && (dma->CH[ch].CNDTR == (sim_dma_reload[ch] / 2u)) )
+    {
+        flags |= DMA_CHN_INT_XFER_HALF_DONE;
+    }
+    if (0u == dma->CH[ch].CNDTR)
+    {
+        flags |= DMA_CHN_INT_XFER_DONE;
+        if (0u != (ccr & DMA_CCR_CIRC_MASK))
+        {
+            dma->CH[ch].CNDTR = sim_dma_reload[ch];
+            sim_dma_index[ch] = 0u;
+        }
+    }
+    if (0u != flags)
+    {
+        dma->ISR |= (flags | DMA_CHN_INT_XFER_GLOBAL) << (ch * 4u);
+    }
+}
+
+static uint32_t sim_dma_irq_lines(void)
+{
+    DMA_Type *dma = SIM_VIEW(DMA1);
+    uint32_t lines = 0u;
+
+    for (uint32_t ch = 0u; ch < DMA_CHANNEL_COUNT; ch++)
+    {
+        if (0u != ((dma->ISR >> (ch * 4u)) & dma->CH[ch].CCR & 0xEu))
+        {
+            lines |= 1u << ((0u == ch) ? DMA1_CH1_IRQn : ((ch < 3u) ? DMA1_CH3_CH2_IRQn : DMA1_CH7_CH4_IRQn));
+        }
+    }
+    return lines;
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* uarts. a frame on the wire takes start, data, parity and stop bits at the port's rate,
+ * times are in cycles and bit times in 1/16 cycles. the rx pin of UART2 can be routed to
+ * TIM2_CH4 instead, then every bit boundary is an event so the edges are captured.
+ */
+
+typedef struct
+{
+    uint64_t bit16;         /* bit time, 1/16 cycles. */
+    uint32_t data;
+    uint32_t parity;        /* 0 none, 1 odd, 2 even. */
+    uint32_t stop;
+} sim_frame_t;
+
+typedef struct
+{
+    uint8_t  rx_queue[SIM_UART_QUEUE];
+    uint32_t rx_head;
+    uint32_t rx_tail;
+    uint64_t rx_start;      /* start bit of the frame at rx_tail. */
+    uint32_t rx_bit;        /* next bit boundary of that frame, capture routing only. */
+    uint64_t rx_free;       /* end of the last frame. */
+    uint64_t rx_idle_at;
+    uint32_t sender_baud;
+    uint8_t  tx_wire[SIM_UART_QUEUE];
+    uint32_t tx_head;
+    uint32_t tx_tail;
+    uint64_t tx_done;       /* end of the frame in the shifter. */
+    uint8_t  tx_shift;
+    bool     tx_hold_full;
+    uint8_t  tx_hold;
+} sim_uart_t;
+
+static sim_uart_t sim_uarts[SIM_UART_COUNT];
+
+static const uint32_t sim_lpuart_rates[8] = {9600u, 4800u, 2400u, 1200u, 600u, 300u, 9600u, 9600u};
+
+uint32_t sim_uart_baud(uint8_t idx)
+{
+    if (0u == idx)
+    {
+        UART_Type *uart = SIM_VIEW(UART2);
+        uint32_t div16 = (uart->BRR * 16u) + (uart->FRA & 0xFu);
+        if ( (0u == (uart->GCR & UART_GCR_UARTEN_MASK)) || (0u == div16) )
+        {
+            return 0u;
+        }
+        return (SIM_CPU_FREQ / sim_apb1_div()) / div16;
+    }
+    LPUART_Type *lpuart = SIM_VIEW(LPUART);
+    if (0u == (lpuart->LPUEN & (LPUART_LPUEN_TXEN_MASK | LPUART_LPUEN_RXEN_MASK)))
+    {
+        return 0u;
+    }
+    return sim_lpuart_rates[(lpuart->LPUBAUD & LPUART_LPUBAUD_BAUD_MASK) >> LPUART_LPUBAUD_BAUD_SHIFT];
+}
+
+/* the port's line coding, at the sender's rate when rx is true and one is set. */
+static void sim_uart_frame(uint8_t idx, bool rx, sim_frame_t *frame)
+{
+    uint32_t baud = sim_uart_baud(idx);
+
+    frame->data = 8u;
+    frame->parity = 0u;
+    frame->stop = 1u;
+    if (0u == idx)
+    {
+        UART_Type *uart = SIM_VIEW(UART2);
+        frame->data   = 5u + ((uart->CCR & UART_CCR_CHAR_MASK) >> UART_CCR_CHAR_SHIFT);
+        frame->parity = (0u == (uart->CCR & UART_CCR_PEN_MASK)) ? 0u : ((0u != (uart->CCR & UART_CCR_PSEL_MASK)) ? 1u : 2u);
+        frame->stop   = (0u != (uart->CCR & UART_CCR_SPB0_MASK)) ? 2u : 1u;
+    }
+    else
+    {
+        LPUART_Type *lpuart = SIM_VIEW(LPUART);
+        frame->data   = (0u != (lpuart->LPUCON & LPUART_LPUCON_DL_MASK)) ? 7u : 8u;
+        frame->parity = (0u == (lpuart->LPUCON & LPUART_LPUCON_PAREN_MASK)) ? 0u : ((0u != (lpuart->LPUCON & LPUART_LPUCON_PTYP_MASK)) ? 1u : 2u);
+        frame->stop   = (0u != (lpuart->LPUCON & LPUART_LPUCON_SL_MASK)) ? 2u : 1u;
+    }
+    if (rx && (0u != sim_uarts[idx].sender_baud))
+    {
+        baud = sim_uarts[idx].sender_baud;
+    }
+    frame->bit16 = (16ull * SIM_CPU_FREQ) / ((0u != baud) ? baud : 115200u);
+}
+
+static uint32_t sim_frame_bits(const sim_frame_t *frame)
+{
+    return 1u + frame->data + ((0u != frame->parity) ? 1u : 0u) + frame->stop;
+}
+
+static uint64_t sim_frame_time(const sim_frame_t *frame, uint32_t bits)
+{
+    return ((frame->bit16 * bits) + 15u) / 16u;
+}
+
+/* line level during bit k of the frame carrying byte. */
+static bool sim_frame_level(const sim_frame_t *frame, uint8_t byte, uint32_t k)
+{
+    if (0u == k)
+    {
+        return false;
+    }
+    if (k <= frame->data)
+    {
+        return (0u != ((byte >> (k - 1u)) & 1u));
+    }
+    if ( (k == (frame->data + 1u)) && (0u != frame->parity) )
+    {
+        return (1u == frame->parity) ^ (0u != (__builtin_popcount(byte & ((1u << frame->data) - 1u)) & 1u));
+    }
+    return true;
+}
+
+static bool sim_uart_rx_captured(uint8_t idx)
+{
+    return (0u == idx) && (2u == sim_gpio_af(0u, 3u)); /* PA3 on TIM2_CH4. */
+}
+
+static bool sim_uart_rate_ok(uint8_t idx)
+{
+    uint32_t actual = sim_uart_baud(idx);
+    uint32_t sender = sim_uarts[idx].sender_baud;
+
+    if ( (0u == sender) || (0u == actual) )
+    {
+        return true;
+    }
+    uint64_t diff = (sender > actual) ? (sender - actual) : (actual - sender);
+    return ((diff * 1000000u) / actual) <= SIM_UART_FERR_PPM;
+}
+
+static void sim_uart_rx_byte(uint8_t idx, uint8_t byte)
+{
+    bool ferr = !sim_uart_rate_ok(idx);
+
+    if (0u == idx)
+    {
+        UART_Type *uart = SIM_VIEW(UART2);
+        uint8_t ch = sim_dma_find(UART2_BASE + offsetof(UART_Type, RDR), false);
+        if (0u == (uart->GCR & UART_GCR_UARTEN_MASK) || (0u == (uart->GCR & UART_GCR_RXEN_MASK)))
+        {
+            return;
+        }
+        uart->ISR |= UART_ISR_RXINTF_MASK | (ferr ? UART_ISR_RXFERRINTF_MASK : 0u);
+        if ( (0u != (uart->GCR & UART_GCR_DMAMODE_MASK)) && (SIM_DMA_NONE != ch) )
+        {
+            sim_dma_transfer(ch, &byte);
+        }
+        else if (0u != (uart->CSR & UART_CSR_RXAVL_MASK))
+        {
+            uart->ISR |= UART_ISR_RXOERRINTF_MASK;
+        }
+        else
+        {
+            uart->RDR = byte;
+            uart->CSR |= UART_CSR_RXAVL_MASK;
+        }
+    }
+    else
+    {
+        LPUART_Type *lpuart = SIM_VIEW(LPUART);
+        uint8_t ch = sim_dma_find(LPUART_BASE + offsetof(LPUART_Type, LPURXD), false);
+        if (0u == (lpuart->LPUEN & LPUART_LPUEN_RXEN_MASK))
+        {
+            return;
+        }
+        lpuart->LPUSTA |= ferr ? LPUART_LPUSTA_FERR_MASK : 0u;
+        if ( (0u != (lpuart->LPUEN & LPUART_LPUEN_DMAR_MASK)) && (SIM_DMA_NONE != ch) )
+        {
+            sim_dma_transfer(ch, &byte);
+        }
+        else if (0u != (lpuart->LPUSTA & LPUART_LPUSTA_RXF_MASK))
+        {
+            lpuart->LPUSTA |= LPUART_LPUSTA_RXOV_MASK;
+        }
+        else
+        {
+            lpuart->LPURXD = byte;
+            lpuart->LPUSTA |= LPUART_LPUSTA_RXF_MASK;
+        }
+    }
+}
+
+/* data for the shifter, from the data register or a dma channel. */
+static bool sim_uart_tx_fetch(uint8_t idx, bool take, uint8_t *byte)
+{
+    sim_uart_t *u = &sim_uarts[idx];
+    uint8_t ch;
+
+    if (0u == idx)
+    {
+        UART_Type *uart = SIM_VIEW(UART2);
+        if ( (0u == (uart->GCR & UART_GCR_UARTEN_MASK)) || (0u == (uart->GCR & UART_GCR_TXEN_MASK)) )
+        {
+            return false;
+        }
+        ch = (0u != (uart->GCR & UART_GCR_DMAMODE_MASK)) ? sim_dma_find(UART2_BASE + offsetof(UART_Type, TDR), true) : SIM_DMA_NONE;
+    }
+    else
+    {
+        LPUART_Type *lpuart = SIM_VIEW(LPUART);
+        if (0u == (lpuart->LPUEN & LPUART_LPUEN_TXEN_MASK))
+        {
+            return false;
+        }
+        ch = (0u != (lpuart->LPUEN & LPUART_LPUEN_DMAT_MASK)) ? sim_dma_find(LPUART_BASE + offsetof(LPUART_Type, LPUTXD), true) : SIM_DMA_NONE;
+    }
+    if (u->tx_hold_full)
+    {
+        if (take)
+        {
+            *byte = u->tx_hold;
+            u->tx_hold_full = false;
+        }
+        return true;
+    }
+    if (SIM_DMA_NONE == ch)
+    {
+        return false;
+    }
+    if (take)
+    {
+        sim_dma_transfer(ch, byte);
+    }
+    return true;
+}
+
+static void sim_uart_tx_status(uint8_t idx, bool busy)
+{
+    if (0u == idx)
+    {
+        UART_Type *uart = SIM_VIEW(UART2);
+        if (busy)
+        {
+            uart->CSR &= ~(UART_CSR_TXC_MASK | UART_CSR_TXEPT_MASK);
+        }
+        else
+        {
+            uart->CSR |= UART_CSR_TXC_MASK | UART_CSR_TXEPT_MASK;
+            uart->ISR |= UART_ISR_TXCINTF_MASK;
+        }
+    }
+    else
+    {
+        LPUART_Type *lpuart = SIM_VIEW(LPUART);
+        lpuart->LPUSTA = busy ? (lpuart->LPUSTA & ~LPUART_LPUSTA_TC_MASK) : (lpuart->LPUSTA | LPUART_LPUSTA_TC_MASK);
+    }
+}
+
+static void sim_uart_reset(uint8_t idx)
+{
+    sim_uart_t *u = &sim_uarts[idx];
+
+    if (0u == idx)
+    {
+        memset(SIM_VIEW(UART2), 0, sizeof(UART_Type));
+        SIM_VIEW(UART2)->CSR = UART_CSR_TXC_MASK | UART_CSR_TXEPT_MASK;
+    }
+    else
+    {
+        memset(SIM_VIEW(LPUART), 0, sizeof(LPUART_Type));
+        SIM_VIEW(LPUART)->LPUSTA = LPUART_LPUSTA_TC_MASK | LPUART_LPUSTA_TXE_MASK;
+    }
+    u->tx_done = SIM_NEVER;
+    u->tx_hold_full = false;
+    u->rx_idle_at = SIM_NEVER;
+}
+
+static uint64_t sim_uart_next_event(uint8_t idx)
+{
+    sim_uart_t *u = &sim_uarts[idx];
+    uint64_t next = u->rx_idle_at;
+    uint8_t byte;
+
+    if (SIM_NEVER != u->tx_done)
+    {
+        next = (u->tx_done < next) ? u->tx_done : next;
+    }
+    else if (sim_uart_tx_fetch(idx, false, &byte))
+    {
+        return sim_now; /* data waiting for an idle shifter. */
+    }
+    if (u->rx_head != u->rx_tail)
+    {
+        sim_frame_t frame;
+        sim_uart_frame(idx, true, &frame);
+        uint32_t bit = sim_uart_rx_captured(idx) ? u->rx_bit : sim_frame_bits(&frame);
+        uint64_t t = u->rx_start + sim_frame_time(&frame, bit);
+        next = (t < next) ? t : next;
+    }
+    return next;
+}
+
+static void sim_uart_run(uint8_t idx, uint64_t t)
+{
+    sim_uart_t *u = &sim_uarts[idx];
+    sim_frame_t frame;
+
+    /* tx: retire the frame in the shifter, start the next one. */
+    bool retired = false;
+    if (u->tx_done == t)
+    {
+        u->tx_wire[u->tx_head++ % SIM_UART_QUEUE] = u->tx_shift;
+        if ((u->tx_head - u->tx_tail) > SIM_UART_QUEUE)
+        {
+            u->tx_tail = u->tx_head - SIM_UART_QUEUE; /* nobody collects, keep the newest. */
+        }
+        u->tx_done = SIM_NEVER;
+        retired = true;
+    }
+    if (SIM_NEVER == u->tx_done)
+    {
+        if (sim_uart_tx_fetch(idx, true, &u->tx_shift))
+        {
+            sim_uart_frame(idx, false, &frame);
+            u->tx_done = t + sim_frame_time(&frame, sim_frame_bits(&frame));
+            sim_uart_tx_status(idx, true);
+        }
+        else if (retired)
+        {
+            sim_uart_tx_status(idx, false);
+        }
+    }
+
+    /* rx: bit boundaries while captured, whole frames otherwise. */
+    if (u->rx_head != u->rx_tail)
+    {
+        bool captured = sim_uart_rx_captured(idx);
+        uint8_t byte = u->rx_queue[u->rx_tail % SIM_UART_QUEUE];
+        sim_uart_frame(idx, true, &frame);
+        uint32_t bits = sim_frame_bits(&frame);
+        uint32_t bit = captured ? u->rx_bit : bits;
+
+        if ((u->rx_start + sim_frame_time(&frame, bit)) == t)
+        {
+            if (captured && (bit < bits))
+            {
+                bool prev = (0u == bit) || sim_frame_level(&frame, byte, bit - 1u);
+                bool level = sim_frame_level(&frame, byte, bit);
+                if (prev != level)
+                {
+                    sim_tim2_edge(t, level);
+                }
+                u->rx_bit++;
+            }
+            else
+            {
+                if (!captured)
+                {
+                    sim_uart_rx_byte(idx, byte);
+                }
+                u->rx_tail++;
+                u->rx_bit = 0u;
+                u->rx_start = t;
+                u->rx_free = t;
+                u->rx_idle_at = ((u->rx_head == u->rx_tail) && !captured) ? (t + sim_frame_time(&frame, bits)) : SIM_NEVER;
+            }
+        }
+    }
+    if (u->rx_idle_at == t)
+    {
+        u->rx_idle_at = SIM_NEVER;
+        if (0u == idx)
+        {
+            SIM_VIEW(UART2)->ISR |= UART_ISR_RXIDLEINTF_MASK;
+        }
+    }
+}
+
+static void sim_uart2_read(uint32_t addr)
+{
+    if ((addr - UART2_BASE) == offsetof(UART_Type, RDR))
+    {
+        SIM_VIEW(UART2)->CSR &= ~UART_CSR_RXAVL_MASK;
+    }
+}
+
+static void sim_uart2_write(uint32_t addr, uint32_t old)
+{
+    UART_Type *uart = SIM_VIEW(UART2);
+    uint32_t val = SIM_REG(addr);
+
+    switch (addr - UART2_BASE)
+    {
+        case offsetof(UART_Type, TDR):
+            sim_uarts[0].tx_hold = (uint8_t)val;
+            sim_uarts[0].tx_hold_full = true;
+            break;
+        case offsetof(UART_Type, ICR):
+            uart->ISR &= ~val;
+            uart->ICR = 0u;
+            break;
+        case offsetof(UART_Type, RDR):
+        case offsetof(UART_Type, CSR):
+        case offsetof(UART_Type, ISR):
+            SIM_REG(addr) = old; /* read only. */
+            break;
+        default:
+            break;
+    }
+}
+
+static void sim_lpuart_read(uint32_t addr)
+{
+    if ((addr - LPUART_BASE) == offsetof(LPUART_Type, LPURXD))
+    {
+        SIM_VIEW(LPUART)->LPUSTA &= ~LPUART_LPUSTA_RXF_MASK;
+    }
+}
+
+static void sim_lpuart_write(uint32_t addr, uint32_t old)
+{
+    LPUART_Type *lpuart = SIM_VIEW(LPUART);
+    uint32_t val = SIM_REG(addr);
+
+    switch (addr - LPUART_BASE)
+    {
+        case offsetof(LPUART_Type, LPUTXD):
+            sim_uarts[1].tx_hold = (uint8_t)val;
+            sim_uarts[1].tx_hold_full = true;
+            break;
+        case offsetof(LPUART_Type, LPUSTA):
+            lpuart->LPUSTA = old & ~(val & (LPUART_LPUSTA_RXOV_MASK | LPUART_LPUSTA_FERR_MASK | LPUART_LPUSTA_PERR_MASK | LPUART_LPUSTA_MATCH_MASK)); /* write 1 to clear. */
+            break;
+        case offsetof(LPUART_Type, LPURXD):
+            lpuart->LPURXD = old;
+            break;
+        default:
+            break;
+    }
+}
+
+uint32_t sim_uart_inject(uint8_t idx, const uint8_t *data, uint32_t len)
+{
+    sim_uart_t *u = &sim_uarts[idx];
+    uint32_t n = 0u;
+
+    if (u->rx_head == u->rx_tail)
+    {
+        u->rx_start = (u->rx_free > sim_now) ? u->rx_free : sim_now;
+        u->rx_bit = 0u;
+        if (u->rx_start < u->rx_idle_at)
+        {
+            u->rx_idle_at = SIM_NEVER; /* the line did not stay quiet long enough. */
+        }
+    }
+    while ( (n < len) && ((u->rx_head - u->rx_tail) < SIM_UART_QUEUE) )
+    {
+        u->rx_queue[u->rx_head++ % SIM_UART_QUEUE] = data[n++];
+    }
+    return n;
+}
+
+uint32_t sim_uart_collect(uint8_t idx, uint8_t *data, uint32_t len)
+{
+    sim_uart_t *u = &sim_uarts[idx];
+    uint32_t n = 0u;
+
+    while ( (n < len) && (u->tx_tail != u->tx_head) )
+    {
+        data[n++] = u->tx_wire[u->tx_tail++ % SIM_UART_QUEUE];
+    }
+    return n;
+}
+
+void sim_uart_sender_baud(uint8_t idx, uint32_t baud)
+{
+    sim_uarts[idx].sender_baud = baud;
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* crc. CRC_CR_AS selects crc-32/mpeg-2 (0, msb first, no final xor) or crc-32 (1, reflected,
+ * final xor), ISIZE the width fed per DR write, IES / OES swap the bytes in and out.
+ */
+
+static uint32_t sim_crc_state;
+
+static uint32_t sim_crc_output(void)
+{
+    uint32_t cr = SIM_VIEW(CRC)->CR;
+    uint32_t out = (0u != (cr & CRC_CR_AS_MASK)) ? ~sim_crc_state : sim_crc_state;
+
+    return (0u != (cr & CRC_CR_OES_MASK)) ? __builtin_bswap32(out) : out;
+}
+
+static void sim_crc_feed(uint32_t val)
+{
+    uint32_t cr = SIM_VIEW(CRC)->CR;
+    uint32_t width = 4u >> ((cr & CRC_CR_ISIZE_MASK) >> CRC_CR_ISIZE_SHIFT);
+    bool reflected = (0u != (cr & CRC_CR_AS_MASK));
+
+    if (0u != (cr & CRC_CR_IES_MASK))
+    {
+        val = __builtin_bswap32(val) >> (8u * (4u - width));
+    }
+    for (uint32_t i = 0u; i < width; i++)
+    {
+        uint8_t byte = reflected ? (uint8_t)(val >> (8u * i)) : (uint8_t)(val >> (8u * (width - 1u - i)));
+        if (reflected)
+        {
+            sim_crc_state ^= byte;
+            for (uint32_t b = 0u; b < 8u; b++)
+            {
+                sim_crc_state = (sim_crc_state >> 1) ^ ((0u != (sim_crc_state & 1u)) ? 0xEDB88320u : 0u);
+            }
+        }
+        else
+        {
+            sim_crc_state ^= (uint32_t)byte << 24;
+            for (uint32_t b = 0u; b < 8u; b++)
+            {
+                sim_crc_state = (sim_crc_state << 1) ^ ((0u != (sim_crc_state & 0x80000000u)) ? 0x04C11DB7u : 0u);
+            }
+        }
+    }
+}
+
+static void sim_crc_write(uint32_t addr, uint32_t old)
+{
+    CRC_Type *crc = SIM_VIEW(CRC);
+
+    (void) old;
+    switch (addr - CRC_BASE)
+    {
+        case offsetof(CRC_Type, DR):
+            sim_crc_feed(crc->DR);
+            break;
+        case offsetof(CRC_Type, CR):
+            if (0u != (crc->CR & CRC_CR_RST_MASK))
+            {
+                sim_crc_state = 0xFFFFFFFFu;
+                crc->CR &= ~CRC_CR_RST_MASK;
+            }
+            break;
+        default:
+            return;
+    }
+    crc->DR = sim_crc_output();
+}
+
+/* ------------------------------------------------------------------------------------------ */
+
+const sim_block_t sim_blocks[] =
+{
+    { RCC_BASE,    0x400u,  NULL,             sim_rcc_write    },
+    { GPIOA_BASE,  0x1000u, sim_gpio_read,    sim_gpio_write   },
+    { TIM2_BASE,   0x400u,  sim_tim2_read,    sim_tim2_write   },
+    { DMA_BASE,    0x400u,  NULL,             sim_dma_write    },
+    { UART2_BASE,  0x400u,  sim_uart2_read,   sim_uart2_write  },
+    { LPUART_BASE, 0x400u,  sim_lpuart_read,  sim_lpuart_write },
+    { CRC_BASE,    0x400u,  NULL,             sim_crc_write    },
+    { USB_FS_BASE, 0x400u,  NULL,             sim_usb_write    },
+};
+const uint32_t sim_block_count = sizeof(sim_blocks) / sizeof(sim_blocks[0]);
+
+void sim_model_reset(void)
+{
+    SIM_VIEW(RCC)->CR = RCC_CR_HSION_MASK | RCC_CR_HSIRDY_MASK;
+    for (uint8_t port = 0u; port < SIM_GPIO_PORT_COUNT; port++)
+    {
+        sim_gpio_port(port)->CRL = 0x44444444u; /* floating inputs. */
+        sim_gpio_port(port)->CRH = 0x44444444u;
+    }
+    sim_tim2_reset();
+    for (uint8_t idx = 0u; idx < SIM_UART_COUNT; idx++)
+    {
+        sim_uart_reset(idx);
+    }
+    sim_crc_state = 0xFFFFFFFFu;
+    SIM_VIEW(CRC)->DR = sim_crc_state;
+    sim_usb_reset();
+}
+
+uint64_t sim_model_next_event(void)
+{
+    uint64_t next = sim_usb_next_event();
+
+    if (sim_dap_next_event() < next)
+    {
+        next = sim_dap_next_event();
+    }
+    for (uint8_t idx = 0u; idx < SIM_UART_COUNT; idx++)
+    {
+        uint64_t t = sim_uart_next_event(idx);
+        if (t < next)
+        {
+            next = t;
+        }
+    }
+    return next;
+}
+
+void sim_model_run(uint64_t t)
+{
+    for (uint8_t idx = 0u; idx < SIM_UART_COUNT; idx++)
+    {
+        if (sim_uart_next_event(idx) <= t)
+        {
+            sim_uart_run(idx, t);
+        }
+    }
+    if (sim_usb_next_event() <= t)
+    {
+        sim_usb_run(t);
+    }
+    if (sim_dap_next_event() <= t)
+    {
+        sim_dap_run(t); /* last, it may wait for the debugger. */
+    }
+}
+
+uint32_t sim_model_irq_lines(void)
+{
+    TIM2_Type *tim = SIM_VIEW(TIM2);
+    UART_Type *uart = SIM_VIEW(UART2);
+    uint32_t lines = sim_dma_irq_lines();
+
+    if (0u != (tim->SR & tim->DIER & 0x1Fu))
+    {
+        lines |= 1u << TIM2_IRQn;
+    }
+    if (0u != (uart->ISR & uart->IER))
+    {
+        lines |= 1u << UART2_IRQn;
+    }
+    if (sim_usb_irq())
+    {
+        lines |= 1u << USB_IRQn;
+    }
+    return lines;
+}
+
+/* sim_periph.c - end */
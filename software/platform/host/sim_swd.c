@@ -0,0 +1,724 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* bit level swd target for the host build, see sim.h. the state machine advances on every
+ * rising SWCLK edge: it samples SWDIO when the probe owns the line and drives the next bit
+ * straight away when the target does, so the probe reads it while SWCLK is low.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_device_registers.h"
+#include "sim.h"
+#include "sim_model.h"
+
+#define SIM_SWD_PORT            0u      /* GPIOA. */
+#define SIM_SWD_SWCLK           (1u << 1u)
+#define SIM_SWD_SWDIO           (1u << 0u)
+#define SIM_SWD_RESET_ONES      50u     /* line reset: this many high bits in a row. */
+
+#define SIM_SWD_ACK_OK          0x1u
+#define SIM_SWD_ACK_WAIT        0x2u
+#define SIM_SWD_ACK_FAULT       0x4u
+#define SIM_SWD_ACK_NONE        0x7u    /* released line, pulled up. */
+
+/* request bits. */
+#define SIM_SWD_REQ_APNDP       (1u << 1u)
+#define SIM_SWD_REQ_RNW         (1u << 2u)
+#define SIM_SWD_REQ_A(req)      (((req) >> 3u) & 0x3u)
+
+/* dp registers. */
+#define SIM_DP_ABORT_DAPABORT   (1u << 0u)
+#define SIM_DP_ABORT_STKCMPCLR  (1u << 1u)
+#define SIM_DP_ABORT_STKERRCLR  (1u << 2u)
+#define SIM_DP_ABORT_WDERRCLR   (1u << 3u)
+#define SIM_DP_ABORT_ORUNERRCLR (1u << 4u)
+#define SIM_DP_CTRL_ORUNDETECT  (1u << 0u)
+#define SIM_DP_CTRL_STICKYORUN  (1u << 1u)
+#define SIM_DP_CTRL_STICKYCMP   (1u << 4u)
+#define SIM_DP_CTRL_STICKYERR   (1u << 5u)
+#define SIM_DP_CTRL_WDATAERR    (1u << 7u)
+#define SIM_DP_CTRL_STICKY      (SIM_DP_CTRL_STICKYORUN | SIM_DP_CTRL_STICKYCMP | SIM_DP_CTRL_STICKYERR | SIM_DP_CTRL_WDATAERR)
+#define SIM_DP_CTRL_WRITABLE    0x543FFF0Du /* ORUNDETECT, TRNMODE, TRNCNT, MASKLANE, the requests. */
+#define SIM_DP_CTRL_REQ_ACKS    0x54000000u /* CDBGRSTREQ, CDBGPWRUPREQ, CSYSPWRUPREQ, acked at once. */
+
+/* mem-ap registers. */
+#define SIM_AP_CSW              0x00u
+#define SIM_AP_TAR              0x04u
+#define SIM_AP_DRW              0x0Cu
+#define SIM_AP_BD0              0x10u
+#define SIM_AP_BASE             0xF8u
+#define SIM_AP_IDR              0xFCu
+#define SIM_AP_CSW_SIZE_MASK    0x7u
+#define SIM_AP_CSW_ADDRINC_MASK (0x3u << 4u)
+#define SIM_AP_CSW_DEVICEEN     (1u << 6u)
+#define SIM_AP_CSW_RESET        0x03000040u
+#define SIM_AP_ROM_BASE         0xE00FF003u /* cortex-m0 rom table, present. */
+
+#define SIM_SWD_SCS_BASE        0xE000E000u
+#define SIM_SWD_SCS_SIZE        0x1000u
+
+typedef enum
+{
+    SIM_SWD_LOCKOUT,                    /* protocol error, waits for a line reset. */
+    SIM_SWD_RESET,                      /* line reset seen, waits for the first idle bit. */
+    SIM_SWD_IDLE,
+    SIM_SWD_REQUEST,
+    SIM_SWD_TRN_ACK,
+    SIM_SWD_ACK,
+    SIM_SWD_RDATA,
+    SIM_SWD_TRN_WDATA,
+    SIM_SWD_WDATA,
+    SIM_SWD_TRN_END,
+} sim_swd_phase_t;
+
+typedef struct
+{
+    uint32_t base;
+    uint32_t size;
+    bool     writable;
+    uint8_t *mem;
+} sim_swd_region_t;
+
+static struct
+{
+    bool             attached;
+    sim_swd_config_t config;
+    sim_swd_region_t regions[3];        /* flash, ram, scs. */
+    sim_swd_stats_t  stats;
+
+    /* wire. */
+    bool             swclk;
+    bool             driving;
+    uint32_t         level;             /* what the target drives. */
+    uint32_t         ones;
+    sim_swd_phase_t  phase;
+    uint32_t         bit;
+    uint32_t         count;
+    uint32_t         request;
+    uint32_t         ack;
+    uint32_t         data;
+    bool             parity_bad;        /* send this read data phase with a wrong parity. */
+
+    /* dp. */
+    bool             need_idcode;       /* after a line reset only a DPIDR read is answered. */
+    uint32_t         ctrl_stat;
+    uint32_t         select;
+    uint32_t         dlcr;
+    uint32_t         rdbuff;
+    uint32_t         resend;
+
+    /* ap. */
+    uint32_t         csw;
+    uint32_t         tar;
+
+    /* fault schedules. */
+    uint32_t         wait_seq;
+    uint32_t         wait_left;
+    bool             stalled;
+    uint32_t         fault_seq;
+    uint32_t         parity_seq;
+} sim_swd;
+
+static uint32_t sim_swd_parity(uint32_t v)
+{
+    return (uint32_t)__builtin_parity(v);
+}
+
+static void sim_swd_drive(bool driving, uint32_t level)
+{
+    sim_swd.driving = driving;
+    sim_swd.level = (!driving) || (0u != level);
+    sim_gpio_set_input(SIM_SWD_PORT, SIM_SWD_SWDIO, (!driving) || (0u != level));
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* memory behind the ap. */
+
+static sim_swd_region_t *sim_swd_region(uint32_t addr, uint32_t len)
+{
+    for (uint32_t i = 0u; i < (sizeof(sim_swd.regions) / sizeof(sim_swd.regions[0])); i++)
+    {
+        sim_swd_region_t *region = &sim_swd.regions[i];
+        if ( (NULL != region->mem) && (addr >= region->base)
+          && ((addr - region->base) < region->size) && (len <= (region->size - (addr - region->base))) )
+        {
+            return region;
+        }
+    }
+    return NULL;
+}
+
+/* one drw access at TAR in the size CSW selects, data in its byte lanes. false for a bus error. */
+static bool sim_swd_mem_access(bool write, uint32_t *data)
+{
+    uint32_t size = sim_swd.csw & SIM_AP_CSW_SIZE_MASK;
+    uint32_t len = (size >= 2u) ? 4u : (1u << size);
+    uint32_t addr = sim_swd.tar & ~(len - 1u);
+    uint32_t lane = (addr & 3u) * 8u;
+    sim_swd_region_t *region = sim_swd_region(addr, len);
+    uint8_t *mem;
+
+    if ( (NULL == region) || (write && !region->writable) )
+    {
+        return false;
+    }
+    mem = region->mem + (addr - region->base);
+    if (write)
+    {
+        for (uint32_t i = 0u; i < len; i++)
+        {
+            mem[i] = (uint8_t)(*data >> (lane + (i * 8u)));
+        }
+    }
+    else
+    {
+        *data = 0u;
+        for (uint32_t i = 0u; i < len; i++)
+        {
+            *data |= (uint32_t)mem[i] << (lane + (i * 8u));
+        }
+    }
+    if (0u != (sim_swd.csw & SIM_AP_CSW_ADDRINC_MASK))
+    {
+        /* auto-increment only carries within the 1KB block. */
+        sim_swd.tar = (sim_swd.tar & ~0x3FFu) | ((sim_swd.tar + len) & 0x3FFu);
+    }
+    return true;
+}
+
+/* drw, or a banked data register: TAR[3:0] from the register, word sized, no increment. */
+static void sim_swd_ap_data(uint32_t reg, bool write, uint32_t *data)
+{
+    uint32_t csw = sim_swd.csw;
+    uint32_t tar = sim_swd.tar;
+    bool ok;
+
+    if (SIM_AP_DRW == reg)
+    {
+        ok = sim_swd_mem_access(write, data);
+    }
+    else
+    {
+        sim_swd.tar = (tar & ~0xFu) | (reg - SIM_AP_BD0);
+        sim_swd.csw = (csw & ~(SIM_AP_CSW_SIZE_MASK | SIM_AP_CSW_ADDRINC_MASK)) | 2u;
+        ok = sim_swd_mem_access(write, data);
+        sim_swd.csw = csw;
+        sim_swd.tar = tar;
+    }
+    if (!ok)
+    {
+        sim_swd.ctrl_stat |= SIM_DP_CTRL_STICKYERR;
+        sim_swd.stats.bus_errors++;
+    }
+}
+
+static bool sim_swd_ap_is_data(uint32_t reg)
+{
+    return (SIM_AP_DRW == reg) || ((reg >= SIM_AP_BD0) && (reg < (SIM_AP_BD0 + 0x10u)));
+}
+
+static uint32_t sim_swd_ap_read(uint32_t reg)
+{
+    uint32_t data = 0u;
+
+    if (0u != (sim_swd.select >> 24u)) /* only APSEL 0 is there. */
+    {
+        return 0u;
+    }
+    if (sim_swd_ap_is_data(reg))
+    {
+        sim_swd_ap_data(reg, false, &data);
+        return data;
+    }
+    switch (reg)
+    {
+        case SIM_AP_CSW:  return sim_swd.csw;
+        case SIM_AP_TAR:  return sim_swd.tar;
+        case SIM_AP_BASE: return SIM_AP_ROM_BASE;
+        case SIM_AP_IDR:  return sim_swd.config.ap_idr;
+        default:          return 0u;
+    }
+}
+
+static void sim_swd_ap_write(uint32_t reg, uint32_t data)
+{
+    if (0u != (sim_swd.select >> 24u))
+    {
+        return;
+    }
+    if (sim_swd_ap_is_data(reg))
+    {
+        sim_swd_ap_data(reg, true, &data);
+    }
+    else if (SIM_AP_CSW == reg)
+    {
+        sim_swd.csw = data | SIM_AP_CSW_DEVICEEN;
+    }
+    else if (SIM_AP_TAR == reg)
+    {
+        sim_swd.tar = data;
+    }
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* packets. */
+
+/* a complete request header arrived: pick the acknowledge, run reads now (ap reads are
+ * posted, the data phase returns the previous result). SIM_SWD_ACK_NONE locks the port out.
+ */
+static uint32_t sim_swd_request(uint32_t req)
+{
+    bool ap = (0u != (req & SIM_SWD_REQ_APNDP));
+    bool read = (0u != (req & SIM_SWD_REQ_RNW));
+    uint32_t a = SIM_SWD_REQ_A(req);
+    bool exempt = (!ap) && ( (read && (a <= 1u)) || ((!read) && (0u == a)) ); /* DPIDR, CTRL/STAT, ABORT. */
+    bool stallable = ap || (read && (3u == a));
+    bool valid = (0u != (req & 1u)) && (0u == (req & (1u << 6u))) && (0u != (req & (1u << 7u)))
+              && (sim_swd_parity((req >> 1u) & 0xFu) == ((req >> 5u) & 1u)); /* start, stop, park, parity. */
+
+    if ( (!valid) || (sim_swd.need_idcode && !((!ap) && read && (0u == a))) )
+    {
+        return SIM_SWD_ACK_NONE;
+    }
+
+    if (stallable && !sim_swd.stalled && (0u != sim_swd.config.wait_every) && (0u != sim_swd.config.wait_count))
+    {
+        if (0u == (++sim_swd.wait_seq % sim_swd.config.wait_every))
+        {
+            sim_swd.stalled = true;
+            sim_swd.wait_left = sim_swd.config.wait_count;
+        }
+    }
+    if ( (!exempt) && (0u != (sim_swd.ctrl_stat & SIM_DP_CTRL_STICKY)) )
+    {
+        return SIM_SWD_ACK_FAULT;
+    }
+    if (stallable && sim_swd.stalled)
+    {
+        if (0u != sim_swd.wait_left)
+        {
+            sim_swd.wait_left--;
+            return SIM_SWD_ACK_WAIT;
+        }
+        sim_swd.stalled = false;
+    }
+    if (ap && (0u != sim_swd.config.fault_every) && (0u == (++sim_swd.fault_seq % sim_swd.config.fault_every)))
+    {
+        sim_swd.ctrl_stat |= SIM_DP_CTRL_STICKYERR;
+        sim_swd.stats.bus_errors++;
+        return SIM_SWD_ACK_FAULT;
+    }
+
+    if (read)
+    {
+        if (ap)
+        {
+            sim_swd.data = sim_swd.rdbuff;
+            sim_swd.rdbuff = sim_swd_ap_read((sim_swd.select & 0xF0u) | (a << 2u));
+            sim_swd.stats.ap_reads++;
+        }
+        else
+        {
+            switch (a)
+            {
+                case 0u: sim_swd.data = sim_swd.config.idcode; sim_swd.need_idcode = false; break;
+                case 1u: sim_swd.data = (0u == (sim_swd.select & 0xFu)) ? sim_swd.ctrl_stat : sim_swd.dlcr; break;
+                case 2u: sim_swd.data = sim_swd.resend; break;
+                default: sim_swd.data = sim_swd.rdbuff; break;
+            }
+            sim_swd.stats.dp_reads++;
+        }
+        sim_swd.resend = sim_swd.data;
+        sim_swd.parity_bad = (0u != sim_swd.config.parity_every)
+                          && (0u == (++sim_swd.parity_seq % sim_swd.config.parity_every));
+        if (sim_swd.parity_bad)
+        {
+            sim_swd.stats.parity_injected++;
+        }
+    }
+    return SIM_SWD_ACK_OK;
+}
+
+/* write data phase done, the write takes effect now. */
+static void sim_swd_write(uint32_t req, uint32_t data)
+{
+    uint32_t a = SIM_SWD_REQ_A(req);
+
+    if (0u != (req & SIM_SWD_REQ_APNDP))
+    {
+        sim_swd_ap_write((sim_swd.select & 0xF0u) | (a << 2u), data);
+        sim_swd.stats.ap_writes++;
+        return;
+    }
+    switch (a)
+    {
+        case 0u:
+            if (0u != (data & SIM_DP_ABORT_DAPABORT))
+            {
+                sim_swd.stalled = false;
+            }
+            if (0u != (data & SIM_DP_ABORT_STKCMPCLR))
+            {
+                sim_swd.ctrl_stat &= ~SIM_DP_CTRL_STICKYCMP;
+            }
+            if (0u != (data & SIM_DP_ABORT_STKERRCLR))
+            {
+                sim_swd.ctrl_stat &= ~SIM_DP_CTRL_STICKYERR;
+            }
+            if (0u != (data & SIM_DP_ABORT_WDERRCLR))
+            {
+                sim_swd.ctrl_stat &= ~SIM_DP_CTRL_WDATAERR;
+            }
+            if (0u != (data & SIM_DP_ABORT_ORUNERRCLR))
+            {
+                sim_swd.ctrl_stat &= ~SIM_DP_CTRL_STICKYORUN;
+            }
+            break;
+        case 1u:
+            if (0u == (sim_swd.select & 0xFu))
+            {
+                sim_swd.ctrl_stat = (sim_swd.ctrl_stat & ~SIM_DP_CTRL_WRITABLE) | (data & SIM_DP_CTRL_WRITABLE);
+                sim_swd.ctrl_stat = (sim_swd.ctrl_stat & ~(SIM_DP_CTRL_REQ_ACKS << 1u))
+                                  | ((sim_swd.ctrl_stat & SIM_DP_CTRL_REQ_ACKS) << 1u);
+            }
+            else if (1u == (sim_swd.select & 0xFu))
+            {
+                sim_swd.dlcr = data & 0x300u; /* TURNROUND. */
+            }
+            break;
+        case 2u:
+            sim_swd.select = data;
+            break;
+        default:
+            break; /* RDBUFF, write ignored. */
+    }
+    sim_swd.stats.dp_writes++;
+}
+
+static void sim_swd_line_reset(void)
+{
+    sim_swd.phase = SIM_SWD_RESET;
+    sim_swd.need_idcode = true;
+    sim_swd.select = 0u;
+    sim_swd.dlcr = 0u;
+    sim_swd.stats.line_resets++;
+}
+
+static sim_swd_edge_hook_t sim_swd_edge_fn = NULL; /* kept across attach and detach. */
+
+static uint8_t sim_swd_bit_kind(uint32_t level, bool host)
+{
+    switch (sim_swd.phase)
+    {
+        case SIM_SWD_IDLE:
+            return (host && (0u != level)) ? SIM_SWD_BIT_REQUEST : SIM_SWD_BIT_IDLE;
+        case SIM_SWD_REQUEST:
+            return SIM_SWD_BIT_REQUEST;
+        case SIM_SWD_TRN_ACK:
+        case SIM_SWD_TRN_WDATA:
+        case SIM_SWD_TRN_END:
+            return SIM_SWD_BIT_TURNAROUND;
+        case SIM_SWD_ACK:
+            return SIM_SWD_BIT_ACK;
+        case SIM_SWD_RDATA:
+        case SIM_SWD_WDATA:
+            return SIM_SWD_BIT_DATA;
+        default:
+            return SIM_SWD_BIT_RESET;
+    }
+}
+
+/* one rising SWCLK edge with the line at level, host when the target was not driving it. */
+static void sim_swd_clock(uint32_t level, bool host)
+{
+    uint32_t trn = ((sim_swd.dlcr >> 8u) & 0x3u) + 1u;
+
+    if (NULL != sim_swd_edge_fn)
+    {
+        sim_swd_edge_fn(sim_now, sim_swd_bit_kind(level, host));
+    }
+
+    if (0u == sim_swd.stats.clocks++)
+    {
+        sim_swd.stats.first_cycle = sim_now;
+    }
+    sim_swd.stats.last_cycle = sim_now;
+    if ( (SIM_SWD_LOCKOUT != sim_swd.phase) && (SIM_SWD_RESET != sim_swd.phase) && (SIM_SWD_IDLE != sim_swd.phase) )
+    {
+        sim_swd.stats.packet_clocks++;
+    }
+
+    sim_swd.ones = (host && (0u != level)) ? (sim_swd.ones + 1u) : 0u;
+    if (sim_swd.ones >= SIM_SWD_RESET_ONES)
+    {
+        if (SIM_SWD_RESET_ONES == sim_swd.ones)
+        {
+            sim_swd_line_reset();
+        }
+        sim_swd_drive(false, 1u);
+        sim_swd.phase = SIM_SWD_RESET;
+        return;
+    }
+
+    switch (sim_swd.phase)
+    {
+        case SIM_SWD_LOCKOUT:
+            break;
+        case SIM_SWD_RESET:
+            if (0u == level)
+            {
+                sim_swd.phase = SIM_SWD_IDLE;
+            }
+            break;
+        case SIM_SWD_IDLE:
+            if (0u != level)
+            {
+                sim_swd.request = 1u;
+                sim_swd.bit = 1u;
+                sim_swd.phase = SIM_SWD_REQUEST;
+                sim_swd.stats.packet_clocks++;
+            }
+            break;
+        case SIM_SWD_REQUEST:
+            sim_swd.request |= level << sim_swd.bit;
+            if (8u == ++sim_swd.bit)
+            {
+                sim_swd.ack = sim_swd_request(sim_swd.request);
+                if (SIM_SWD_ACK_NONE == sim_swd.ack)
+                {
+                    sim_swd.stats.no_ack++;
+                    sim_swd.phase = SIM_SWD_LOCKOUT;
+                    break;
+                }
+                sim_swd.phase = SIM_SWD_TRN_ACK;
+                sim_swd.count = trn;
+            }
+            break;
+        case SIM_SWD_TRN_ACK:
+            if (0u == --sim_swd.count)
+            {
+                sim_swd.phase = SIM_SWD_ACK;
+                sim_swd.bit = 0u;
+                sim_swd_drive(true, sim_swd.ack & 1u);
+            }
+            break;
+        case SIM_SWD_ACK:
+            if (3u > ++sim_swd.bit)
+            {
+                sim_swd_drive(true, (sim_swd.ack >> sim_swd.bit) & 1u);
+                break;
+            }
+            switch (sim_swd.ack)
+            {
+                case SIM_SWD_ACK_OK:    sim_swd.stats.ok++;    break;
+                case SIM_SWD_ACK_WAIT:  sim_swd.stats.wait++;  break;
+                default:                sim_swd.stats.fault++; break;
+            }
+            if ( (SIM_SWD_ACK_OK != sim_swd.ack) && (0u != (sim_swd.ctrl_stat & SIM_DP_CTRL_ORUNDETECT)) )
+            {
+                /* overrun detection: the data phase still happens, its content is ignored. */
+                sim_swd.ctrl_stat |= SIM_DP_CTRL_STICKYORUN;
+                sim_swd.data = 0u;
+                sim_swd.parity_bad = false;
+            }
+            else if (SIM_SWD_ACK_OK != sim_swd.ack)
+            {
+                sim_swd_drive(false, 1u);
+                sim_swd.phase = SIM_SWD_TRN_END;
+                sim_swd.count = trn;
+                break;
+            }
+            sim_swd.bit = 0u;
+            if (0u != (sim_swd.request & SIM_SWD_REQ_RNW))
+            {
+                sim_swd.phase = SIM_SWD_RDATA;
+                sim_swd_drive(true, sim_swd.data & 1u);
+            }
+            else
+            {
+                sim_swd_drive(false, 1u);
+                sim_swd.phase = SIM_SWD_TRN_WDATA;
+                sim_swd.count = trn;
+            }
+            break;
+        case SIM_SWD_RDATA:
+            if (32u > ++sim_swd.bit)
+            {
+                sim_swd_drive(true, (sim_swd.data >> sim_swd.bit) & 1u);
+            }
+            else if (32u == sim_swd.bit)
+            {
+                sim_swd_drive(true, sim_swd_parity(sim_swd.data) ^ (sim_swd.parity_bad ? 1u : 0u));
+            }
+            else
+            {
+                sim_swd_drive(false, 1u);
+                sim_swd.phase = SIM_SWD_TRN_END;
+                sim_swd.count = trn;
+            }
+            break;
+        case SIM_SWD_TRN_WDATA:
+            if (0u == --sim_swd.count)
+            {
+                sim_swd.phase = SIM_SWD_WDATA;
+                sim_swd.bit = 0u;
+                sim_swd.data = 0u;
+            }
+            break;
+        case SIM_SWD_WDATA:
+            if (32u > sim_swd.bit)
+            {
+                sim_swd.data |= level << sim_swd.bit++;
+                break;
+            }
+            sim_swd.phase = SIM_SWD_IDLE;
+            if (SIM_SWD_ACK_OK != sim_swd.ack)
+            {
+                break;
+            }
+            if (level != sim_swd_parity(sim_swd.data))
+            {
+                sim_swd.ctrl_stat |= SIM_DP_CTRL_WDATAERR;
+                sim_swd.stats.wdata_errors++;
+                break;
+            }
+            sim_swd_write(sim_swd.request, sim_swd.data);
+            break;
+        case SIM_SWD_TRN_END:
+            if (0u == --sim_swd.count)
+            {
+                sim_swd.phase = SIM_SWD_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void sim_swd_pins(uint8_t port)
+{
+    uint16_t oe;
+    uint16_t out;
+    bool swclk;
+
+    if ( (!sim_swd.attached) || (SIM_SWD_PORT != port) )
+    {
+        return;
+    }
+    oe = sim_gpio_get_output_enable(SIM_SWD_PORT);
+    out = sim_gpio_get_output(SIM_SWD_PORT);
+    swclk = (0u != (oe & out & SIM_SWD_SWCLK)); /* pulled down on the target while released. */
+    if (swclk && !sim_swd.swclk)
+    {
+        /* the probe wins a clash on SWDIO, released the target pull-up holds it high. */
+        bool host = (0u != (oe & SIM_SWD_SWDIO)) || !sim_swd.driving;
+        uint32_t level = (0u != (oe & SIM_SWD_SWDIO)) ? ((0u != (out & SIM_SWD_SWDIO)) ? 1u : 0u) : sim_swd.level;
+        sim_swd_clock(level, host);
+    }
+    sim_swd.swclk = swclk;
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* api. */
+
+static const sim_swd_config_t sim_swd_default =
+{
+    .idcode       = 0x0BB11477u,        /* cortex-m0 SW-DP. */
+    .ap_idr       = 0x04770021u,        /* cortex-m0 AHB-AP. */
+    .flash_base   = 0x08000000u,
+    .flash_size   = 0x10000u,
+    .ram_base     = 0x20000000u,
+    .ram_size     = 0x2000u,
+};
+
+void sim_swd_attach(const sim_swd_config_t *config)
+{
+    sim_swd_detach();
+    sim_swd.config = (NULL != config) ? *config : sim_swd_default;
+    sim_swd.regions[0] = (sim_swd_region_t){ sim_swd.config.flash_base, sim_swd.config.flash_size, false, NULL };
+    sim_swd.regions[1] = (sim_swd_region_t){ sim_swd.config.ram_base, sim_swd.config.ram_size, true, NULL };
+    sim_swd.regions[2] = (sim_swd_region_t){ SIM_SWD_SCS_BASE, SIM_SWD_SCS_SIZE, true, NULL };
+    for (uint32_t i = 0u; i < (sizeof(sim_swd.regions) / sizeof(sim_swd.regions[0])); i++)
+    {
+        sim_swd.regions[i].mem = (0u != sim_swd.regions[i].size) ? calloc(1u, sim_swd.regions[i].size) : NULL;
+        if ( (0u != sim_swd.regions[i].size) && (NULL == sim_swd.regions[i].mem) )
+        {
+            sim_fatal("out of memory for the swd target");
+        }
+    }
+    if (NULL != sim_swd.regions[0].mem)
+    {
+        memset(sim_swd.regions[0].mem, 0xFF, sim_swd.regions[0].size); /* erased flash. */
+    }
+    *(uint32_t *)(sim_swd.regions[2].mem + 0xD00u) = 0x410CC200u; /* CPUID. */
+
+    sim_swd.phase = SIM_SWD_LOCKOUT;   /* at power up the probe has to line reset first. */
+    sim_swd.need_idcode = true;
+    sim_swd.csw = SIM_AP_CSW_RESET;
+    sim_swd.swclk = (0u != (sim_gpio_get_output_enable(SIM_SWD_PORT) & sim_gpio_get_output(SIM_SWD_PORT) & SIM_SWD_SWCLK));
+    sim_swd.attached = true;
+    sim_swd_drive(false, 1u);
+}
+
+void sim_swd_detach(void)
+{
+    for (uint32_t i = 0u; i < (sizeof(sim_swd.regions) / sizeof(sim_swd.regions[0])); i++)
+    {
+        free(sim_swd.regions[i].mem);
+    }
+    if (sim_swd.attached)
+    {
+        sim_gpio_release_input(SIM_SWD_PORT, SIM_SWD_SWDIO);
+    }
+    memset(&sim_swd, 0, sizeof(sim_swd));
+}
+
+uint8_t *sim_swd_memory(uint32_t addr, uint32_t len)
+{
+    sim_swd_region_t *region = sim_swd_region(addr, len);
+
+    return (NULL != region) ? (region->mem + (addr - region->base)) : NULL;
+}
+
+void sim_swd_stats(sim_swd_stats_t *stats, bool clear)
+{
+    if (NULL != stats)
+    {
+        *stats = sim_swd.stats;
+    }
+    if (clear)
+    {
+        memset(&sim_swd.stats, 0, sizeof(sim_swd.stats));
+    }
+}
+
+void sim_swd_edge_hook(sim_swd_edge_hook_t hook)
+{
+    sim_swd_edge_fn = hook;
+}
+
+/* sim_swd.c - end */
@@ -0,0 +1,677 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* thumb-1 interpreter, see sim_thumb.h. instruction timing follows the cortex-m0 trm with
+ * zero wait state memory: one cycle for data processing, two for loads and stores, 1+N for
+ * multiple transfers, three for a taken branch (four for bl, 4+N for pop with pc). wait
+ * states come on top from the bus: data accesses add theirs to the instruction, a fetch of a
+ * new word stalls the instruction that needs it. a taken branch always refetches.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "sim_thumb.h"
+
+static bool sim_thumb_fault(sim_thumb_t *cpu, uint32_t pc, const char *what)
+{
+    cpu->fault = what;
+    cpu->fault_pc = pc;
+    return false;
+}
+
+/* instruction halfword at addr, fetching its word when the core does not hold it. */
+static bool sim_thumb_fetch(sim_thumb_t *cpu, uint32_t addr, uint16_t *hw)
+{
+    uint32_t word_addr = addr & ~3u;
+
+    if ( !cpu->fetched || (word_addr != cpu->fetch_addr) )
+    {
+        uint32_t wait = 0u;
+        if (!cpu->bus->fetch(cpu->ctx, word_addr, cpu->cycles, &cpu->fetch_word, &wait))
+        {
+            return sim_thumb_fault(cpu, addr, "instruction fetch bus error");
+        }
+        cpu->cycles += wait;
+        cpu->fetch_addr = word_addr;
+        cpu->fetched = true;
+    }
+    *hw = (uint16_t)((0u != (addr & 2u)) ? (cpu->fetch_word >> 16u) : cpu->fetch_word);
+    return true;
+}
+
+/* data accesses happen in the second cycle of the instruction, plus index for multiples. */
+static bool sim_thumb_load(sim_thumb_t *cpu, uint32_t addr, uint32_t size, uint32_t index, uint32_t *val)
+{
+    uint32_t wait = 0u;
+
+    if (0u != (addr & (size - 1u)))
+    {
+        return sim_thumb_fault(cpu, cpu->r[15], "unaligned load");
+    }
+    if (!cpu->bus->read(cpu->ctx, addr, size, cpu->cycles + 1u + index, val, &wait))
+    {
+        return sim_thumb_fault(cpu, cpu->r[15], "load bus error");
+    }
+    cpu->cycles += wait;
+    return true;
+}
+
+static bool sim_thumb_store(sim_thumb_t *cpu, uint32_t addr, uint32_t size, uint32_t index, uint32_t val)
+{
+    uint32_t wait = 0u;
+
+    if (0u != (addr & (size - 1u)))
+    {
+        return sim_thumb_fault(cpu, cpu->r[15], "unaligned store");
+    }
+    if (!cpu->bus->write(cpu->ctx, addr, size, val, cpu->cycles + 1u + index, &wait))
+    {
+        return sim_thumb_fault(cpu, cpu->r[15], "store bus error");
+    }
+    cpu->cycles += wait;
+    return true;
+}
+
+static void sim_thumb_nz(sim_thumb_t *cpu, uint32_t r)
+{
+    cpu->n = (0u != (r >> 31u));
+    cpu->z = (0u == r);
+}
+
+static uint32_t sim_thumb_add(sim_thumb_t *cpu, uint32_t a, uint32_t b, uint32_t carry)
+{
+    uint64_t sum = (uint64_t)a + b + carry;
+    uint32_t r = (uint32_t)sum;
+
+    sim_thumb_nz(cpu, r);
+    cpu->c = (0u != (sum >> 32u));
+    cpu->v = (0u != (((a ^ r) & (b ^ r)) >> 31u));
+    return r;
+}
+
+typedef enum
+{
+    SIM_THUMB_LSL,
+    SIM_THUMB_LSR,
+    SIM_THUMB_ASR,
+    SIM_THUMB_ROR,
+} sim_thumb_shift_t;
+
+/* register controlled shift, amount from the bottom byte, flags set. */
+static uint32_t sim_thumb_shift(sim_thumb_t *cpu, sim_thumb_shift_t type, uint32_t a, uint32_t amount)
+{
+    uint32_t r = a;
+
+    amount &= 0xFFu;
+    if (0u != amount)
+    {
+        switch (type)
+        {
+            case SIM_THUMB_LSL:
+                cpu->c = (amount <= 32u) && (0u != ((a >> (32u - amount)) & 1u));
+                r = (amount < 32u) ? (a << amount) : 0u;
+                break;
+            case SIM_THUMB_LSR:
+                cpu->c = (amount <= 32u) && (0u != ((a >> (amount - 1u)) & 1u));
+                r = (amount < 32u) ? (a >> amount) : 0u;
+                break;
+            case SIM_THUMB_ASR:
+                amount = (amount > 32u) ? 32u : amount;
+                cpu->c = (0u != (((uint32_t)((int32_t)a >> (amount - 1u))) & 1u));
+                r = (amount < 32u) ? (uint32_t)((int32_t)a >> amount) : (uint32_t)((int32_t)a >> 31);
+                break;
+            default:
+                amount &= 31u;
+                r = (0u == amount) ? a : ((a >> amount) | (a << (32u - amount)));
+                cpu->c = (0u != (r >> 31u));
+                break;
+        }
+    }
+    sim_thumb_nz(cpu, r);
+    return r;
+}
+
+static bool sim_thumb_condition(const sim_thumb_t *cpu, uint32_t cond)
+{
+    switch (cond)
+    {
+        case 0x0u: return cpu->z;
+        case 0x1u: return !cpu->z;
+        case 0x2u: return cpu->c;
+        case 0x3u: return !cpu->c;
+        case 0x4u: return cpu->n;
+        case 0x5u: return !cpu->n;
+        case 0x6u: return cpu->v;
+        case 0x7u: return !cpu->v;
+        case 0x8u: return cpu->c && !cpu->z;
+        case 0x9u: return !cpu->c || cpu->z;
+        case 0xAu: return (cpu->n == cpu->v);
+        case 0xBu: return (cpu->n != cpu->v);
+        case 0xCu: return !cpu->z && (cpu->n == cpu->v);
+        case 0xDu: return cpu->z || (cpu->n != cpu->v);
+        default:   return true;
+    }
+}
+
+static void sim_thumb_branch(sim_thumb_t *cpu, uint32_t target)
+{
+    cpu->r[15] = target & ~1u;
+    cpu->fetched = false; /* the pipeline refills from the target. */
+}
+
+/* the four data processing formats with low registers. */
+static bool sim_thumb_alu(sim_thumb_t *cpu, uint16_t op, uint32_t *cycles)
+{
+    uint32_t rd = op & 7u;
+    uint32_t rm = (op >> 3u) & 7u;
+    uint32_t a = cpu->r[rd];
+    uint32_t b = cpu->r[rm];
+
+    switch ((op >> 6u) & 0xFu)
+    {
+        case 0x0u: cpu->r[rd] = a & b; sim_thumb_nz(cpu, cpu->r[rd]); break;                        /* ANDS */
+        case 0x1u: cpu->r[rd] = a ^ b; sim_thumb_nz(cpu, cpu->r[rd]); break;                        /* EORS */
+        case 0x2u: cpu->r[rd] = sim_thumb_shift(cpu, SIM_THUMB_LSL, a, b); break;                  /* LSLS */
+        case 0x3u: cpu->r[rd] = sim_thumb_shift(cpu, SIM_THUMB_LSR, a, b); break;                  /* LSRS */
+        case 0x4u: cpu->r[rd] = sim_thumb_shift(cpu, SIM_THUMB_ASR, a, b); break;                  /* ASRS */
+        case 0x5u: cpu->r[rd] = sim_thumb_add(cpu, a, b, cpu->c ? 1u : 0u); break;                 /* ADCS */
+        case 0x6u: cpu->r[rd] = sim_thumb_add(cpu, a, ~b, cpu->c ? 1u : 0u); break;                /* SBCS */
+        case 0x7u: cpu->r[rd] = sim_thumb_shift(cpu, SIM_THUMB_ROR, a, b); break;                  /* RORS */
+        case 0x8u: sim_thumb_nz(cpu, a & b); break;                                                 /* TST */
+        case 0x9u: cpu->r[rd] = sim_thumb_add(cpu, ~b, 0u, 1u); break;                             /* RSBS #0 */
+        case 0xAu: (void)sim_thumb_add(cpu, a, ~b, 1u); break;                                      /* CMP */
+        case 0xBu: (void)sim_thumb_add(cpu, a, b, 0u); break;                                       /* CMN */
+        case 0xCu: cpu->r[rd] = a | b; sim_thumb_nz(cpu, cpu->r[rd]); break;                        /* ORRS */
+        case 0xDu: cpu->r[rd] = a * b; sim_thumb_nz(cpu, cpu->r[rd]); *cycles = cpu->mul_cycles; break; /* MULS */
+        case 0xEu: cpu->r[rd] = a & ~b; sim_thumb_nz(cpu, cpu->r[rd]); break;                       /* BICS */
+        default:   cpu->r[rd] = ~b; sim_thumb_nz(cpu, cpu->r[rd]); break;                           /* MVNS */
+    }
+    return true;
+}
+
+/* high register operations and branch exchange. pc reads as the instruction plus four. */
+static bool sim_thumb_special(sim_thumb_t *cpu, uint16_t op, uint32_t pc, uint32_t *cycles)
+{
+    uint32_t rd = (op & 7u) | ((op >> 4u) & 8u);
+    uint32_t rm = (op >> 3u) & 0xFu;
+    uint32_t b = (15u == rm) ? (pc + 4u) : cpu->r[rm];
+    uint32_t a = (15u == rd) ? (pc + 4u) : cpu->r[rd];
+
+    switch ((op >> 8u) & 3u)
+    {
+        case 0u: /* ADD */
+        case 2u: /* MOV */
+        {
+            uint32_t r = (0u == ((op >> 8u) & 3u)) ? (a + b) : b;
+            if (15u == rd)
+            {
+                sim_thumb_branch(cpu, r);
+                *cycles = 3u;
+            }
+            else
+            {
+                cpu->r[rd] = (13u == rd) ? (r & ~3u) : r;
+            }
+            return true;
+        }
+        case 1u: /* CMP */
+            (void)sim_thumb_add(cpu, a, ~b, 1u);
+            return true;
+        default: /* BX, BLX */
+            if (0u == (b & 1u))
+            {
+                return sim_thumb_fault(cpu, pc, "interworking branch to arm state");
+            }
+            if (0u != (op & 0x80u))
+            {
+                cpu->r[14] = (pc + 2u) | 1u;
+            }
+            sim_thumb_branch(cpu, b);
+            *cycles = 3u;
+            return true;
+    }
+}
+
+/* load and store with register offset, immediate offset and sp relative. */
+static bool sim_thumb_ldst(sim_thumb_t *cpu, uint16_t op)
+{
+    uint32_t rt = op & 7u;
+    uint32_t rn = (op >> 3u) & 7u;
+    uint32_t addr;
+    uint32_t size;
+    bool load;
+    bool sign = false;
+    uint32_t val;
+
+    switch (op >> 12u)
+    {
+        case 0x5u: /* register offset. */
+        {
+            static const uint8_t sizes[8] = { 4u, 2u, 1u, 1u, 4u, 2u, 1u, 2u };
+            uint32_t kind = (op >> 9u) & 7u;
+            addr = cpu->r[rn] + cpu->r[(op >> 6u) & 7u];
+            size = sizes[kind];
+            load = (kind >= 3u);
+            sign = (3u == kind) || (7u == kind);
+            break;
+        }
+        case 0x6u: /* word, immediate. */
+            addr = cpu->r[rn] + (((op >> 6u) & 0x1Fu) << 2u);
+            size = 4u;
+            load = (0u != (op & 0x800u));
+            break;
+        case 0x7u: /* byte, immediate. */
+            addr = cpu->r[rn] + ((op >> 6u) & 0x1Fu);
+            size = 1u;
+            load = (0u != (op & 0x800u));
+            break;
+        case 0x8u: /* halfword, immediate. */
+            addr = cpu->r[rn] + (((op >> 6u) & 0x1Fu) << 1u);
+            size = 2u;
+            load = (0u != (op & 0x800u));
+            break;
+        default: /* sp relative. */
+            rt = (op >> 8u) & 7u;
+            addr = cpu->r[13] + ((op & 0xFFu) << 2u);
+            size = 4u;
+            load = (0u != (op & 0x800u));
+            break;
+    }
+    if (!load)
+    {
+        return sim_thumb_store(cpu, addr, size, 0u, cpu->r[rt]);
+    }
+    if (!sim_thumb_load(cpu, addr, size, 0u, &val))
+    {
+        return false;
+    }
+    if (sign)
+    {
+        val = (1u == size) ? (uint32_t)(int32_t)(int8_t)val : (uint32_t)(int32_t)(int16_t)val;
+    }
+    cpu->r[rt] = val;
+    return true;
+}
+
+/* 1011 xxxx: sp adjust, extends, push and pop, cps, reverses, hints. */
+static bool sim_thumb_misc(sim_thumb_t *cpu, uint16_t op, uint32_t pc, uint32_t *cycles)
+{
+    uint32_t rd = op & 7u;
+    uint32_t rm = (op >> 3u) & 7u;
+
+    if (0xB000u == (op & 0xFF00u)) /* ADD / SUB sp, #imm */
+    {
+        uint32_t imm = (op & 0x7Fu) << 2u;
+        cpu->r[13] = (0u != (op & 0x80u)) ? (cpu->r[13] - imm) : (cpu->r[13] + imm);
+        return true;
+    }
+    if (0xB200u == (op & 0xFF00u))
+    {
+        switch ((op >> 6u) & 3u)
+        {
+            case 0u:  cpu->r[rd] = (uint32_t)(int32_t)(int16_t)cpu->r[rm]; break;
+            case 1u:  cpu->r[rd] = (uint32_t)(int32_t)(int8_t)cpu->r[rm]; break;
+            case 2u:  cpu->r[rd] = cpu->r[rm] & 0xFFFFu; break;
+            default:  cpu->r[rd] = cpu->r[rm] & 0xFFu; break;
+        }
+        return true;
+    }
+    if (0xB400u == (op & 0xFE00u)) /* PUSH */
+    {
+        uint32_t list = (op & 0xFFu) | ((0u != (op & 0x100u)) ? 0x4000u : 0u);
+        uint32_t count = (uint32_t)__builtin_popcount(list);
+        uint32_t addr = cpu->r[13] - (4u * count);
+        uint32_t index = 0u;
+        for (uint32_t i = 0u; i < 15u; i++)
+        {
+            if ( (0u != (list & (1u << i))) && !sim_thumb_store(cpu, addr + (4u * index), 4u, index, cpu->r[i]) )
+            {
+                return false;
+            }
+            index += (list >> i) & 1u;
+        }
+        cpu->r[13] = addr;
+        *cycles = 1u + count;
+        return true;
+    }
+    if (0xBC00u == (op & 0xFE00u)) /* POP */
+    {
+        uint32_t list = op & 0xFFu;
+        uint32_t count = (uint32_t)__builtin_popcount(list);
+        uint32_t addr = cpu->r[13];
+        uint32_t val;
+        for (uint32_t i = 0u; i < 8u; i++)
+        {
+            if (0u != (list & (1u << i)))
+            {
+                if (!sim_thumb_load(cpu, addr, 4u, i, &val))
+                {
+                    return false;
+                }
+                cpu->r[i] = val;
+                addr += 4u;
+            }
+        }
+        *cycles = 1u + count;
+        if (0u != (op & 0x100u))
+        {
+            if (!sim_thumb_load(cpu, addr, 4u, count, &val))
+            {
+                return false;
+            }
+            if (0u == (val & 1u))
+            {
+                return sim_thumb_fault(cpu, pc, "pop to arm state");
+            }
+            addr += 4u;
+            sim_thumb_branch(cpu, val);
+            *cycles = 4u + count;
+        }
+        cpu->r[13] = addr;
+        return true;
+    }
+    if (0xB660u == (op & 0xFFEFu)) /* CPSIE / CPSID i */
+    {
+        cpu->primask = (op >> 4u) & 1u;
+        return true;
+    }
+    if (0xBA00u == (op & 0xFF00u))
+    {
+        uint32_t v = cpu->r[rm];
+        switch ((op >> 6u) & 3u)
+        {
+            case 0u:  cpu->r[rd] = __builtin_bswap32(v); return true;
+            case 1u:  cpu->r[rd] = ((v & 0x00FF00FFu) << 8u) | ((v >> 8u) & 0x00FF00FFu); return true;
+            case 3u:  cpu->r[rd] = (uint32_t)(int32_t)(int16_t)(((v & 0xFFu) << 8u) | ((v >> 8u) & 0xFFu)); return true;
+            default:  break;
+        }
+    }
+    if (0xBE00u == (op & 0xFF00u))
+    {
+        return sim_thumb_fault(cpu, pc, "bkpt");
+    }
+    if (0xBF00u == (op & 0xFF0Fu))
+    {
+        if ( (0x20u == (op & 0xF0u)) || (0x30u == (op & 0xF0u)) )
+        {
+            return sim_thumb_fault(cpu, pc, "wfe / wfi, nothing would wake the core");
+        }
+        return true; /* NOP, YIELD, SEV */
+    }
+    return sim_thumb_fault(cpu, pc, "undefined instruction");
+}
+
+/* the 32 bit encodings: BL, MSR, MRS and the barriers. */
+static bool sim_thumb_wide(sim_thumb_t *cpu, uint16_t op, uint32_t pc, uint32_t *cycles)
+{
+    uint16_t op2;
+
+    if (!sim_thumb_fetch(cpu, pc + 2u, &op2))
+    {
+        return false;
+    }
+    if ( (0xF000u == (op & 0xF800u)) && (0xD000u == (op2 & 0xD000u)) ) /* BL */
+    {
+        uint32_t s = (op >> 10u) & 1u;
+        uint32_t i1 = 1u ^ ((op2 >> 13u) & 1u) ^ s;
+        uint32_t i2 = 1u ^ ((op2 >> 11u) & 1u) ^ s;
+        uint32_t imm = (s << 24u) | (i1 << 23u) | (i2 << 22u) | ((op & 0x3FFu) << 12u) | ((op2 & 0x7FFu) << 1u);
+        imm = (0u != s) ? (imm | 0xFE000000u) : imm;
+        cpu->r[14] = (pc + 4u) | 1u;
+        sim_thumb_branch(cpu, pc + 4u + imm);
+        *cycles = 4u;
+        return true;
+    }
+    if ( (0xF380u == (op & 0xFFF0u)) && (0x8800u == (op2 & 0xFF00u)) ) /* MSR */
+    {
+        uint32_t sysm = op2 & 0xFFu;
+        if (16u == sysm)
+        {
+            cpu->primask = cpu->r[op & 0xFu] & 1u;
+        }
+        else if (8u == sysm)
+        {
+            cpu->r[13] = cpu->r[op & 0xFu] & ~3u; /* msp, there is only one stack here. */
+        }
+        cpu->r[15] = pc + 4u;
+        *cycles = 3u;
+        return true;
+    }
+    if ( (0xF3EFu == op) && (0x8000u == (op2 & 0xF000u)) ) /* MRS */
+    {
+        uint32_t sysm = op2 & 0xFFu;
+        uint32_t val = 0u;
+        if (16u == sysm)
+        {
+            val = cpu->primask;
+        }
+        else if ( (8u == sysm) || (9u == sysm) )
+        {
+            val = cpu->r[13];
+        }
+        else if (sysm <= 7u)
+        {
+            val = ((cpu->n ? 1u : 0u) << 31u) | ((cpu->z ? 1u : 0u) << 30u) | ((cpu->c ? 1u : 0u) << 29u) | ((cpu->v ? 1u : 0u) << 28u);
+        }
+        cpu->r[(op2 >> 8u) & 0xFu] = val;
+        cpu->r[15] = pc + 4u;
+        *cycles = 3u;
+        return true;
+    }
+    if ( (0xF3BFu == op) && (0x8F00u == (op2 & 0xFF00u)) ) /* DSB, DMB, ISB */
+    {
+        cpu->r[15] = pc + 4u;
+        *cycles = 3u;
+        return true;
+    }
+    return sim_thumb_fault(cpu, pc, "undefined 32 bit instruction");
+}
+
+void sim_thumb_init(sim_thumb_t *cpu, const sim_thumb_bus_t *bus, void *ctx)
+{
+    memset(cpu, 0, sizeof(*cpu));
+    cpu->bus = bus;
+    cpu->ctx = ctx;
+    cpu->mul_cycles = 1u;
+}
+
+bool sim_thumb_step(sim_thumb_t *cpu)
+{
+    uint32_t pc = cpu->r[15];
+    uint32_t cycles = 1u;
+    uint16_t op;
+    bool ok = true;
+
+    if (NULL != cpu->fault)
+    {
+        return false;
+    }
+    if (!sim_thumb_fetch(cpu, pc, &op))
+    {
+        return false;
+    }
+    cpu->r[15] = pc + 2u;
+
+    switch (op >> 11u)
+    {
+        case 0x00u: /* LSLS imm */
+        {
+            uint32_t imm = (op >> 6u) & 0x1Fu;
+            uint32_t a = cpu->r[(op >> 3u) & 7u];
+            if (0u != imm)
+            {
+                cpu->c = (0u != ((a >> (32u - imm)) & 1u));
+            }
+            cpu->r[op & 7u] = a << imm;
+            sim_thumb_nz(cpu, cpu->r[op & 7u]);
+            break;
+        }
+        case 0x01u: /* LSRS imm, 0 means 32 */
+        case 0x02u: /* ASRS imm */
+        {
+            uint32_t imm = (op >> 6u) & 0x1Fu;
+            cpu->r[op & 7u] = sim_thumb_shift(cpu, (0x01u == (op >> 11u)) ? SIM_THUMB_LSR : SIM_THUMB_ASR,
+                                              cpu->r[(op >> 3u) & 7u], (0u != imm) ? imm : 32u);
+            break;
+        }
+        case 0x03u: /* ADDS / SUBS register or imm3 */
+        {
+            uint32_t a = cpu->r[(op >> 3u) & 7u];
+            uint32_t b = (0u != (op & 0x400u)) ? ((op >> 6u) & 7u) : cpu->r[(op >> 6u) & 7u];
+            cpu->r[op & 7u] = (0u != (op & 0x200u)) ? sim_thumb_add(cpu, a, ~b, 1u) : sim_thumb_add(cpu, a, b, 0u);
+            break;
+        }
+        case 0x04u: /* MOVS imm8 */
+            cpu->r[(op >> 8u) & 7u] = op & 0xFFu;
+            sim_thumb_nz(cpu, op & 0xFFu);
+            break;
+        case 0x05u: /* CMP imm8 */
+            (void)sim_thumb_add(cpu, cpu->r[(op >> 8u) & 7u], ~(uint32_t)(op & 0xFFu), 1u);
+            break;
+        case 0x06u: /* ADDS imm8 */
+            cpu->r[(op >> 8u) & 7u] = sim_thumb_add(cpu, cpu->r[(op >> 8u) & 7u], op & 0xFFu, 0u);
+            break;
+        case 0x07u: /* SUBS imm8 */
+            cpu->r[(op >> 8u) & 7u] = sim_thumb_add(cpu, cpu->r[(op >> 8u) & 7u], ~(uint32_t)(op & 0xFFu), 1u);
+            break;
+        case 0x08u:
+            ok = (0u == (op & 0x400u)) ? sim_thumb_alu(cpu, op, &cycles) : sim_thumb_special(cpu, op, pc, &cycles);
+            break;
+        case 0x09u: /* LDR literal */
+        {
+            uint32_t val;
+            ok = sim_thumb_load(cpu, ((pc + 4u) & ~3u) + ((op & 0xFFu) << 2u), 4u, 0u, &val);
+            cpu->r[(op >> 8u) & 7u] = ok ? val : cpu->r[(op >> 8u) & 7u];
+            cycles = 2u;
+            break;
+        }
+        case 0x0Au: case 0x0Bu: case 0x0Cu: case 0x0Du: case 0x0Eu: case 0x0Fu:
+        case 0x10u: case 0x11u: case 0x12u: case 0x13u:
+            ok = sim_thumb_ldst(cpu, op);
+            cycles = 2u;
+            break;
+        case 0x14u: /* ADR */
+            cpu->r[(op >> 8u) & 7u] = ((pc + 4u) & ~3u) + ((op & 0xFFu) << 2u);
+            break;
+        case 0x15u: /* ADD rd, sp, imm */
+            cpu->r[(op >> 8u) & 7u] = cpu->r[13] + ((op & 0xFFu) << 2u);
+            break;
+        case 0x16u: case 0x17u:
+            ok = sim_thumb_misc(cpu, op, pc, &cycles);
+            break;
+        case 0x18u: /* STM rn!, {list} */
+        case 0x19u: /* LDM rn{!}, {list} */
+        {
+            uint32_t rn = (op >> 8u) & 7u;
+            uint32_t list = op & 0xFFu;
+            uint32_t addr = cpu->r[rn];
+            uint32_t index = 0u;
+            bool load = (0x19u == (op >> 11u));
+            for (uint32_t i = 0u; ok && (i < 8u); i++)
+            {
+                if (0u != (list & (1u << i)))
+                {
+                    uint32_t val;
+                    ok = load ? sim_thumb_load(cpu, addr, 4u, index, &val) : sim_thumb_store(cpu, addr, 4u, index, cpu->r[i]);
+                    if (ok && load)
+                    {
+                        cpu->r[i] = val;
+                    }
+                    addr += 4u;
+                    index++;
+                }
+            }
+            if ( ok && (!load || (0u == (list & (1u << rn)))) )
+            {
+                cpu->r[rn] = addr;
+            }
+            cycles = 1u + index;
+            break;
+        }
+        case 0x1Au: case 0x1Bu: /* B cond, UDF, SVC */
+        {
+            uint32_t cond = (op >> 8u) & 0xFu;
+            if (cond >= 0xEu)
+            {
+                ok = sim_thumb_fault(cpu, pc, (0xFu == cond) ? "svc" : "udf");
+            }
+            else if (sim_thumb_condition(cpu, cond))
+            {
+                sim_thumb_branch(cpu, pc + 4u + (uint32_t)((int32_t)(int8_t)(op & 0xFFu) * 2));
+                cycles = 3u;
+            }
+            break;
+        }
+        case 0x1Cu: /* B */
+        {
+            int32_t imm = (int32_t)((uint32_t)(op & 0x7FFu) << 21u) >> 20;
+            sim_thumb_branch(cpu, pc + 4u + (uint32_t)imm);
+            cycles = 3u;
+            break;
+        }
+        case 0x1Eu: case 0x1Fu: case 0x1Du:
+            ok = sim_thumb_wide(cpu, op, pc, &cycles);
+            break;
+        default:
+            ok = sim_thumb_fault(cpu, pc, "undefined instruction");
+            break;
+    }
+    if (!ok)
+    {
+        cpu->r[15] = pc;
+        return false;
+    }
+    cpu->cycles += cycles;
+    cpu->instructions++;
+    return true;
+}
+
+bool sim_thumb_call(sim_thumb_t *cpu, uint32_t fn, const uint32_t *args, uint32_t count, uint64_t max_cycles)
+{
+    uint64_t end = cpu->cycles + max_cycles;
+
+    for (uint32_t i = 0u; i < 4u; i++)
+    {
+        cpu->r[i] = (i < count) ? args[i] : 0u;
+    }
+    cpu->r[14] = SIM_THUMB_RETURN;
+    cpu->fault = NULL;
+    sim_thumb_branch(cpu, fn);
+    while (cpu->r[15] != (SIM_THUMB_RETURN & ~1u))
+    {
+        if (cpu->cycles >= end)
+        {
+            return sim_thumb_fault(cpu, cpu->r[15], "cycle limit reached");
+        }
+        if (!sim_thumb_step(cpu))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* sim_thumb.c - end */
@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* armv6-m (thumb-1) interpreter with cortex-m0 instruction timing, for tools that time
+ * compiled firmware code on the host. the memory system is the caller's: every 32 bit
+ * instruction fetch and every data access goes through a sim_thumb_bus_t that answers with
+ * the wait states it cost. no exceptions are modelled, svc, bkpt, udf, faults and wfi stop
+ * the core.
+ */
+
+#ifndef SIM_THUMB_H
+#define SIM_THUMB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SIM_THUMB_RETURN        0xFFFFFFF1u /* lr of sim_thumb_call(), a return there ends the call. */
+
+/* accesses at the given core cycle, false for a bus error. fetches are word aligned. */
+typedef struct
+{
+    bool (*fetch)(void *ctx, uint32_t addr, uint64_t cycle, uint32_t *word, uint32_t *wait);
+    bool (*read)(void *ctx, uint32_t addr, uint32_t size, uint64_t cycle, uint32_t *val, uint32_t *wait);
+    bool (*write)(void *ctx, uint32_t addr, uint32_t size, uint32_t val, uint64_t cycle, uint32_t *wait);
+} sim_thumb_bus_t;
+
+typedef struct
+{
+    uint32_t r[16];                     /* r15 holds the address of the next instruction. */
+    bool     n;
+    bool     z;
+    bool     c;
+    bool     v;
+    uint32_t primask;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint32_t mul_cycles;                /* 1 for the fast multiplier, 32 for the small one. */
+    const char *fault;                  /* why the core stopped, NULL while it runs. */
+    uint32_t fault_pc;
+
+    const sim_thumb_bus_t *bus;
+    void    *ctx;
+    bool     fetched;                   /* the fetch word below is valid. */
+    uint32_t fetch_addr;
+    uint32_t fetch_word;
+} sim_thumb_t;
+
+void sim_thumb_init(sim_thumb_t *cpu, const sim_thumb_bus_t *bus, void *ctx);
+bool sim_thumb_step(sim_thumb_t *cpu);
+/* call fn (thumb bit set) with up to four arguments on the current sp, r0 holds the result. */
+bool sim_thumb_call(sim_thumb_t *cpu, uint32_t fn, const uint32_t *args, uint32_t count, uint64_t max_cycles);
+
+#endif /* SIM_THUMB_H */
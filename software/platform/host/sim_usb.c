@@ -0,0 +1,701 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* usb full speed device controller (the bdt based sie of the MM32) and the host on the far end
+ * of the bus. the host runs 1ms frames and spends each frame's bus time on transactions:
+ * interrupt pipes when their interval is due, then control and bulk round robin. every
+ * token is answered from the buffer descriptors the firmware owns, completions go through
+ * the four entry FSSTAT fifo and TOKDNE exactly like on the chip.
+ */
+
+#include <stddef.h>
+#include <string.h>
+
+#include "hal_device_registers.h"
+#include "hal_usb_bdt.h"
+#include "sim.h"
+#include "sim_model.h"
+
+#define SIM_USB_EP_COUNT        USB_BDT_EP_NUM
+#define SIM_USB_STAT_DEPTH      4u
+#define SIM_USB_BYTE_CYCLES     (SIM_CPU_FREQ / 1500000u) /* 12Mbit/s. */
+#define SIM_USB_FRAME_CYCLES    (SIM_CPU_FREQ / 1000u)
+#define SIM_USB_FRAME_BYTES     1500u   /* bus time of one frame, in bytes at 12Mbit/s. */
+#define SIM_USB_SOF_BYTES       6u
+#define SIM_USB_DATA_OVERHEAD   13u     /* token, data and handshake packets around a payload. */
+#define SIM_USB_SHORT_BYTES     8u      /* token and handshake or timeout, no data. */
+#define SIM_USB_RESET_FRAMES    10u
+#define SIM_USB_ERROR_LIMIT     3u      /* timeouts before a transfer fails. */
+
+#define SIM_USB_PID_OUT         0x1u
+#define SIM_USB_PID_IN          0x9u
+#define SIM_USB_PID_SETUP       0xDu
+
+typedef enum
+{
+    SIM_USB_ACK,
+    SIM_USB_NAK,
+    SIM_USB_STALLED,
+    SIM_USB_TIMEOUT,
+} sim_usb_handshake_t;
+
+typedef enum
+{
+    SIM_USB_CTRL_IDLE,
+    SIM_USB_CTRL_SETUP,
+    SIM_USB_CTRL_DATA,
+    SIM_USB_CTRL_STATUS,
+} sim_usb_ctrl_stage_t;
+
+/* a host pipe, one per endpoint and direction. */
+typedef struct
+{
+    uint8_t        type;                /* bmAttributes transfer type, 0 control. */
+    uint16_t       max_packet;
+    uint8_t        interval;
+    bool           toggle;              /* DATA1 next. */
+    bool           busy;
+    uint32_t       frame;               /* last periodic attempt, in sofs. */
+    uint8_t       *data;
+    uint32_t       len;
+    uint32_t       done;
+    uint32_t       errors;
+    sim_usb_done_t fn;
+    void          *ctx;
+} sim_usb_pipe_t;
+
+static struct
+{
+    /* device side. */
+    USB_BufDespTable_Type *bdt;
+    bool           odd[SIM_USB_EP_COUNT][2];
+    uint32_t       stat[SIM_USB_STAT_DEPTH];
+    uint32_t       stat_count;
+
+    /* host side. */
+    bool           plugged;
+    bool           running;             /* past the bus reset. */
+    uint64_t       next;
+    uint64_t       frame_end;
+    uint32_t       frame;
+    uint32_t       sofs;                /* frames since connect, for the periodic schedule. */
+    uint32_t       frame_bytes;
+    uint32_t       frame_packets;
+    uint8_t        addr;
+    uint8_t        rr;                  /* bulk round robin position. */
+    sim_usb_pipe_t pipes[SIM_USB_EP_COUNT][2];
+
+    sim_usb_ctrl_stage_t ctrl_stage;
+    uint8_t        setup[8];
+    uint8_t       *ctrl_data;
+    sim_usb_done_t ctrl_fn;
+    void          *ctrl_ctx;
+
+    sim_usb_stats_t stats;
+} sim_usb;
+
+static USB_Type *sim_usb_regs(void)
+{
+    return SIM_VIEW(USB);
+}
+
+void sim_usb_reset(void)
+{
+    memset(sim_usb_regs(), 0, sizeof(USB_Type));
+    memset(sim_usb.odd, 0, sizeof(sim_usb.odd));
+    sim_usb.stat_count = 0u;
+    sim_usb.bdt = NULL;
+}
+
+bool sim_usb_irq(void)
+{
+    return 0u != (sim_usb_regs()->FSINTSTAT & sim_usb_regs()->FSINTENB);
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* registers. */
+
+static void sim_usb_stat_update(void)
+{
+    USB_Type *usb = sim_usb_regs();
+
+    if (0u != sim_usb.stat_count)
+    {
+        usb->FSSTAT = sim_usb.stat[0];
+        usb->FSINTSTAT |= USB_FSINTSTAT_TOKDNE_MASK;
+    }
+    else
+    {
+        usb->FSINTSTAT &= ~USB_FSINTSTAT_TOKDNE_MASK;
+    }
+}
+
+void sim_usb_write(uint32_t addr, uint32_t old)
+{
+    USB_Type *usb = sim_usb_regs();
+    uint32_t val = SIM_REG(addr);
+
+    switch (addr - USB_FS_BASE)
+    {
+        case offsetof(USB_Type, FSINTSTAT):
+            usb->FSINTSTAT = old & ~val;
+            if (0u != (val & old & USB_FSINTSTAT_TOKDNE_MASK))
+            {
+                /* clearing TOKDNE retires the head of the status fifo. */
+                sim_usb.stat_count--;
+                memmove(&sim_usb.stat[0], &sim_usb.stat[1], sim_usb.stat_count * sizeof(sim_usb.stat[0]));
+                sim_usb_stat_update();
+            }
+            break;
+        case offsetof(USB_Type, FSERRSTAT):
+            usb->FSERRSTAT = old & ~val;
+            break;
+        case offsetof(USB_Type, FSSTAT):
+        case offsetof(USB_Type, FSFRMNUML):
+        case offsetof(USB_Type, FSFRMNUMH):
+            SIM_REG(addr) = old; /* read only. */
+            break;
+        case offsetof(USB_Type, FSCTL):
+            if (0u != (val & USB_FSCTL_ODDRST_MASK))
+            {
+                memset(sim_usb.odd, 0, sizeof(sim_usb.odd));
+            }
+            break;
+        case offsetof(USB_Type, FSBDTPAGE1):
+        case offsetof(USB_Type, FSBDTPAGE2):
+        case offsetof(USB_Type, FSBDTPAGE3):
+            sim_usb.bdt = (USB_BufDespTable_Type *)(uintptr_t)
+                ( ((usb->FSBDTPAGE1 >> USB_FSBDTPAGE1_BDTBA_SHIFT) << 9u)
+                | ((usb->FSBDTPAGE2 >> USB_FSBDTPAGE2_BDTBA_SHIFT) << 16u)
+                | ((usb->FSBDTPAGE3 >> USB_FSBDTPAGE3_BDTBA_SHIFT) << 24u) );
+            break;
+        default:
+            break;
+    }
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* device side of one transaction. the bdt and the packet buffers are plain firmware memory. */
+
+/* answer one token. toggle is the DATA0/1 the host sends or expects, *dropped tells the host
+ * an IN packet came with the other one and is thrown away as a retransmission.
+ */
+static sim_usb_handshake_t sim_usb_token(uint8_t pid, uint8_t ep, bool toggle, uint8_t *data, uint32_t *len, bool *dropped)
+{
+    USB_Type *usb = sim_usb_regs();
+    bool in = (SIM_USB_PID_IN == pid);
+    uint32_t epctl = (ep < SIM_USB_EP_COUNT) ? usb->FSEPCTL[ep] : 0u;
+    bool odd;
+    USB_BufDesp_Type *bd;
+    uint32_t bc;
+
+    *dropped = false;
+    if ( (0u == (usb->FSCTL & USB_FSCTL_USBEN_MASK)) || (NULL == sim_usb.bdt)
+      || ((usb->FSADDR & USB_FSADDR_ADDR_MASK) != sim_usb.addr)
+      || (0u == (epctl & (in ? USB_FSEPCTL_EPTXEN_MASK : USB_FSEPCTL_EPRXEN_MASK))) )
+    {
+        return SIM_USB_TIMEOUT;
+    }
+    if ( (0u != (usb->FSCTL & USB_FSCTL_TXDSUSPENDTOKENBUSY_MASK)) || (SIM_USB_STAT_DEPTH == sim_usb.stat_count) )
+    {
+        return SIM_USB_NAK; /* the sie holds tokens after a setup and while the fifo is full. */
+    }
+    odd = sim_usb.odd[ep][in];
+    bd = &sim_usb.bdt->Table[ep][in][odd];
+    /* a stalled endpoint still takes setups, a bd stall only counts while the sie owns the bd. */
+    if ( (SIM_USB_PID_SETUP != pid)
+      && ((0u != (epctl & USB_FSEPCTL_EPSTALL_MASK)) || ((0u != bd->OWN) && (0u != bd->BDT_STALL))) )
+    {
+        usb->FSINTSTAT |= USB_FSINTSTAT_STALL_MASK;
+        return SIM_USB_STALLED;
+    }
+    if (0u == bd->OWN)
+    {
+        return SIM_USB_NAK;
+    }
+
+    if (bd->DATA != (toggle ? 1u : 0u))
+    {
+        sim_usb.stats.toggle_errors++;
+        *dropped = in;
+        if ( (!in) && (0u != bd->DTS) )
+        {
+            *dropped = true;
+            return SIM_USB_ACK; /* acked and dropped, the bd stays with the sie. */
+        }
+    }
+    bc = bd->BC;
+    if (in)
+    {
+        memcpy(data, (const void *)(uintptr_t)bd->ADDR, bc);
+        *len = bc;
+    }
+    else
+    {
+        if (*len > bc)
+        {
+            sim_usb.stats.overflows++;
+            *len = bc;
+        }
+        memcpy((void *)(uintptr_t)bd->ADDR, data, *len);
+        bc = *len;
+    }
+    bd->HEAD = (bd->HEAD & (1u << 6u)) | ((uint32_t)pid << 2u) | (bc << 16u); /* DATA kept, TOK_PID, BC, OWN cleared. */
+
+    sim_usb.odd[ep][in] = !odd;
+    sim_usb.stat[sim_usb.stat_count++] = USB_FSSTAT_ENDP(ep) | USB_FSSTAT_TX(in ? 1u : 0u) | USB_FSSTAT_ODD(odd ? 1u : 0u);
+    if (SIM_USB_PID_SETUP == pid)
+    {
+        usb->FSCTL |= USB_FSCTL_TXDSUSPENDTOKENBUSY_MASK;
+    }
+    sim_usb_stat_update();
+    return SIM_USB_ACK;
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* host. */
+
+static void sim_usb_finish(sim_usb_pipe_t *pipe, int32_t result)
+{
+    pipe->busy = false;
+    if (NULL != pipe->fn)
+    {
+        pipe->fn(pipe->ctx, result, pipe->done);
+    }
+}
+
+static void sim_usb_ctrl_finish(int32_t result, uint32_t len)
+{
+    sim_usb.ctrl_stage = SIM_USB_CTRL_IDLE;
+    if (NULL != sim_usb.ctrl_fn)
+    {
+        sim_usb.ctrl_fn(sim_usb.ctrl_ctx, result, len);
+    }
+}
+
+static void sim_usb_abort_all(int32_t result)
+{
+    if (SIM_USB_CTRL_IDLE != sim_usb.ctrl_stage)
+    {
+        sim_usb_ctrl_finish(result, 0u);
+    }
+    for (uint32_t ep = 0u; ep < SIM_USB_EP_COUNT; ep++)
+    {
+        for (uint32_t dir = 0u; dir < 2u; dir++)
+        {
+            if (sim_usb.pipes[ep][dir].busy)
+            {
+                sim_usb_finish(&sim_usb.pipes[ep][dir], result);
+            }
+        }
+    }
+}
+
+/* one data transaction of a pipe, returns the bus bytes it took. */
+static uint32_t sim_usb_transact(sim_usb_pipe_t *pipe, uint8_t ep, bool in, uint8_t pid, int32_t *result, bool *complete)
+{
+    uint8_t buf[1024];
+    uint32_t len = 0u;
+    bool dropped;
+    sim_usb_handshake_t hs;
+
+    *complete = false;
+    if (!in)
+    {
+        len = pipe->len - pipe->done;
+        len = (len > pipe->max_packet) ? pipe->max_packet : len;
+        if (NULL != pipe->data)
+        {
+            memcpy(buf, pipe->data + pipe->done, len);
+        }
+    }
+    hs = sim_usb_token(pid, ep, pipe->toggle, buf, &len, &dropped);
+    switch (hs)
+    {
+        case SIM_USB_NAK:
+            sim_usb.stats.naks++;
+            return in ? SIM_USB_SHORT_BYTES : (SIM_USB_DATA_OVERHEAD + len);
+        case SIM_USB_STALLED:
+            sim_usb.stats.stalls++;
+            *result = SIM_USB_STALL;
+            *complete = true;
+            return in ? SIM_USB_SHORT_BYTES : (SIM_USB_DATA_OVERHEAD + len);
+        case SIM_USB_TIMEOUT:
+            sim_usb.stats.timeouts++;
+            if (++pipe->errors >= SIM_USB_ERROR_LIMIT)
+            {
+                *result = SIM_USB_ERROR;
+                *complete = true;
+            }
+            return SIM_USB_SHORT_BYTES + (in ? 0u : len);
+        default:
+            break;
+    }
+
+    pipe->errors = 0u;
+    if (in && dropped)
+    {
+        return SIM_USB_DATA_OVERHEAD + len;
+    }
+    if (in)
+    {
+        uint32_t room = pipe->len - pipe->done;
+        if (len > room)
+        {
+            sim_usb.stats.overflows++; /* babble. */
+            *result = SIM_USB_ERROR;
+            *complete = true;
+            return SIM_USB_DATA_OVERHEAD + len;
+        }
+        if (NULL != pipe->data)
+        {
+            memcpy(pipe->data + pipe->done, buf, len);
+        }
+        sim_usb.stats.bytes_in += len;
+    }
+    else
+    {
+        sim_usb.stats.bytes_out += len;
+    }
+    pipe->toggle = !pipe->toggle;
+    pipe->done += len;
+    sim_usb.stats.packets++;
+    sim_usb.frame_packets++;
+    *result = SIM_USB_OK;
+    *complete = (pipe->done >= pipe->len) || (in && (len < pipe->max_packet));
+    return SIM_USB_DATA_OVERHEAD + len;
+}
+
+/* next stage of the control transfer on ep0. */
+static uint32_t sim_usb_control_step(void)
+{
+    sim_usb_pipe_t *out = &sim_usb.pipes[0u][0u];
+    sim_usb_pipe_t *in = &sim_usb.pipes[0u][1u];
+    bool data_in = (0u != (sim_usb.setup[0] & 0x80u));
+    uint16_t wlength = (uint16_t)(sim_usb.setup[6] | (sim_usb.setup[7] << 8u));
+    sim_usb_pipe_t *pipe;
+    int32_t result = SIM_USB_OK;
+    bool complete;
+    uint32_t bytes = 0u;
+
+    switch (sim_usb.ctrl_stage)
+    {
+        case SIM_USB_CTRL_SETUP:
+            out->toggle = false;
+            out->data = sim_usb.setup;
+            out->len = sizeof(sim_usb.setup);
+            out->done = 0u;
+            bytes = sim_usb_transact(out, 0u, false, SIM_USB_PID_SETUP, &result, &complete);
+            if (!complete)
+            {
+                break;
+            }
+            if (SIM_USB_OK != result)
+            {
+                sim_usb_ctrl_finish(result, 0u);
+                break;
+            }
+            in->toggle = true;
+            out->toggle = true;
+            if (0u != wlength)
+            {
+                sim_usb.ctrl_stage = SIM_USB_CTRL_DATA;
+                pipe = data_in ? in : out;
+                pipe->data = sim_usb.ctrl_data;
+                pipe->len = wlength;
+            }
+            else
+            {
+                sim_usb.ctrl_stage = SIM_USB_CTRL_STATUS;
+                pipe = in;
+                pipe->data = NULL;
+                pipe->len = 0u;
+            }
+            pipe->done = 0u;
+            break;
+        case SIM_USB_CTRL_DATA:
+            pipe = data_in ? in : out;
+            bytes = sim_usb_transact(pipe, 0u, data_in, data_in ? SIM_USB_PID_IN : SIM_USB_PID_OUT, &result, &complete);
+            if (!complete)
+            {
+                break;
+            }
+            if (SIM_USB_OK != result)
+            {
+                sim_usb_ctrl_finish(result, pipe->done);
+                break;
+            }
+            sim_usb.ctrl_stage = SIM_USB_CTRL_STATUS;
+            pipe = data_in ? out : in;
+            pipe->toggle = true;
+            pipe->data = NULL;
+            pipe->len = 0u;
+            pipe->done = 0u;
+            break;
+        default:
+            pipe = ((0u != wlength) && data_in) ? out : in;
+            bytes = sim_usb_transact(pipe, 0u, (pipe == in), (pipe == in) ? SIM_USB_PID_IN : SIM_USB_PID_OUT, &result, &complete);
+            if (!complete)
+            {
+                break;
+            }
+            if ( (SIM_USB_OK == result) && (0x00u == sim_usb.setup[0]) && (0x05u == sim_usb.setup[1]) )
+            {
+                sim_usb.addr = sim_usb.setup[2] & 0x7Fu; /* SET_ADDRESS takes effect after its status stage. */
+            }
+            sim_usb_ctrl_finish(result, (0u != wlength) ? (data_in ? in->done : out->done) : 0u);
+            break;
+    }
+    return bytes;
+}
+
+/* interrupt pipes get one attempt every interval frames. */
+static bool sim_usb_periodic_due(sim_usb_pipe_t *pipe)
+{
+    uint32_t interval = (0u != pipe->interval) ? pipe->interval : 1u;
+
+    return pipe->busy && (3u == pipe->type) && ((sim_usb.sofs - pipe->frame) >= interval);
+}
+
+/* one transaction of the pipe at slot ep * 2 + in. */
+static uint32_t sim_usb_pipe_step(uint32_t slot)
+{
+    uint8_t ep = (uint8_t)(slot / 2u);
+    bool in = (0u != (slot & 1u));
+    sim_usb_pipe_t *pipe = &sim_usb.pipes[ep][in];
+    int32_t result;
+    bool complete;
+    uint32_t bytes;
+
+    bytes = sim_usb_transact(pipe, ep, in, in ? SIM_USB_PID_IN : SIM_USB_PID_OUT, &result, &complete);
+    if (complete)
+    {
+        sim_usb_finish(pipe, result);
+    }
+    return bytes;
+}
+
+static void sim_usb_frame_start(uint64_t t)
+{
+    USB_Type *usb = sim_usb_regs();
+
+    if (0u != sim_usb.frame_packets)
+    {
+        sim_usb.stats.busy_frames++;
+        if (sim_usb.frame_packets > sim_usb.stats.max_frame_packets)
+        {
+            sim_usb.stats.max_frame_packets = sim_usb.frame_packets;
+        }
+    }
+    sim_usb.frame_packets = 0u;
+    sim_usb.frame = (sim_usb.frame + 1u) & 0x7FFu;
+    sim_usb.sofs++;
+    sim_usb.frame_bytes = SIM_USB_SOF_BYTES;
+    sim_usb.frame_end = t + SIM_USB_FRAME_CYCLES;
+    sim_usb.stats.frames++;
+    usb->FSFRMNUML = sim_usb.frame & 0xFFu;
+    usb->FSFRMNUMH = sim_usb.frame >> 8u;
+    usb->FSINTSTAT |= USB_FSINTSTAT_SOFTOK_MASK;
+}
+
+uint64_t sim_usb_next_event(void)
+{
+    return sim_usb.plugged ? sim_usb.next : SIM_NEVER;
+}
+
+void sim_usb_run(uint64_t t)
+{
+    const uint32_t slots = SIM_USB_EP_COUNT * 2u;
+    uint32_t bytes = 0u;
+
+    if (!sim_usb.running)
+    {
+        if (0u == (sim_usb_regs()->FSCTL & USB_FSCTL_USBEN_MASK))
+        {
+            sim_usb.next = t + SIM_USB_FRAME_CYCLES; /* no pull-up yet. */
+        }
+        else if (0u == sim_usb.frame_end)
+        {
+            /* device seen: bus reset, then frames. transfers queued meanwhile start after it. */
+            for (uint32_t ep = 0u; ep < SIM_USB_EP_COUNT; ep++)
+            {
+                sim_usb.pipes[ep][0u].toggle = false;
+                sim_usb.pipes[ep][1u].toggle = false;
+            }
+            sim_usb.addr = 0u;
+            sim_usb_regs()->FSINTSTAT |= USB_FSINTSTAT_USBRST_MASK;
+            sim_usb.frame_end = t + (SIM_USB_RESET_FRAMES * SIM_USB_FRAME_CYCLES);
+            sim_usb.next = sim_usb.frame_end;
+        }
+        else
+        {
+            sim_usb.running = true;
+            sim_usb_frame_start(t);
+            sim_usb.next = t;
+        }
+        return;
+    }
+    if (t >= sim_usb.frame_end)
+    {
+        sim_usb_frame_start(sim_usb.frame_end);
+    }
+
+    /* periodic first, then control and bulk round robin, as long as the frame has room. */
+    for (uint32_t slot = 2u; (slot < slots) && (0u == bytes); slot++)
+    {
+        sim_usb_pipe_t *pipe = &sim_usb.pipes[slot / 2u][slot & 1u];
+        if (sim_usb_periodic_due(pipe) && ((sim_usb.frame_bytes + pipe->max_packet + SIM_USB_DATA_OVERHEAD) <= SIM_USB_FRAME_BYTES))
+        {
+            pipe->frame = sim_usb.sofs;
+            bytes = sim_usb_pipe_step(slot);
+        }
+    }
+    for (uint32_t i = 0u; (i < slots) && (0u == bytes); i++)
+    {
+        uint32_t slot = (sim_usb.rr + i) % slots;
+        sim_usb_pipe_t *pipe = &sim_usb.pipes[slot / 2u][slot & 1u];
+        if ((sim_usb.frame_bytes + pipe->max_packet + SIM_USB_DATA_OVERHEAD) > SIM_USB_FRAME_BYTES)
+        {
+            continue;
+        }
+        if (slot < 2u)
+        {
+            if ( (0u == slot) && (SIM_USB_CTRL_IDLE != sim_usb.ctrl_stage) )
+            {
+                bytes = sim_usb_control_step();
+            }
+        }
+        else if (pipe->busy && (2u == pipe->type))
+        {
+            bytes = sim_usb_pipe_step(slot);
+        }
+        if (0u != bytes)
+        {
+            sim_usb.rr = (uint8_t)((slot + 1u) % slots);
+        }
+    }
+
+    if (0u == bytes)
+    {
+        sim_usb.next = sim_usb.frame_end;
+        return;
+    }
+    sim_usb.frame_bytes += bytes;
+    sim_usb.next = t + ((uint64_t)bytes * SIM_USB_BYTE_CYCLES);
+    if (sim_usb.next > sim_usb.frame_end)
+    {
+        sim_usb.next = sim_usb.frame_end;
+    }
+}
+
+/* ------------------------------------------------------------------------------------------ */
+/* api. */
+
+void sim_usb_connect(bool connect)
+{
+    if (!connect)
+    {
+        sim_usb_abort_all(SIM_USB_ERROR);
+        sim_usb.plugged = false;
+        sim_usb.running = false;
+        return;
+    }
+    sim_usb.plugged = true;
+    sim_usb.running = false;
+    sim_usb.frame_end = 0u;
+    sim_usb.next = sim_now;
+    sim_usb.pipes[0u][0u].max_packet = 64u;
+    sim_usb.pipes[0u][1u].max_packet = 64u;
+}
+
+void sim_usb_pipe(uint8_t ep_addr, uint8_t type, uint16_t max_packet, uint8_t interval)
+{
+    sim_usb_pipe_t *pipe = &sim_usb.pipes[ep_addr & 0x0Fu][(ep_addr & 0x80u) ? 1u : 0u];
+
+    if ((ep_addr & 0x0Fu) >= SIM_USB_EP_COUNT)
+    {
+        return;
+    }
+    pipe->type = type;
+    pipe->max_packet = (max_packet > 1023u) ? 1023u : max_packet;
+    pipe->interval = interval;
+    pipe->frame = sim_usb.sofs - ((0u != interval) ? interval : 1u);
+    pipe->toggle = false;
+    if (0u == (ep_addr & 0x0Fu))
+    {
+        sim_usb.pipes[0u][0u].max_packet = pipe->max_packet; /* one size for both ep0 directions. */
+        sim_usb.pipes[0u][1u].max_packet = pipe->max_packet;
+    }
+}
+
+bool sim_usb_control(const uint8_t setup[8], uint8_t *data, sim_usb_done_t done, void *ctx)
+{
+    if ( (!sim_usb.plugged) || (SIM_USB_CTRL_IDLE != sim_usb.ctrl_stage) )
+    {
+        return false;
+    }
+    memcpy(sim_usb.setup, setup, sizeof(sim_usb.setup));
+    sim_usb.ctrl_data = data;
+    sim_usb.ctrl_fn = done;
+    sim_usb.ctrl_ctx = ctx;
+    sim_usb.pipes[0u][0u].errors = 0u;
+    sim_usb.pipes[0u][1u].errors = 0u;
+    sim_usb.ctrl_stage = SIM_USB_CTRL_SETUP;
+    return true;
+}
+
+bool sim_usb_transfer(uint8_t ep_addr, uint8_t *data, uint32_t len, sim_usb_done_t done, void *ctx)
+{
+    uint8_t ep = ep_addr & 0x0Fu;
+    sim_usb_pipe_t *pipe = &sim_usb.pipes[ep][(ep_addr & 0x80u) ? 1u : 0u];
+
+    if ( (!sim_usb.plugged) || (0u == ep) || (ep >= SIM_USB_EP_COUNT) || (0u == pipe->max_packet) || pipe->busy )
+    {
+        return false;
+    }
+    pipe->data = data;
+    pipe->len = len;
+    pipe->done = 0u;
+    pipe->errors = 0u;
+    pipe->fn = done;
+    pipe->ctx = ctx;
+    pipe->busy = true; /* a periodic pipe keeps its schedule, at most one transaction per interval. */
+    return true;
+}
+
+void sim_usb_stats(sim_usb_stats_t *stats, bool clear)
+{
+    if (NULL != stats)
+    {
+        *stats = sim_usb.stats;
+    }
+    if (clear)
+    {
+        memset(&sim_usb.stats, 0, sizeof(sim_usb.stats));
+        sim_usb.frame_packets = 0u; /* the running frame counts from here, not with what came before. */
+    }
+}
+
+/* sim_usb.c - end */
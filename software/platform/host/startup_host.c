@@ -0,0 +1,130 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* host counterpart of startup_mm32f0163d.s: the interrupt vectors the simulator dispatches
+ * through, with the same weak default handlers, and the reset sequence run before main().
+ */
+
+#include <stdlib.h>
+
+#include "hal_device_registers.h"
+#include "sim.h"
+
+void Default_Handler(void)
+{
+    sim_fatal("unexpected interrupt");
+}
+
+#define SIM_HANDLER(name) void name(void) __attribute__((weak, alias("Default_Handler")))
+
+SIM_HANDLER(WWDG_IWDG_IRQHandler);
+SIM_HANDLER(PVD_IRQHandler);
+SIM_HANDLER(RTC_BKP_IRQHandler);
+SIM_HANDLER(FLASH_IRQHandler);
+SIM_HANDLER(RCC_IRQHandler);
+SIM_HANDLER(EXTI0_1_IRQHandler);
+SIM_HANDLER(EXTI3_2_IRQHandler);
+SIM_HANDLER(EXTI15_4_IRQHandler);
+SIM_HANDLER(HWDIV_IRQHandler);
+SIM_HANDLER(DMA1_CH1_IRQHandler);
+SIM_HANDLER(DMA1_CH3_CH2_IRQHandler);
+SIM_HANDLER(DMA1_CH7_CH4_IRQHandler);
+SIM_HANDLER(ADC_COMP_IRQHandler);
+SIM_HANDLER(TIM1_BRK_UP_TRG_COM_IRQHandler);
+SIM_HANDLER(TIM1_CC_IRQHandler);
+SIM_HANDLER(TIM2_IRQHandler);
+SIM_HANDLER(TIM3_IRQHandler);
+SIM_HANDLER(LPUART_IRQHandler);
+SIM_HANDLER(LPTIM_IRQHandler);
+SIM_HANDLER(TIM14_IRQHandler);
+SIM_HANDLER(TIM16_IRQHandler);
+SIM_HANDLER(TIM17_IRQHandler);
+SIM_HANDLER(I2C1_IRQHandler);
+SIM_HANDLER(I3C1_IRQHandler);
+SIM_HANDLER(SPI1_IRQHandler);
+SIM_HANDLER(SPI2_IRQHandler);
+SIM_HANDLER(UART1_IRQHandler);
+SIM_HANDLER(UART2_IRQHandler);
+SIM_HANDLER(UART3_4_IRQHandler);
+SIM_HANDLER(FLEXCAN_IRQHandler);
+SIM_HANDLER(USB_IRQHandler);
+
+void (* const sim_vectors[32])(void) =
+{
+    WWDG_IWDG_IRQHandler,           /* 0 */
+    PVD_IRQHandler,
+    RTC_BKP_IRQHandler,
+    FLASH_IRQHandler,
+    RCC_IRQHandler,
+    EXTI0_1_IRQHandler,
+    EXTI3_2_IRQHandler,
+    EXTI15_4_IRQHandler,
+    HWDIV_IRQHandler,
+    DMA1_CH1_IRQHandler,
+    DMA1_CH3_CH2_IRQHandler,        /* 10 */
+    DMA1_CH7_CH4_IRQHandler,
+    ADC_COMP_IRQHandler,
+    TIM1_BRK_UP_TRG_COM_IRQHandler,
+    TIM1_CC_IRQHandler,
+    TIM2_IRQHandler,
+    TIM3_IRQHandler,
+    LPUART_IRQHandler,
+    LPTIM_IRQHandler,
+    TIM14_IRQHandler,
+    Default_Handler,                /* 20, reserved. */
+    TIM16_IRQHandler,
+    TIM17_IRQHandler,
+    I2C1_IRQHandler,
+    I3C1_IRQHandler,
+    SPI1_IRQHandler,
+    SPI2_IRQHandler,
+    UART1_IRQHandler,
+    UART2_IRQHandler,
+    UART3_4_IRQHandler,
+    FLEXCAN_IRQHandler,             /* 30 */
+    USB_IRQHandler,
+};
+
+/* map the peripherals and bring the clocks up like the reset handler does, before main().
+ * SIM_DAP_PORT=<port> in the environment puts the default swd target on the probe pins and
+ * a cmsis-dap tcp link on the usb port (openocd: adapter driver cmsis-dap, cmsis-dap backend tcp).
+ */
+__attribute__((constructor)) static void Reset_Handler(void)
+{
+    const char *port = getenv("SIM_DAP_PORT");
+
+    sim_init();
+    SystemInit();
+    if (NULL != port)
+    {
+        sim_swd_attach(NULL);
+        if (!sim_dap_listen((uint16_t)atoi(port)))
+        {
+            sim_fatal("cannot listen on SIM_DAP_PORT");
+        }
+    }
+}
+
+/* startup_host.c - end */
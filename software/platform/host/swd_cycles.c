@@ -0,0 +1,785 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* swd-cycles: times the SWD code of a probe firmware image on an emulated cortex-m0.
+ *
+ *   swd-cycles [--latency N] [--no-prefetch] [--mul-cycles N] [--clock HZ[,HZ..]] [--json] image.axf
+ *
+ * the image (keil .axf or gcc .elf, with symbols) is loaded into a 128K flash at 0x08000000
+ * and the 16K sram, DAP_Setup() runs and then, for every clock, DAP_ProcessCommand() gets a
+ * DAP_SWJ_Clock, a line reset, the DPIDR read and the debug power up, followed by the
+ * measured commands: one DP read, one DP write, one AP read and 14 word AP block reads and
+ * writes. the SWD pins are the simulated gpio port with the default target of sim_swd.c on
+ * them, every rising SWCLK edge is stamped with the core cycle it happened at.
+ *
+ * fetches from flash see the wait states in FLASH->ACR as SystemInit() leaves them
+ * (--latency overrides). the flash is assumed to deliver 64 bit lines, with the prefetch
+ * buffer reading the next line as soon as the current one is in. sram and peripherals have
+ * no wait states. interrupts are not modelled, the nvic and systick are plain memory.
+ */
+
+#include <elf.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal_device_registers.h"
+#include "sim.h"
+#include "sim_model.h"
+#include "sim_thumb.h"
+
+#define SWD_CYCLES_FLASH_BASE   0x08000000u
+#define SWD_CYCLES_FLASH_SIZE   0x20000u
+#define SWD_CYCLES_SRAM_BASE    0x20000000u
+#define SWD_CYCLES_SRAM_SIZE    0x4000u
+#define SWD_CYCLES_BUF_BASE     0x30000000u /* request and response, outside the device map. */
+#define SWD_CYCLES_BUF_SIZE     0x1000u
+#define SWD_CYCLES_REQUEST      (SWD_CYCLES_BUF_BASE)
+#define SWD_CYCLES_RESPONSE     (SWD_CYCLES_BUF_BASE + 0x800u)
+#define SWD_CYCLES_LINE         8u      /* flash line, bytes. */
+#define SWD_CYCLES_MAX_CLOCKS   16u
+#define SWD_CYCLES_MAX_EDGES    8192u
+#define SWD_CYCLES_CALL_LIMIT   200000000u
+#define SWD_CYCLES_BLOCK_WORDS  14u     /* fills the 64 byte packet of a block write. */
+#define SWD_CYCLES_KINDS        (SIM_SWD_BIT_DATA + 1u)
+
+/* the commands used, from DAP.h of the CMSIS_5 submodule which this tool does not need. */
+#define SWD_CYCLES_DAP_OK       0x00u
+#define SWD_CYCLES_PORT_SWD     0x01u
+#define SWD_CYCLES_CONNECT      0x02u
+#define SWD_CYCLES_CONFIGURE    0x04u
+#define SWD_CYCLES_TRANSFER     0x05u
+#define SWD_CYCLES_BLOCK        0x06u
+#define SWD_CYCLES_SWJ_CLOCK    0x11u
+#define SWD_CYCLES_SWJ_SEQUENCE 0x12u
+
+typedef struct
+{
+    uint32_t base;
+    uint32_t size;
+    uint8_t *data;
+} swd_cycles_mem_t;
+
+typedef struct
+{
+    uint32_t count;
+    uint32_t median;
+    uint32_t min;
+    uint32_t max;
+} swd_cycles_spread_t;
+
+typedef struct
+{
+    const char *name;
+    uint64_t cycles;                    /* DAP_ProcessCommand(), call to return. */
+    uint64_t flash_waits;               /* of those, stalled on flash. */
+    uint32_t edges;
+    uint32_t packets;
+    uint32_t words;                     /* data words moved, 0 for a single transfer. */
+} swd_cycles_command_t;
+
+static uint8_t swd_cycles_flash[SWD_CYCLES_FLASH_SIZE];
+static uint8_t swd_cycles_sram[SWD_CYCLES_SRAM_SIZE];
+static uint8_t swd_cycles_buf[SWD_CYCLES_BUF_SIZE];
+
+static const swd_cycles_mem_t swd_cycles_mems[] =
+{
+    { SWD_CYCLES_FLASH_BASE, SWD_CYCLES_FLASH_SIZE, swd_cycles_flash },
+    { SWD_CYCLES_SRAM_BASE,  SWD_CYCLES_SRAM_SIZE,  swd_cycles_sram  },
+    { SWD_CYCLES_BUF_BASE,   SWD_CYCLES_BUF_SIZE,   swd_cycles_buf   },
+};
+
+static struct
+{
+    uint32_t latency;
+    bool     prefetch;
+    uint32_t line;                      /* line in the fetch buffer, UINT32_MAX when none. */
+    uint32_t prefetch_line;
+    uint64_t prefetch_ready;            /* cycle the prefetched line is in. */
+    uint64_t waits;
+    uint64_t base;                      /* sim_cycles() at core cycle 0. */
+    uint32_t edge_count;
+    uint64_t edge_cycle[SWD_CYCLES_MAX_EDGES];
+    uint8_t  edge_kind[SWD_CYCLES_MAX_EDGES];
+} swd_cycles;
+
+static uint8_t *swd_cycles_mem(uint32_t addr, uint32_t len, bool *flash)
+{
+    for (uint32_t i = 0u; i < (sizeof(swd_cycles_mems) / sizeof(swd_cycles_mems[0])); i++)
+    {
+        const swd_cycles_mem_t *mem = &swd_cycles_mems[i];
+        if ( (addr >= mem->base) && ((addr - mem->base) < mem->size) && (len <= (mem->size - (addr - mem->base))) )
+        {
+            if (NULL != flash)
+            {
+                *flash = (SWD_CYCLES_FLASH_BASE == mem->base);
+            }
+            return mem->data + (addr - mem->base);
+        }
+    }
+    return NULL;
+}
+
+/* wait states for an access to a flash line at the given cycle. the buffer holds one line,
+ * the prefetcher the one after it.
+ */
+static uint32_t swd_cycles_flash_fetch(uint32_t addr, uint64_t cycle)
+{
+    uint32_t line = addr & ~(SWD_CYCLES_LINE - 1u);
+    uint32_t wait = 0u;
+
+    if (line == swd_cycles.line)
+    {
+        return 0u;
+    }
+    if ( swd_cycles.prefetch && (line == swd_cycles.prefetch_line) )
+    {
+        wait = (swd_cycles.prefetch_ready > cycle) ? (uint32_t)(swd_cycles.prefetch_ready - cycle) : 0u;
+    }
+    else
+    {
+        wait = swd_cycles.latency;
+    }
+    swd_cycles.line = line;
+    swd_cycles.prefetch_line = line + SWD_CYCLES_LINE;
+    swd_cycles.prefetch_ready = cycle + wait + swd_cycles.latency + 1u;
+    return wait;
+}
+
+/* catch the register model up with the core before it sees an access. */
+static void swd_cycles_sync(uint64_t cycle)
+{
+    uint64_t t = swd_cycles.base + cycle;
+
+    if (t > sim_cycles())
+    {
+        sim_advance(t - sim_cycles());
+    }
+}
+
+/* the register blocks of sim_periph.c, the scs is left out so nothing reaches the nvic. */
+static const sim_block_t *swd_cycles_block(uint32_t addr)
+{
+    for (uint32_t i = 0u; i < sim_block_count; i++)
+    {
+        if ((addr - sim_blocks[i].base) < sim_blocks[i].size)
+        {
+            return &sim_blocks[i];
+        }
+    }
+    return NULL;
+}
+
+static bool swd_cycles_bus_fetch(void *ctx, uint32_t addr, uint64_t cycle, uint32_t *word, uint32_t *wait)
+{
+    bool flash = false;
+    uint8_t *p = swd_cycles_mem(addr, 4u, &flash);
+
+    (void)ctx;
+    if (NULL == p)
+    {
+        return false;
+    }
+    memcpy(word, p, 4u);
+    *wait = flash ? swd_cycles_flash_fetch(addr, cycle) : 0u;
+    swd_cycles.waits += *wait;
+    return true;
+}
+
+static bool swd_cycles_bus_read(void *ctx, uint32_t addr, uint32_t size, uint64_t cycle, uint32_t *val, uint32_t *wait)
+{
+    bool flash = false;
+    uint8_t *p = swd_cycles_mem(addr, size, &flash);
+
+    (void)ctx;
+    *val = 0u;
+    if (NULL != p)
+    {
+        memcpy(val, p, size);
+        *wait = flash ? swd_cycles.latency : 0u; /* literal pools, the fetch buffer is not touched. */
+        swd_cycles.waits += *wait;
+        return true;
+    }
+    p = sim_view_find(addr);
+    if (NULL == p)
+    {
+        return false;
+    }
+    const sim_block_t *block = swd_cycles_block(addr);
+    swd_cycles_sync(cycle);
+    if ( (NULL != block) && (NULL != block->read) )
+    {
+        block->read(addr & ~3u);
+    }
+    memcpy(val, p, size);
+    return true;
+}
+
+static bool swd_cycles_bus_write(void *ctx, uint32_t addr, uint32_t size, uint32_t val, uint64_t cycle, uint32_t *wait)
+{
+    bool flash = false;
+    uint8_t *p = swd_cycles_mem(addr, size, &flash);
+
+    (void)ctx;
+    (void)wait;
+    if (NULL != p)
+    {
+        if (flash)
+        {
+            return false;
+        }
+        memcpy(p, &val, size);
+        return true;
+    }
+    p = sim_view_find(addr);
+    if (NULL == p)
+    {
+        return false;
+    }
+    const sim_block_t *block = swd_cycles_block(addr);
+    uint32_t old = SIM_REG(addr & ~3u);
+    swd_cycles_sync(cycle);
+    memcpy(p, &val, size);
+    if ( (NULL != block) && (NULL != block->write) )
+    {
+        block->write(addr & ~3u, old);
+    }
+    return true;
+}
+
+static const sim_thumb_bus_t swd_cycles_bus =
+{
+    swd_cycles_bus_fetch,
+    swd_cycles_bus_read,
+    swd_cycles_bus_write,
+};
+
+static void swd_cycles_edge(uint64_t cycle, uint8_t bit)
+{
+    if (swd_cycles.edge_count < SWD_CYCLES_MAX_EDGES)
+    {
+        swd_cycles.edge_cycle[swd_cycles.edge_count] = cycle - swd_cycles.base;
+        swd_cycles.edge_kind[swd_cycles.edge_count] = bit;
+        swd_cycles.edge_count++;
+    }
+}
+
+/* PT_LOAD segments at their load and their run address, so initialised data needs no copy.
+ * returns the two entry points through the symbol table.
+ */
+static bool swd_cycles_load(const char *path, uint32_t *setup, uint32_t *process)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *image = NULL;
+    long len;
+    bool ok = false;
+
+    *setup = 0u;
+    *process = 0u;
+    if (NULL == f)
+    {
+        perror(path);
+        return false;
+    }
+    if ( (0 == fseek(f, 0, SEEK_END)) && ((len = ftell(f)) > (long)sizeof(Elf32_Ehdr)) && (0 == fseek(f, 0, SEEK_SET)) )
+    {
+        image = malloc((size_t)len);
+        ok = (NULL != image) && (fread(image, 1u, (size_t)len, f) == (size_t)len);
+    }
+    fclose(f);
+
+    const Elf32_Ehdr *eh = (const Elf32_Ehdr *)image;
+    if ( !ok || (0 != memcmp(eh->e_ident, ELFMAG, SELFMAG)) || (ELFCLASS32 != eh->e_ident[EI_CLASS]) ||
+         (ELFDATA2LSB != eh->e_ident[EI_DATA]) || (EM_ARM != eh->e_machine) )
+    {
+        fprintf(stderr, "%s: not a little endian arm elf file\n", path);
+        free(image);
+        return false;
+    }
+
+    for (uint32_t i = 0u; ok && (i < eh->e_phnum); i++)
+    {
+        const Elf32_Phdr *ph = (const Elf32_Phdr *)(image + eh->e_phoff + (i * eh->e_phentsize));
+        if ( (PT_LOAD != ph->p_type) || (0u == ph->p_memsz) )
+        {
+            continue;
+        }
+        uint8_t *run = swd_cycles_mem(ph->p_vaddr, ph->p_memsz, NULL);
+        uint8_t *load = swd_cycles_mem(ph->p_paddr, ph->p_filesz, NULL);
+        if ( (NULL == run) || ((ph->p_offset + ph->p_filesz) > (uint32_t)len) )
+        {
+            fprintf(stderr, "%s: segment at 0x%08x is outside flash and sram\n", path, (unsigned)ph->p_vaddr);
+            ok = false;
+            break;
+        }
+        memcpy(run, image + ph->p_offset, ph->p_filesz);
+        memset(run + ph->p_filesz, 0, ph->p_memsz - ph->p_filesz);
+        if ( (NULL != load) && (load != run) )
+        {
+            memcpy(load, image + ph->p_offset, ph->p_filesz);
+        }
+    }
+
+    for (uint32_t i = 0u; ok && (i < eh->e_shnum); i++)
+    {
+        const Elf32_Shdr *sh = (const Elf32_Shdr *)(image + eh->e_shoff + (i * eh->e_shentsize));
+        if ( (SHT_SYMTAB != sh->sh_type) || (sh->sh_link >= eh->e_shnum) )
+        {
+            continue;
+        }
+        const Elf32_Shdr *strtab = (const Elf32_Shdr *)(image + eh->e_shoff + (sh->sh_link * eh->e_shentsize));
+        for (uint32_t n = 0u; n < (sh->sh_size / sizeof(Elf32_Sym)); n++)
+        {
+            const Elf32_Sym *sym = (const Elf32_Sym *)(image + sh->sh_offset) + n;
+            const char *name = (const char *)image + strtab->sh_offset + sym->st_name;
+            if (0 == strcmp(name, "DAP_Setup"))
+            {
+                *setup = sym->st_value | 1u;
+            }
+            else if (0 == strcmp(name, "DAP_ProcessCommand"))
+            {
+                *process = sym->st_value | 1u;
+            }
+        }
+    }
+    if ( ok && ((0u == *setup) || (0u == *process)) )
+    {
+        fprintf(stderr, "%s: no DAP_Setup / DAP_ProcessCommand symbols\n", path);
+        ok = false;
+    }
+    free(image);
+    return ok;
+}
+
+static sim_thumb_t swd_cycles_cpu;
+static uint32_t swd_cycles_sp;
+static uint32_t swd_cycles_process;
+
+/* one command through DAP_ProcessCommand() on a fresh stack, edges stamped from its start. */
+static bool swd_cycles_command(swd_cycles_command_t *cmd, const uint8_t *request, uint32_t len, uint8_t *response)
+{
+    sim_thumb_t *cpu = &swd_cycles_cpu;
+    const uint32_t args[2] = { SWD_CYCLES_REQUEST, SWD_CYCLES_RESPONSE };
+    uint64_t start = cpu->cycles;
+    uint64_t waits = swd_cycles.waits;
+
+    memset(swd_cycles_buf, 0, sizeof(swd_cycles_buf));
+    memcpy(swd_cycles_mem(SWD_CYCLES_REQUEST, len, NULL), request, len);
+    swd_cycles.edge_count = 0u;
+    cpu->r[13] = swd_cycles_sp;
+    if (!sim_thumb_call(cpu, swd_cycles_process, args, 2u, SWD_CYCLES_CALL_LIMIT))
+    {
+        fprintf(stderr, "swd-cycles: %s at 0x%08x running command 0x%02x\n",
+                cpu->fault, (unsigned)cpu->fault_pc, request[0]);
+        return false;
+    }
+    memcpy(response, swd_cycles_mem(SWD_CYCLES_RESPONSE, 64u, NULL), 64u);
+    if (NULL != cmd)
+    {
+        cmd->cycles = cpu->cycles - start;
+        cmd->flash_waits = swd_cycles.waits - waits;
+        cmd->edges = swd_cycles.edge_count;
+        cmd->packets = 0u;
+        for (uint32_t i = 0u; i < swd_cycles.edge_count; i++)
+        {
+            if ( (SIM_SWD_BIT_REQUEST == swd_cycles.edge_kind[i]) &&
+                 ((0u == i) || (SIM_SWD_BIT_REQUEST != swd_cycles.edge_kind[i - 1u])) )
+            {
+                cmd->packets++;
+            }
+        }
+    }
+    return true;
+}
+
+static void swd_cycles_put32(uint8_t *p, uint32_t val)
+{
+    p[0] = (uint8_t)val;
+    p[1] = (uint8_t)(val >> 8u);
+    p[2] = (uint8_t)(val >> 16u);
+    p[3] = (uint8_t)(val >> 24u);
+}
+
+/* a DAP_Transfer that has to complete with OK. */
+static bool swd_cycles_transfer(swd_cycles_command_t *cmd, const uint8_t *transfers, uint32_t len, uint8_t count)
+{
+    uint8_t request[64] = { SWD_CYCLES_TRANSFER, 0u, count };
+    uint8_t response[64];
+
+    memcpy(&request[3], transfers, len);
+    if (!swd_cycles_command(cmd, request, len + 3u, response))
+    {
+        return false;
+    }
+    if ( (response[1] != count) || (0x01u != response[2]) )
+    {
+        fprintf(stderr, "swd-cycles: transfer %u of %u failed, ack 0x%02x\n", response[1], count, response[2]);
+        return false;
+    }
+    return true;
+}
+
+/* bit times by protocol phase, from the edges of the last command. only edges inside a
+ * packet count, the gaps between packets are command overhead.
+ */
+static void swd_cycles_bits(uint32_t *deltas[SWD_CYCLES_KINDS], uint32_t counts[SWD_CYCLES_KINDS], uint32_t max)
+{
+    for (uint32_t i = 1u; i < swd_cycles.edge_count; i++)
+    {
+        uint8_t kind = swd_cycles.edge_kind[i];
+        uint8_t prev = swd_cycles.edge_kind[i - 1u];
+        bool inside = (SIM_SWD_BIT_TURNAROUND == kind) || (SIM_SWD_BIT_ACK == kind) || (SIM_SWD_BIT_DATA == kind) ||
+                      ( (SIM_SWD_BIT_REQUEST == kind) && (SIM_SWD_BIT_REQUEST == prev) );
+        if ( inside && (counts[kind] < max) )
+        {
+            deltas[kind][counts[kind]++] = (uint32_t)(swd_cycles.edge_cycle[i] - swd_cycles.edge_cycle[i - 1u]);
+        }
+    }
+}
+
+static int swd_cycles_compare(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static swd_cycles_spread_t swd_cycles_spread(uint32_t *deltas, uint32_t count)
+{
+    swd_cycles_spread_t s = { count, 0u, 0u, 0u };
+
+    if (0u != count)
+    {
+        qsort(deltas, count, sizeof(deltas[0]), swd_cycles_compare);
+        s.median = deltas[count / 2u];
+        s.min = deltas[0];
+        s.max = deltas[count - 1u];
+    }
+    return s;
+}
+
+static const char * const swd_cycles_kind_names[SWD_CYCLES_KINDS] = { "reset", "idle", "request", "turnaround", "ack", "data" };
+
+/* everything for one clock setting. the measured commands run with the target freshly
+ * reset and powered up, TAR at the start of the target ram.
+ */
+static bool swd_cycles_clock(uint32_t clock, bool json, bool first)
+{
+    static uint32_t deltas_buf[SWD_CYCLES_KINDS][SWD_CYCLES_MAX_EDGES];
+    uint32_t *deltas[SWD_CYCLES_KINDS];
+    uint32_t counts[SWD_CYCLES_KINDS] = { 0u };
+    swd_cycles_command_t cmds[5] = { { "dp_read" }, { "dp_write" }, { "ap_read" }, { "block_read" }, { "block_write" } };
+    uint8_t request[64];
+    uint8_t response[64];
+    uint8_t xfer[32];
+
+    for (uint32_t k = 0u; k < SWD_CYCLES_KINDS; k++)
+    {
+        deltas[k] = deltas_buf[k];
+    }
+    request[0] = SWD_CYCLES_SWJ_CLOCK;
+    swd_cycles_put32(&request[1], clock);
+    if ( !swd_cycles_command(NULL, request, 5u, response) || (SWD_CYCLES_DAP_OK != response[1]) )
+    {
+        fprintf(stderr, "swd-cycles: DAP_SWJ_Clock %u refused\n", (unsigned)clock);
+        return false;
+    }
+
+    /* line reset, jtag to swd, line reset, idle. */
+    static const uint8_t sequences[][10] =
+    {
+        { SWD_CYCLES_SWJ_SEQUENCE, 51u, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu },
+        { SWD_CYCLES_SWJ_SEQUENCE, 16u, 0x9Eu, 0xE7u },
+        { SWD_CYCLES_SWJ_SEQUENCE, 51u, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu, 0xFFu },
+        { SWD_CYCLES_SWJ_SEQUENCE, 8u, 0x00u },
+    };
+    for (uint32_t i = 0u; i < (sizeof(sequences) / sizeof(sequences[0])); i++)
+    {
+        if (!swd_cycles_command(NULL, sequences[i], sizeof(sequences[i]), response))
+        {
+            return false;
+        }
+    }
+
+    /* DPIDR, then SELECT 0, CTRL/STAT power up requests, CSW word size, TAR. */
+    const uint32_t ram = 0x20000000u;
+    uint8_t setup[4 + (4u * 5u)] = { 0x02u, 0x08u, 0u, 0u, 0u, 0u, 0x04u };
+    swd_cycles_put32(&setup[7], 0x50000000u);
+    setup[11] = 0x01u;
+    swd_cycles_put32(&setup[12], 0x23000012u);
+    setup[16] = 0x05u;
+    swd_cycles_put32(&setup[17], ram);
+    if (!swd_cycles_transfer(NULL, setup, 21u, 5u))
+    {
+        return false;
+    }
+
+    xfer[0] = 0x02u; /* DP read DPIDR. */
+    if (!swd_cycles_transfer(&cmds[0], xfer, 1u, 1u))
+    {
+        return false;
+    }
+    swd_cycles_bits(deltas, counts, SWD_CYCLES_MAX_EDGES);
+
+    xfer[0] = 0x08u; /* DP write SELECT. */
+    swd_cycles_put32(&xfer[1], 0u);
+    if (!swd_cycles_transfer(&cmds[1], xfer, 5u, 1u))
+    {
+        return false;
+    }
+    swd_cycles_bits(deltas, counts, SWD_CYCLES_MAX_EDGES);
+
+    xfer[0] = 0x0Fu; /* AP read DRW, posted: the value comes with the RDBUFF read after it. */
+    if (!swd_cycles_transfer(&cmds[2], xfer, 1u, 1u))
+    {
+        return false;
+    }
+    swd_cycles_bits(deltas, counts, SWD_CYCLES_MAX_EDGES);
+
+    for (uint32_t i = 3u; i < 5u; i++)
+    {
+        uint32_t len = 5u;
+        xfer[0] = 0x05u; /* TAR back to the start. */
+        swd_cycles_put32(&xfer[1], ram);
+        if (!swd_cycles_transfer(NULL, xfer, 5u, 1u))
+        {
+            return false;
+        }
+        request[0] = SWD_CYCLES_BLOCK;
+        request[1] = 0u;
+        request[2] = (uint8_t)SWD_CYCLES_BLOCK_WORDS;
+        request[3] = 0u;
+        request[4] = (3u == i) ? 0x0Fu : 0x0Du;
+        if (4u == i)
+        {
+            for (uint32_t w = 0u; w < SWD_CYCLES_BLOCK_WORDS; w++)
+            {
+                swd_cycles_put32(&request[len], 0x5A5A0000u + w);
+                len += 4u;
+            }
+        }
+        if (!swd_cycles_command(&cmds[i], request, len, response))
+        {
+            return false;
+        }
+        if ( (SWD_CYCLES_BLOCK_WORDS != (response[1] | ((uint32_t)response[2] << 8u))) || (0x01u != response[3]) )
+        {
+            fprintf(stderr, "swd-cycles: block %s failed, ack 0x%02x\n", (3u == i) ? "read" : "write", response[3]);
+            return false;
+        }
+        cmds[i].words = SWD_CYCLES_BLOCK_WORDS;
+        swd_cycles_bits(deltas, counts, SWD_CYCLES_MAX_EDGES);
+    }
+
+    /* request and data bits are plain bit times, turnaround and ack show the direction switch. */
+    swd_cycles_spread_t kinds[SWD_CYCLES_KINDS];
+    static uint32_t plain[2u * SWD_CYCLES_MAX_EDGES];
+    uint32_t plain_count = 0u;
+    memcpy(&plain[0], deltas[SIM_SWD_BIT_REQUEST], counts[SIM_SWD_BIT_REQUEST] * sizeof(uint32_t));
+    plain_count += counts[SIM_SWD_BIT_REQUEST];
+    memcpy(&plain[plain_count], deltas[SIM_SWD_BIT_DATA], counts[SIM_SWD_BIT_DATA] * sizeof(uint32_t));
+    plain_count += counts[SIM_SWD_BIT_DATA];
+    swd_cycles_spread_t bit = swd_cycles_spread(plain, plain_count);
+    for (uint32_t k = SIM_SWD_BIT_REQUEST; k < SWD_CYCLES_KINDS; k++)
+    {
+        kinds[k] = swd_cycles_spread(deltas[k], counts[k]);
+    }
+    double swclk = (0u != bit.median) ? ((double)SIM_CPU_FREQ / bit.median) : 0.0;
+
+    if (json)
+    {
+        printf("%s    {\"clock\": %u, \"cycles_per_bit\": {\"median\": %u, \"min\": %u, \"max\": %u}, \"swclk_hz\": %.0f,\n",
+               first ? "" : ",\n", (unsigned)clock, (unsigned)bit.median, (unsigned)bit.min, (unsigned)bit.max, swclk);
+        printf("     \"phases\": {");
+        for (uint32_t k = SIM_SWD_BIT_REQUEST; k < SWD_CYCLES_KINDS; k++)
+        {
+            printf("%s\"%s\": {\"median\": %u, \"min\": %u, \"max\": %u}", (SIM_SWD_BIT_REQUEST == k) ? "" : ", ",
+                   swd_cycles_kind_names[k], (unsigned)kinds[k].median, (unsigned)kinds[k].min, (unsigned)kinds[k].max);
+        }
+        printf("},\n     \"commands\": {");
+        for (uint32_t i = 0u; i < 5u; i++)
+        {
+            printf("%s\"%s\": {\"cycles\": %llu, \"flash_waits\": %llu, \"edges\": %u, \"packets\": %u",
+                   (0u == i) ? "" : ", ", cmds[i].name, (unsigned long long)cmds[i].cycles,
+                   (unsigned long long)cmds[i].flash_waits, (unsigned)cmds[i].edges, (unsigned)cmds[i].packets);
+            if (0u != cmds[i].words)
+            {
+                printf(", \"cycles_per_word\": %.1f", (double)cmds[i].cycles / cmds[i].words);
+            }
+            printf("}");
+        }
+        printf("}}");
+    }
+    else
+    {
+        printf("clock %u Hz: %u cycles/bit (%u..%u), swclk %.3f MHz\n",
+               (unsigned)clock, (unsigned)bit.median, (unsigned)bit.min, (unsigned)bit.max, swclk / 1e6);
+        printf("  bit cycles by phase:");
+        for (uint32_t k = SIM_SWD_BIT_REQUEST; k < SWD_CYCLES_KINDS; k++)
+        {
+            printf(" %s %u (%u..%u)", swd_cycles_kind_names[k], (unsigned)kinds[k].median, (unsigned)kinds[k].min, (unsigned)kinds[k].max);
+        }
+        printf("\n");
+        for (uint32_t i = 0u; i < 5u; i++)
+        {
+            printf("  %-12s %8llu cycles %7llu flash waits %4u edges %3u packets",
+                   cmds[i].name, (unsigned long long)cmds[i].cycles, (unsigned long long)cmds[i].flash_waits,
+                   (unsigned)cmds[i].edges, (unsigned)cmds[i].packets);
+            if (0u != cmds[i].words)
+            {
+                printf(" %8.1f cycles/word", (double)cmds[i].cycles / cmds[i].words);
+            }
+            printf("\n");
+        }
+    }
+    return true;
+}
+
+static void swd_cycles_usage(void)
+{
+    fprintf(stderr, "usage: swd-cycles [--latency N] [--no-prefetch] [--mul-cycles N] [--clock HZ[,HZ..]] [--json] image.axf\n");
+    exit(2);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t clocks[SWD_CYCLES_MAX_CLOCKS] = { 100000u, 1000000u, 2000000u, 4000000u, 10000000u, 30000000u };
+    uint32_t clock_count = 6u;
+    int32_t latency = -1;
+    bool prefetch = true;
+    bool prefetch_set = false;
+    uint32_t mul_cycles = 1u;
+    bool json = false;
+    const char *path = NULL;
+    uint32_t setup;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ( (0 == strcmp(argv[i], "--latency")) && ((i + 1) < argc) )
+        {
+            latency = atoi(argv[++i]);
+        }
+        else if (0 == strcmp(argv[i], "--no-prefetch"))
+        {
+            prefetch = false;
+            prefetch_set = true;
+        }
+        else if ( (0 == strcmp(argv[i], "--mul-cycles")) && ((i + 1) < argc) )
+        {
+            mul_cycles = (uint32_t)atoi(argv[++i]);
+        }
+        else if ( (0 == strcmp(argv[i], "--clock")) && ((i + 1) < argc) )
+        {
+            char *p = argv[++i];
+            clock_count = 0u;
+            while ( ('\0' != *p) && (clock_count < SWD_CYCLES_MAX_CLOCKS) )
+            {
+                clocks[clock_count++] = (uint32_t)strtoul(p, &p, 0);
+                p += (',' == *p) ? 1 : 0;
+            }
+        }
+        else if (0 == strcmp(argv[i], "--json"))
+        {
+            json = true;
+        }
+        else if ( ('-' != argv[i][0]) && (NULL == path) )
+        {
+            path = argv[i];
+        }
+        else
+        {
+            swd_cycles_usage();
+        }
+    }
+    if ( (NULL == path) || (0u == clock_count) )
+    {
+        swd_cycles_usage();
+    }
+    if (!swd_cycles_load(path, &setup, &swd_cycles_process))
+    {
+        return 1;
+    }
+
+    /* the startup constructor ran SystemInit() on the model, FLASH->ACR is what the firmware sets. */
+    uint32_t acr = SIM_VIEW(FLASH)->ACR;
+    swd_cycles.latency = (latency >= 0) ? (uint32_t)latency : (acr & FLASH_ACR_LATENCY_MASK);
+    swd_cycles.prefetch = prefetch_set ? prefetch : (0u != (acr & FLASH_ACR_PRFTBE_MASK));
+    swd_cycles.line = UINT32_MAX;
+    swd_cycles.prefetch_line = UINT32_MAX;
+    swd_cycles.base = sim_cycles();
+
+    sim_swd_attach(NULL);
+    sim_swd_edge_hook(swd_cycles_edge);
+
+    sim_thumb_init(&swd_cycles_cpu, &swd_cycles_bus, NULL);
+    swd_cycles_cpu.mul_cycles = mul_cycles;
+    memcpy(&swd_cycles_sp, swd_cycles_flash, 4u);
+    if ( (swd_cycles_sp <= SWD_CYCLES_SRAM_BASE) || (swd_cycles_sp > (SWD_CYCLES_SRAM_BASE + SWD_CYCLES_SRAM_SIZE)) )
+    {
+        swd_cycles_sp = SWD_CYCLES_SRAM_BASE + SWD_CYCLES_SRAM_SIZE;
+    }
+    swd_cycles_cpu.r[13] = swd_cycles_sp;
+    if (!sim_thumb_call(&swd_cycles_cpu, setup, NULL, 0u, SWD_CYCLES_CALL_LIMIT))
+    {
+        fprintf(stderr, "swd-cycles: %s at 0x%08x in DAP_Setup\n", swd_cycles_cpu.fault, (unsigned)swd_cycles_cpu.fault_pc);
+        return 1;
+    }
+
+    uint8_t connect[2] = { SWD_CYCLES_CONNECT, SWD_CYCLES_PORT_SWD };
+    uint8_t configure[6] = { SWD_CYCLES_CONFIGURE, 0u, 100u, 0u, 0u, 0u };
+    uint8_t response[64];
+    if ( !swd_cycles_command(NULL, connect, sizeof(connect), response) || (SWD_CYCLES_PORT_SWD != response[1]) ||
+         !swd_cycles_command(NULL, configure, sizeof(configure), response) || (SWD_CYCLES_DAP_OK != response[1]) )
+    {
+        fprintf(stderr, "swd-cycles: the firmware does not connect in swd mode\n");
+        return 1;
+    }
+
+    if (json)
+    {
+        printf("{\"image\": \"%s\", \"flash_latency\": %u, \"prefetch\": %s, \"cpu_hz\": %u, \"clocks\": [\n",
+               path, (unsigned)swd_cycles.latency, swd_cycles.prefetch ? "true" : "false", (unsigned)SIM_CPU_FREQ);
+    }
+    else
+    {
+        printf("%s: flash latency %u, prefetch %s, core %u MHz\n",
+               path, (unsigned)swd_cycles.latency, swd_cycles.prefetch ? "on" : "off", (unsigned)(SIM_CPU_FREQ / 1000000u));
+    }
+    for (uint32_t i = 0u; i < clock_count; i++)
+    {
+        if (!swd_cycles_clock(clocks[i], json, (0u == i)))
+        {
+            return 1;
+        }
+    }
+    if (json)
+    {
+        printf("\n]}\n");
+    }
+    return 0;
+}
+
+/* swd_cycles.c - end */
@@ -0,0 +1,444 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* swd-cycles reference image: a plain bit-bang SWD engine with the DAP_Setup() /
+ * DAP_ProcessCommand() entry points swd-cycles calls, SWCLK on PA1 and SWDIO on PA0.
+ * it answers DAP_Connect, DAP_TransferConfigure, DAP_SWJ_Clock, DAP_SWJ_Sequence,
+ * DAP_Transfer and DAP_TransferBlock, enough for every step swd-cycles takes.
+ * DAP_SWJ_Clock sets a busy wait of 12MHz / clock loops per half bit.
+ *
+ * the code sits in flash, or with SWD_REF_SRAM defined in an sram .ramfunc region. it is
+ * a self-test of swd-cycles (pin edges, packet decode, the .ramfunc copy) and not a
+ * model of SW_DP.c: its cycle counts say nothing about the firmware. the host build
+ * assembles it when llvm-mc and ld.lld are found (CMakeLists.txt), by hand:
+ *
+ *   llvm-mc --triple=thumbv6m-none-eabi -mcpu=cortex-m0 -filetype=obj swd_ref.s -o flash.o
+ *   llvm-mc --triple=thumbv6m-none-eabi -mcpu=cortex-m0 -filetype=obj --defsym SWD_REF_SRAM=1 swd_ref.s -o sram.o
+ *   ld.lld -T swd_ref.ld -z max-page-size=8 flash.o -o swd_ref_flash.elf
+ *   ld.lld -T swd_ref.ld -z max-page-size=8 sram.o -o swd_ref_sram.elf
+ */
+
+    .syntax unified
+    .cpu cortex-m0
+    .thumb
+    .equ GPIOA, 0x48000000
+
+    .section .vectors,"a"
+    .word 0x20004000
+    .word DAP_Setup
+
+.ifdef SWD_REF_SRAM
+    .section .ramfunc,"ax",%progbits
+.else
+    .text
+.endif
+    .thumb_func
+    .global DAP_Setup
+DAP_Setup:
+    ldr r0, =delay
+    movs r1, #0
+    str r1, [r0]
+    bx lr
+
+    .thumb_func
+wait:
+    ldr r3, =delay
+    ldr r3, [r3]
+    cmp r3, #0
+    beq 2f
+1:  subs r3, #1
+    bne 1b
+2:  bx lr
+
+    .thumb_func
+wbit:
+    push {lr}
+    ldr r2, =GPIOA
+    movs r1, #1
+    ands r0, r1
+    beq 1f
+    str r1, [r2, #0x10]
+    b 2f
+1:  str r1, [r2, #0x14]
+2:  movs r1, #2
+    str r1, [r2, #0x14]
+    bl wait
+    ldr r2, =GPIOA
+    movs r1, #2
+    str r1, [r2, #0x10]
+    bl wait
+    pop {pc}
+
+    .thumb_func
+rbit:
+    push {lr}
+    ldr r2, =GPIOA
+    movs r1, #2
+    str r1, [r2, #0x14]
+    bl wait
+    ldr r2, =GPIOA
+    ldr r0, [r2, #0x08]
+    movs r1, #1
+    ands r0, r1
+    movs r1, #2
+    str r1, [r2, #0x10]
+    bl wait
+    pop {pc}
+
+    .thumb_func
+swdio_mode:
+    ldr r2, =GPIOA
+    ldr r1, [r2]
+    lsrs r1, r1, #4
+    lsls r1, r1, #4
+    orrs r1, r0
+    str r1, [r2]
+    bx lr
+
+    .thumb_func
+parity:
+    movs r1, #0
+    movs r2, #1
+1:  cmp r0, #0
+    beq 2f
+    mov r3, r0
+    ands r3, r2
+    eors r1, r3
+    lsrs r0, r0, #1
+    b 1b
+2:  mov r0, r1
+    bx lr
+
+    .thumb_func
+get32:
+    ldrb r1, [r0, #3]
+    ldrb r2, [r0, #2]
+    lsls r1, r1, #8
+    orrs r1, r2
+    ldrb r2, [r0, #1]
+    lsls r1, r1, #8
+    orrs r1, r2
+    ldrb r2, [r0]
+    lsls r1, r1, #8
+    orrs r1, r2
+    mov r0, r1
+    bx lr
+
+    .thumb_func
+put32:
+    strb r1, [r0]
+    lsrs r1, r1, #8
+    strb r1, [r0, #1]
+    lsrs r1, r1, #8
+    strb r1, [r0, #2]
+    lsrs r1, r1, #8
+    strb r1, [r0, #3]
+    bx lr
+
+@ r0 request, r1 data word pointer -> r0 ack
+    .thumb_func
+xfer:
+    push {r4-r7, lr}
+    mov r4, r0
+    mov r5, r1
+    movs r0, #3
+    bl swdio_mode
+    movs r6, #0xF
+    ands r6, r4
+    mov r0, r6
+    bl parity
+    lsls r0, r0, #5
+    lsls r6, r6, #1
+    orrs r6, r0
+    movs r0, #0x81
+    orrs r6, r0
+    movs r7, #8
+1:  mov r0, r6
+    bl wbit
+    lsrs r6, r6, #1
+    subs r7, #1
+    bne 1b
+    movs r0, #4
+    bl swdio_mode
+    bl rbit
+    bl rbit
+    mov r6, r0
+    bl rbit
+    lsls r0, r0, #1
+    orrs r6, r0
+    bl rbit
+    lsls r0, r0, #2
+    orrs r6, r0
+    cmp r6, #1
+    bne 8f
+    movs r0, #2
+    tst r4, r0
+    beq 5f
+    movs r6, #0
+    movs r7, #0
+3:  bl rbit
+    lsls r0, r0, r7
+    orrs r6, r0
+    adds r7, #1
+    cmp r7, #32
+    bne 3b
+    bl rbit
+    bl rbit
+    str r6, [r5]
+    movs r0, #3
+    bl swdio_mode
+    movs r0, #1
+    pop {r4-r7, pc}
+5:  bl rbit
+    movs r0, #3
+    bl swdio_mode
+    ldr r6, [r5]
+    mov r0, r6
+    bl parity
+    mov r4, r0
+    movs r7, #32
+6:  mov r0, r6
+    bl wbit
+    lsrs r6, r6, #1
+    subs r7, #1
+    bne 6b
+    mov r0, r4
+    bl wbit
+    movs r0, #1
+    pop {r4-r7, pc}
+8:  bl rbit
+    movs r0, #3
+    bl swdio_mode
+    mov r0, r6
+    pop {r4-r7, pc}
+
+    .thumb_func
+    .global DAP_ProcessCommand
+DAP_ProcessCommand:
+    push {r4-r7, lr}
+    mov r4, r0
+    mov r5, r1
+    ldrb r0, [r4]
+    strb r0, [r5]
+    cmp r0, #0x02
+    beq connect
+    cmp r0, #0x04
+    beq ok
+    cmp r0, #0x11
+    beq clock
+    cmp r0, #0x12
+    beq seq
+    cmp r0, #0x05
+    bne 1f
+    b transfer
+1:  cmp r0, #0x06
+    bne 2f
+    b block
+2:  movs r0, #0xFF
+    strb r0, [r5]
+    b done
+ok:
+    movs r0, #0
+    strb r0, [r5, #1]
+done:
+    movs r0, #0
+    pop {r4-r7, pc}
+
+connect:
+    ldr r2, =GPIOA
+    movs r1, #3
+    str r1, [r2, #0x10]
+    ldr r1, [r2]
+    lsrs r1, r1, #8
+    lsls r1, r1, #8
+    movs r0, #0x33
+    orrs r1, r0
+    str r1, [r2]
+    movs r0, #1
+    strb r0, [r5, #1]
+    b done
+
+clock:
+    adds r0, r4, #1
+    bl get32
+    ldr r1, =12000000
+    movs r2, #0
+1:  cmp r1, r0
+    blo 2f
+    subs r1, r1, r0
+    adds r2, #1
+    b 1b
+2:  ldr r1, =delay
+    str r2, [r1]
+    b ok
+
+seq:
+    ldrb r6, [r4, #1]
+    cmp r6, #0
+    bne 1f
+    movs r6, #1
+    lsls r6, r6, #8
+1:  adds r4, #2
+    movs r7, #0
+    movs r0, #3
+    bl swdio_mode
+2:  lsrs r0, r7, #3
+    ldrb r0, [r4, r0]
+    movs r1, #7
+    ands r1, r7
+    lsrs r0, r0, r1
+    bl wbit
+    adds r7, #1
+    cmp r7, r6
+    bne 2b
+    b ok
+
+transfer:
+    ldrb r6, [r4, #2]
+    adds r4, #3
+    adds r0, r5, #3
+    mov r8, r0
+    movs r7, #0
+    movs r0, #1
+    mov r9, r0
+1:  cmp r7, r6
+    beq 9f
+    ldrb r0, [r4]
+    adds r4, #1
+    mov r10, r0
+    movs r1, #2
+    tst r0, r1
+    bne 3f
+    mov r0, r4
+    bl get32
+    ldr r1, =word
+    str r0, [r1]
+    adds r4, #4
+    mov r0, r10
+    ldr r1, =word
+    bl xfer
+    b 4f
+3:  ldr r1, =word
+    bl xfer
+    cmp r0, #1
+    bne 4f
+    mov r1, r10
+    movs r2, #1
+    tst r1, r2
+    beq 5f
+    movs r0, #0x0E
+    ldr r1, =word
+    bl xfer
+    cmp r0, #1
+    bne 4f
+5:  ldr r1, =word
+    ldr r1, [r1]
+    mov r0, r8
+    bl put32
+    mov r0, r8
+    adds r0, #4
+    mov r8, r0
+    movs r0, #1
+4:  mov r9, r0
+    cmp r0, #1
+    bne 9f
+    adds r7, #1
+    b 1b
+9:  strb r7, [r5, #1]
+    mov r0, r9
+    strb r0, [r5, #2]
+    b done
+
+block:
+    ldrb r6, [r4, #2]
+    ldrb r0, [r4, #3]
+    lsls r0, r0, #8
+    orrs r6, r0
+    ldrb r0, [r4, #4]
+    mov r10, r0
+    adds r4, #5
+    adds r0, r5, #4
+    mov r8, r0
+    movs r7, #0
+    movs r0, #1
+    mov r9, r0
+    mov r0, r10
+    movs r1, #2
+    tst r0, r1
+    beq 6f
+    ldr r1, =word
+    bl xfer
+    mov r9, r0
+    cmp r0, #1
+    bne 9f
+1:  cmp r7, r6
+    beq 9f
+    adds r0, r7, #1
+    cmp r0, r6
+    beq 2f
+    mov r0, r10
+    b 3f
+2:  movs r0, #0x0E
+3:  ldr r1, =word
+    bl xfer
+    mov r9, r0
+    cmp r0, #1
+    bne 9f
+    ldr r1, =word
+    ldr r1, [r1]
+    mov r0, r8
+    bl put32
+    mov r0, r8
+    adds r0, #4
+    mov r8, r0
+    adds r7, #1
+    b 1b
+6:  cmp r7, r6
+    beq 9f
+    mov r0, r4
+    bl get32
+    ldr r1, =word
+    str r0, [r1]
+    adds r4, #4
+    mov r0, r10
+    ldr r1, =word
+    bl xfer
+    mov r9, r0
+    cmp r0, #1
+    bne 9f
+    adds r7, #1
+    b 6b
+9:  strb r7, [r5, #1]
+    lsrs r0, r7, #8
+    strb r0, [r5, #2]
+    mov r0, r9
+    strb r0, [r5, #3]
+    b done
+    .ltorg
+
+    .bss
+    .align 2
+delay: .word 0
+word:  .word 0
@@ -0,0 +1,54 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* stand-in for tinyusb's device/dcd.h: the driver api tusb_port.c implements and the
+ * events it raises, which usb_loop.c handles.
+ */
+
+#ifndef DCD_H
+#define DCD_H
+
+#include "tusb.h"
+
+void dcd_init(uint8_t rhport);
+void dcd_int_enable(uint8_t rhport);
+void dcd_int_disable(uint8_t rhport);
+void dcd_int_handler(uint8_t rhport);
+void dcd_set_address(uint8_t rhport, uint8_t dev_addr);
+void dcd_remote_wakeup(uint8_t rhport);
+void dcd_sof_enable(uint8_t rhport, bool en);
+bool dcd_edpt_open(uint8_t rhport, tusb_desc_endpoint_t const * desc_ep);
+void dcd_edpt_close(uint8_t rhport, uint8_t ep_addr);
+void dcd_edpt_close_all(uint8_t rhport);
+bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes);
+void dcd_edpt_stall(uint8_t rhport, uint8_t ep_addr);
+void dcd_edpt_clear_stall(uint8_t rhport, uint8_t ep_addr);
+
+void dcd_event_setup_received(uint8_t rhport, uint8_t const * setup, bool in_isr);
+void dcd_event_xfer_complete(uint8_t rhport, uint8_t ep_addr, uint32_t xferred_bytes, uint8_t result, bool in_isr);
+void dcd_event_bus_reset(uint8_t rhport, int speed, bool in_isr);
+void dcd_event_bus_signal(uint8_t rhport, int eid, bool in_isr);
+
+#endif /* DCD_H */
@@ -0,0 +1,76 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* stand-in for the tinyusb headers, just what tusb_port.c and platform.h use, so
+ * usb_loop.c can run the port against sim_usb.c without the tinyusb submodule.
+ */
+
+#ifndef TUSB_H
+#define TUSB_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define TUSB_DIR_IN_MASK        0x80u
+#define TUD_OPT_RHPORT          0u
+#define CFG_TUD_ENDPOINT0_SIZE  64u
+
+enum { TUSB_XFER_CONTROL = 0, TUSB_XFER_ISOCHRONOUS, TUSB_XFER_BULK, TUSB_XFER_INTERRUPT };
+enum { TUSB_DIR_OUT = 0, TUSB_DIR_IN = 1 };
+enum { XFER_RESULT_SUCCESS = 0 };
+enum { TUSB_SPEED_FULL = 0 };
+enum { DCD_EVENT_SUSPEND = 5, DCD_EVENT_RESUME };
+
+typedef struct
+{
+    uint8_t  bLength;
+    uint8_t  bDescriptorType;
+    uint8_t  bEndpointAddress;
+    struct
+    {
+        uint8_t xfer  : 2;
+        uint8_t sync  : 2;
+        uint8_t usage : 2;
+        uint8_t       : 2;
+    } bmAttributes;
+    uint16_t wMaxPacketSize;
+    uint8_t  bInterval;
+} tusb_desc_endpoint_t;
+
+typedef struct
+{
+    uint32_t bit_rate;
+    uint8_t  stop_bits;
+    uint8_t  parity;
+    uint8_t  data_bits;
+} cdc_line_coding_t;
+
+static inline uint8_t tu_edpt_addr(uint8_t num, uint8_t dir)
+{
+    return (uint8_t)(num | (dir ? TUSB_DIR_IN_MASK : 0u));
+}
+
+#endif /* TUSB_H */
@@ -0,0 +1,311 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2023 UnsicentificLaLaLaLa
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+/* usb-loop: tusb_port.c against the usb host of sim_usb.c, with a small stand-in for the
+ * tinyusb device stack (the headers in test/tusb) so it runs without the submodule.
+ * it checks enumeration up to set configuration, a stalled request and the recovery
+ * after it, and a bulk echo on ep 1, which has to fill the frames to the bus limit and no further.
+ * exits non-zero on the first failure.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "device/dcd.h"
+#include "device/usbd_pvt.h"
+#include "sim.h"
+
+#define USB_LOOP_EVENTS         64u
+#define USB_LOOP_TIMEOUT        960000000ull    /* 10 s of virtual time. */
+#define USB_LOOP_ADDR           7u
+#define USB_LOOP_ECHO_SIZE      512u
+#define USB_LOOP_ECHO_RUNS      20u
+#define USB_LOOP_FRAME_PACKETS  19u             /* 64 byte bulk packets that fit the 1500 byte frame. */
+
+enum
+{
+    USB_LOOP_EV_SETUP = 1,
+    USB_LOOP_EV_XFER,
+    USB_LOOP_EV_RESET,
+};
+
+typedef struct
+{
+    uint8_t  kind;
+    uint8_t  ep_addr;
+    uint32_t len;
+    uint8_t  setup[8];
+} usb_loop_event_t;
+
+static const uint8_t usb_loop_dev_desc[18] =
+{
+    18u, 1u, 0x00u, 0x02u, 0u, 0u, 0u, 64u, 0x34u, 0x12u, 0x78u, 0x56u, 0x00u, 0x01u, 0u, 0u, 0u, 1u,
+};
+
+/* the stand-in stack: events queued from the usb isr, handled in usb_loop_task(). */
+static usb_loop_event_t usb_loop_events[USB_LOOP_EVENTS];
+static volatile uint32_t usb_loop_head = 0u;
+static uint32_t usb_loop_tail = 0u;
+static uint8_t  usb_loop_ep0[CFG_TUD_ENDPOINT0_SIZE];
+static uint8_t  usb_loop_out[USB_LOOP_ECHO_SIZE];
+static uint8_t  usb_loop_in[USB_LOOP_ECHO_SIZE];
+static bool     usb_loop_ep0_data; /* a descriptor is going out, its status stage follows. */
+
+/* what the host side saw. */
+static volatile bool usb_loop_done;
+static int32_t  usb_loop_result;
+static uint32_t usb_loop_len;
+static uint32_t usb_loop_failures = 0u;
+
+static void usb_loop_push(usb_loop_event_t ev)
+{
+    usb_loop_events[usb_loop_head % USB_LOOP_EVENTS] = ev;
+    usb_loop_head++;
+}
+
+void dcd_event_setup_received(uint8_t rhport, uint8_t const * setup, bool in_isr)
+{
+    usb_loop_event_t ev = { .kind = USB_LOOP_EV_SETUP };
+
+    (void) rhport;
+    (void) in_isr;
+    memcpy(ev.setup, setup, sizeof(ev.setup));
+    usb_loop_push(ev);
+}
+
+void dcd_event_xfer_complete(uint8_t rhport, uint8_t ep_addr, uint32_t xferred_bytes, uint8_t result, bool in_isr)
+{
+    usb_loop_event_t ev = { .kind = USB_LOOP_EV_XFER, .ep_addr = ep_addr, .len = xferred_bytes };
+
+    (void) rhport;
+    (void) result;
+    (void) in_isr;
+    usb_loop_push(ev);
+}
+
+void dcd_event_bus_reset(uint8_t rhport, int speed, bool in_isr)
+{
+    usb_loop_event_t ev = { .kind = USB_LOOP_EV_RESET };
+
+    (void) rhport;
+    (void) speed;
+    (void) in_isr;
+    usb_loop_push(ev);
+}
+
+void dcd_event_bus_signal(uint8_t rhport, int eid, bool in_isr)
+{
+    (void) rhport;
+    (void) eid;
+    (void) in_isr;
+}
+
+/* tusb_port_notify() is not exercised, the class drivers are not here. */
+bool usbd_edpt_claim(uint8_t rhport, uint8_t ep_addr)
+{
+    (void) rhport;
+    (void) ep_addr;
+    return true;
+}
+
+bool usbd_edpt_release(uint8_t rhport, uint8_t ep_addr)
+{
+    (void) rhport;
+    (void) ep_addr;
+    return true;
+}
+
+bool usbd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t * buffer, uint16_t total_bytes)
+{
+    return dcd_edpt_xfer(rhport, ep_addr, buffer, total_bytes);
+}
+
+static void usb_loop_setup(const uint8_t *setup)
+{
+    uint16_t length = (uint16_t)(setup[6] | (setup[7] << 8));
+
+    switch (setup[1])
+    {
+        case 0x06u: /* GET_DESCRIPTOR, always the device descriptor. */
+        {
+            uint16_t n = (length < sizeof(usb_loop_dev_desc)) ? length : (uint16_t)sizeof(usb_loop_dev_desc);
+            memcpy(usb_loop_ep0, usb_loop_dev_desc, n);
+            dcd_edpt_xfer(0u, 0x80u, usb_loop_ep0, n);
+            usb_loop_ep0_data = true;
+            break;
+        }
+        case 0x05u: /* SET_ADDRESS, the port sends the status stage itself. */
+            dcd_set_address(0u, setup[2]);
+            break;
+        case 0x09u: /* SET_CONFIGURATION, bulk ep 1 echoes what it gets. */
+        {
+            tusb_desc_endpoint_t desc = { .bLength = 7u, .bDescriptorType = 5u, .bEndpointAddress = 0x01u, .wMaxPacketSize = 64u };
+            desc.bmAttributes.xfer = TUSB_XFER_BULK;
+            dcd_edpt_open(0u, &desc);
+            desc.bEndpointAddress = 0x81u;
+            dcd_edpt_open(0u, &desc);
+            dcd_edpt_xfer(0u, 0x80u, NULL, 0u);
+            dcd_edpt_xfer(0u, 0x01u, usb_loop_out, sizeof(usb_loop_out));
+            break;
+        }
+        default:
+            dcd_edpt_stall(0u, 0x00u);
+            break;
+    }
+}
+
+static void usb_loop_task(void)
+{
+    while (usb_loop_tail != usb_loop_head)
+    {
+        usb_loop_event_t ev = usb_loop_events[usb_loop_tail % USB_LOOP_EVENTS];
+        usb_loop_tail++;
+        if (USB_LOOP_EV_RESET == ev.kind)
+        {
+            usb_loop_ep0_data = false;
+        }
+        else if (USB_LOOP_EV_SETUP == ev.kind)
+        {
+            usb_loop_setup(ev.setup);
+        }
+        else if ( (0x80u == ev.ep_addr) && usb_loop_ep0_data )
+        {
+            usb_loop_ep0_data = false;
+            dcd_edpt_xfer(0u, 0x00u, NULL, 0u);
+        }
+        else if (0x01u == ev.ep_addr)
+        {
+            memcpy(usb_loop_in, usb_loop_out, ev.len);
+            dcd_edpt_xfer(0u, 0x81u, usb_loop_in, (uint16_t)ev.len);
+        }
+        else if (0x81u == ev.ep_addr)
+        {
+            dcd_edpt_xfer(0u, 0x01u, usb_loop_out, sizeof(usb_loop_out));
+        }
+    }
+}
+
+static void usb_loop_complete(void *ctx, int32_t result, uint32_t len)
+{
+    (void) ctx;
+    usb_loop_result = result;
+    usb_loop_len    = len;
+    usb_loop_done   = true;
+}
+
+/* run the device until the host transfer completes, then check its outcome. */
+static void usb_loop_expect(const char *what, int32_t result, uint32_t len)
+{
+    uint64_t start = sim_cycles();
+
+    while (!usb_loop_done && ((sim_cycles() - start) < USB_LOOP_TIMEOUT))
+    {
+        usb_loop_task();
+        sim_idle();
+    }
+    if (!usb_loop_done)
+    {
+        printf("FAIL %s: no completion\n", what);
+        usb_loop_failures++;
+    }
+    else if ( (result != usb_loop_result) || (len != usb_loop_len) )
+    {
+        printf("FAIL %s: result %d len %u, expected %d len %u\n", what, (int)usb_loop_result, (unsigned)usb_loop_len, (int)result, (unsigned)len);
+        usb_loop_failures++;
+    }
+    else
+    {
+        printf("ok   %s\n", what);
+    }
+    usb_loop_done = false;
+}
+
+int main(void)
+{
+    static const uint8_t get_desc[8] = {0x80u, 0x06u, 0x00u, 0x01u, 0x00u, 0x00u, 64u, 0x00u};
+    static const uint8_t set_addr[8] = {0x00u, 0x05u, USB_LOOP_ADDR, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u};
+    static const uint8_t bad_req[8]  = {0x80u, 0x33u, 0x00u, 0x00u, 0x00u, 0x00u, 8u, 0x00u};
+    static const uint8_t set_cfg[8]  = {0x00u, 0x09u, 0x01u, 0x00u, 0x00u, 0x00u, 0x00u, 0x00u};
+    static uint8_t buf[USB_LOOP_ECHO_SIZE];
+    static uint8_t back[USB_LOOP_ECHO_SIZE];
+    sim_usb_stats_t stats;
+
+    dcd_init(0u);
+    dcd_int_enable(0u);
+    sim_usb_connect(true);
+
+    sim_usb_control(get_desc, buf, usb_loop_complete, NULL);
+    usb_loop_expect("get device descriptor", SIM_USB_OK, sizeof(usb_loop_dev_desc));
+    sim_usb_control(set_addr, NULL, usb_loop_complete, NULL);
+    usb_loop_expect("set address", SIM_USB_OK, 0u);
+    sim_usb_control(get_desc, buf, usb_loop_complete, NULL);
+    usb_loop_expect("get device descriptor at the new address", SIM_USB_OK, sizeof(usb_loop_dev_desc));
+    if (0 != memcmp(buf, usb_loop_dev_desc, sizeof(usb_loop_dev_desc)))
+    {
+        printf("FAIL device descriptor contents\n");
+        usb_loop_failures++;
+    }
+    sim_usb_control(bad_req, buf, usb_loop_complete, NULL);
+    usb_loop_expect("unknown request stalls", SIM_USB_STALL, 0u);
+    sim_usb_control(get_desc, buf, usb_loop_complete, NULL);
+    usb_loop_expect("get device descriptor after the stall", SIM_USB_OK, sizeof(usb_loop_dev_desc));
+    sim_usb_control(set_cfg, NULL, usb_loop_complete, NULL);
+    usb_loop_expect("set configuration", SIM_USB_OK, 0u);
+
+    sim_usb_pipe(0x01u, TUSB_XFER_BULK, 64u, 0u);
+    sim_usb_pipe(0x81u, TUSB_XFER_BULK, 64u, 0u);
+    sim_usb_stats(NULL, true);
+    for (uint32_t run = 0u; run < USB_LOOP_ECHO_RUNS; run++)
+    {
+        for (uint32_t i = 0u; i < sizeof(buf); i++)
+        {
+            buf[i] = (uint8_t)((i * 7u) + run);
+        }
+        sim_usb_transfer(0x01u, buf, sizeof(buf), usb_loop_complete, NULL);
+        usb_loop_expect("bulk out", SIM_USB_OK, sizeof(buf));
+        memset(back, 0, sizeof(back));
+        sim_usb_transfer(0x81u, back, sizeof(back), usb_loop_complete, NULL);
+        usb_loop_expect("bulk in", SIM_USB_OK, sizeof(back));
+        if (0 != memcmp(buf, back, sizeof(buf)))
+        {
+            printf("FAIL bulk echo contents, run %u\n", (unsigned)run);
+            usb_loop_failures++;
+        }
+    }
+
+    sim_usb_stats(&stats, false);
+    printf("%u packets in %u frames, at most %u per frame, %u naks, %u toggle errors\n",
+           (unsigned)stats.packets, (unsigned)stats.frames, (unsigned)stats.max_frame_packets,
+           (unsigned)stats.naks, (unsigned)stats.toggle_errors);
+    if ( (USB_LOOP_FRAME_PACKETS != stats.max_frame_packets) || (0u != stats.toggle_errors) || (0u != stats.stalls) )
+    {
+        printf("FAIL bulk schedule\n");
+        usb_loop_failures++;
+    }
+    printf("%s\n", (0u == usb_loop_failures) ? "PASS" : "FAIL");
+    return (0u == usb_loop_failures) ? 0 : 1;
+}
+
+/* usb_loop.c - end */
@@ -114,7 +114,7 @@ This information includes:
 #define SWO_STREAM              0               ///< SWO Streaming Trace: 1 = available, 0 = not available.
 
 /// Clock frequency of the Test Domain Timer. Timer value is returned with \ref TIMESTAMP_GET.
-#define TIMESTAMP_CLOCK         0U              ///< Timestamp clock in Hz (0 = timestamps not supported).
+#define TIMESTAMP_CLOCK         96000000U       ///< Timestamp clock in Hz (0 = timestamps not supported).
 
 /// Indicate that UART Communication Port is available.
 /// This information is returned by the command \ref DAP_Info as part of <b>Capabilities</b>.
@@ -159,6 +159,7 @@ static const char TargetBoardName    [] = TARGET_BOARD_NAME;
 #define BRD_DAP_SWCLK_GPIO_PIN       GPIO_PIN_1
 #define BRD_DAP_SWDIO_GPIO_PORT      GPIOA
 #define BRD_DAP_SWDIO_GPIO_PIN       GPIO_PIN_0
+#define BRD_DAP_SWDIO_GPIO_CRL_POS   (0u * 4u)   /* mode nibble of the swdio pin in CRL, pins 0..7 only. */
 #define BRD_DAP_CONN_LED_GPIO_PORT   GPIOA
 #define BRD_DAP_CONN_LED_GPIO_PIN    GPIO_PIN_6
 
@@ -453,11 +454,11 @@ Configure the SWDIO DAP hardware I/O pin to output mode. This function is
 called prior \ref PIN_SWDIO_OUT function calls.
 */
 __STATIC_FORCEINLINE void     PIN_SWDIO_OUT_ENABLE  (void) {
-  GPIO_Init_Type gpio_init;
-  gpio_init.Pins    = BRD_DAP_SWDIO_GPIO_PIN;
-  gpio_init.PinMode = GPIO_PinMode_Out_PushPull;
-  gpio_init.Speed   = GPIO_Speed_50MHz;
-  GPIO_Init(BRD_DAP_SWDIO_GPIO_PORT, &gpio_init);
+  /* what GPIO_Init() writes for a 50MHz push-pull output, inline so the bit loops in sram
+   * do not call into flash at every turnaround.
+   */
+  BRD_DAP_SWDIO_GPIO_PORT->CRL = (BRD_DAP_SWDIO_GPIO_PORT->CRL & ~(0xFu << BRD_DAP_SWDIO_GPIO_CRL_POS))
+                               | ((uint32_t)GPIO_Speed_50MHz << BRD_DAP_SWDIO_GPIO_CRL_POS);
 }
 
 /** SWDIO I/O pin: Switch to Input mode (used in SWD mode only).
@@ -465,11 +466,9 @@ Configure the SWDIO DAP hardware I/O pin to input mode. This function is
 called prior \ref PIN_SWDIO_IN function calls.
 */
 __STATIC_FORCEINLINE void     PIN_SWDIO_OUT_DISABLE (void) {
-  GPIO_Init_Type gpio_init;
-  gpio_init.Pins    = BRD_DAP_SWDIO_GPIO_PIN;
-  gpio_init.PinMode = GPIO_PinMode_In_Floating;
-  gpio_init.Speed   = GPIO_Speed_50MHz;
-  GPIO_Init(BRD_DAP_SWDIO_GPIO_PORT, &gpio_init);
+  /* floating input, as GPIO_Init() would set it. */
+  BRD_DAP_SWDIO_GPIO_PORT->CRL = (BRD_DAP_SWDIO_GPIO_PORT->CRL & ~(0xFu << BRD_DAP_SWDIO_GPIO_CRL_POS))
+                               | ((uint32_t)GPIO_PinMode_In_Floating << BRD_DAP_SWDIO_GPIO_CRL_POS);
 }
 
 
@@ -592,8 +591,9 @@ __STATIC_INLINE void LED_RUNNING_OUT (uint32_t bit) {}
 @{
 Access function for Test Domain Timer.
 
-The value of the Test Domain Timer in the Debug Unit is returned by the function \ref TIMESTAMP_GET. By
-default, the DWT timer is used.  The frequency of this timer is configured with \ref TIMESTAMP_CLOCK.
+The value of the Test Domain Timer in the Debug Unit is returned by the function \ref TIMESTAMP_GET. The
+Cortex-M0 has no DWT, so the free-running TIM2 set up by platform_init() is used.  The frequency of this
+timer is configured with \ref TIMESTAMP_CLOCK.
 
 */
 
@@ -601,7 +601,7 @@ default, the DWT timer is used.  The frequency of this timer is configured with
 \return Current timestamp value.
 */
 __STATIC_INLINE uint32_t TIMESTAMP_GET (void) {
-  return 0;
+  return TIM2->CNT;
 }
 
 ///@}
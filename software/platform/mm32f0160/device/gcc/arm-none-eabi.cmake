@@ -0,0 +1,30 @@
+# arm-none-eabi gcc for the MM32F0163D (cortex-m0), for the firmware build:
+#   cmake -S . -B build-arm -DCMAKE_TOOLCHAIN_FILE=platform/mm32f0160/device/gcc/arm-none-eabi.cmake
+# set ARM_TOOLCHAIN_DIR when the toolchain is not on the PATH.
+
+set(CMAKE_SYSTEM_NAME Generic)
+set(CMAKE_SYSTEM_PROCESSOR arm)
+
+if(DEFINED ENV{ARM_TOOLCHAIN_DIR})
+    set(ARM_TOOLCHAIN_PREFIX $ENV{ARM_TOOLCHAIN_DIR}/bin/arm-none-eabi-)
+else()
+    set(ARM_TOOLCHAIN_PREFIX arm-none-eabi-)
+endif()
+
+set(CMAKE_C_COMPILER   ${ARM_TOOLCHAIN_PREFIX}gcc)
+set(CMAKE_ASM_COMPILER ${ARM_TOOLCHAIN_PREFIX}gcc)
+set(CMAKE_AR           ${ARM_TOOLCHAIN_PREFIX}gcc-ar)
+set(CMAKE_RANLIB       ${ARM_TOOLCHAIN_PREFIX}gcc-ranlib)
+set(CMAKE_OBJCOPY      ${ARM_TOOLCHAIN_PREFIX}objcopy)
+set(CMAKE_SIZE         ${ARM_TOOLCHAIN_PREFIX}size)
+
+# no host libraries or startup files to link a test program against.
+set(CMAKE_TRY_COMPILE_TARGET_TYPE STATIC_LIBRARY)
+
+set(CMAKE_C_FLAGS_INIT          "-mcpu=cortex-m0 -mthumb -ffunction-sections -fdata-sections")
+set(CMAKE_ASM_FLAGS_INIT        "-mcpu=cortex-m0 -mthumb")
+set(CMAKE_EXE_LINKER_FLAGS_INIT "-mcpu=cortex-m0 -mthumb -nostartfiles -specs=nano.specs -specs=nosys.specs -Wl,--gc-sections")
+
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
@@ -0,0 +1,203 @@
+/* ------------------------------------------------------------------------- */
+/*  @file:    startup_mm32f0163d.s                                           */
+/*  @purpose: CMSIS Cortex-M0 Core Device Startup File, GNU assembler         */
+/*                                                                           */
+/*  gcc counterpart of mdk/startup_mm32f0163d.s, for gcc/linker/              */
+/*  mm32f0163d_flash.ld. the reset handler does what __main does for keil:    */
+/*  copy .ramfunc and .data to sram and clear .bss, after SystemInit() so the */
+/*  copy runs at full clock.                                                  */
+/* ------------------------------------------------------------------------- */
+/*                                                                           */
+/* Copyright 2022 MindMotion                                                 */
+/* All rights reserved.                                                      */
+/*                                                                           */
+/* SPDX-License-Identifier: BSD-3-Clause                                     */
+/*****************************************************************************/
+
+                .syntax unified
+                .cpu    cortex-m0
+                .thumb
+
+/* Vector Table Mapped to Address 0 at Reset */
+                .section .isr_vector, "a"
+                .align  2
+                .globl  __Vectors
+                .globl  __Vectors_End
+                .globl  __Vectors_Size
+__Vectors:
+                .long   __StackTop                                              /*     Top of Stack */
+                .long   Reset_Handler                                           /*     Reset Handler */
+                .long   NMI_Handler                                             /* -14 NMI Handler */
+                .long   HardFault_Handler                                       /* -13 Hard Fault Handler */
+                .long   0                                                       /* -12 Reserved */
+                .long   0                                                       /* -11 Reserved */
+                .long   0                                                       /* -10 Reserved */
+                .long   0                                                       /* -9  Reserved */
+                .long   0                                                       /* -8  Reserved */
+                .long   0                                                       /* -7  Reserved */
+                .long   0                                                       /* -6  Reserved */
+                .long   SVCall_Handler                                          /* -5  SVCall Handler */
+                .long   0                                                       /* -4  Reserved */
+                .long   0                                                       /* -3  Reserved */
+                .long   PendSV_Handler                                          /* -2  PendSV Handler */
+                .long   SysTick_Handler                                         /* -1  SysTick Handler */
+
+                .long   WWDG_IWDG_IRQHandler                                    /* 0   WWDG_IWDG */
+                .long   PVD_IRQHandler                                          /* 1   PVD */
+                .long   RTC_BKP_IRQHandler                                      /* 2   RTC_BKP */
+                .long   FLASH_IRQHandler                                        /* 3   FLASH */
+                .long   RCC_IRQHandler                                          /* 4   RCC */
+                .long   EXTI0_1_IRQHandler                                      /* 5   EXTI0_1 */
+                .long   EXTI3_2_IRQHandler                                      /* 6   EXTI3_2 */
+                .long   EXTI15_4_IRQHandler                                     /* 7   EXTI15_4 */
+                .long   HWDIV_IRQHandler                                        /* 8   HWDIV */
+                .long   DMA1_CH1_IRQHandler                                     /* 9   DMA1_CH1 */
+                .long   DMA1_CH3_CH2_IRQHandler                                 /* 10  DMA1_CH3_CH2 */
+                .long   DMA1_CH7_CH4_IRQHandler                                 /* 11  DMA1_CH7_CH4 */
+                .long   ADC_COMP_IRQHandler                                     /* 12  ADC_COMP */
+                .long   TIM1_BRK_UP_TRG_COM_IRQHandler                          /* 13  TIM1_BRK_UP_TRG_COM */
+                .long   TIM1_CC_IRQHandler                                      /* 14  TIM1_CC */
+                .long   TIM2_IRQHandler                                         /* 15  TIM2 */
+                .long   TIM3_IRQHandler                                         /* 16  TIM3 */
+                .long   LPUART_IRQHandler                                       /* 17  LPUART */
+                .long   LPTIM_IRQHandler                                        /* 18  LPTIM */
+                .long   TIM14_IRQHandler                                        /* 19  TIM14 */
+                .long   0                                                       /* 20  Reserved */
+                .long   TIM16_IRQHandler                                        /* 21  TIM16 */
+                .long   TIM17_IRQHandler                                        /* 22  TIM17 */
+                .long   I2C1_IRQHandler                                         /* 23  I2C1 */
+                .long   I3C1_IRQHandler                                         /* 24  I3C1 */
+                .long   SPI1_IRQHandler                                         /* 25  SPI1 */
+                .long   SPI2_IRQHandler                                         /* 26  SPI2 */
+                .long   UART1_IRQHandler                                        /* 27  UART1 */
+                .long   UART2_IRQHandler                                        /* 28  UART2 */
+                .long   UART3_4_IRQHandler                                      /* 29  UART3_4 */
+                .long   FLEXCAN_IRQHandler                                      /* 30  FLEXCAN */
+                .long   USB_IRQHandler                                          /* 31  USB */
+
+__Vectors_End:
+                .equ    __Vectors_Size, __Vectors_End - __Vectors
+
+                .text
+
+/* Reset handler */
+                .thumb_func
+                .weak   Reset_Handler
+                .type   Reset_Handler, %function
+Reset_Handler:
+                ldr     r0, =SystemInit
+                blx     r0
+                ldr     r1, =__ramfunc_load__
+                ldr     r2, =__ramfunc_start__
+                ldr     r3, =__ramfunc_end__
+                bl      copy_words
+                ldr     r1, =__data_load__
+                ldr     r2, =__data_start__
+                ldr     r3, =__data_end__
+                bl      copy_words
+                ldr     r2, =__bss_start__
+                ldr     r3, =__bss_end__
+                movs    r0, #0
+1:              cmp     r2, r3
+                bhs     2f
+                stmia   r2!, {r0}
+                b       1b
+2:              bl      main
+                b       .
+                .size   Reset_Handler, . - Reset_Handler
+
+/* words from r1 to r2 until r2 reaches r3. */
+                .thumb_func
+                .type   copy_words, %function
+copy_words:
+                cmp     r2, r3
+                bhs     1f
+                ldmia   r1!, {r0}
+                stmia   r2!, {r0}
+                b       copy_words
+1:              bx      lr
+                .size   copy_words, . - copy_words
+
+/* Dummy Exception Handlers (infinite loops which can be modified) */
+                .thumb_func
+                .type   Default_Handler, %function
+Default_Handler:
+                b       .
+                .size   Default_Handler, . - Default_Handler
+
+                .pool
+
+                .weak   NMI_Handler
+                .thumb_set NMI_Handler, Default_Handler
+                .weak   HardFault_Handler
+                .thumb_set HardFault_Handler, Default_Handler
+                .weak   SVCall_Handler
+                .thumb_set SVCall_Handler, Default_Handler
+                .weak   PendSV_Handler
+                .thumb_set PendSV_Handler, Default_Handler
+                .weak   SysTick_Handler
+                .thumb_set SysTick_Handler, Default_Handler
+                .weak   WWDG_IWDG_IRQHandler
+                .thumb_set WWDG_IWDG_IRQHandler, Default_Handler
+                .weak   PVD_IRQHandler
+                .thumb_set PVD_IRQHandler, Default_Handler
+                .weak   RTC_BKP_IRQHandler
+                .thumb_set RTC_BKP_IRQHandler, Default_Handler
+                .weak   FLASH_IRQHandler
+                .thumb_set FLASH_IRQHandler, Default_Handler
+                .weak   RCC_IRQHandler
+                .thumb_set RCC_IRQHandler, Default_Handler
+                .weak   EXTI0_1_IRQHandler
+                .thumb_set EXTI0_1_IRQHandler, Default_Handler
+                .weak   EXTI3_2_IRQHandler
+                .thumb_set EXTI3_2_IRQHandler, Default_Handler
+                .weak   EXTI15_4_IRQHandler
+                .thumb_set EXTI15_4_IRQHandler, Default_Handler
+                .weak   HWDIV_IRQHandler
+                .thumb_set HWDIV_IRQHandler, Default_Handler
+                .weak   DMA1_CH1_IRQHandler
+                .thumb_set DMA1_CH1_IRQHandler, Default_Handler
+                .weak   DMA1_CH3_CH2_IRQHandler
+                .thumb_set DMA1_CH3_CH2_IRQHandler, Default_Handler
+                .weak   DMA1_CH7_CH4_IRQHandler
+                .thumb_set DMA1_CH7_CH4_IRQHandler, Default_Handler
+                .weak   ADC_COMP_IRQHandler
+                .thumb_set ADC_COMP_IRQHandler, Default_Handler
+                .weak   TIM1_BRK_UP_TRG_COM_IRQHandler
+                .thumb_set TIM1_BRK_UP_TRG_COM_IRQHandler, Default_Handler
+                .weak   TIM1_CC_IRQHandler
+                .thumb_set TIM1_CC_IRQHandler, Default_Handler
+                .weak   TIM2_IRQHandler
+                .thumb_set TIM2_IRQHandler, Default_Handler
+                .weak   TIM3_IRQHandler
+                .thumb_set TIM3_IRQHandler, Default_Handler
+                .weak   LPUART_IRQHandler
+                .thumb_set LPUART_IRQHandler, Default_Handler
+                .weak   LPTIM_IRQHandler
+                .thumb_set LPTIM_IRQHandler, Default_Handler
+                .weak   TIM14_IRQHandler
+                .thumb_set TIM14_IRQHandler, Default_Handler
+                .weak   TIM16_IRQHandler
+                .thumb_set TIM16_IRQHandler, Default_Handler
+                .weak   TIM17_IRQHandler
+                .thumb_set TIM17_IRQHandler, Default_Handler
+                .weak   I2C1_IRQHandler
+                .thumb_set I2C1_IRQHandler, Default_Handler
+                .weak   I3C1_IRQHandler
+                .thumb_set I3C1_IRQHandler, Default_Handler
+                .weak   SPI1_IRQHandler
+                .thumb_set SPI1_IRQHandler, Default_Handler
+                .weak   SPI2_IRQHandler
+                .thumb_set SPI2_IRQHandler, Default_Handler
+                .weak   UART1_IRQHandler
+                .thumb_set UART1_IRQHandler, Default_Handler
+                .weak   UART2_IRQHandler
+                .thumb_set UART2_IRQHandler, Default_Handler
+                .weak   UART3_4_IRQHandler
+                .thumb_set UART3_4_IRQHandler, Default_Handler
+                .weak   FLEXCAN_IRQHandler
+                .thumb_set FLEXCAN_IRQHandler, Default_Handler
+                .weak   USB_IRQHandler
+                .thumb_set USB_IRQHandler, Default_Handler
+
+                .end
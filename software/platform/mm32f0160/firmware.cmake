@@ -0,0 +1,149 @@
+# arm-none-eabi gcc build of the probe firmware, included by the top CMakeLists.txt with
+# device/gcc/arm-none-eabi.cmake as the toolchain file. same sources and defines as the keil
+# project in mdk/project.uvprojx, linked with device/gcc/linker/mm32f0163d_flash.ld.
+#
+# MM32_OPT_PROFILE:
+#   split  the swd, usb and dma paths (MM32_FAST_SOURCES) for speed, the rest for size.
+#   speed  everything for speed.
+#   size   everything for size.
+# MM32_LTO links with link time optimisation. gcc keeps the per file optimisation level
+# through lto. SW_DP.c and hal_usb.c stay out of it, the linker script puts them into
+# .ramfunc by object file name.
+# tiny-dap.elf, .hex and .bin come out with a section size report and a map file.
+# tools/fw_profiles.py builds every profile and compares code size and swd-cycles timings.
+
+enable_language(ASM)
+
+set(MM32_OPT_PROFILE "split" CACHE STRING "optimisation profile: split, speed or size")
+set_property(CACHE MM32_OPT_PROFILE PROPERTY STRINGS split speed size)
+option(MM32_LTO "link time optimisation" ON)
+
+set(MM32_OPT_SPEED -O2)
+set(MM32_OPT_SIZE  -Os)
+
+if(NOT (EXISTS ${TINYUSB_DIR}/src/tusb.h AND EXISTS ${CMSIS_DAP_DIR}/Source/DAP.c))
+    message(FATAL_ERROR "the firmware needs the tinyusb and CMSIS_5 submodules: git submodule update --init")
+endif()
+
+set(CMAKE_C_STANDARD 11)
+set(CMAKE_C_EXTENSIONS ON)
+
+# the hot paths: swd bit loops and transfer engine, usb dcd and device stack, uart dma.
+set(MM32_FAST_SOURCES
+    ${APP_DIR}/swj_tune.c
+    ${APP_DIR}/stream.c
+    ${APP_DIR}/serial.c
+    ${MM32_DIR}/tusb_port.c
+    ${MM32_DIR}/uart_port.c
+    ${DEVICE_DIR}/drivers/hal_dma.c
+    ${DEVICE_DIR}/drivers/hal_gpio.c
+    ${DEVICE_DIR}/drivers/hal_uart.c
+    ${DEVICE_DIR}/drivers/hal_usb.c
+    ${TINYUSB_DIR}/src/common/tusb_fifo.c
+    ${TINYUSB_DIR}/src/device/usbd.c
+    ${TINYUSB_DIR}/src/class/cdc/cdc_device.c
+    ${TINYUSB_DIR}/src/class/hid/hid_device.c
+    ${TINYUSB_DIR}/src/class/vendor/vendor_device.c
+    ${CMSIS_DAP_DIR}/Source/DAP.c
+    ${CMSIS_DAP_DIR}/Source/SW_DP.c
+)
+
+add_executable(tiny-dap
+    ${APP_DIR}/main.c
+    ${APP_DIR}/tusb_descriptors.c
+    ${APP_DIR}/target.c
+    ${APP_DIR}/swj_tune.c
+    ${APP_DIR}/DAP_vendor.c
+    ${APP_DIR}/core_reg.c
+    ${APP_DIR}/stream.c
+    ${APP_DIR}/halt_mon.c
+    ${APP_DIR}/profile.c
+    ${APP_DIR}/serial.c
+    ${APP_DIR}/isp.c
+    ${APP_DIR}/bench.c
+    ${APP_DIR}/trace.c
+    ${MM32_DIR}/platform.c
+    ${MM32_DIR}/tusb_port.c
+    ${MM32_DIR}/uart_port.c
+    ${DEVICE_DIR}/system_mm32f0163d.c
+    ${DEVICE_DIR}/gcc/startup_mm32f0163d.s
+    ${DEVICE_DIR}/drivers/hal_adc.c
+    ${DEVICE_DIR}/drivers/hal_bkp.c
+    ${DEVICE_DIR}/drivers/hal_comp.c
+    ${DEVICE_DIR}/drivers/hal_crc.c
+    ${DEVICE_DIR}/drivers/hal_dma.c
+    ${DEVICE_DIR}/drivers/hal_exti.c
+    ${DEVICE_DIR}/drivers/hal_flash.c
+    ${DEVICE_DIR}/drivers/hal_flexcan.c
+    ${DEVICE_DIR}/drivers/hal_gpio.c
+    ${DEVICE_DIR}/drivers/hal_hwdiv.c
+    ${DEVICE_DIR}/drivers/hal_i2c.c
+    ${DEVICE_DIR}/drivers/hal_i2s.c
+    ${DEVICE_DIR}/drivers/hal_i3c.c
+    ${DEVICE_DIR}/drivers/hal_iwdg.c
+    ${DEVICE_DIR}/drivers/hal_lptim.c
+    ${DEVICE_DIR}/drivers/hal_lpuart.c
+    ${DEVICE_DIR}/drivers/hal_power.c
+    ${DEVICE_DIR}/drivers/hal_pwr.c
+    ${DEVICE_DIR}/drivers/hal_rcc.c
+    ${DEVICE_DIR}/drivers/hal_rtc.c
+    ${DEVICE_DIR}/drivers/hal_spi.c
+    ${DEVICE_DIR}/drivers/hal_syscfg.c
+    ${DEVICE_DIR}/drivers/hal_tim.c
+    ${DEVICE_DIR}/drivers/hal_uart.c
+    ${DEVICE_DIR}/drivers/hal_usb.c
+    ${DEVICE_DIR}/drivers/hal_wwdg.c
+    ${TINYUSB_DIR}/src/tusb.c
+    ${TINYUSB_DIR}/src/common/tusb_fifo.c
+    ${TINYUSB_DIR}/src/device/usbd.c
+    ${TINYUSB_DIR}/src/device/usbd_control.c
+    ${TINYUSB_DIR}/src/class/cdc/cdc_device.c
+    ${TINYUSB_DIR}/src/class/hid/hid_device.c
+    ${TINYUSB_DIR}/src/class/vendor/vendor_device.c
+    ${CMSIS_DAP_DIR}/Source/DAP.c
+    ${CMSIS_DAP_DIR}/Source/SW_DP.c
+)
+set_target_properties(tiny-dap PROPERTIES SUFFIX .elf)
+target_compile_definitions(tiny-dap PRIVATE CFG_TUSB_MCU)
+target_include_directories(tiny-dap PRIVATE
+    ${DEVICE_DIR}
+    ${DEVICE_DIR}/drivers
+    ${MM32_DIR}
+    ${APP_DIR}
+    ${CMAKE_CURRENT_SOURCE_DIR}/third-party/CMSIS_5/CMSIS/Core/Include
+    ${CMSIS_DAP_DIR}/Include
+    ${TINYUSB_DIR}/src
+)
+target_compile_options(tiny-dap PRIVATE -Wall -g)
+target_link_options(tiny-dap PRIVATE
+    -T${DEVICE_DIR}/gcc/linker/mm32f0163d_flash.ld
+    -Wl,-Map=$<TARGET_FILE_DIR:tiny-dap>/tiny-dap.map
+)
+set_property(TARGET tiny-dap APPEND PROPERTY LINK_DEPENDS ${DEVICE_DIR}/gcc/linker/mm32f0163d_flash.ld)
+
+if(MM32_OPT_PROFILE STREQUAL "split")
+    target_compile_options(tiny-dap PRIVATE ${MM32_OPT_SIZE})
+    target_link_options(tiny-dap PRIVATE ${MM32_OPT_SIZE})
+    set_property(SOURCE ${MM32_FAST_SOURCES} APPEND PROPERTY COMPILE_OPTIONS ${MM32_OPT_SPEED})
+elseif(MM32_OPT_PROFILE STREQUAL "speed")
+    target_compile_options(tiny-dap PRIVATE ${MM32_OPT_SPEED})
+    target_link_options(tiny-dap PRIVATE ${MM32_OPT_SPEED})
+elseif(MM32_OPT_PROFILE STREQUAL "size")
+    target_compile_options(tiny-dap PRIVATE ${MM32_OPT_SIZE})
+    target_link_options(tiny-dap PRIVATE ${MM32_OPT_SIZE})
+else()
+    message(FATAL_ERROR "MM32_OPT_PROFILE must be split, speed or size, not ${MM32_OPT_PROFILE}")
+endif()
+
+if(MM32_LTO)
+    target_compile_options(tiny-dap PRIVATE -flto)
+    target_link_options(tiny-dap PRIVATE -flto)
+    set_property(SOURCE ${CMSIS_DAP_DIR}/Source/SW_DP.c ${DEVICE_DIR}/drivers/hal_usb.c APPEND PROPERTY COMPILE_OPTIONS -fno-lto)
+endif()
+
+add_custom_command(TARGET tiny-dap POST_BUILD
+    COMMAND ${CMAKE_OBJCOPY} -O ihex $<TARGET_FILE:tiny-dap> $<TARGET_FILE_DIR:tiny-dap>/tiny-dap.hex
+    COMMAND ${CMAKE_OBJCOPY} -O binary $<TARGET_FILE:tiny-dap> $<TARGET_FILE_DIR:tiny-dap>/tiny-dap.bin
+    COMMAND ${CMAKE_SIZE} -A $<TARGET_FILE:tiny-dap>
+    COMMENT "tiny-dap: ${MM32_OPT_PROFILE} profile, lto ${MM32_LTO}"
+)
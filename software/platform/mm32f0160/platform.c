@@ -24,9 +24,60 @@
  */
 
 #include "platform.h"
+#include "hal_rcc.h"
+#include "hal_tim.h"
+
+static void platform_timer_init(void)
+{
+    RCC_EnableAPB1Periphs(RCC_APB1_PERIPH_TIM2, true);
+    RCC_ResetAPB1Periphs(RCC_APB1_PERIPH_TIM2);
+
+    TIM_Init_Type tim_init;
+    tim_init.ClockFreqHz         = PLATFORM_TIMER_FREQ; /* APB1 is divided, so the timer runs at 2 x PCLK1. */
+    tim_init.StepFreqHz          = PLATFORM_TIMER_FREQ;
+    tim_init.Period              = 0xFFFFFFFFu;
+    tim_init.EnablePreloadPeriod = false;
+    tim_init.PeriodMode          = TIM_PeriodMode_Continuous;
+    tim_init.CountMode           = TIM_CountMode_Increasing;
+    TIM_Init((TIM_Type*)TIM2, &tim_init);
+    TIM_Start((TIM_Type*)TIM2);
+}
 
 void platform_init(void)
 {
+    platform_timer_init();
+    uart_port_init();
+}
+
+/* PCLK1 from the live RCC settings, assumes HSI/6 (8MHz) as the PLL1 input as set up in SystemInit. */
+uint32_t platform_apb1_freq(void)
+{
+    static const uint16_t hpre_div[8] = {2u, 4u, 8u, 16u, 64u, 128u, 256u, 512u};
+    uint32_t cfgr = RCC->CFGR;
+    uint32_t freq = PLATFORM_PLL_INPUT_FREQ;
+
+    if (RCC_CFGR_SWS(2u) == (cfgr & RCC_CFGR_SWS_MASK))
+    {
+        uint32_t pll = RCC->PLL1CFGR;
+        freq = freq * (((pll & RCC_PLL1CFGR_PLL1MUL_MASK) >> RCC_PLL1CFGR_PLL1MUL_SHIFT) + 1u)
+                    / (((pll & RCC_PLL1CFGR_PLL1DIV_MASK) >> RCC_PLL1CFGR_PLL1DIV_SHIFT) + 1u);
+    }
+    uint32_t hpre = (cfgr & RCC_CFGR_HPRE_MASK) >> RCC_CFGR_HPRE_SHIFT;
+    if (hpre >= 8u)
+    {
+        freq /= hpre_div[hpre - 8u];
+    }
+    uint32_t ppre1 = (cfgr & RCC_CFGR_PPRE1_MASK) >> RCC_CFGR_PPRE1_SHIFT;
+    if (ppre1 >= 4u)
+    {
+        freq >>= (ppre1 - 3u);
+    }
+    return freq;
+}
+
+uint32_t platform_timer_get(void)
+{
+    return TIM_GetCounterValue((TIM_Type*)TIM2);
 }
 
 /* platform.c - end */
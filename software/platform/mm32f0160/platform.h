@@ -30,11 +30,83 @@
 
 void platform_init(void);
 
-/* uart api. */
-void uart_init(cdc_line_coding_t const* p_line_coding);
-bool uart_rx_available(void);
-uint32_t uart_rx(uint8_t *buf, uint32_t buf_len);
-bool uart_tx_idle(void);
-uint32_t uart_tx(uint8_t *buf, uint32_t buf_len);
+/* code placement. RAMFUNC functions go to .ramfunc, which the keil scatter file and the gcc
+ * linker script run from sram (copied there at startup), clear of the flash wait states.
+ * both also put the swd bit loops of SW_DP.c and the buffer descriptor accessors of
+ * hal_usb.c there. calls between flash and sram go through linker veneers, so only mark
+ * functions that do their work locally.
+ */
+#if defined(__arm__)
+#define RAMFUNC                 __attribute__((section(".ramfunc"), noinline))
+#else
+#define RAMFUNC
+#endif
+
+/* usb api. queues an interrupt in transfer outside of the class drivers (a cdc SERIAL_STATE
+ * notification). data is copied to buffer, which must stay valid until the transfer completes.
+ * false when the endpoint is still busy.
+ */
+bool tusb_port_notify(uint8_t ep_addr, uint8_t *buffer, uint8_t const *data, uint16_t total_bytes);
+
+/* clock api. */
+#define PLATFORM_PLL_INPUT_FREQ 8000000u
+uint32_t platform_apb1_freq(void);
+
+/* timer api, TIM2 free-running 32-bit counter used as the probe-wide time base. */
+#define PLATFORM_TIMER_FREQ     96000000u
+/* longest interval timed on it, 2^32 ticks wrap after 44.7 s. PLATFORM_MS_TO_TICKS clamps
+ * to it, so a difference of two platform_timer_get() values can always be compared.
+ */
+#define PLATFORM_TIMER_MAX_MS   40000u
+#define PLATFORM_MS_TO_TICKS(ms) \
+    ((((ms) > PLATFORM_TIMER_MAX_MS) ? PLATFORM_TIMER_MAX_MS : (ms)) * (PLATFORM_TIMER_FREQ / 1000u))
+uint32_t platform_timer_get(void);
+
+/* uart api, one port per serial bridge channel: 0 is UART2, 1 is LPUART.
+ * uart_init() refuses rates that are too slow or off by more than UART_BAUD_MAX_ERROR_PPM
+ * and keeps the previous setting, rates above the fastest divisor are clamped. an accepted
+ * coding is applied by uart_task() once queued tx data has gone out. LPUART runs
+ * from the LSE and only does 300..9600 baud, 9600 is its ceiling.
+ * rts / cts are gpios, board v1.1 has no spare pin pair for them. boards that route them
+ * define BRD_UART_RTS_GPIO_PORT / _PIN and BRD_UART_CTS_GPIO_PORT / _PIN here.
+ * v1.1 does not route LPUART either, so port 1 and its cdc interface only exist on boards
+ * that define BRD_LPUART_TX_GPIO_PORT / _PIN, BRD_LPUART_RX_GPIO_PORT / _PIN and
+ * BRD_LPUART_GPIO_AF. those go in the project defines, tusb_config.h needs them too.
+ */
+#ifdef BRD_LPUART_TX_GPIO_PORT
+#define PLATFORM_UART_COUNT     2u
+#else
+#define PLATFORM_UART_COUNT     1u
+#endif
+#define UART_BAUD_MAX_ERROR_PPM 25000
+#define UART_ERROR_BREAK        (1u << 2) /* same bit positions as the cdc SERIAL_STATE bitmap. */
+#define UART_ERROR_FRAMING      (1u << 4)
+#define UART_ERROR_PARITY       (1u << 5)
+#define UART_ERROR_OVERRUN      (1u << 6)
+void uart_port_init(void);
+bool uart_init(uint8_t idx, cdc_line_coding_t const* p_line_coding);
+void uart_task(uint8_t idx);
+bool uart_set_flow_control(uint8_t idx, bool enable);
+void uart_set_break(uint8_t idx, bool enable);
+bool uart_get_baud(uint8_t idx, uint32_t *requested, uint32_t *actual, int32_t *error_ppm);
+void uart_get_line_coding(uint8_t idx, cdc_line_coding_t *coding);
+uint32_t uart_rx_peek(uint8_t idx, uint8_t **buf);
+void uart_rx_consume(uint8_t idx, uint32_t len);
+bool uart_rx_idle(uint8_t idx);
+uint32_t uart_rx_stamped(uint8_t idx, uint32_t *time);
+uint32_t uart_rx_overrun_count(uint8_t idx);
+uint32_t uart_rx_errors(uint8_t idx);
+bool uart_tx_idle(uint8_t idx);
+uint32_t uart_tx_reserve(uint8_t idx, uint8_t **buf);
+void uart_tx_commit(uint8_t idx, uint32_t len);
+
+/* uart auto-baud, UART2 only. */
+#define UART_AUTOBAUD_IDLE      0u
+#define UART_AUTOBAUD_RUNNING   1u
+#define UART_AUTOBAUD_LOCKED    2u
+#define UART_AUTOBAUD_FAILED    3u
+bool uart_autobaud_start(uint8_t idx);
+uint8_t uart_autobaud_poll(uint8_t idx, uint32_t *baud);
+void uart_autobaud_stop(uint8_t idx);
 
 #endif /* PLATFORM_H */
@@ -6,10 +6,13 @@
  */
 
 #include "device/dcd.h"
+#include "device/usbd_pvt.h"
 #include "hal_usb.h"
 #include "hal_rcc.h"
 
 #include "tusb.h"
+#include "platform.h"
+#include "trace.h"
 
 /* OTG_FS BufferDescriptorTable Buffer. */
 static __ALIGNED(512u) USB_BufDespTable_Type usb_bd_tbl = {0u}; /* usb_bufdesp_table */
@@ -56,7 +59,7 @@ void USB_BusResetHandler(void)
     usb_epmng_tbl[0u][USB_Direction_IN].data_n = true; /* the first Tx data's data_n is 1. */
 }
 
-void USB_TokenDoneHandler(uint8_t rhport) /* roothub port. */
+RAMFUNC void USB_TokenDoneHandler(uint8_t rhport) /* roothub port. */
 {
     USB_BufDesp_Type             * bd = USB_GetBufDesp(USB); /* get bd. */
     USB_TokenPid_Type           token = USB_BufDesp_GetTokenPid(bd); /* get token pid. */
@@ -68,6 +71,8 @@ void USB_TokenDoneHandler(uint8_t rhport) /* roothub port. */
     USB_BufDesp_Reset(bd);
     usb_epmng_tbl[ep_index][ep_dir].odd_even = !odd; /* toggle the bd odd_even flag. */
     USB_ClearInterruptStatus(USB, USB_INT_TOKENDONE);/* clear interrupt status. */
+    trace_event(TRACE_USB_TOKEN, (uint8_t)ep_index | ((USB_Direction_IN == ep_dir) ? TUSB_DIR_IN_MASK : 0u),
+                (uint16_t)(size | ((uint32_t)odd << 10) | ((uint32_t)usb_epmng_tbl[ep_index][ep_dir].data_n << 11) | ((uint32_t)token << 12)));
 
     if (0u == ep_index && USB_Direction_OUT == ep_dir ) /* ep0_out include setup packet & out_packet, need to special treatment */
     {
@@ -163,7 +168,7 @@ void dcd_init       (uint8_t rhport)
 }
 
 // Interrupt Handler
-void dcd_int_handler(uint8_t rhport)
+RAMFUNC void dcd_int_handler(uint8_t rhport)
 {
     uint32_t flag = USB_GetInterruptStatus(USB);
 
@@ -176,6 +181,7 @@ void dcd_int_handler(uint8_t rhport)
     if (flag & USB_INT_RESET)
     {
         USB_ClearInterruptStatus(USB, USB_INT_RESET);
+        trace_event(TRACE_USB_RESET, 0u, 0u);
         USB_BusResetHandler();
 
         dcd_event_bus_reset(rhport, TUSB_SPEED_FULL, true);
@@ -184,17 +190,20 @@ void dcd_int_handler(uint8_t rhport)
     if (flag & USB_INT_SLEEP)
     {
         USB_ClearInterruptStatus(USB, USB_INT_SLEEP);
+        trace_event(TRACE_USB_SUSPEND, 0u, 0u);
 
         dcd_event_bus_signal(rhport, DCD_EVENT_SUSPEND, true);
     }
     if (flag & USB_INT_RESUME)
     {
         USB_ClearInterruptStatus(USB, USB_INT_RESUME);
+        trace_event(TRACE_USB_RESUME, 0u, 0u);
 
         dcd_event_bus_signal(rhport, DCD_EVENT_RESUME, true);
     }
     if (flag & USB_INT_STALL)
     {
+        trace_event(TRACE_USB_STALL, 0u, 0u);
         USB_EnableEndPointStall(USB, USB_EP_0, false);
         dcd_edpt_clear_stall(rhport, 0);
         USB_BufDesp_Xfer(&usb_bd_tbl.Table[0u][USB_Direction_OUT][usb_epmng_tbl[0u][USB_Direction_OUT].odd_even], 1, usb_ep0_buffer, 64);
@@ -235,6 +244,7 @@ void dcd_int_disable(uint8_t rhport)
 void dcd_set_address(uint8_t rhport, uint8_t dev_addr)
 {
     usb_device_addr = dev_addr;
+    trace_event(TRACE_USB_ADDRESS, dev_addr, 0u);
     /* get addr, Tx ZLP, then set addr to USB. */
     dcd_edpt_xfer(rhport, tu_edpt_addr(0, TUSB_DIR_IN), NULL, 0);
 }
@@ -343,6 +353,7 @@ bool dcd_edpt_xfer            (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer
 
     if (0u == ep_index && ep_dir == USB_Direction_OUT)
     {
+        trace_event(TRACE_USB_XFER, ep_addr, total_bytes);
         if (true == usb_epmng_tbl[0u][USB_Direction_OUT].xfer_done)
         {
             for (uint32_t i = 0; i < total_bytes; i++)
@@ -361,8 +372,10 @@ bool dcd_edpt_xfer            (uint8_t rhport, uint8_t ep_addr, uint8_t * buffer
 
     if ( USB_BufDesp_IsBusy(&usb_bd_tbl.Table[ep_index][ep_dir][odd]) ) /* BD.OWN not equal 0, mean BD owner is SIE, BD is busy. */
     {
+        trace_event(TRACE_USB_XFER_BUSY, ep_addr, total_bytes);
         return false;
     }
+    trace_event(TRACE_USB_XFER, ep_addr, total_bytes);
     usb_epmng_tbl[ep_index][ep_dir].length    = total_bytes;
     usb_epmng_tbl[ep_index][ep_dir].remaining = total_bytes;
     if (total_bytes > max_packet_size) /* if xfer data length more than EP max_packet_size, divide data. */
@@ -385,6 +398,7 @@ void dcd_edpt_stall           (uint8_t rhport, uint8_t ep_addr)
 {
     (void) rhport;
     uint32_t ep_index = ep_addr & 0x0fu;
+    trace_event(TRACE_USB_EP_STALL, ep_addr, 1u);
     USB_EnableEndPointStall(USB, 1u << ep_index, true);
 }
 
@@ -394,11 +408,31 @@ void dcd_edpt_clear_stall     (uint8_t rhport, uint8_t ep_addr)
 {
     (void) rhport;
     uint32_t ep_index = ep_addr & 0x0fu;
+    trace_event(TRACE_USB_EP_STALL, ep_addr, 0u);
     USB_EnableEndPointStall(USB, 1u << ep_index, false);
 }
 
+/* notification endpoint transfer for serial.c. tinyusb has no public call for a cdc SERIAL_STATE
+ * notification, this shim keeps its private endpoint api out of the application. data is only
+ * copied to buffer once the endpoint is free, so a transfer still in flight is not disturbed.
+ */
+bool tusb_port_notify(uint8_t ep_addr, uint8_t * buffer, uint8_t const * data, uint16_t total_bytes)
+{
+    if (!usbd_edpt_claim(TUD_OPT_RHPORT, ep_addr))
+    {
+        return false;
+    }
+    memcpy(buffer, data, total_bytes);
+    if (!usbd_edpt_xfer(TUD_OPT_RHPORT, ep_addr, buffer, total_bytes))
+    {
+        usbd_edpt_release(TUD_OPT_RHPORT, ep_addr);
+        return false;
+    }
+    return true;
+}
+
 /* USB IRQ. */
-void USB_IRQHandler(void)
+RAMFUNC void USB_IRQHandler(void)
 {
     dcd_int_handler(TUD_OPT_RHPORT);
 }
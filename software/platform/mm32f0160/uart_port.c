@@ -23,45 +23,298 @@
  *
  */
 
+#include "platform.h"
 #include "hal_rcc.h"
 #include "hal_gpio.h"
 #include "hal_dma.h"
 #include "hal_dma_request.h"
 #include "hal_uart.h"
+#include "hal_lpuart.h"
+#include "hal_tim.h"
 #include "tusb.h"
 
-static uint8_t uart_recv_buf[128];
-static uint8_t uart_tx_buf[128];
+/* rx rings are filled by a circular dma. head is advanced from the dma half / full
+ * transfer interrupts (and the uart idle-line interrupt where there is one) and from
+ * the reader, tail only by the reader.
+ * tx rings: the writer advances head, the dma transfer-complete interrupt advances
+ * tail and immediately chains the next contiguous run so the transmitter never idles.
+ * all ring sizes are powers of two.
+ */
+#ifndef UART_RX_RING_SIZE
+#define UART_RX_RING_SIZE   1024u
+#endif
+#ifndef UART_TX_RING_SIZE
+#define UART_TX_RING_SIZE   512u
+#endif
+#if (PLATFORM_UART_COUNT > 1u)
+#define LPUART_RX_RING_SIZE 128u  /* lpuart tops out at 9600 baud. */
+#define LPUART_TX_RING_SIZE 128u
+#endif
+#define UART_RX_RING_MIN    256u
+#define UART_RX_RING_MS     8u    /* active ring holds about this much line time. */
+#define UART_TX_FLOW_RUN    16u   /* longest dma run while cts flow control is on. */
+
+/* baud rate generator: BRR and FRA form a divisor in 1/16 steps, 16 is the smallest. */
+#define UART_DIV16_MIN      16u
+#define UART_DIV16_MAX      0xFFFFFu
+#define UART_DRAIN_TIMEOUT  PLATFORM_MS_TO_TICKS(50u) /* a new line coding waits at most 50ms for tx to drain. */
+
+/* auto-baud: PA3 (UART2_RX) is switched to TIM2_CH4 and the edges are captured on the
+ * free-running probe timer. the shortest gap between edges is one bit, the estimate is
+ * then refined over every gap of up to a character.
+ */
+#define UART_AUTOBAUD_AF        GPIO_AF_2 /* PA3 - TIM2_CH4. */
+#define UART_AUTOBAUD_EDGES     48u       /* a few characters of typical traffic. */
+#define UART_AUTOBAUD_TIMEOUT   PLATFORM_MS_TO_TICKS(10000u)
+#define UART_AUTOBAUD_MAX_BAUD  3000000u
+#define UART_AUTOBAUD_SNAP_PPM  20000     /* snap to a standard rate this close, otherwise keep the measured one. */
+
+/* rts / cts flow control on gpios, the uart2 hardware flow pins are taken by swd. */
+#if defined(BRD_UART_RTS_GPIO_PORT) && defined(BRD_UART_CTS_GPIO_PORT)
+#define UART_HAS_FLOW_CONTROL 1
+#else
+#define UART_HAS_FLOW_CONTROL 0
+#endif
 
-void uart_init(cdc_line_coding_t const* p_line_coding)
+typedef struct uart_port uart_port_t;
+
+struct uart_port
 {
-    RCC_EnableAHB1Periphs(RCC_AHB1_PERIPH_DMA1, true);
-    RCC_ResetAHB1Periphs(RCC_AHB1_PERIPH_DMA1);
+    /* wiring. */
+    bool      (*apply)(uart_port_t *port, cdc_line_coding_t const *coding, uint32_t *actual, bool program);
+    bool      (*tx_done)(void);     /* the transmitter has shifted out its last character. */
+    uint32_t  (*poll_errors)(void); /* UART_ERROR_xxx read from status flags, NULL when reported by an isr. */
+    uint8_t   dma_rx;
+    uint8_t   dma_tx;
+    GPIO_Type *tx_gpio;             /* tx pin, used for break. NULL when not routed. */
+    uint16_t  tx_pin;
+    uint8_t   tx_af;
+    bool      has_flow;
+    uint8_t  *rx_buf;
+    uint32_t  rx_buf_size;
+    uint8_t  *tx_buf;
+    uint32_t  tx_buf_size;
+
+    /* rx state. */
+    uint32_t          rx_size;      /* active part of the ring. */
+    uint32_t          rx_size_next; /* applied once the reader has caught up. */
+    volatile uint32_t rx_head;      /* free-running count of bytes written by the dma. */
+    volatile uint32_t rx_pos;       /* last dma position seen. */
+    volatile uint32_t rx_tail;      /* free-running count of bytes consumed. */
+    volatile uint32_t rx_overruns;  /* bytes lost to ring or uart overrun. */
+    volatile uint32_t rx_error_bits;
+    volatile bool     rx_line_idle;
+    volatile uint32_t rx_stamp_head; /* rx_head when an isr last saw data land, */
+    volatile uint32_t rx_stamp_time; /* and the timer then. */
+
+    /* tx state. */
+    volatile uint32_t tx_head;      /* free-running count of bytes queued. */
+    volatile uint32_t tx_tail;      /* free-running count of bytes sent. */
+    volatile uint32_t tx_inflight;  /* length of the running dma transfer. */
+    volatile bool     tx_break;     /* tx is held low, no new runs are started. */
+
+    /* line state. */
+    uint32_t baud_requested;
+    uint32_t baud_actual;
+    int32_t  baud_error;            /* ppm, actual against requested. */
+    bool     baud_applied;          /* the last requested rate was accepted. */
+    cdc_line_coding_t coding;       /* last accepted line coding. */
+    bool     coding_pending;        /* accepted, waiting for tx to drain, see uart_task(). */
+    uint32_t coding_time;           /* when it was accepted. */
+    bool     flow;
+};
+
+static uint32_t uart_autobaud_edges[UART_AUTOBAUD_EDGES];
+static volatile uint32_t uart_autobaud_count = 0u;
+static uint32_t uart_autobaud_start_time;
+static uint32_t uart_autobaud_baud = 0u;
+static uint8_t  uart_autobaud_state = UART_AUTOBAUD_IDLE;
+static uint8_t  uart_autobaud_first;   /* index of the first falling edge, 1 if the line was low at start. */
+static uint8_t  uart_autobaud_rx[UART_AUTOBAUD_EDGES / 2u]; /* characters rebuilt from the edges, */
+static uint32_t uart_autobaud_rx_len = 0u;
+static uint32_t uart_autobaud_rx_pos = 0u;
+static uint32_t uart_autobaud_rx_ahead; /* read after this many ring bytes, older than the measurement. */
+
+static uint8_t uart2_rx_buf[UART_RX_RING_SIZE];
+static uint8_t uart2_tx_buf[UART_TX_RING_SIZE];
+#if (PLATFORM_UART_COUNT > 1u)
+static uint8_t lpuart_rx_buf[LPUART_RX_RING_SIZE];
+static uint8_t lpuart_tx_buf[LPUART_TX_RING_SIZE];
+#endif
+
+static bool     uart2_apply(uart_port_t *port, cdc_line_coding_t const *coding, uint32_t *actual, bool program);
+static bool     uart2_tx_done(void);
+static void     uart_tx_kick(uart_port_t *port);
+#if (PLATFORM_UART_COUNT > 1u)
+static bool     lpuart_apply(uart_port_t *port, cdc_line_coding_t const *coding, uint32_t *actual, bool program);
+static bool     lpuart_tx_done(void);
+static uint32_t lpuart_poll_errors(void);
+#endif
+
+static uart_port_t uart_ports[PLATFORM_UART_COUNT] =
+{
+    {
+        .apply       = uart2_apply,
+        .tx_done     = uart2_tx_done,
+        .poll_errors = NULL,
+        .dma_rx      = DMA_REQ_DMA1_UART2_RX_1,
+        .dma_tx      = DMA_REQ_DMA1_UART2_TX_1,
+        .tx_gpio     = GPIOA,
+        .tx_pin      = GPIO_PIN_2,
+        .tx_af       = GPIO_AF_1,
+        .has_flow    = UART_HAS_FLOW_CONTROL,
+        .rx_buf      = uart2_rx_buf,
+        .rx_buf_size = sizeof(uart2_rx_buf),
+        .tx_buf      = uart2_tx_buf,
+        .tx_buf_size = sizeof(uart2_tx_buf),
+    },
+#if (PLATFORM_UART_COUNT > 1u)
+    {
+        .apply       = lpuart_apply,
+        .tx_done     = lpuart_tx_done,
+        .poll_errors = lpuart_poll_errors,
+        .dma_rx      = DMA_REQ_DMA1_LPUART_RX,
+        .dma_tx      = DMA_REQ_DMA1_LPUART_TX,
+        .tx_gpio     = BRD_LPUART_TX_GPIO_PORT,
+        .tx_pin      = BRD_LPUART_TX_GPIO_PIN,
+        .tx_af       = BRD_LPUART_GPIO_AF,
+        .has_flow    = false,
+        .rx_buf      = lpuart_rx_buf,
+        .rx_buf_size = sizeof(lpuart_rx_buf),
+        .tx_buf      = lpuart_tx_buf,
+        .tx_buf_size = sizeof(lpuart_tx_buf),
+    },
+#endif
+};
+
+static void uart_rts_update(uart_port_t *port)
+{
+#if UART_HAS_FLOW_CONTROL
+    if (&uart_ports[0] != port)
+    {
+        return;
+    }
+    uint32_t level = port->rx_head - port->rx_tail;
+    if (!port->flow || (level < (port->rx_size / 4u)))
+    {
+        BRD_UART_RTS_GPIO_PORT->BRR = BRD_UART_RTS_GPIO_PIN; /* assert, ready to receive. */
+    }
+    else if (level > ((port->rx_size / 4u) * 3u))
+    {
+        BRD_UART_RTS_GPIO_PORT->BSRR = BRD_UART_RTS_GPIO_PIN;
+    }
+#else
+    (void) port;
+#endif
+}
+
+static bool uart_cts_ready(uart_port_t *port)
+{
+#if UART_HAS_FLOW_CONTROL
+    return !port->flow || (0u == (BRD_UART_CTS_GPIO_PORT->IDR & BRD_UART_CTS_GPIO_PIN));
+#else
+    (void) port;
+    return true;
+#endif
+}
+
+static int32_t uart_error_ppm(uint32_t actual, uint32_t requested)
+{
+    return (int32_t)(((int64_t)actual - (int64_t)requested) * 1000000 / (int64_t)requested);
+}
+
+/* size the active rx ring for the line rate. */
+static void uart_scale_buffers(uart_port_t *port, uint32_t baud)
+{
+    uint32_t bytes_per_ms = baud / 10000u; /* 10 bits per character. */
+    uint32_t size = (port->rx_buf_size < UART_RX_RING_MIN) ? port->rx_buf_size : UART_RX_RING_MIN;
+
+    while ( (size < port->rx_buf_size) && (size < (bytes_per_ms * UART_RX_RING_MS)) )
+    {
+        size <<= 1;
+    }
+    port->rx_size_next = size;
+}
+
+/* (re)start the circular rx dma over the active part of the ring. */
+static void uart_rx_dma_start(uart_port_t *port)
+{
+    DMA_EnableChannel(DMA1, port->dma_rx, false);
+    DMA_ClearChannelInterruptStatus(DMA1, port->dma_rx, DMA_CHN_INT_XFER_GLOBAL | DMA_CHN_INT_XFER_HALF_DONE | DMA_CHN_INT_XFER_DONE);
+    port->rx_size = port->rx_size_next;
+    port->rx_head = 0u;
+    port->rx_pos  = 0u;
+    port->rx_tail = 0u;
+    port->rx_stamp_head = 0u;
+    DMA1->CH[port->dma_rx].CMAR  = (uint32_t)port->rx_buf;
+    DMA1->CH[port->dma_rx].CNDTR = port->rx_size;
+    DMA_EnableChannel(DMA1, port->dma_rx, true);
+}
 
+/* only the port's own two channels are touched, so other dma users are not disturbed. */
+static void uart_dma_init(uart_port_t *port, uint32_t rx_data_addr, uint32_t tx_data_addr)
+{
+    DMA_EnableChannel(DMA1, port->dma_rx, false);
     DMA_Channel_Init_Type dma_chn_uart_recv_init;
-    dma_chn_uart_recv_init.MemAddr            = (uint32_t)uart_recv_buf;
+    dma_chn_uart_recv_init.MemAddr            = (uint32_t)port->rx_buf;
     dma_chn_uart_recv_init.MemAddrIncMode     = DMA_AddrIncMode_IncAfterXfer;
-    dma_chn_uart_recv_init.PeriphAddr         = UART_GetRxDataRegAddr(UART2);
+    dma_chn_uart_recv_init.PeriphAddr         = rx_data_addr;
     dma_chn_uart_recv_init.PeriphAddrIncMode  = DMA_AddrIncMode_StayAfterXfer;
     dma_chn_uart_recv_init.XferMode           = DMA_XferMode_PeriphToMemory;
     dma_chn_uart_recv_init.XferWidth          = DMA_XferWidth_8b;
-    dma_chn_uart_recv_init.XferCount          = sizeof(uart_recv_buf);
+    dma_chn_uart_recv_init.XferCount          = port->rx_buf_size;
     dma_chn_uart_recv_init.ReloadMode         = DMA_ReloadMode_AutoReloadContinuous;
     dma_chn_uart_recv_init.Priority           = DMA_Priority_High;
-    DMA_InitChannel(DMA1, DMA_REQ_DMA1_UART2_RX_1, (DMA_Channel_Init_Type*)&dma_chn_uart_recv_init);
-    DMA_EnableChannel(DMA1, DMA_REQ_DMA1_UART2_RX_1, true);
+    DMA_InitChannel(DMA1, port->dma_rx, (DMA_Channel_Init_Type*)&dma_chn_uart_recv_init);
+    DMA_EnableChannelInterrupts(DMA1, port->dma_rx, DMA_CHN_INT_XFER_HALF_DONE | DMA_CHN_INT_XFER_DONE, true);
 
+    DMA_EnableChannel(DMA1, port->dma_tx, false);
     DMA_Channel_Init_Type dma_chn_uart_send_init;
-    dma_chn_uart_send_init.MemAddr            = (uint32_t)uart_tx_buf;
+    dma_chn_uart_send_init.MemAddr            = (uint32_t)port->tx_buf;
     dma_chn_uart_send_init.MemAddrIncMode     = DMA_AddrIncMode_IncAfterXfer;
-    dma_chn_uart_send_init.PeriphAddr         = UART_GetTxDataRegAddr(UART2);
+    dma_chn_uart_send_init.PeriphAddr         = tx_data_addr;
     dma_chn_uart_send_init.PeriphAddrIncMode  = DMA_AddrIncMode_StayAfterXfer;
     dma_chn_uart_send_init.XferMode           = DMA_XferMode_MemoryToPeriph;
     dma_chn_uart_send_init.XferWidth          = DMA_XferWidth_8b;
     dma_chn_uart_send_init.XferCount          = 0;
-    dma_chn_uart_send_init.ReloadMode         = DMA_ReloadMode_AutoReload;
+    dma_chn_uart_send_init.ReloadMode         = DMA_ReloadMode_OneTime;
     dma_chn_uart_send_init.Priority           = DMA_Priority_High;
-    DMA_InitChannel(DMA1, DMA_REQ_DMA1_UART2_TX_1, (DMA_Channel_Init_Type*)&dma_chn_uart_send_init);
+    DMA_InitChannel(DMA1, port->dma_tx, (DMA_Channel_Init_Type*)&dma_chn_uart_send_init);
+    DMA_ClearChannelInterruptStatus(DMA1, port->dma_tx, DMA_CHN_INT_XFER_GLOBAL | DMA_CHN_INT_XFER_DONE);
+    DMA_EnableChannelInterrupts(DMA1, port->dma_tx, DMA_CHN_INT_XFER_DONE, true);
+    port->tx_head = 0u;
+    port->tx_tail = 0u;
+    port->tx_inflight = 0u;
+}
+
+/* uart2: nearest BRR / FRA divisor, rates above the fastest divisor are clamped.
+ * the apply functions check a coding and find the actual rate, they only touch the port with program set.
+ */
+static bool uart2_apply(uart_port_t *port, cdc_line_coding_t const *coding, uint32_t *actual, bool program)
+{
+    (void) port;
+    uint32_t clock = platform_apb1_freq();
+    uint32_t baud = coding->bit_rate;
+
+    if (baud > (clock / UART_DIV16_MIN))
+    {
+        baud = clock / UART_DIV16_MIN;
+    }
+    uint32_t div16 = (clock + (baud / 2u)) / baud;
+    if (div16 > UART_DIV16_MAX)
+    {
+        return false;
+    }
+    *actual = clock / div16;
+    int32_t error = uart_error_ppm(*actual, coding->bit_rate);
+    if ( (div16 != UART_DIV16_MIN) && ((error > UART_BAUD_MAX_ERROR_PPM) || (error < -UART_BAUD_MAX_ERROR_PPM)) )
+    {
+        return false;
+    }
+    if (!program)
+    {
+        return true;
+    }
 
     UART_WordLength_Type wordlen[] =
     {
@@ -83,24 +336,108 @@ void uart_init(cdc_line_coding_t const* p_line_coding)
         [2] = UART_Parity_Even,
     };
 
-    RCC_EnableAPB1Periphs(RCC_APB1_PERIPH_UART2, true);
-    RCC_ResetAPB1Periphs(RCC_APB1_PERIPH_UART2);
-
     UART_Init_Type uart_init;
-    uart_init.ClockFreqHz   = 48000000;
-    uart_init.BaudRate      = p_line_coding->bit_rate;
-    uart_init.WordLength    = wordlen[p_line_coding->data_bits];
-    uart_init.StopBits      = stopbits[p_line_coding->stop_bits];
-    uart_init.Parity        = parity[p_line_coding->parity];
+    uart_init.ClockFreqHz   = clock;
+    uart_init.BaudRate      = *actual;
+    uart_init.WordLength    = (coding->data_bits >= 5u && coding->data_bits <= 8u) ? wordlen[coding->data_bits] : UART_WordLength_8b;
+    uart_init.StopBits      = (coding->stop_bits <= 2u) ? stopbits[coding->stop_bits] : UART_StopBits_1;
+    uart_init.Parity        = (coding->parity <= 2u) ? parity[coding->parity] : UART_Parity_None;
     uart_init.XferMode      = UART_XferMode_RxTx;
     uart_init.HwFlowControl = UART_HwFlowControl_None;
     uart_init.XferSignal    = UART_XferSignal_Normal;
     uart_init.EnableSwapTxRxXferSignal = false;
+    UART_Enable(UART2, false);
     UART_Init(UART2, (UART_Init_Type*)&uart_init);
+    UART2->BRR = div16 / 16u; /* the hal truncates, use the rounded divisor. */
+    UART2->FRA = div16 % 16u;
     UART_Enable(UART2, true);
+    return true;
+}
+
+static bool uart2_tx_done(void)
+{
+    return (0u != (UART_GetStatus(UART2) & UART_STATUS_TX_DONE));
+}
+
+#if (PLATFORM_UART_COUNT > 1u)
+/* lpuart: clocked from the 32.768kHz LSE, so only the fixed 300..9600 rates exist. */
+static bool lpuart_apply(uart_port_t *port, cdc_line_coding_t const *coding, uint32_t *actual, bool program)
+{
+    (void) port;
+    static const uint32_t rates[] = {9600u, 4800u, 2400u, 1200u, 600u, 300u}; /* LPUART_Baudrate_Type order. */
+    uint32_t idx = 0u;
+
+    while ( (idx < (sizeof(rates) / sizeof(rates[0])))
+         && ((uart_error_ppm(rates[idx], coding->bit_rate) > UART_BAUD_MAX_ERROR_PPM)
+          || (uart_error_ppm(rates[idx], coding->bit_rate) < -UART_BAUD_MAX_ERROR_PPM)) )
+    {
+        idx++;
+    }
+    if ( (idx == (sizeof(rates) / sizeof(rates[0]))) || (coding->data_bits < 7u) || (1u == coding->stop_bits) )
+    {
+        return false;
+    }
+    *actual = rates[idx];
+    if (!program)
+    {
+        return true;
+    }
+
+    LPUART_Init_Type lpuart_init;
+    lpuart_init.ClockSource = LPUART_ClockSource_LSE;
+    lpuart_init.BaudRate    = (LPUART_Baudrate_Type)idx;
+    lpuart_init.WordLength  = (7u == coding->data_bits) ? LPUART_WordLength_7 : LPUART_WordLength_8;
+    lpuart_init.StopBits    = (2u == coding->stop_bits) ? LPUART_StopBits_2 : LPUART_StopBits_1;
+    lpuart_init.Parity      = (1u == coding->parity) ? LPUART_Parity_Odd : ((2u == coding->parity) ? LPUART_Parity_Even : LPUART_Parity_None);
+    LPUART_EnableTx(LPUART, false);
+    LPUART_EnableRx(LPUART, false);
+    LPUART->LPUCON &= ~(LPUART_LPUCON_DL_MASK | LPUART_LPUCON_SL_MASK | LPUART_LPUCON_PAREN_MASK | LPUART_LPUCON_PTYP_MASK); /* the hal only sets bits. */
+    LPUART_Init(LPUART, &lpuart_init);
+    LPUART_EnableTx(LPUART, true);
+    LPUART_EnableRx(LPUART, true);
+    return true;
+}
+
+static bool lpuart_tx_done(void)
+{
+    return (0u != (LPUART_GetStatus(LPUART) & LPUART_STATUS_TX_DONE));
+}
+
+static uint32_t lpuart_poll_errors(void)
+{
+    uint32_t status = LPUART->LPUSTA;
+    uint32_t errors = 0u;
+
+    if (0u != (status & LPUART_LPUSTA_RXOV_MASK))
+    {
+        errors |= UART_ERROR_OVERRUN;
+    }
+    if (0u != (status & LPUART_LPUSTA_FERR_MASK))
+    {
+        errors |= UART_ERROR_FRAMING;
+    }
+    if (0u != (status & LPUART_LPUSTA_PERR_MASK))
+    {
+        errors |= UART_ERROR_PARITY;
+    }
+    LPUART->LPUSTA = status & (LPUART_LPUSTA_RXOV_MASK | LPUART_LPUSTA_FERR_MASK | LPUART_LPUSTA_PERR_MASK); /* write 1 to clear. */
+    return errors;
+}
+#endif /* PLATFORM_UART_COUNT > 1u */
+
+static void uart2_port_init(uart_port_t *port)
+{
+    RCC_EnableAPB1Periphs(RCC_APB1_PERIPH_UART2, true);
+    RCC_ResetAPB1Periphs(RCC_APB1_PERIPH_UART2);
+    uart_dma_init(port, UART_GetRxDataRegAddr(UART2), UART_GetTxDataRegAddr(UART2));
     UART_EnableDMA(UART2, true);
+    UART_ClearInterruptStatus(UART2, UART_ISR_RXIDLEINTF_MASK | UART_ISR_RXOERRINTF_MASK | UART_ISR_RXFERRINTF_MASK | UART_ISR_RXPERRINTF_MASK | UART_ISR_RXBRKINTF_MASK);
+    UART_EnableInterrupts(UART2, UART_IER_RXIDLEIEN_MASK | UART_IER_RXOERRIEN_MASK | UART_IER_RXFERRIEN_MASK | UART_IER_RXPERRIEN_MASK | UART_IER_RXBRKIEN_MASK, true);
 
-    RCC_EnableAHB1Periphs(RCC_AHB1_PERIPH_GPIOA, true);
+    NVIC_SetPriority(DMA1_CH7_CH4_IRQn, 1u);
+    NVIC_EnableIRQ(DMA1_CH7_CH4_IRQn);
+    NVIC_SetPriority(UART2_IRQn, 1u);
+    NVIC_EnableIRQ(UART2_IRQn);
 
     GPIO_Init_Type gpio_init;
     /* PA3 - UART2_RX. */
@@ -116,41 +453,674 @@ void uart_init(cdc_line_coding_t const* p_line_coding)
     gpio_init.Speed = GPIO_Speed_50MHz;
     GPIO_Init(GPIOA, &gpio_init);
     GPIO_PinAFConf(GPIOA, gpio_init.Pins, GPIO_AF_1);
+
+#if UART_HAS_FLOW_CONTROL
+    /* RTS - output, low when ready. */
+    gpio_init.Pins  = BRD_UART_RTS_GPIO_PIN;
+    gpio_init.PinMode  = GPIO_PinMode_Out_PushPull;
+    gpio_init.Speed = GPIO_Speed_50MHz;
+    GPIO_ClearBits(BRD_UART_RTS_GPIO_PORT, gpio_init.Pins);
+    GPIO_Init(BRD_UART_RTS_GPIO_PORT, &gpio_init);
+
+    /* CTS - input, low when the target is ready. */
+    gpio_init.Pins  = BRD_UART_CTS_GPIO_PIN;
+    gpio_init.PinMode  = GPIO_PinMode_In_PullDown;
+    gpio_init.Speed = GPIO_Speed_50MHz;
+    GPIO_Init(BRD_UART_CTS_GPIO_PORT, &gpio_init);
+#endif
 }
 
-static uint32_t last_recv_index = 0;
+#if (PLATFORM_UART_COUNT > 1u)
+static void lpuart_port_init(uart_port_t *port)
+{
+    RCC->BDCR |= RCC_BDCR_DBP_MASK | RCC_BDCR_LSEON_MASK; /* lpuart baud clock. */
+    RCC_EnableAPB2Periphs(RCC_APB2_PERIPH_LPUART, true);
+    RCC_ResetAPB2Periphs(RCC_APB2_PERIPH_LPUART);
+    uart_dma_init(port, LPUART_GetRxDataRegAddr(LPUART), LPUART_GetTxDataRegAddr(LPUART));
+    LPUART_EnableDMA(LPUART, LPUART_DMA_TXRX, true);
 
-bool uart_rx_available(void)
+    NVIC_SetPriority(DMA1_CH1_IRQn, 1u);
+    NVIC_EnableIRQ(DMA1_CH1_IRQn);
+    NVIC_SetPriority(DMA1_CH3_CH2_IRQn, 1u);
+    NVIC_EnableIRQ(DMA1_CH3_CH2_IRQn);
+
+    GPIO_Init_Type gpio_init;
+    gpio_init.Pins  = BRD_LPUART_RX_GPIO_PIN;
+    gpio_init.PinMode  = GPIO_PinMode_In_Floating;
+    gpio_init.Speed = GPIO_Speed_50MHz;
+    GPIO_Init(BRD_LPUART_RX_GPIO_PORT, &gpio_init);
+    GPIO_PinAFConf(BRD_LPUART_RX_GPIO_PORT, gpio_init.Pins, BRD_LPUART_GPIO_AF);
+
+    gpio_init.Pins  = BRD_LPUART_TX_GPIO_PIN;
+    gpio_init.PinMode  = GPIO_PinMode_AF_PushPull;
+    gpio_init.Speed = GPIO_Speed_50MHz;
+    GPIO_Init(BRD_LPUART_TX_GPIO_PORT, &gpio_init);
+    GPIO_PinAFConf(BRD_LPUART_TX_GPIO_PORT, gpio_init.Pins, BRD_LPUART_GPIO_AF);
+}
+#endif /* PLATFORM_UART_COUNT > 1u */
+
+/* one-time setup of all ports, each starts at 115200 8N1 (9600 on lpuart). */
+void uart_port_init(void)
 {
-    uint32_t now_recv_index = sizeof(uart_recv_buf) - DMA1->CH[DMA_REQ_DMA1_UART2_RX_1].CNDTR;
-    return now_recv_index != last_recv_index;
+    cdc_line_coding_t line_coding = { .bit_rate = 115200u, .stop_bits = 0u, .parity = 0u, .data_bits = 8u };
+
+    RCC_EnableAHB1Periphs(RCC_AHB1_PERIPH_DMA1, true);
+    RCC_EnableAHB1Periphs(RCC_AHB1_PERIPH_GPIOA, true);
+
+    uart2_port_init(&uart_ports[0]);
+    uart_init(0u, &line_coding); /* nothing is queued, applied right away. */
+    uart_rx_dma_start(&uart_ports[0]);
+
+#if (PLATFORM_UART_COUNT > 1u)
+    lpuart_port_init(&uart_ports[1]);
+    line_coding.bit_rate = 9600u;
+    uart_init(1u, &line_coding);
+    uart_rx_dma_start(&uart_ports[1]);
+#endif
 }
 
-uint32_t uart_rx(uint8_t *buf, uint32_t buf_len)
+/* accept a line coding for the running port. it is checked here and applied by uart_task()
+ * once queued tx data has gone out at the old setting, no new tx data is taken until then.
+ * the rx ring and its unread data are kept and a new ring size takes effect once the reader
+ * has caught up.
+ */
+bool uart_init(uint8_t idx, cdc_line_coding_t const* p_line_coding)
 {
-    uint32_t now_recv_index = sizeof(uart_recv_buf) - DMA1->CH[DMA_REQ_DMA1_UART2_RX_1].CNDTR;
-    uint32_t i = 0;
-    while(i < buf_len && last_recv_index != now_recv_index)
+    uart_port_t *port = &uart_ports[idx];
+    uint32_t actual;
+
+    port->baud_requested = p_line_coding->bit_rate;
+    port->baud_applied = (0u != p_line_coding->bit_rate) && port->apply(port, p_line_coding, &actual, false);
+    if (!port->baud_applied)
     {
-        buf[i] = uart_recv_buf[last_recv_index];
-        last_recv_index++;
-        last_recv_index %= sizeof(uart_recv_buf);
-        i++;
+        return false;
     }
-    return i;
+    port->baud_actual    = actual;
+    port->baud_error     = uart_error_ppm(actual, p_line_coding->bit_rate);
+    port->coding         = *p_line_coding;
+    port->coding_pending = true;
+    port->coding_time    = platform_timer_get();
+    uart_task(idx); /* right away when tx is idle. */
+    return true;
 }
 
-bool uart_tx_idle(void)
+/* apply a pending line coding once tx has drained, or after UART_DRAIN_TIMEOUT when cts holds it up.
+ * called from the serial bridge loop for every port and from uart_tx_reserve(), never waits.
+ */
+void uart_task(uint8_t idx)
 {
-    return (DMA1->CH[DMA_REQ_DMA1_UART2_TX_1].CCR & DMA_CCR_EN_MASK) == 0;
+    uart_port_t *port = &uart_ports[idx];
+    uint32_t actual;
+
+    if (   !port->coding_pending
+        || ( ((port->tx_head != port->tx_tail) || !port->tx_done())
+          && ((platform_timer_get() - port->coding_time) < UART_DRAIN_TIMEOUT) ) )
+    {
+        return;
+    }
+    port->coding_pending = false;
+    (void) port->apply(port, &port->coding, &actual, true);
+    uart_scale_buffers(port, actual);
+}
+
+/* returns false when the last requested rate was refused, actual and error then describe the rate still in use. */
+bool uart_get_baud(uint8_t idx, uint32_t *requested, uint32_t *actual, int32_t *error_ppm)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    *requested = port->baud_requested;
+    *actual    = port->baud_actual;
+    *error_ppm = port->baud_error;
+    return port->baud_applied;
+}
+
+void uart_get_line_coding(uint8_t idx, cdc_line_coding_t *coding)
+{
+    *coding = uart_ports[idx].coding;
+}
+
+bool uart_set_flow_control(uint8_t idx, bool enable)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    port->flow = enable && port->has_flow;
+    uart_rts_update(port);
+    return (port->flow == enable);
+}
+
+/* hold TX low (break) or give the pin back to the uart. queued data waits for the
+ * end of the break, a run that is already in flight finishes into the held pin.
+ */
+void uart_set_break(uint8_t idx, bool enable)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    if (NULL == port->tx_gpio)
+    {
+        return;
+    }
+    port->tx_break = enable;
+    GPIO_Init_Type gpio_init;
+    gpio_init.Pins  = port->tx_pin;
+    gpio_init.PinMode  = enable ? GPIO_PinMode_Out_PushPull : GPIO_PinMode_AF_PushPull;
+    gpio_init.Speed = GPIO_Speed_50MHz;
+    GPIO_ClearBits(port->tx_gpio, gpio_init.Pins);
+    GPIO_Init(port->tx_gpio, &gpio_init);
+    GPIO_PinAFConf(port->tx_gpio, gpio_init.Pins, port->tx_af);
+    if (!enable)
+    {
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        uart_tx_kick(port); /* resume what was queued during the break. */
+        __set_PRIMASK(primask);
+    }
+}
+
+/* advance head to the dma position, called with interrupts masked or from the port's isrs.
+ * the half / full transfer interrupts guarantee it runs at least twice per lap.
+ */
+static void uart_rx_update(uart_port_t *port)
+{
+    uint32_t mask = port->rx_size - 1u;
+    uint32_t pos = (port->rx_size - DMA1->CH[port->dma_rx].CNDTR) & mask;
+    port->rx_head += (pos - port->rx_pos) & mask;
+    port->rx_pos   = pos;
+    uart_rts_update(port);
+}
+
+/* from the idle and dma isrs only: the bytes up to head have landed by now. */
+static void uart_rx_stamp(uart_port_t *port)
+{
+    port->rx_stamp_time = platform_timer_get();
+    port->rx_stamp_head = port->rx_head;
+}
+
+/* start a dma transfer of the next contiguous run of the tx ring, called with interrupts masked or from the dma isr. */
+static void uart_tx_kick(uart_port_t *port)
+{
+    uint32_t len = port->tx_head - port->tx_tail;
+    uint32_t idx = port->tx_tail & (port->tx_buf_size - 1u);
+
+    if ( (0u != port->tx_inflight) || (0u == len) || port->tx_break || !uart_cts_ready(port) )
+    {
+        return;
+    }
+    if (len > (port->tx_buf_size - idx))
+    {
+        len = port->tx_buf_size - idx;
+    }
+    if (port->flow && (len > UART_TX_FLOW_RUN))
+    {
+        len = UART_TX_FLOW_RUN; /* short runs so a cts stop takes effect quickly. */
+    }
+    port->tx_inflight = len;
+    DMA1->CH[port->dma_tx].CMAR  = (uint32_t)&port->tx_buf[idx];
+    DMA1->CH[port->dma_tx].CNDTR = len;
+    DMA_EnableChannel(DMA1, port->dma_tx, true);
 }
 
-uint32_t uart_tx(uint8_t *buf, uint32_t buf_len)
+static void uart_dma_tx_isr(uart_port_t *port)
 {
-    memcpy(uart_tx_buf, buf, buf_len);
-    DMA1->CH[DMA_REQ_DMA1_UART2_TX_1].CNDTR = buf_len;
-    DMA_EnableChannel(DMA1, DMA_REQ_DMA1_UART2_TX_1, true);
-    return buf_len;
+    uint32_t status = DMA_GetChannelInterruptStatus(DMA1, port->dma_tx);
+    if (0u != (status & DMA_CHN_INT_XFER_DONE))
+    {
+        DMA_ClearChannelInterruptStatus(DMA1, port->dma_tx, DMA_CHN_INT_XFER_GLOBAL | DMA_CHN_INT_XFER_DONE);
+        DMA_EnableChannel(DMA1, port->dma_tx, false);
+        port->tx_tail += port->tx_inflight;
+        port->tx_inflight = 0u;
+        uart_tx_kick(port);
+    }
+}
+
+static void uart_dma_rx_isr(uart_port_t *port)
+{
+    uint32_t status = DMA_GetChannelInterruptStatus(DMA1, port->dma_rx);
+    if (0u != (status & (DMA_CHN_INT_XFER_HALF_DONE | DMA_CHN_INT_XFER_DONE)))
+    {
+        DMA_ClearChannelInterruptStatus(DMA1, port->dma_rx, DMA_CHN_INT_XFER_GLOBAL | DMA_CHN_INT_XFER_HALF_DONE | DMA_CHN_INT_XFER_DONE);
+        uart_rx_update(port);
+        uart_rx_stamp(port);
+    }
+}
+
+/* uart2 tx / rx. */
+void DMA1_CH7_CH4_IRQHandler(void)
+{
+    uart_dma_tx_isr(&uart_ports[0]);
+    uart_dma_rx_isr(&uart_ports[0]);
+}
+
+#if (PLATFORM_UART_COUNT > 1u)
+/* lpuart tx. */
+void DMA1_CH1_IRQHandler(void)
+{
+    uart_dma_tx_isr(&uart_ports[1]);
+}
+
+/* lpuart rx. */
+void DMA1_CH3_CH2_IRQHandler(void)
+{
+    uart_dma_rx_isr(&uart_ports[1]);
+}
+#endif
+
+void UART2_IRQHandler(void)
+{
+    uart_port_t *port = &uart_ports[0];
+    uint32_t status = UART_GetInterruptStatus(UART2);
+    if (0u != (status & UART_ISR_RXOERRINTF_MASK))
+    {
+        port->rx_overruns++;
+        port->rx_error_bits |= UART_ERROR_OVERRUN;
+    }
+    if (0u != (status & UART_ISR_RXFERRINTF_MASK))
+    {
+        port->rx_error_bits |= UART_ERROR_FRAMING;
+    }
+    if (0u != (status & UART_ISR_RXPERRINTF_MASK))
+    {
+        port->rx_error_bits |= UART_ERROR_PARITY;
+    }
+    if (0u != (status & UART_ISR_RXBRKINTF_MASK))
+    {
+        port->rx_error_bits |= UART_ERROR_BREAK;
+    }
+    if (0u != (status & UART_ISR_RXIDLEINTF_MASK))
+    {
+        uart_rx_update(port);
+        uart_rx_stamp(port);
+        port->rx_line_idle = true;
+    }
+    UART_ClearInterruptStatus(UART2, status & (UART_ISR_RXIDLEINTF_MASK | UART_ISR_RXOERRINTF_MASK | UART_ISR_RXFERRINTF_MASK | UART_ISR_RXPERRINTF_MASK | UART_ISR_RXBRKINTF_MASK));
+}
+
+/* contiguous run of received bytes starting at the read position. */
+uint32_t uart_rx_peek(uint8_t idx, uint8_t **buf)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    if ( (0u == idx) && (uart_autobaud_rx_pos != uart_autobaud_rx_len) && (0u == uart_autobaud_rx_ahead) )
+    {
+        *buf = &uart_autobaud_rx[uart_autobaud_rx_pos];
+        return uart_autobaud_rx_len - uart_autobaud_rx_pos;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uart_rx_update(port);
+    if ( (port->rx_size != port->rx_size_next) && (port->rx_head == port->rx_tail) )
+    {
+        uart_rx_dma_start(port); /* resize while the ring is empty. */
+    }
+    uint32_t head = port->rx_head;
+    __set_PRIMASK(primask);
+
+    if ((head - port->rx_tail) > port->rx_size)
+    {
+        /* the dma lapped the reader, drop everything but the most recent half ring. */
+        uint32_t tail = head - (port->rx_size / 2u);
+        port->rx_overruns += tail - port->rx_tail;
+        port->rx_error_bits |= UART_ERROR_OVERRUN;
+        uart_autobaud_rx_ahead -= (uart_autobaud_rx_ahead > (tail - port->rx_tail)) ? (tail - port->rx_tail) : uart_autobaud_rx_ahead;
+        port->rx_tail = tail;
+    }
+    uint32_t pos = port->rx_tail & (port->rx_size - 1u);
+    uint32_t len = head - port->rx_tail;
+    if (len > (port->rx_size - pos))
+    {
+        len = port->rx_size - pos;
+    }
+    if ( (0u == idx) && (uart_autobaud_rx_pos != uart_autobaud_rx_len) && (len > uart_autobaud_rx_ahead) )
+    {
+        len = uart_autobaud_rx_ahead; /* the rebuilt characters go first. */
+    }
+    *buf = &port->rx_buf[pos];
+    return len;
+}
+
+void uart_rx_consume(uint8_t idx, uint32_t len)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    if ( (0u == idx) && (uart_autobaud_rx_pos != uart_autobaud_rx_len) )
+    {
+        if (0u == uart_autobaud_rx_ahead)
+        {
+            uart_autobaud_rx_pos += len;
+            return;
+        }
+        uart_autobaud_rx_ahead -= len;
+    }
+    port->rx_tail += len;
+    uart_rts_update(port);
+}
+
+/* how many bytes from the read position had landed at *time, taken in the idle or
+ * dma half / full isr. the rest were picked up by polling since and are not stamped.
+ * the lpuart has no idle interrupt, only its dma isrs stamp.
+ */
+uint32_t uart_rx_stamped(uint8_t idx, uint32_t *time)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    if ( (0u == idx) && (uart_autobaud_rx_pos != uart_autobaud_rx_len) && (0u == uart_autobaud_rx_ahead) )
+    {
+        *time = uart_autobaud_edges[UART_AUTOBAUD_EDGES - 1u];
+        return uart_autobaud_rx_len - uart_autobaud_rx_pos;
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t n = port->rx_stamp_head - port->rx_tail;
+    *time = port->rx_stamp_time;
+    __set_PRIMASK(primask);
+    return ((int32_t)n > 0) ? n : 0u;
+}
+
+/* true once after the line went idle following received data, ports without idle detection never report it. */
+bool uart_rx_idle(uint8_t idx)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    bool idle = port->rx_line_idle;
+    port->rx_line_idle = false;
+    return idle;
+}
+
+uint32_t uart_rx_overrun_count(uint8_t idx)
+{
+    return uart_ports[idx].rx_overruns;
+}
+
+/* UART_ERROR_xxx bits seen since the previous call. */
+uint32_t uart_rx_errors(uint8_t idx)
+{
+    uart_port_t *port = &uart_ports[idx];
+    uint32_t polled = (NULL != port->poll_errors) ? port->poll_errors() : 0u;
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t bits = port->rx_error_bits | polled;
+    port->rx_error_bits = 0u;
+    __set_PRIMASK(primask);
+    if (0u != (polled & UART_ERROR_OVERRUN))
+    {
+        port->rx_overruns++;
+    }
+    return bits;
+}
+
+bool uart_tx_idle(uint8_t idx)
+{
+    return (uart_ports[idx].tx_head == uart_ports[idx].tx_tail);
+}
+
+/* contiguous free space in the tx ring for the caller to fill. */
+uint32_t uart_tx_reserve(uint8_t idx, uint8_t **buf)
+{
+    uart_port_t *port = &uart_ports[idx];
+    uint32_t head = port->tx_head;
+    uint32_t pos = head & (port->tx_buf_size - 1u);
+    uint32_t len = port->tx_buf_size - (head - port->tx_tail);
+
+    uart_task(idx);
+    if (port->coding_pending)
+    {
+        len = 0u; /* the ring drains at the old setting first. */
+    }
+
+    if (len > (port->tx_buf_size - pos))
+    {
+        len = port->tx_buf_size - pos;
+    }
+    *buf = &port->tx_buf[pos];
+    return len;
+}
+
+/* queue len bytes written through uart_tx_reserve() and start the dma if it is idle.
+ * also called with len 0 to restart a run held back by cts.
+ */
+void uart_tx_commit(uint8_t idx, uint32_t len)
+{
+    uart_port_t *port = &uart_ports[idx];
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    port->tx_head += len;
+    uart_tx_kick(port);
+    __set_PRIMASK(primask);
+}
+
+/* route PA3 to the uart or to the capture channel. */
+static void uart_autobaud_pin(bool capture)
+{
+    GPIO_Init_Type gpio_init;
+    gpio_init.Pins  = GPIO_PIN_3;
+    gpio_init.PinMode  = GPIO_PinMode_In_Floating;
+    gpio_init.Speed = GPIO_Speed_50MHz;
+    GPIO_Init(GPIOA, &gpio_init);
+    GPIO_PinAFConf(GPIOA, gpio_init.Pins, capture ? UART_AUTOBAUD_AF : GPIO_AF_1);
+}
+
+/* TIM2 is the probe timer, only the auto-baud capture channel interrupts. */
+void TIM2_IRQHandler(void)
+{
+    uint32_t status = TIM_GetInterruptStatus((TIM_Type*)TIM2);
+    TIM_ClearInterruptStatus((TIM_Type*)TIM2, status);
+    if (0u != (status & TIM_STATUS_CHN4_EVENT))
+    {
+        uart_autobaud_edges[uart_autobaud_count++] = TIM_GetChannelValue((TIM_Type*)TIM2, TIM_CHN_4);
+        if (UART_AUTOBAUD_EDGES == uart_autobaud_count)
+        {
+            TIM_EnableInterrupts((TIM_Type*)TIM2, TIM_INT_CHN4_EVENT, false);
+        }
+    }
+}
+
+/* measure the bit rate on the rx pin, only UART2 can do this. the rx ring and queued tx
+ * data are kept. while the pin is on the timer the uart receives nothing, the characters
+ * are rebuilt from the edges once the rate locks, see uart_autobaud_decode().
+ */
+bool uart_autobaud_start(uint8_t idx)
+{
+    if (0u != idx)
+    {
+        return false;
+    }
+    TIM_EnableInterrupts((TIM_Type*)TIM2, TIM_INT_CHN4_EVENT, false);
+    uart_autobaud_count = 0u;
+    uart_autobaud_start_time = platform_timer_get();
+    uart_autobaud_baud = 0u;
+    uart_autobaud_state = UART_AUTOBAUD_RUNNING;
+    uart_autobaud_first = GPIO_ReadInDataBit(GPIOA, GPIO_PIN_3) ? 0u : 1u; /* low: mid character, the first edge rises. */
+
+    TIM_InputCaptureConf_Type capture;
+    capture.InDiv       = TIM_InputCaptureInDiv_OnEach1Capture;
+    capture.InFilter    = TIM_InputCaptureInFilter_Alt1; /* a few clocks of glitch rejection. */
+    capture.PinPolarity = TIM_PinPolarity_RisingOrFalling;
+    TIM_EnableInputCapture((TIM_Type*)TIM2, TIM_CHN_4, &capture);
+    TIM_ClearInterruptStatus((TIM_Type*)TIM2, TIM_STATUS_CHN4_EVENT | TIM_STATUS_CHN4_OVER_EVENT);
+    TIM_EnableInterrupts((TIM_Type*)TIM2, TIM_INT_CHN4_EVENT, true);
+    NVIC_SetPriority(TIM2_IRQn, 0u);
+    NVIC_EnableIRQ(TIM2_IRQn);
+    uart_autobaud_pin(true);
+    return true;
+}
+
+/* bit rate from the captured edges, 0 if they make no sense. */
+static uint32_t uart_autobaud_calc(void)
+{
+    static const uint32_t rates[] =
+    {
+        300u, 600u, 1200u, 2400u, 4800u, 9600u, 14400u, 19200u, 28800u, 38400u, 57600u,
+        76800u, 115200u, 128000u, 230400u, 250000u, 460800u, 500000u, 921600u, 1000000u,
+        1500000u, 2000000u, 3000000u,
+    };
+    uint32_t bit = 0xFFFFFFFFu;
+
+    for (uint32_t i = 1u; i < UART_AUTOBAUD_EDGES; i++)
+    {
+        uint32_t gap = uart_autobaud_edges[i] - uart_autobaud_edges[i - 1u];
+        if (gap < bit)
+        {
+            bit = gap;
+        }
+    }
+    if (bit < (PLATFORM_TIMER_FREQ / UART_AUTOBAUD_MAX_BAUD))
+    {
+        return 0u;
+    }
+
+    /* total time over total bits, gaps longer than a character are idle time. */
+    uint32_t ticks = 0u;
+    uint32_t bits = 0u;
+    for (uint32_t i = 1u; i < UART_AUTOBAUD_EDGES; i++)
+    {
+        uint32_t gap = uart_autobaud_edges[i] - uart_autobaud_edges[i - 1u];
+        uint32_t n = (gap + (bit / 2u)) / bit;
+        if (n <= 10u)
+        {
+            ticks += gap;
+            bits  += n;
+        }
+    }
+    uint32_t baud = (uint32_t)(((uint64_t)bits * PLATFORM_TIMER_FREQ + (ticks / 2u)) / ticks);
+
+    for (uint32_t i = 0u; i < (sizeof(rates) / sizeof(rates[0])); i++)
+    {
+        int32_t error = uart_error_ppm(baud, rates[i]);
+        if ( (error <= UART_AUTOBAUD_SNAP_PPM) && (error >= -UART_AUTOBAUD_SNAP_PPM) )
+        {
+            return rates[i];
+        }
+    }
+    return baud; /* a fractional rate. */
+}
+
+/* sample the edge timeline at the bit centres of each frame with the locked rate. the line
+ * idles high, so the level after an edge follows from its index. quiet is how long after
+ * the last edge the line is known to have stayed put, a frame running past that is lost.
+ */
+static void uart_autobaud_decode(uart_port_t *port, uint32_t baud, uint32_t quiet)
+{
+    uint32_t data_bits = ((port->coding.data_bits >= 5u) && (port->coding.data_bits <= 8u)) ? port->coding.data_bits : 8u;
+    bool     parity = (1u == port->coding.parity) || (2u == port->coding.parity);
+    uint32_t frame = 1u + data_bits + (parity ? 1u : 0u) + 1u; /* start to the first stop bit. */
+    uint32_t base = uart_autobaud_edges[0];
+    uint32_t end = (uart_autobaud_edges[UART_AUTOBAUD_EDGES - 1u] - base) + quiet;
+    uint32_t k = uart_autobaud_first;
+    uint32_t len = 0u;
+
+    while (k < UART_AUTOBAUD_EDGES)
+    {
+        uint32_t start = uart_autobaud_edges[k] - base;
+        uint32_t stop = start + (((2u * frame) - 1u) * PLATFORM_TIMER_FREQ) / (2u * baud);
+        uint32_t word = 0u;
+        uint32_t j = k;
+
+        if (stop > end)
+        {
+            port->rx_overruns++;
+            port->rx_error_bits |= UART_ERROR_OVERRUN;
+            break;
+        }
+        for (uint32_t i = 0u; i < frame; i++)
+        {
+            uint32_t t = start + (((2u * i) + 1u) * PLATFORM_TIMER_FREQ) / (2u * baud);
+            while ( ((j + 1u) < UART_AUTOBAUD_EDGES) && ((uart_autobaud_edges[j + 1u] - base) <= t) )
+            {
+                j++;
+            }
+            word |= ((j - uart_autobaud_first) & 1u) << i; /* after a rising edge the line is high. */
+        }
+
+        uint32_t data = (word >> 1) & ((1u << data_bits) - 1u);
+        if (parity)
+        {
+            uint32_t ones = (word >> (1u + data_bits)) & 1u;
+            for (uint32_t i = 0u; i < data_bits; i++)
+            {
+                ones += (data >> i) & 1u;
+            }
+            if ((ones & 1u) != ((1u == port->coding.parity) ? 1u : 0u))
+            {
+                port->rx_error_bits |= UART_ERROR_PARITY;
+            }
+        }
+        if (0u == (word & (1u << (frame - 1u))))
+        {
+            port->rx_error_bits |= UART_ERROR_FRAMING;
+        }
+        uart_autobaud_rx[len++] = (uint8_t)data;
+
+        /* the next start bit is the first falling edge after the stop bit centre. */
+        k = j + 1u;
+        while ( (k < UART_AUTOBAUD_EDGES) && ((0u != ((k - uart_autobaud_first) & 1u)) || ((uart_autobaud_edges[k] - base) <= stop)) )
+        {
+            k++;
+        }
+    }
+    if (uart_autobaud_rx_pos != uart_autobaud_rx_len)
+    {
+        port->rx_overruns += uart_autobaud_rx_len - uart_autobaud_rx_pos; /* an earlier run was never read. */
+    }
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uart_rx_update(port);
+    uart_autobaud_rx_ahead = port->rx_head - port->rx_tail;
+    __set_PRIMASK(primask);
+    uart_autobaud_rx_pos = 0u;
+    uart_autobaud_rx_len = len;
+}
+
+/* finish a running measurement once enough edges are in, then apply the rate with the
+ * rest of the line coding unchanged. returns UART_AUTOBAUD_xxx, baud is the locked rate.
+ */
+uint8_t uart_autobaud_poll(uint8_t idx, uint32_t *baud)
+{
+    if (0u != idx)
+    {
+        *baud = 0u;
+        return UART_AUTOBAUD_IDLE;
+    }
+    if ( (UART_AUTOBAUD_RUNNING == uart_autobaud_state) && (UART_AUTOBAUD_EDGES == uart_autobaud_count) )
+    {
+        cdc_line_coding_t coding = uart_ports[idx].coding;
+        uint32_t now = platform_timer_get();
+        bool moved = (0u != (TIM_GetInterruptStatus((TIM_Type*)TIM2) & (TIM_STATUS_CHN4_EVENT | TIM_STATUS_CHN4_OVER_EVENT)));
+
+        coding.bit_rate = uart_autobaud_calc();
+        uart_autobaud_pin(false);
+        if ( (0u != coding.bit_rate) && uart_init(idx, &coding) )
+        {
+            uart_autobaud_decode(&uart_ports[idx], coding.bit_rate, moved ? 0u : (now - uart_autobaud_edges[UART_AUTOBAUD_EDGES - 1u]));
+            uart_autobaud_baud  = coding.bit_rate;
+            uart_autobaud_state = UART_AUTOBAUD_LOCKED;
+        }
+        else
+        {
+            uart_autobaud_state = UART_AUTOBAUD_FAILED;
+        }
+    }
+    else if ( (UART_AUTOBAUD_RUNNING == uart_autobaud_state) && ((platform_timer_get() - uart_autobaud_start_time) >= UART_AUTOBAUD_TIMEOUT) )
+    {
+        uart_autobaud_stop(idx);
+    }
+    *baud = uart_autobaud_baud;
+    return uart_autobaud_state;
+}
+
+/* end a running measurement without a result and give the pin back to the uart. */
+void uart_autobaud_stop(uint8_t idx)
+{
+    if ( (0u != idx) || (UART_AUTOBAUD_RUNNING != uart_autobaud_state) )
+    {
+        return;
+    }
+    TIM_EnableInterrupts((TIM_Type*)TIM2, TIM_INT_CHN4_EVENT, false);
+    uart_autobaud_pin(false);
+    uart_autobaud_state = UART_AUTOBAUD_FAILED;
 }
 
 /* uart_port.c - end */
@@ -0,0 +1,727 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2023 UnsicentificLaLaLaLa
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""DAP workload traces: capture, generate and replay them as a benchmark.
+
+A trace is a compact binary log of CMSIS-DAP commands, all little endian:
+  header  "DAPTRACE" (8), version (2), packet size (2), reserved (4)
+  record  gap (4), request length (2), response length (2), request, response
+gap is the host time in us before the request at capture, the response is what the
+probe answered then (empty in generated traces).
+
+Capture a debugger session, OpenOCD with "cmsis-dap backend tcp" and port 4442:
+    dap_bench.py capture -o session.trace --listen 4442 --target sim:127.0.0.1:4441
+Write the built-in workloads (flash, dump, step, rtt):
+    dap_bench.py generate -o traces
+Replay, report and compare against an earlier run:
+    dap_bench.py replay traces/*.trace --target sim:127.0.0.1:4441 --json now.json
+    dap_bench.py replay traces/*.trace --target usb --baseline before.json --tolerance 5
+Run the probe's own benchmarks (ID_DAP_VENDOR_BENCH, application/bench.c): usb loopback,
+swclk per clock setting, swd block rate against target ram, uart loopback (tx wired to rx):
+    dap_bench.py selftest --target usb --test usb swclk swd uart --json selftest.json
+
+Targets: sim:HOST:PORT is the host simulator (SIM_DAP_PORT=4441, platform/host/sim_dap.c),
+timed in virtual cpu cycles and with swd counters. tcp:HOST:PORT is any other cmsis-dap
+tcp server and usb the probe's hid interface (pyusb), both timed in wall time.
+"""
+
+import argparse
+import glob
+import json
+import os
+import socket
+import struct
+import sys
+import time
+
+TRACE_MAGIC = b"DAPTRACE"
+TRACE_VERSION = 1
+TRACE_HEADER = struct.Struct("<8sHHI")
+TRACE_RECORD = struct.Struct("<IHH")
+
+TCP_SIGNATURE = 0x00504144
+TCP_HEADER = struct.Struct("<IHBB")
+TCP_REQUEST, TCP_RESPONSE, TCP_STATUS = 1, 2, 3
+SIM_STATUS = struct.Struct("<QIQQQIIIIII")
+
+USB_VID, USB_PID = 0x3333, 0x4005
+HID_ITF, HID_EP_OUT, HID_EP_IN = 0, 0x01, 0x81
+PACKET_SIZE = 64
+
+ID_INFO, ID_CONNECT, ID_TRANSFER_CONFIGURE, ID_TRANSFER, ID_TRANSFER_BLOCK = 0x00, 0x02, 0x04, 0x05, 0x06
+ID_SWJ_CLOCK, ID_SWJ_SEQUENCE, ID_SWD_CONFIGURE = 0x11, 0x12, 0x13
+ACK_OK = 1
+
+# ID_DAP_VENDOR_BENCH tests, see application/bench.h. probe times are TIM2 ticks.
+ID_VENDOR_BENCH = 0x8B
+BENCH_USB, BENCH_SWCLK, BENCH_SWD, BENCH_UART, BENCH_UART_STATUS = 0, 1, 2, 3, 4
+BENCH_SWCLK_MAX = 5
+BENCH_UART_BUSY, BENCH_UART_DONE = 1, 2
+BENCH_UART_ERRORS = {0: None, 1: "baud", 2: "timeout"}
+TIMER_HZ = 96000000
+DAP_OK = 0
+
+# DAP_Transfer request bits.
+APNDP, RNW, MATCH_VALUE, MATCH_MASK, TIMESTAMP = 0x01, 0x02, 0x10, 0x20, 0x80
+
+DHCSR, DCRSR, DCRDR = 0xE000EDF0, 0xE000EDF4, 0xE000EDF8
+DBGKEY = 0xA05F0000
+CSW_WORD_INC = 0x23000012
+FLASH_BASE, RAM_BASE = 0x08000000, 0x20000000
+
+
+# ----------------------------------------------------------------------------------------
+# trace files.
+
+def write_trace(path, records, packet_size=PACKET_SIZE):
+    """records: (gap_us, request, response) tuples."""
+    with open(path, "wb") as f:
+        f.write(TRACE_HEADER.pack(TRACE_MAGIC, TRACE_VERSION, packet_size, 0))
+        for gap, req, resp in records:
+            f.write(TRACE_RECORD.pack(min(gap, 0xFFFFFFFF), len(req), len(resp)) + req + resp)
+
+
+def read_trace(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    magic, version, packet_size, _ = TRACE_HEADER.unpack_from(data)
+    if magic != TRACE_MAGIC or version != TRACE_VERSION:
+        raise ValueError("%s: not a version %d dap trace" % (path, TRACE_VERSION))
+    records = []
+    pos = TRACE_HEADER.size
+    while pos + TRACE_RECORD.size <= len(data):
+        gap, req_len, resp_len = TRACE_RECORD.unpack_from(data, pos)
+        pos += TRACE_RECORD.size
+        req = data[pos:pos + req_len]
+        resp = data[pos + req_len:pos + req_len + resp_len]
+        pos += req_len + resp_len
+        records.append((gap, req, resp))
+    return packet_size, records
+
+
+# ----------------------------------------------------------------------------------------
+# probes.
+
+class TcpProbe:
+    """cmsis-dap tcp framing, with the simulator's status request when virtual is set."""
+
+    def __init__(self, host, port, virtual):
+        self.virtual = virtual
+        self.sock = socket.create_connection((host, port))
+        self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+    def _recv_exact(self, n):
+        data = b""
+        while len(data) < n:
+            chunk = self.sock.recv(n - len(data))
+            if not chunk:
+                raise ConnectionError("probe closed the connection")
+            data += chunk
+        return data
+
+    def _transact(self, ptype, payload):
+        self.sock.sendall(TCP_HEADER.pack(TCP_SIGNATURE, len(payload), ptype, 0) + payload)
+        signature, length, rtype, _ = TCP_HEADER.unpack(self._recv_exact(TCP_HEADER.size))
+        if signature != TCP_SIGNATURE:
+            raise ConnectionError("bad response header")
+        return rtype, self._recv_exact(length)
+
+    def request(self, req):
+        rtype, resp = self._transact(TCP_REQUEST, req)
+        if rtype != TCP_RESPONSE:
+            raise ConnectionError("unexpected packet type %d" % rtype)
+        return resp
+
+    def status(self):
+        if not self.virtual:
+            return None
+        rtype, payload = self._transact(TCP_STATUS, b"")
+        if rtype != TCP_STATUS or len(payload) < SIM_STATUS.size:
+            raise ConnectionError("no status from the simulator")
+        keys = ("now", "cpu_hz", "last_cycles", "swd_clocks", "swd_packet_clocks",
+                "swd_ok", "swd_wait", "swd_fault", "swd_no_ack", "usb_frames", "usb_naks")
+        return dict(zip(keys, SIM_STATUS.unpack_from(payload)))
+
+    def close(self):
+        self.sock.close()
+
+
+class UsbProbe:
+    """the probe's hid interface, one report per command."""
+
+    def __init__(self):
+        import usb.core
+        self.dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+        if self.dev is None:
+            raise ConnectionError("probe not found")
+        try:
+            if self.dev.is_kernel_driver_active(HID_ITF):
+                self.dev.detach_kernel_driver(HID_ITF)
+        except NotImplementedError:
+            pass
+
+    def request(self, req):
+        self.dev.write(HID_EP_OUT, req.ljust(PACKET_SIZE, b"\0"))
+        return bytes(self.dev.read(HID_EP_IN, PACKET_SIZE, timeout=1000))
+
+    def status(self):
+        return None
+
+    def close(self):
+        import usb.util
+        usb.util.dispose_resources(self.dev)
+
+
+def open_probe(spec):
+    if spec == "usb":
+        return UsbProbe()
+    kind, _, rest = spec.partition(":")
+    host, _, port = rest.rpartition(":")
+    if kind not in ("sim", "tcp") or not port:
+        raise ValueError("target is sim:HOST:PORT, tcp:HOST:PORT or usb")
+    return TcpProbe(host or "127.0.0.1", int(port), kind == "sim")
+
+
+def probe_info(probe):
+    """DAP_Info packet size and count, as the firmware reports them."""
+    size = probe.request(bytes((ID_INFO, 0xFE)))
+    count = probe.request(bytes((ID_INFO, 0xFF)))
+    return struct.unpack_from("<H", size, 2)[0], count[2]
+
+
+# ----------------------------------------------------------------------------------------
+# built-in workloads.
+
+def dp_r(addr):
+    return RNW | (addr & 0x0C)
+
+
+def dp_w(addr):
+    return addr & 0x0C
+
+
+def ap_r(addr):
+    return APNDP | RNW | (addr & 0x0C)
+
+
+def ap_w(addr):
+    return APNDP | (addr & 0x0C)
+
+
+TAR, DRW = 0x04, 0x0C
+
+
+def transfer(*ops):
+    """DAP_Transfer of (request, value) pairs, value None for reads."""
+    out = bytearray((ID_TRANSFER, 0, len(ops)))
+    for req, value in ops:
+        out.append(req)
+        if value is not None:
+            out += struct.pack("<I", value)
+    return bytes(out)
+
+
+def block_read(count):
+    return struct.pack("<BBHB", ID_TRANSFER_BLOCK, 0, count, ap_r(DRW))
+
+
+def block_write(words):
+    return struct.pack("<BBHB%dI" % len(words), ID_TRANSFER_BLOCK, 0, len(words), ap_w(DRW), *words)
+
+
+def connect(clock):
+    line_reset = bytes((ID_SWJ_SEQUENCE, 51)) + b"\xff" * 7
+    return [
+        bytes((ID_CONNECT, 1)),
+        struct.pack("<BI", ID_SWJ_CLOCK, clock),
+        struct.pack("<BBHH", ID_TRANSFER_CONFIGURE, 0, 64, 0),
+        bytes((ID_SWD_CONFIGURE, 0)),
+        line_reset, bytes((ID_SWJ_SEQUENCE, 16, 0x9E, 0xE7)), line_reset, bytes((ID_SWJ_SEQUENCE, 8, 0)),
+        transfer((dp_r(0x0), None)),
+        transfer((dp_w(0x0), 0x1E), (dp_w(0x8), 0), (dp_w(0x4), 0x50000000), (dp_r(0x4), None)),
+        transfer((ap_w(0x0), CSW_WORD_INC)),
+    ]
+
+
+def words_per_block(packet_size, write):
+    return (packet_size - (5 if write else 4)) // 4
+
+
+def workload_dump(args):
+    """read flash in 1KB steps (the TAR wraps there), one block read per packet."""
+    reqs = []
+    per = words_per_block(args.packet_size, False)
+    for addr in range(FLASH_BASE, FLASH_BASE + args.size, 1024):
+        reqs.append(transfer((ap_w(TAR), addr)))
+        for left in range(256, 0, -per):
+            reqs.append(block_read(min(per, left)))
+    return reqs
+
+
+def workload_flash(args):
+    """algorithm style programming: a page into the ram buffer, registers, run, poll."""
+    reqs = []
+    per = words_per_block(args.packet_size, True)
+    buf = RAM_BASE + 0x400
+    for page in range(args.size // 1024):
+        words = [((page << 16) ^ (i * 0x01010101)) & 0xFFFFFFFF for i in range(256)]
+        reqs.append(transfer((ap_w(TAR), buf)))
+        for i in range(0, 256, per):
+            reqs.append(block_write(words[i:i + per]))
+        regs = [(0, FLASH_BASE + page * 1024), (1, buf), (2, 1024), (15, RAM_BASE + 1)]
+        for i in range(0, len(regs), 2):
+            ops = []
+            for reg, value in regs[i:i + 2]:
+                ops += [(ap_w(TAR), DCRDR), (ap_w(DRW), value), (ap_w(TAR), DCRSR), (ap_w(DRW), 0x10000 | reg)]
+            reqs.append(transfer(*ops))
+        reqs.append(transfer((ap_w(TAR), DHCSR), (ap_w(DRW), DBGKEY | 0x1)))
+        for _ in range(3):
+            reqs.append(transfer((ap_w(TAR), DHCSR), (ap_r(DRW), None)))
+    return reqs
+
+
+def workload_step(args):
+    """halt, then single step and read the pc back, one packet per step."""
+    reqs = [transfer((ap_w(TAR), DHCSR), (ap_w(DRW), DBGKEY | 0x3), (ap_r(DRW), None))]
+    for _ in range(args.count):
+        reqs.append(transfer((ap_w(TAR), DHCSR), (ap_w(DRW), DBGKEY | 0x5), (ap_r(DRW), None),
+                             (ap_w(TAR), DCRSR), (ap_w(DRW), 15),
+                             (ap_w(TAR), DHCSR), (ap_r(DRW), None),
+                             (ap_w(TAR), DCRDR), (ap_r(DRW), None)))
+    return reqs
+
+
+def workload_rtt(args):
+    """poll an rtt up buffer's offsets, drain a block of data every 8th poll."""
+    cb = RAM_BASE
+    wroff = cb + 24 + 12
+    per = words_per_block(args.packet_size, False)
+    reqs = [transfer((ap_w(TAR), cb)), block_read(12)]
+    for i in range(args.count):
+        reqs.append(transfer((ap_w(TAR), wroff), (ap_r(DRW), None), (ap_r(DRW), None)))
+        if i % 8 == 7:
+            reqs.append(transfer((ap_w(TAR), cb + 0x100)))
+            reqs.append(block_read(per))
+            reqs.append(transfer((ap_w(TAR), wroff + 4), (ap_w(DRW), (i * 4) & 0x3FF)))
+    return reqs
+
+
+WORKLOADS = {"flash": workload_flash, "dump": workload_dump, "step": workload_step, "rtt": workload_rtt}
+
+
+# ----------------------------------------------------------------------------------------
+# metrics.
+
+def transfer_stats(req, resp):
+    """target data bytes moved and whether the transfer failed, for DAP_Transfer and
+    DAP_TransferBlock. other commands move no target data."""
+    if len(req) >= 3 and req[0] == ID_TRANSFER and len(resp) >= 3:
+        done, pos, moved = resp[1], 3, 0
+        for i in range(min(req[2], done)):
+            if pos >= len(req):
+                break
+            r = req[pos]
+            pos += 1
+            if r & RNW and not r & MATCH_VALUE:
+                moved += 4
+            else:
+                pos += 4
+                moved += 0 if r & (MATCH_VALUE | MATCH_MASK) else 4
+        return moved, (resp[2] & 0x07) != ACK_OK
+    if len(req) >= 5 and req[0] == ID_TRANSFER_BLOCK and len(resp) >= 4:
+        done = struct.unpack_from("<H", resp, 1)[0]
+        return 4 * done, (resp[3] & 0x07) != ACK_OK
+    return 0, False
+
+
+def swj_clock(records):
+    for _, req, _ in records:
+        if len(req) >= 5 and req[0] == ID_SWJ_CLOCK:
+            return struct.unpack_from("<I", req, 1)[0]
+    return None
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    ordered = sorted(values)
+    k = (len(ordered) - 1) * p / 100.0
+    lo = int(k)
+    hi = min(lo + 1, len(ordered) - 1)
+    return ordered[lo] + (ordered[hi] - ordered[lo]) * (k - lo)
+
+
+def replay(probe, records, check):
+    latencies = []
+    payload = errors = mismatches = 0
+    first = probe.status()
+    wall = time.perf_counter()
+    for _, req, recorded in records:
+        t0 = time.perf_counter_ns()
+        resp = probe.request(req)
+        t1 = time.perf_counter_ns()
+        st = probe.status()
+        if st:
+            latencies.append(st["last_cycles"] * 1e6 / st["cpu_hz"])
+        else:
+            latencies.append((t1 - t0) / 1e3)
+        moved, failed = transfer_stats(req, resp)
+        payload += moved
+        errors += failed
+        if check and recorded and resp[:len(recorded)] != recorded:
+            mismatches += 1
+    wall = time.perf_counter() - wall
+    last = probe.status()
+
+    result = {"commands": len(records), "time": "virtual" if last else "wall"}
+    elapsed = (last["now"] - first["now"]) / last["cpu_hz"] if last else wall
+    result["elapsed_s"] = elapsed
+    result["commands_per_s"] = len(records) / elapsed if elapsed else 0.0
+    result["payload_bytes"] = payload
+    result["payload_bytes_per_s"] = payload / elapsed if elapsed else 0.0
+    result["latency_us"] = {"mean": sum(latencies) / len(latencies) if latencies else 0.0,
+                            "p50": percentile(latencies, 50), "p90": percentile(latencies, 90),
+                            "p99": percentile(latencies, 99), "max": max(latencies, default=0.0)}
+    result["transfer_errors"] = errors
+    if check:
+        result["mismatches"] = mismatches
+    if last:
+        clocks = last["swd_clocks"] - first["swd_clocks"]
+        packet_clocks = last["swd_packet_clocks"] - first["swd_packet_clocks"]
+        clock_hz = swj_clock(records)
+        result["swd"] = {
+            "clocks": clocks,
+            "packet_clocks": packet_clocks,
+            "efficiency": packet_clocks / clocks if clocks else 0.0,       # clocks that carried packets.
+            "utilization": clocks / (elapsed * clock_hz) if clock_hz and elapsed else None, # of the set swj clock.
+            "wait": last["swd_wait"] - first["swd_wait"],
+            "fault": last["swd_fault"] - first["swd_fault"],
+            "no_ack": last["swd_no_ack"] - first["swd_no_ack"],
+        }
+        result["usb_frames"] = last["usb_frames"] - first["usb_frames"]
+    return result
+
+
+# regressions: (path, True when higher is better).
+COMPARED = (("commands_per_s", True), ("payload_bytes_per_s", True), ("latency_us.p50", False),
+            ("latency_us.p99", False), ("swd.efficiency", True))
+
+
+def lookup(result, path):
+    for key in path.split("."):
+        if not isinstance(result, dict) or result.get(key) is None:
+            return None
+        result = result[key]
+    return result
+
+
+def compare(results, baseline, tolerance):
+    regressions = []
+    for name, result in results.items():
+        base = baseline.get(name)
+        if base is None:
+            continue
+        for path, higher_better in COMPARED:
+            now, was = lookup(result, path), lookup(base, path)
+            if not now or not was:
+                continue
+            change = (now - was) / was * 100.0
+            if (change < -tolerance) if higher_better else (change > tolerance):
+                regressions.append("%s %s: %.6g -> %.6g (%+.1f%%)" % (name, path, was, now, change))
+    return regressions
+
+
+# ----------------------------------------------------------------------------------------
+# probe self-benchmarks.
+
+def bench(probe, test, payload):
+    resp = probe.request(bytes((ID_VENDOR_BENCH, test)) + payload)
+    if len(resp) < 2 or resp[0] != ID_VENDOR_BENCH:
+        raise ConnectionError("the probe has no self-benchmarks")
+    return resp[1:]
+
+
+def bench_usb(probe, packet_size, packets):
+    """full packets echoed on the dap endpoint, timed by the host and the probe."""
+    size = packet_size - 4
+    echo = min(size, packet_size - 10)
+    errors = 0
+    wall = time.perf_counter()
+    for i in range(packets):
+        payload = bytes((i + j) & 0xFF for j in range(size))
+        resp = bench(probe, BENCH_USB, bytes((1 if i == 0 else 0, size)) + payload)
+        if resp[0] != DAP_OK or resp[9:9 + echo] != payload[:echo]:
+            errors += 1
+    wall = time.perf_counter() - wall
+    count, ticks = struct.unpack_from("<II", resp, 1)
+    probe_s = ticks / TIMER_HZ
+    return {
+        "packets": packets, "packet_size": packet_size, "errors": errors,
+        "host_s": wall, "host_bytes_per_s": packets * packet_size / wall if wall else 0.0,
+        "probe_packets": count,
+        "probe_bytes_per_s": (count - 1) * packet_size / probe_s if probe_s else 0.0,
+    }
+
+
+def bench_swclk(probe, clocks, transfers):
+    """swclk reached at each setting over whole transfers, open line or not."""
+    results = []
+    for i in range(0, len(clocks), BENCH_SWCLK_MAX):
+        chunk = clocks[i:i + BENCH_SWCLK_MAX]
+        resp = bench(probe, BENCH_SWCLK, struct.pack("<HB%dI" % len(chunk), transfers, len(chunk), *chunk))
+        if resp[0] != DAP_OK:
+            raise ConnectionError("swclk test refused, is the probe connected in swd mode?")
+        for j in range(resp[1]):
+            clock, bits, ticks = struct.unpack_from("<III", resp, 2 + 12 * j)
+            results.append({"clock": clock, "swclk_hz": bits * TIMER_HZ / ticks if ticks else 0.0,
+                            "cycles": bits, "ticks": ticks})
+    return results
+
+
+def bench_swd(probe, addr, words):
+    resp = bench(probe, BENCH_SWD, struct.pack("<II", addr, words))
+    ack, done, read_ticks, write_ticks = struct.unpack_from("<BIII", resp, 1)
+    return {
+        "ok": resp[0] == DAP_OK, "ack": ack, "words": done,
+        "read_bytes_per_s": 4 * done * TIMER_HZ / read_ticks if read_ticks else 0.0,
+        "write_bytes_per_s": 4 * done * TIMER_HZ / write_ticks if write_ticks else 0.0,
+    }
+
+
+def bench_uart(probe, channel, baud, count, timeout):
+    """pattern through the uart dma rings, needs tx wired to rx."""
+    resp = bench(probe, BENCH_UART, struct.pack("<BII", channel, baud, count))
+    deadline = time.perf_counter() + timeout
+    while True:
+        status = bench(probe, BENCH_UART_STATUS, b"")
+        if status[0] != BENCH_UART_BUSY or time.perf_counter() > deadline:
+            break
+        time.sleep(0.05)
+    state, error, actual, received, mismatches, ticks, rx_errors = struct.unpack_from("<BBIIIIB", status)
+    return {
+        "ok": resp[0] == DAP_OK and state == BENCH_UART_DONE and mismatches == 0,
+        "error": BENCH_UART_ERRORS.get(error, error) if state != BENCH_UART_BUSY else "host timeout",
+        "baud": baud, "actual_baud": actual, "bytes": received, "mismatches": mismatches,
+        "rx_errors": rx_errors,
+        "bytes_per_s": received * TIMER_HZ / ticks if ticks else 0.0,
+        "line_bytes_per_s": actual / 10.0,
+    }
+
+
+# ----------------------------------------------------------------------------------------
+# commands.
+
+def cmd_generate(args):
+    os.makedirs(args.output, exist_ok=True)
+    for name in args.workload:
+        reqs = connect(args.clock) + WORKLOADS[name](args)
+        for req in reqs:
+            if len(req) > args.packet_size:
+                raise ValueError("%s: %d byte request does not fit a packet" % (name, len(req)))
+        path = os.path.join(args.output, name + ".trace")
+        write_trace(path, [(0, req, b"") for req in reqs], args.packet_size)
+        print("%s: %d commands" % (path, len(reqs)))
+    return 0
+
+
+def cmd_capture(args):
+    probe = open_probe(args.target)
+    packet_size, _ = probe_info(probe)
+    server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(("127.0.0.1", args.listen))
+    server.listen(1)
+    print("waiting for the debugger on 127.0.0.1:%d" % args.listen, file=sys.stderr)
+    conn, _ = server.accept()
+    conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    records = []
+    last = time.perf_counter()
+
+    def recv_exact(n):
+        data = b""
+        while len(data) < n:
+            chunk = conn.recv(n - len(data))
+            if not chunk:
+                return None
+            data += chunk
+        return data
+
+    try:
+        while True:
+            header = recv_exact(TCP_HEADER.size)
+            if header is None:
+                break
+            signature, length, ptype, _ = TCP_HEADER.unpack(header)
+            req = recv_exact(length) if length else b""
+            if signature != TCP_SIGNATURE or ptype != TCP_REQUEST or req is None:
+                break
+            gap = int((time.perf_counter() - last) * 1e6)
+            resp = probe.request(req)
+            conn.sendall(TCP_HEADER.pack(TCP_SIGNATURE, len(resp), TCP_RESPONSE, 0) + resp)
+            last = time.perf_counter()
+            records.append((gap, req, resp))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        conn.close()
+        server.close()
+        probe.close()
+    write_trace(args.output, records, packet_size)
+    print("%s: %d commands" % (args.output, len(records)), file=sys.stderr)
+    return 0
+
+
+def cmd_replay(args):
+    paths = [p for pattern in args.traces for p in (sorted(glob.glob(pattern)) or [pattern])]
+    probe = open_probe(args.target)
+    packet_size, packet_count = probe_info(probe)
+    results = {}
+    for path in paths:
+        trace_size, records = read_trace(path)
+        if trace_size > packet_size:
+            print("%s: captured with %d byte packets, the probe takes %d" % (path, trace_size, packet_size), file=sys.stderr)
+        name = os.path.splitext(os.path.basename(path))[0]
+        for _ in range(args.warmup):
+            replay(probe, records, False)
+        results[name] = replay(probe, records, args.check)
+    probe.close()
+
+    report = {"target": args.target, "packet_size": packet_size, "packet_count": packet_count, "results": results}
+    text = json.dumps(report, indent=2, sort_keys=True)
+    if args.json:
+        with open(args.json, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+    if args.baseline:
+        with open(args.baseline) as f:
+            baseline = json.load(f).get("results", {})
+        regressions = compare(results, baseline, args.tolerance)
+        for line in regressions:
+            print("regression: " + line, file=sys.stderr)
+        return 1 if regressions else 0
+    return 0
+
+
+def cmd_selftest(args):
+    probe = open_probe(args.target)
+    packet_size, packet_count = probe_info(probe)
+    results = {}
+    try:
+        if "usb" in args.test:
+            results["usb"] = bench_usb(probe, packet_size, args.packets)
+        if "swclk" in args.test or "swd" in args.test:
+            for req in connect(args.clocks[0]):
+                probe.request(req)
+        if "swclk" in args.test:
+            results["swclk"] = bench_swclk(probe, args.clocks, args.transfers)
+        if "swd" in args.test:
+            probe.request(struct.pack("<BI", ID_SWJ_CLOCK, args.swd_clock))
+            results["swd"] = bench_swd(probe, args.swd_addr, args.swd_words)
+        if "uart" in args.test:
+            results["uart"] = bench_uart(probe, args.uart_channel, args.uart_baud, args.uart_bytes, args.uart_timeout)
+    finally:
+        probe.close()
+
+    report = {"target": args.target, "packet_size": packet_size, "packet_count": packet_count, "results": results}
+    text = json.dumps(report, indent=2, sort_keys=True)
+    if args.json:
+        with open(args.json, "w") as f:
+            f.write(text + "\n")
+    else:
+        print(text)
+    failed = [name for name, result in results.items() if isinstance(result, dict) and not result.get("ok", True)]
+    return 1 if failed else 0
+
+
+def cmd_info(args):
+    for path in args.traces:
+        packet_size, records = read_trace(path)
+        ids = {}
+        for _, req, _ in records:
+            if req:
+                ids[req[0]] = ids.get(req[0], 0) + 1
+        gaps = sum(g for g, _, _ in records) / 1e6
+        print("%s: %d commands, %d byte packets, %.3f s host gaps, %s" % (
+            path, len(records), packet_size, gaps, " ".join("%02x:%d" % i for i in sorted(ids.items()))))
+    return 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    sub = parser.add_subparsers(dest="command", required=True)
+
+    p = sub.add_parser("generate", help="write the built-in workloads")
+    p.add_argument("-o", "--output", default=".", help="directory for the traces")
+    p.add_argument("--workload", nargs="+", choices=sorted(WORKLOADS), default=sorted(WORKLOADS))
+    p.add_argument("--size", type=lambda s: int(s, 0), default=16384, help="bytes for flash and dump")
+    p.add_argument("--count", type=int, default=500, help="steps for step, polls for rtt")
+    p.add_argument("--clock", type=int, default=4000000, help="swj clock in Hz")
+    p.add_argument("--packet-size", type=int, default=PACKET_SIZE)
+    p.set_defaults(fn=cmd_generate)
+
+    p = sub.add_parser("capture", help="record a debugger session through a tcp proxy")
+    p.add_argument("-o", "--output", required=True)
+    p.add_argument("--listen", type=int, default=4442, help="port the debugger connects to")
+    p.add_argument("--target", default="sim:127.0.0.1:4441")
+    p.set_defaults(fn=cmd_capture)
+
+    p = sub.add_parser("replay", help="replay traces and report")
+    p.add_argument("traces", nargs="+")
+    p.add_argument("--target", default="sim:127.0.0.1:4441")
+    p.add_argument("--json", help="write the report here instead of stdout")
+    p.add_argument("--baseline", help="report of an earlier run, exit 1 on regressions")
+    p.add_argument("--tolerance", type=float, default=5.0, help="allowed change in percent")
+    p.add_argument("--warmup", type=int, default=0, help="unmeasured runs before each trace")
+    p.add_argument("--check", action="store_true", help="count responses that differ from the recorded ones")
+    p.set_defaults(fn=cmd_replay)
+
+    p = sub.add_parser("info", help="summarize traces")
+    p.add_argument("traces", nargs="+")
+    p.set_defaults(fn=cmd_info)
+
+    p = sub.add_parser("selftest", help="run the probe's own usb, swd and uart benchmarks")
+    p.add_argument("--target", default="usb", help="sim:HOST:PORT, tcp:HOST:PORT or usb")
+    p.add_argument("--test", nargs="+", choices=("usb", "swclk", "swd", "uart"), default=["usb", "swclk", "swd"])
+    p.add_argument("--packets", type=int, default=1000, help="usb loopback packets")
+    p.add_argument("--clocks", type=lambda s: [int(c) for c in s.split(",")],
+                   default=[100000, 1000000, 2000000, 4000000, 8000000, 12000000], help="swj clocks, HZ[,HZ..]")
+    p.add_argument("--transfers", type=int, default=200, help="transfers timed per clock")
+    p.add_argument("--swd-clock", type=int, default=10000000, help="swj clock for the block test")
+    p.add_argument("--swd-addr", type=lambda s: int(s, 0), default=RAM_BASE, help="target ram, read and written back")
+    p.add_argument("--swd-words", type=lambda s: int(s, 0), default=1024)
+    p.add_argument("--uart-channel", type=int, default=0, help="serial channel with tx wired to rx")
+    p.add_argument("--uart-baud", type=int, default=115200)
+    p.add_argument("--uart-bytes", type=lambda s: int(s, 0), default=4096)
+    p.add_argument("--uart-timeout", type=float, default=10.0, help="seconds to wait for the loopback")
+    p.add_argument("--json", help="write the report here instead of stdout")
+    p.set_defaults(fn=cmd_selftest)
+
+    args = parser.parse_args()
+    return args.fn(args)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
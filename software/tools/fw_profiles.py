@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2023 UnsicentificLaLaLaLa
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""Firmware optimisation profiles: build each one, compare code size and swd timing.
+
+Every profile is a separate arm-none-eabi build of tiny-dap.elf (platform/mm32f0160/firmware.cmake)
+in its own build directory, MM32_OPT_PROFILE split, speed or size, each with and without lto:
+    fw_profiles.py --build-dir _profiles
+    fw_profiles.py --build-dir _profiles --profile split+lto split size+lto --json profiles.json
+
+Code size comes from arm-none-eabi-size -A: flash is everything loaded from flash, .ramfunc
+included, sram the copied .ramfunc and .data plus .bss. With --swd-cycles pointing at the host
+build of platform/host/swd_cycles.c every image is also run through the cycle harness, which
+reports the swclk reached and the block read / write cycles per word for each --clock.
+The first profile is the baseline the others are compared against, in percent.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+
+TOOLCHAIN_FILE = os.path.join("platform", "mm32f0160", "device", "gcc", "arm-none-eabi.cmake")
+PROFILES = ["split+lto", "split", "speed+lto", "speed", "size+lto", "size"]
+
+# sections of size -A that stay in flash, the ones copied to sram and the zero filled ones.
+FLASH_SECTIONS = (".interrupts", ".text", ".rodata", ".ARM.exidx", ".ARM.extab",
+                  ".preinit_array", ".init_array", ".fini_array")
+COPIED_SECTIONS = (".ramfunc", ".data")
+ZERO_SECTIONS = (".bss",)
+
+# report columns: name, path into a result, format.
+COLUMNS = [
+    ("flash", "size.flash", "%d"),
+    ("ramfunc", "size.ramfunc", "%d"),
+    ("sram", "size.sram", "%d"),
+]
+CLOCK_COLUMNS = [
+    ("swclk", "swclk_hz", "%.0f"),
+    ("rd/word", "block_read", "%.1f"),
+    ("wr/word", "block_write", "%.1f"),
+]
+
+
+def tool(args, name):
+    return os.path.join(args.toolchain_dir, "arm-none-eabi-" + name) if args.toolchain_dir else "arm-none-eabi-" + name
+
+
+def build(args, profile):
+    opt, _, lto = profile.partition("+")
+    directory = os.path.join(args.build_dir, profile.replace("+", "-"))
+    env = dict(os.environ)
+    if args.toolchain_dir:
+        env["ARM_TOOLCHAIN_DIR"] = args.toolchain_dir
+    configure = ["cmake", "-S", args.source, "-B", directory,
+                 "-DCMAKE_TOOLCHAIN_FILE=" + os.path.join(os.path.abspath(args.source), TOOLCHAIN_FILE),
+                 "-DMM32_OPT_PROFILE=" + opt, "-DMM32_LTO=" + ("ON" if lto == "lto" else "OFF")]
+    for command in (configure, ["cmake", "--build", directory, "-j", str(args.jobs)]):
+        out = subprocess.run(command, env=env, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+        if out.returncode:
+            sys.stderr.write(out.stdout)
+            raise RuntimeError("%s: %s failed" % (profile, command[1]))
+    return os.path.join(directory, "tiny-dap.elf")
+
+
+def section_sizes(args, elf):
+    out = subprocess.run([tool(args, "size"), "-A", elf], stdout=subprocess.PIPE, universal_newlines=True, check=True)
+    sections = {}
+    for line in out.stdout.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[0].startswith(".") and fields[1].isdigit():
+            sections[fields[0]] = int(fields[1])
+    copied = sum(sections.get(s, 0) for s in COPIED_SECTIONS)
+    return {
+        "flash": sum(sections.get(s, 0) for s in FLASH_SECTIONS) + copied,
+        "ramfunc": sections.get(".ramfunc", 0),
+        "sram": copied + sum(sections.get(s, 0) for s in ZERO_SECTIONS),
+        "sections": sections,
+    }
+
+
+def swd_timing(args, elf):
+    command = [args.swd_cycles, "--json"]
+    if args.clock:
+        command += ["--clock", args.clock]
+    out = subprocess.run(command + [elf], stdout=subprocess.PIPE, universal_newlines=True, check=True)
+    report = json.loads(out.stdout)
+    clocks = {}
+    for entry in report["clocks"]:
+        commands = entry.get("commands", {})
+        clocks[str(entry["clock"])] = {
+            "cycles_per_bit": entry["cycles_per_bit"]["median"],
+            "swclk_hz": entry["swclk_hz"],
+            "block_read": commands.get("block_read", {}).get("cycles_per_word"),
+            "block_write": commands.get("block_write", {}).get("cycles_per_word"),
+        }
+    return clocks
+
+
+def lookup(result, path):
+    for key in path.split("."):
+        if not isinstance(result, dict) or result.get(key) is None:
+            return None
+        result = result[key]
+    return result
+
+
+def cell(result, base, path, fmt):
+    now, was = lookup(result, path), lookup(base, path)
+    if now is None:
+        return "-"
+    text = fmt % now
+    if result is not base and was:
+        change = (now - was) / was * 100.0
+        text += " (%+.1f%%)" % change
+    return text
+
+
+def print_table(results, profiles):
+    base = results[profiles[0]]
+    headers = ["profile"] + [c[0] for c in COLUMNS]
+    clocks = sorted(base.get("swd", {}), key=int)
+    for clock in clocks:
+        headers += ["%s %s" % (name, clock) for name, _, _ in CLOCK_COLUMNS]
+    rows = [headers]
+    for profile in profiles:
+        result = results[profile]
+        row = [profile] + [cell(result, base, path, fmt) for _, path, fmt in COLUMNS]
+        for clock in clocks:
+            row += [cell(result, base, "swd.%s.%s" % (clock, path), fmt) for _, path, fmt in CLOCK_COLUMNS]
+        rows.append(row)
+    widths = [max(len(row[i]) for row in rows) for i in range(len(headers))]
+    for row in rows:
+        print("  ".join(text.ljust(widths[i]) if 0 == i else text.rjust(widths[i]) for i, text in enumerate(row)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--source", default=os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir),
+                        help="the software directory with the top CMakeLists.txt")
+    parser.add_argument("--build-dir", default="_profiles", help="one sub directory per profile goes here")
+    parser.add_argument("--profile", nargs="+", choices=PROFILES, default=PROFILES, help="first one is the baseline")
+    parser.add_argument("--toolchain-dir", help="directory of the arm-none-eabi tools, else the PATH")
+    parser.add_argument("--swd-cycles", help="host swd-cycles binary, times every image when given")
+    parser.add_argument("--clock", default="1000000,10000000", help="swd clocks for swd-cycles, HZ[,HZ..]")
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count() or 1)
+    parser.add_argument("--json", help="write the results here as well")
+    args = parser.parse_args()
+
+    results = {}
+    for profile in args.profile:
+        elf = build(args, profile)
+        result = {"elf": elf, "size": section_sizes(args, elf)}
+        if args.swd_cycles:
+            result["swd"] = swd_timing(args, elf)
+        results[profile] = result
+        print("%s: %d bytes flash, %d bytes sram" % (profile, result["size"]["flash"], result["size"]["sram"]), file=sys.stderr)
+
+    print_table(results, args.profile)
+    if args.json:
+        with open(args.json, "w") as f:
+            f.write(json.dumps({"baseline": args.profile[0], "results": results}, indent=2, sort_keys=True) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
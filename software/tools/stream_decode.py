@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2023 UnsicentificLaLaLaLa
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""Reference decoder for the tiny-dap stream channel (application/stream.h).
+
+IN packets are always 64 bytes and hold whole frames: channel (1), length (1),
+data. Channel 0xFF pads the rest of a packet. Each channel is a byte stream;
+the record channels carry type (1), length (1), payload records that may span
+frames. OUT is a plain frame stream, channel 0 takes 4-byte control messages.
+
+Decode a raw capture:   stream_decode.py --file capture.bin
+Read a live probe:      stream_decode.py --usb [--credit 3=4096] [--priority 2=0]
+"""
+
+import argparse
+import struct
+import sys
+
+PACKET_SIZE = 64
+
+CH_CONTROL, CH_EVENT, CH_SAMPLING, CH_UART = range(4)
+CH_ISP = 6
+CH_PAD = 0xFF
+CH_NAMES = {CH_EVENT: "event", CH_SAMPLING: "sampling", CH_UART: "uart"}
+RECORD_CHANNELS = (CH_EVENT, CH_SAMPLING, CH_UART)
+
+CTRL_CREDIT, CTRL_PRIORITY, CTRL_RESET = 0x01, 0x02, 0x03
+
+TYPE_HALT, TYPE_FAULT, TYPE_PROFILE, TYPE_SERIAL = 0x01, 0x02, 0x03, 0x04
+
+USB_VID, USB_PID = 0x3333, 0x4005
+USB_ITF, USB_EP_OUT, USB_EP_IN = 3, 0x04, 0x84
+
+FAULT_NAMES = ("timestamp", "cfsr", "hfsr", "dfsr", "mmfar", "bfar", "lr", "pc", "xpsr", "msp", "psp",
+               "r0", "r1", "r2", "r3", "r12", "lr_stacked", "pc_stacked", "xpsr_stacked")
+
+
+def frame(channel, data):
+    """OUT frames for a channel, split at 255 bytes."""
+    out = bytearray()
+    for i in range(0, max(len(data), 1), 255):
+        chunk = data[i:i + 255]
+        out += bytes((channel, len(chunk))) + chunk
+    return bytes(out)
+
+
+def control(op, channel, value):
+    return frame(CH_CONTROL, struct.pack("<BBH", op, channel, value))
+
+
+class Decoder:
+    """Feed IN packets, get (channel, item) back. item is a record tuple
+    (type, payload) on record channels and raw bytes elsewhere."""
+
+    def __init__(self):
+        self.pending = {}
+
+    def feed(self, data):
+        for i in range(0, len(data) - len(data) % PACKET_SIZE, PACKET_SIZE):
+            yield from self._packet(data[i:i + PACKET_SIZE])
+
+    def _packet(self, packet):
+        pos = 0
+        while pos + 2 <= len(packet):
+            channel, length = packet[pos], packet[pos + 1]
+            if channel == CH_PAD:
+                return
+            data = packet[pos + 2:pos + 2 + length]
+            pos += 2 + length
+            if channel in RECORD_CHANNELS:
+                yield from self._records(channel, data)
+            else:
+                yield channel, bytes(data)
+
+    def _records(self, channel, data):
+        buf = self.pending.setdefault(channel, bytearray())
+        buf += data
+        while len(buf) >= 2 and len(buf) >= 2 + buf[1]:
+            rtype, length = buf[0], buf[1]
+            yield channel, (rtype, bytes(buf[2:2 + length]))
+            del buf[:2 + length]
+
+
+def format_record(rtype, payload, timer_hz):
+    def ts(t):
+        return "%12.6f" % (t / timer_hz)
+
+    if rtype == TYPE_HALT and len(payload) == 16:
+        t, dhcsr, dfsr, pc = struct.unpack("<4I", payload)
+        return "%s halt  dhcsr=%08x dfsr=%08x pc=%08x" % (ts(t), dhcsr, dfsr, pc)
+    if rtype == TYPE_FAULT and len(payload) == 4 * len(FAULT_NAMES):
+        words = struct.unpack("<%dI" % len(FAULT_NAMES), payload)
+        regs = " ".join("%s=%08x" % (n, v) for n, v in zip(FAULT_NAMES[1:], words[1:]))
+        return "%s fault %s" % (ts(words[0]), regs)
+    if rtype == TYPE_PROFILE and len(payload) >= 8:
+        t, samples, other = struct.unpack_from("<IHH", payload)
+        bins = [struct.unpack_from("<BH", payload, i) for i in range(8, len(payload) - 2, 3)]
+        return "%s prof  samples=%d other=%d %s" % (ts(t), samples, other, " ".join("%d:%d" % b for b in bins))
+    if rtype == TYPE_SERIAL and len(payload) >= 10:
+        t, channel, flags, offset = struct.unpack_from("<IBBI", payload)
+        marks = ("idle " if flags & 1 else "") + ("polled " if flags & 2 else "")
+        return "%s uart%d @%-8d %s%r" % (ts(t), channel, offset, marks, payload[10:])
+    return "type %02x: %s" % (rtype, payload.hex())
+
+
+def print_items(items, timer_hz):
+    for channel, item in items:
+        if isinstance(item, tuple):
+            print(format_record(item[0], item[1], timer_hz))
+        else:
+            print("%-8s %s" % (CH_NAMES.get(channel, "ch%d" % channel), item.hex()))
+
+
+def parse_pairs(values):
+    return [tuple(int(x, 0) for x in v.split("=", 1)) for v in values]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--file", help="raw IN capture, a multiple of 64 bytes")
+    source.add_argument("--usb", action="store_true", help="read from the probe with pyusb")
+    parser.add_argument("--save", help="also write the raw IN data to this file")
+    parser.add_argument("--credit", action="append", default=[], metavar="CH=BYTES", help="switch a channel to credit flow control")
+    parser.add_argument("--priority", action="append", default=[], metavar="CH=PRIO", help="set a channel priority")
+    parser.add_argument("--timer-hz", type=float, default=96e6, help="probe timer frequency")
+    args = parser.parse_args()
+
+    decoder = Decoder()
+    if args.file:
+        with open(args.file, "rb") as f:
+            print_items(decoder.feed(f.read()), args.timer_hz)
+        return 0
+
+    import usb.core
+    dev = usb.core.find(idVendor=USB_VID, idProduct=USB_PID)
+    if dev is None:
+        print("probe not found", file=sys.stderr)
+        return 1
+    out = b"".join(control(CTRL_PRIORITY, ch, prio) for ch, prio in parse_pairs(args.priority))
+    out += b"".join(control(CTRL_CREDIT, ch, n) for ch, n in parse_pairs(args.credit))
+    if out:
+        dev.write(USB_EP_OUT, out)
+    save = open(args.save, "wb") if args.save else None
+    credits = dict(parse_pairs(args.credit))
+    try:
+        while True:
+            try:
+                data = bytes(dev.read(USB_EP_IN, 16 * PACKET_SIZE, timeout=1000))
+            except usb.core.USBTimeoutError:
+                continue
+            if save:
+                save.write(data)
+            items = list(decoder.feed(data))
+            print_items(items, args.timer_hz)
+            # hand consumed credit back so flow-controlled channels keep going.
+            for ch in credits:
+                used = sum(len(i) if isinstance(i, bytes) else 2 + len(i[1]) for c, i in items if c == ch)
+                if used:
+                    dev.write(USB_EP_OUT, control(CTRL_CREDIT, ch, min(used, 0xFFFF)))
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if save:
+            save.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
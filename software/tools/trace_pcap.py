@@ -0,0 +1,249 @@
+#!/usr/bin/env python3
+#
+# MIT License
+#
+# Copyright (c) 2023 UnsicentificLaLaLaLa
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+#
+
+"""Download the probe's usb / dap event trace and write it as pcapng or pcap.
+
+The firmware keeps two rings of timestamped events (application/trace.h): one recorded by the
+usb interrupt (tokens, bus reset, suspend, resume, stalls) and one by thread mode (transfers
+queued, endpoint stalls, set address, dap command start and end). ID_DAP_VENDOR_TRACE reads
+them, recording is paused meanwhile unless --live is given.
+
+    trace_pcap.py --target usb -o trace.pcapng
+    trace_pcap.py --target sim:127.0.0.1:4441 --text
+    trace_pcap.py --target usb --pcap -o trace.pcap
+
+Every event is one packet of link type USER0 (147), all little endian:
+  sequence (4), TIM2 ticks (4), ring (1), type (1), arg (1), reserved (1), value (2)
+pcapng has an interface per ring and a comment per packet that spells the event out, which
+wireshark shows without a dissector. Ticks are unwrapped backwards from the download time,
+gaps of more than a timer period (~44 s) between two events of a ring come out short.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from dap_bench import open_probe  # noqa: E402
+
+ID_VENDOR_TRACE = 0x8C
+TRACE_FLAG_PAUSE = 0x01
+DAP_OK = 0
+TIMER_HZ = 96000000
+RESPONSE = struct.Struct("<BBIIIB")   # id, status, head, now, first, count.
+EVENT = struct.Struct("<IBBH")
+PACKET = struct.Struct("<IIBBBBH")
+LINKTYPE_USER0 = 147
+
+RINGS = ("usb irq", "thread")
+
+TOKEN, RESET, SUSPEND, RESUME, STALL, XFER, XFER_BUSY, EP_STALL, ADDRESS = range(1, 10)
+DAP_START, DAP_END = 0x10, 0x11
+PIDS = {0x1: "OUT", 0x9: "IN", 0xD: "SETUP"}
+DAP_COMMANDS = {
+    0x00: "DAP_Info", 0x01: "DAP_HostStatus", 0x02: "DAP_Connect", 0x03: "DAP_Disconnect",
+    0x04: "DAP_TransferConfigure", 0x05: "DAP_Transfer", 0x06: "DAP_TransferBlock",
+    0x07: "DAP_TransferAbort", 0x08: "DAP_WriteABORT", 0x09: "DAP_Delay", 0x0A: "DAP_ResetTarget",
+    0x10: "DAP_SWJ_Pins", 0x11: "DAP_SWJ_Clock", 0x12: "DAP_SWJ_Sequence", 0x13: "DAP_SWD_Configure",
+    0x1D: "DAP_SWD_Sequence", 0x17: "DAP_SWO_Transport", 0x18: "DAP_SWO_Mode", 0x19: "DAP_SWO_Baudrate",
+    0x1A: "DAP_SWO_Control", 0x1B: "DAP_SWO_Status", 0x1C: "DAP_SWO_Data", 0x7E: "DAP_QueueCommands",
+    0x7F: "DAP_ExecuteCommands",
+}
+
+
+# ----------------------------------------------------------------------------------------
+# download.
+
+def download(probe, ring, flags):
+    """events of one ring as (sequence, ticks, type, arg, value), plus its head, now and the
+    host time of the first response."""
+    events = []
+    first = 0
+    stamp = None
+    while True:
+        resp = probe.request(struct.pack("<BBBI", ID_VENDOR_TRACE, ring, flags, first))
+        if len(resp) < RESPONSE.size or resp[0] != ID_VENDOR_TRACE or resp[1] != DAP_OK:
+            raise ConnectionError("the probe has no event trace")
+        _, _, head, now, got, count = RESPONSE.unpack_from(resp)
+        if stamp is None:
+            stamp = (time.time(), now)
+        for i in range(count):
+            ticks, etype, arg, value = EVENT.unpack_from(resp, RESPONSE.size + EVENT.size * i)
+            events.append((got + i, ticks, etype, arg, value))
+        first = got + count
+        if count == 0 or first >= head:
+            return events, stamp
+
+
+def unwrap(events, stamp):
+    """absolute host times, walking back from the sample of TIM2 taken at download."""
+    wall, now = stamp
+    out = []
+    age = None
+    for seq, ticks, etype, arg, value in reversed(events):
+        age = ((now - ticks) & 0xFFFFFFFF) if age is None else age + ((prev - ticks) & 0xFFFFFFFF)
+        prev = ticks
+        out.append((wall - age / TIMER_HZ, seq, ticks, etype, arg, value))
+    out.reverse()
+    return out
+
+
+# ----------------------------------------------------------------------------------------
+# decoding.
+
+def describe(etype, arg, value):
+    ep = "ep 0x%02x" % arg
+    if etype == TOKEN:
+        pid = PIDS.get(value >> 12, "pid 0x%x" % (value >> 12))
+        return "%s %s %d bytes, bd %s, next DATA%d" % (pid, ep, value & 0x3FF, "odd" if value & 0x400 else "even",
+                                                       (value >> 11) & 1)
+    if etype == RESET:
+        return "bus reset"
+    if etype == SUSPEND:
+        return "suspend"
+    if etype == RESUME:
+        return "resume"
+    if etype == STALL:
+        return "stall handshake on ep 0"
+    if etype == XFER:
+        return "xfer %s %d bytes" % (ep, value)
+    if etype == XFER_BUSY:
+        return "xfer %s %d bytes refused, bd busy" % (ep, value)
+    if etype == EP_STALL:
+        return "%s %s" % ("stall" if value else "clear stall", ep)
+    if etype == ADDRESS:
+        return "set address %d" % arg
+    name = DAP_COMMANDS.get(arg, "vendor 0x%02x" % arg if arg >= 0x80 else "command 0x%02x" % arg)
+    if etype == DAP_START:
+        return "%s start, %02x %02x" % (name, value & 0xFF, value >> 8)
+    if etype == DAP_END:
+        return "%s end, %d response bytes" % (name, value)
+    return "event 0x%02x arg 0x%02x value 0x%04x" % (etype, arg, value)
+
+
+def annotate(rings):
+    """merge the rings in time order, with a text per event and dap command durations."""
+    merged = []
+    for ring, events in enumerate(rings):
+        started = {}
+        last = None
+        for t, seq, ticks, etype, arg, value in events:
+            text = describe(etype, arg, value)
+            if last is not None and seq != last + 1:
+                text += " (%d events lost before)" % (seq - last - 1)
+            last = seq
+            if etype == DAP_START:
+                started[arg] = ticks
+            elif etype == DAP_END and arg in started:
+                text += ", %.1f us" % (((ticks - started.pop(arg)) & 0xFFFFFFFF) * 1e6 / TIMER_HZ)
+            merged.append((t, ring, seq, ticks, etype, arg, value, text))
+    merged.sort(key=lambda e: (e[0], e[1], e[2]))
+    return merged
+
+
+# ----------------------------------------------------------------------------------------
+# output.
+
+def pad4(data):
+    return data + b"\0" * (-len(data) % 4)
+
+
+def option(code, value):
+    return struct.pack("<HH", code, len(value)) + pad4(value)
+
+
+def block(btype, body):
+    length = 12 + len(body)
+    return struct.pack("<II", btype, length) + body + struct.pack("<I", length)
+
+
+def payload(ring, seq, ticks, etype, arg, value):
+    return PACKET.pack(seq, ticks, ring, etype, arg, 0, value)
+
+
+def write_pcapng(f, merged):
+    f.write(block(0x0A0D0D0A, struct.pack("<IHHq", 0x1A2B3C4D, 1, 0, -1)
+                  + option(4, b"trace_pcap.py") + option(0, b"")))
+    for name in RINGS:
+        f.write(block(1, struct.pack("<HHI", LINKTYPE_USER0, 0, 0)
+                      + option(2, ("tiny-dap " + name).encode()) + option(9, b"\x09") + option(0, b"")))
+    for t, ring, seq, ticks, etype, arg, value, text in merged:
+        ns = int(t * 1e9)
+        data = payload(ring, seq, ticks, etype, arg, value)
+        f.write(block(6, struct.pack("<IIIII", ring, ns >> 32, ns & 0xFFFFFFFF, len(data), len(data))
+                      + pad4(data) + option(1, text.encode()) + option(0, b"")))
+
+
+def write_pcap(f, merged):
+    f.write(struct.pack("<IHHiIII", 0xA1B23C4D, 2, 4, 0, 0, 65535, LINKTYPE_USER0))  # ns timestamps.
+    for t, ring, seq, ticks, etype, arg, value, _ in merged:
+        ns = int(t * 1e9)
+        data = payload(ring, seq, ticks, etype, arg, value)
+        f.write(struct.pack("<IIII", ns // 1000000000, ns % 1000000000, len(data), len(data)) + data)
+
+
+def write_text(f, merged):
+    start = merged[0][0] if merged else 0.0
+    for t, ring, seq, _, _, _, _, text in merged:
+        f.write("%12.6f  %-7s %8d  %s\n" % (t - start, RINGS[ring], seq, text))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--target", default="usb", help="sim:HOST:PORT, tcp:HOST:PORT or usb")
+    parser.add_argument("-o", "--output", help="capture file, default trace.pcapng or trace.pcap")
+    parser.add_argument("--pcap", action="store_true", help="classic pcap, one interface, no comments")
+    parser.add_argument("--text", action="store_true", help="print the merged timeline instead")
+    parser.add_argument("--live", action="store_true", help="keep recording while downloading")
+    args = parser.parse_args()
+
+    probe = open_probe(args.target)
+    flags = 0 if args.live else TRACE_FLAG_PAUSE
+    try:
+        rings = []
+        for ring in range(len(RINGS)):
+            events, stamp = download(probe, ring, flags)
+            rings.append(unwrap(events, stamp))
+    finally:
+        if not args.live:
+            probe.request(struct.pack("<BBBI", ID_VENDOR_TRACE, 0, 0, 0xFFFFFFFF))  # resume recording.
+        probe.close()
+    merged = annotate(rings)
+
+    if args.text:
+        write_text(sys.stdout, merged)
+        return 0
+    output = args.output or ("trace.pcap" if args.pcap else "trace.pcapng")
+    with open(output, "wb") as f:
+        (write_pcap if args.pcap else write_pcapng)(f, merged)
+    print("%s: %d events, %s" % (output, len(merged), ", ".join(
+        "%s %d" % (name, len(events)) for name, events in zip(RINGS, rings))), file=sys.stderr)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())